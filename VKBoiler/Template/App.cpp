@@ -2,8 +2,13 @@
 
 #define OUT_CODE(condition) if(!condition) { m_Running = false; return false; }
 
-#include <vulkan/vulkan_win32.h>
 #include <vector>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#undef max
+#undef min
 
 bool VulkanApp::BaseInit()
 {
@@ -11,12 +16,84 @@ bool VulkanApp::BaseInit()
 	PreDeviceSetupParameters params = {};
 	PreDeviceSetup(params);
 
+	if (params.UseHostAllocationCallbacks)
+		m_pAllocator = m_HostAllocator.GetCallbacks();
+	m_ReportHostAllocations = params.UseHostAllocationCallbacks && params.EnableDeviceDebugging;
+
 	// Own init code
+	OUT_CODE(InitializeLoader());
 	OUT_CODE(CreateInstance(params))
+	LoadInstanceFunctions(m_Instance);
 	OUT_CODE(CreateWindow(params));
 	OUT_CODE(CreateSurface());
 	OUT_CODE(PickPhysicalDevice(params));
 	OUT_CODE(CreateLogicalDevice(params));
+	// From here on device calls skip the loader trampolines
+	LoadDeviceFunctions(m_Device);
+	m_FramePacer.Init(m_Device, m_OptionalFeatures.PresentWait, params.TargetFrameRate, params.MaxQueuedFrames);
+	m_DamageTracker.SetIncrementalPresent(m_OptionalFeatures.IncrementalPresent);
+	m_LayoutCache.Init(m_Device, m_pAllocator);
+	m_ShaderVariants.Init(m_Device, m_pAllocator);
+	if (!params.ShaderLibraryPath.empty())
+		OUT_CODE(m_ShaderLibrary.Open(params.ShaderLibraryPath));
+	// Pipeline libraries accept SPIR-V chained into the stage, so the library can skip module objects
+	m_ShaderLibrary.SetInlineModules(m_OptionalFeatures.GraphicsPipelineLibrary);
+	m_PipelineBuilder.Init(m_Device, m_pAllocator, &m_ShaderLibrary, m_OptionalFeatures.GraphicsPipelineLibrary,
+		m_OptionalFeatures.DynamicRendering, m_OptionalFeatures.DynamicState, params.MaxQueuedFrames + 1);
+	VkShaderStageFlags graphicsStages = 0;
+	if (params.EnabledDeviceFeatures.tessellationShader)
+		graphicsStages |= VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT | VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
+	if (params.EnabledDeviceFeatures.geometryShader)
+		graphicsStages |= VK_SHADER_STAGE_GEOMETRY_BIT;
+	if (m_OptionalFeatures.MeshShader)
+		graphicsStages |= VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT;
+	m_ShaderObjects.Init(m_Device, m_pAllocator, &m_ShaderLibrary, &m_LayoutCache, m_OptionalFeatures.ShaderObject, graphicsStages);
+	OUT_CODE(m_DrawQueue.Init(m_Device, m_PhysDevice, m_pAllocator, params.MaxQueuedFrames + 1,
+		m_OptionalFeatures.MultiDrawIndirect ? params.DrawQueueIndirectCapacity : 0));
+	if (params.EnableGpuCulling || params.EnableOcclusionCulling)
+	{
+		bool supported = m_OptionalFeatures.DrawIndirectCount && m_OptionalFeatures.MultiDrawIndirect;
+		if (!supported)
+			printf("GPU culling disabled, the device lacks drawIndirectCount or multiDrawIndirect\n");
+		uint32_t graphicsFamily = FindQueueFamily(VK_QUEUE_GRAPHICS_BIT, 0);
+		uint32_t computeFamily = FindQueueFamily(VK_QUEUE_COMPUTE_BIT, VK_QUEUE_GRAPHICS_BIT);
+		if (computeFamily == UINT32_MAX)
+			computeFamily = graphicsFamily;
+		if (graphicsFamily == UINT32_MAX)
+			graphicsFamily = computeFamily;
+		OUT_CODE(m_GpuCulling.Init(m_Device, m_PhysDevice, m_pAllocator, &m_ShaderLibrary, &m_LayoutCache,
+			supported && params.EnableGpuCulling, computeFamily, graphicsFamily, params.MaxQueuedFrames + 1, params.GpuCullingMaxInstances));
+		OUT_CODE(m_OcclusionCulling.Init(m_Device, m_PhysDevice, m_pAllocator, &m_ShaderLibrary, &m_LayoutCache,
+			supported && params.EnableOcclusionCulling, computeFamily, graphicsFamily, params.MaxQueuedFrames + 1, params.GpuCullingMaxInstances));
+	}
+	OUT_CODE(m_Meshlets.Init(m_Device, m_PhysDevice, m_pAllocator, &m_ShaderLibrary, &m_LayoutCache, params.EnableMeshlets,
+		m_OptionalFeatures.MeshShader, params.MaxQueuedFrames + 1));
+	if (params.EnableSoftwareOcclusion)
+		m_SoftwareOcclusion.Init(params.SoftwareOcclusionWidth, params.SoftwareOcclusionHeight);
+	// Rebuilt pipelines have to be picked up even when rendering on demand
+	if (params.EnableShaderHotReload)
+		OUT_CODE(m_ShaderHotReload.Start(m_Device, m_pAllocator, params.MaxQueuedFrames + 1, [this]() { Invalidate(); }));
+
+	if (params.BenchmarkDispatch)
+	{
+		uint32_t family = m_QueueIndices.empty() || m_QueueIndices[0].FamilyCount == 0 ? 0 : m_QueueIndices[0].Families[0];
+		DispatchBenchmarkResult result{};
+		BenchmarkDeviceDispatch(m_Instance, m_Device, family, 100000, &result);
+	}
+	if (params.BenchmarkShaderObjects)
+	{
+		uint32_t family = m_QueueIndices.empty() || m_QueueIndices[0].FamilyCount == 0 ? 0 : m_QueueIndices[0].Families[0];
+		ShaderObjectBenchmarkResult result{};
+		if (!m_OptionalFeatures.ShaderObject)
+			printf("Shader object benchmark skipped, shader objects are not enabled\n");
+		else
+			BenchmarkShaderObjects(m_Device, family, 100000, &result);
+	}
+
+	m_FixedTimestep = params.FixedTimestep;
+	m_MaxUpdateSteps = params.MaxUpdateStepsPerFrame;
+	m_RenderOnDemand = params.RenderOnDemand;
+	m_HiddenPollInterval = params.HiddenPollInterval;
 
 	m_InitializedBase = true;
 	return true;
@@ -25,126 +102,145 @@ bool VulkanApp::BaseInit()
 void VulkanApp::BaseDestroy()
 {
 	// Own destroy code
+	m_FramePacer.Destroy();
+	m_ShaderHotReload.Stop();
+	m_PipelineBuilder.Destroy();
+	m_ShaderObjects.Destroy();
+	m_DrawQueue.Destroy();
+	m_GpuCulling.Destroy();
+	m_OcclusionCulling.Destroy();
+	m_Meshlets.Destroy();
+	m_ShaderLibrary.Close(m_Device, m_pAllocator);
+	m_ShaderVariants.Destroy();
+	m_LayoutCache.Destroy();
+
 	if (m_Device != VK_NULL_HANDLE)
-		vkDestroyDevice(m_Device, nullptr);
+		vkDestroyDevice(m_Device, m_pAllocator);
 
 	if (m_Surface != VK_NULL_HANDLE)
-		vkDestroySurfaceKHR(m_Instance, m_Surface, nullptr);
+		vkDestroySurfaceKHR(m_Instance, m_Surface, m_pAllocator);
 	if (m_pWindow)
 		delete m_pWindow;
 
 	if (m_Instance != VK_NULL_HANDLE)
-		vkDestroyInstance(m_Instance, nullptr);
+		vkDestroyInstance(m_Instance, m_pAllocator);
+
+	if (m_ReportHostAllocations)
+		m_HostAllocator.PrintStatistics();
+
+	ShutdownLoader();
 }
 
 void VulkanApp::WindowUpdate()
 {
 	m_pWindow->Tick();
+	for (const WindowEvent& event : m_pWindow->GetEvents())
+	{
+		// The surface contents are undefined after these, always redraw
+		if (event.Type == WindowEventType::Resize || event.Type == WindowEventType::Restored)
+			m_Invalidated.store(true, std::memory_order_release);
+		OnWindowEvent(event);
+	}
 }
 
+void VulkanApp::Invalidate()
+{
+	m_Invalidated.store(true, std::memory_order_release);
+	if (m_pWindow)
+		m_pWindow->Wake();
+}
 
-bool VulkanApp::CreateInstance(const PreDeviceSetupParameters& params)
+void VulkanApp::WaitWhileIdle()
 {
-	std::vector<const char*> layers = {
-		"VK_LAYER_KHRONOS_validation"
-	};
+	if (!IsWindowVisible())
+	{
+		m_pWindow->WaitForEvents(m_HiddenPollInterval);
+		return;
+	}
 
-	std::vector<const char*> extensions = {
-		VK_EXT_DEBUG_UTILS_EXTENSION_NAME,
-		VK_KHR_SURFACE_EXTENSION_NAME,
-		VK_KHR_WIN32_SURFACE_EXTENSION_NAME
-	};
+	if (m_RenderOnDemand && !m_Invalidated.load(std::memory_order_acquire))
+	{
+		m_pWindow->WaitForEvents(INFINITE);
+		// Time spent idle should not be simulated
+		m_LastStepTime = std::chrono::steady_clock::now();
+	}
+}
 
-	uint32_t count = 0;
-	vkEnumerateInstanceLayerProperties(&count, nullptr);
-	std::vector<VkLayerProperties> validationLayers(static_cast<size_t>(count));
-	vkEnumerateInstanceLayerProperties(&count, validationLayers.data());
+bool VulkanApp::ShouldRender()
+{
+	if (!IsWindowVisible())
+		return false;
+
+	if (!m_RenderOnDemand)
+		return true;
 
-	vkEnumerateInstanceExtensionProperties(nullptr, &count, nullptr);
-	std::vector<VkExtensionProperties> instanceExtensions(static_cast<size_t>(count));
-	vkEnumerateInstanceExtensionProperties(nullptr, &count, instanceExtensions.data());
+	return m_Invalidated.exchange(false, std::memory_order_acq_rel);
+}
+
+void VulkanApp::StepSimulation()
+{
+	auto now = std::chrono::steady_clock::now();
+	double elapsed = std::chrono::duration<double>(now - m_LastStepTime).count();
+	m_LastStepTime = now;
 
-	// Append validation layers
-	for (const char* paramLayer : params.ValidationLayers)
+	if (m_FixedTimestep <= 0.0)
 	{
-		for (const auto& layer : layers)
-		{
-			if (strcmp(paramLayer, layer) != 0)
-			{
-				layers.push_back(paramLayer);
-				break;
-			}
-		}
+		Update(static_cast<float>(elapsed));
+		m_InterpolationAlpha = 0.0f;
+		return;
 	}
 
-	// Append extensions
-	for (const char* paramExtensions : params.InstanceExtensions)
+	m_Accumulator += elapsed;
+
+	uint32_t steps = 0;
+	while (m_Accumulator >= m_FixedTimestep && steps < m_MaxUpdateSteps)
 	{
-		for (const auto& extension : extensions)
-		{
-			if (strcmp(paramExtensions, extension) != 0)
-			{
-				layers.push_back(paramExtensions);
-				break;
-			}
-		}
+		Update(static_cast<float>(m_FixedTimestep));
+		m_Accumulator -= m_FixedTimestep;
+		steps++;
 	}
 
-	// Query if all instance layers are present
-	bool allLayersPresent = true;
-	const char* failedLayer = nullptr;
-	for (const auto& requestedLayer : layers)
-	{
-		bool layerPresent = false;
-		for (const auto& instanceLayer : validationLayers)
-		{
-			if (strcmp(instanceLayer.layerName, requestedLayer) == 0)
-			{
-				layerPresent = true;
-				break;
-			}
-		}
+	// Could not catch up, drop whole steps but keep the fraction so interpolation stays smooth
+	if (m_Accumulator >= m_FixedTimestep)
+		m_Accumulator = std::fmod(m_Accumulator, m_FixedTimestep);
 
-		if (!layerPresent)
-		{
-			allLayersPresent = false;
-			failedLayer = requestedLayer;
-			break;
-		}
-	}
+	m_InterpolationAlpha = static_cast<float>(m_Accumulator / m_FixedTimestep);
+}
 
-	if (!allLayersPresent)
-	{
-		printf("not all requested validation layers are available failed at layer request[\"%s\"]\n", failedLayer);
-		return false;
-	}
 
-	// Query if all extensions are present
-	bool allExtensionsPresent = true;
-	const char* failedExtension = nullptr;
-	for (const auto& requestedExtension : extensions)
-	{
-		bool extensionPresent = false;
-		for (const auto& instanceExtension : instanceExtensions)
-		{
-			if (strcmp(instanceExtension.extensionName, requestedExtension) == 0)
-			{
-				extensionPresent = true;
-				break;
-			}
-		}
+bool VulkanApp::CreateInstance(const PreDeviceSetupParameters& params)
+{
+	std::vector<const char*> layers = {
+		"VK_LAYER_KHRONOS_validation"
+	};
+
+	std::vector<const char*> extensions = {
+		VK_EXT_DEBUG_UTILS_EXTENSION_NAME,
+		VK_KHR_SURFACE_EXTENSION_NAME,
+		VK_KHR_WIN32_SURFACE_EXTENSION_NAME
+	};
+
+	// Append requested layers and extensions, skipping duplicates
+	AppendUnique(layers, params.ValidationLayers);
+	AppendUnique(extensions, params.InstanceExtensions);
 
-		if (!extensionPresent)
+	// Layers are only enabled while debugging, so only then are they required
+	if (params.EnableDeviceDebugging)
+	{
+		CapabilitySet availableLayers = CapabilitySet::FromInstanceLayers();
+		std::vector<const char*> missingLayers;
+		if (!availableLayers.ContainsAll(layers, &missingLayers))
 		{
-			allExtensionsPresent = false;
-			failedExtension = requestedExtension;
-			break;
+			printf("not all requested validation layers are available, missing: %s\n", JoinNames(missingLayers).c_str());
+			return false;
 		}
 	}
 
-	if (!allExtensionsPresent)
+	CapabilitySet availableExtensions = CapabilitySet::FromInstanceExtensions();
+	std::vector<const char*> missingExtensions;
+	if (!availableExtensions.ContainsAll(extensions, &missingExtensions))
 	{
-		printf("not all requested instance extensions are available request[\"%s\"]\n", failedExtension);
+		printf("not all requested instance extensions are available, missing: %s\n", JoinNames(missingExtensions).c_str());
 		return false;
 	}
 
@@ -168,7 +264,7 @@ bool VulkanApp::CreateInstance(const PreDeviceSetupParameters& params)
 		ci.ppEnabledLayerNames = layers.data();
 	}
 
-	if (vkCreateInstance(&ci, nullptr, &m_Instance) != VK_SUCCESS)
+	if (vkCreateInstance(&ci, m_pAllocator, &m_Instance) != VK_SUCCESS)
 	{
 		printf("Failed to create instance!\n"); 
 		return false;
@@ -197,7 +293,7 @@ bool VulkanApp::CreateSurface()
 	ci.hinstance = GetModuleHandle(NULL);
 	ci.hwnd = m_pWindow->GetWindowHandle();
 
-	if (vkCreateWin32SurfaceKHR(m_Instance, &ci, nullptr, &m_Surface) != VK_SUCCESS)
+	if (vkCreateWin32SurfaceKHR(m_Instance, &ci, m_pAllocator, &m_Surface) != VK_SUCCESS)
 	{
 		printf("Failed to create window surface!\n");
 		return false;
@@ -214,56 +310,28 @@ bool VulkanApp::PickPhysicalDevice(const PreDeviceSetupParameters& params)
 
 	uint32_t deviceCount = count;
 
-	const float LOW_WEIGHT = 1.0f;
-	const float MEDIUM_WEIGHT = 2.0f;
-	const float HIGH_WEIGHT = 3.0f;
-	float highestScore = 0.0f;
-
 	std::vector<std::string> GPUNames(count);
 	std::vector<bool> failedOnExtensions(count);
+	std::vector<std::vector<const char*>> missingExtensions(count);
 	std::vector<bool> failedOnFeatures(count);
 	std::vector<bool> failedOnQueues(count);
+	std::vector<PhysicalDeviceCandidate> candidates;
 
 	uint32_t index = 0;
 	for (VkPhysicalDevice device : devices)
 	{
-		VkPhysicalDeviceProperties props{};
-		VkPhysicalDeviceFeatures features{};
-		VkSurfaceCapabilitiesKHR surface_cap{};
-		vkGetPhysicalDeviceProperties(device, &props);
-		vkGetPhysicalDeviceFeatures(device, &features);
-		vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device, m_Surface, &surface_cap);
+		PhysicalDeviceCandidate candidate = QueryPhysicalDeviceCandidate(device);
+		const VkPhysicalDeviceFeatures& features = candidate.Features;
 
-		GPUNames[index] = props.deviceName;
+		GPUNames[index] = candidate.Properties.deviceName;
 
 		bool deviceSuitable = true;
 
-		if (params.DeviceExtensions.size() > 0)
+		candidate.Extensions = CapabilitySet::FromDeviceExtensions(device);
+		if (!candidate.Extensions.ContainsAll(params.DeviceExtensions, &missingExtensions[index]))
 		{
-			count = 0;
-			vkEnumerateDeviceExtensionProperties(device, nullptr, &count, nullptr);
-			std::vector<VkExtensionProperties> extensions(count);
-			vkEnumerateDeviceExtensionProperties(device, nullptr, &count, extensions.data());
-
-			for (size_t i = 0; i < params.DeviceExtensions.size(); i++)
-			{
-				bool extensionAvailable = false;
-				for (const auto& extension : extensions)
-				{
-					if (strcmp(extension.extensionName, params.DeviceExtensions[i]) == 0)
-					{
-						extensionAvailable = true;
-						break;
-					}
-				}
-
-				if (!extensionAvailable)
-				{
-					deviceSuitable = false;
-					failedOnExtensions[index] = true;
-					break;
-				}
-			}
+			deviceSuitable = false;
+			failedOnExtensions[index] = true;
 		}
 		
 		if (!QueryPhysicalDeviceQueues(device, params))
@@ -277,7 +345,7 @@ bool VulkanApp::PickPhysicalDevice(const PreDeviceSetupParameters& params)
 		for (size_t i = 0; i < featureCount; i++)
 		{
 			const VkBool32& desiredValue = *(reinterpret_cast<const VkBool32*>(&params.EnabledDeviceFeatures) + i);
-			const VkBool32& deviceValue = *(reinterpret_cast<VkBool32*>(&features) + i);
+			const VkBool32& deviceValue = *(reinterpret_cast<const VkBool32*>(&features) + i);
 			if (desiredValue == VK_TRUE)
 			{
 				if (deviceValue != VK_TRUE)
@@ -293,15 +361,40 @@ bool VulkanApp::PickPhysicalDevice(const PreDeviceSetupParameters& params)
 
 		if (!deviceSuitable)
 			continue;
-		
-		float score = 1.0f;
-		if (props.deviceType & VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU)
-			score += HIGH_WEIGHT;
 
+		candidates.push_back(std::move(candidate));
+	}
+
+	// Benchmarking only makes sense when there is something to choose between
+	float bestBandwidth = 0.0f;
+	if (params.DeviceScoring.RunBenchmark && candidates.size() > 1)
+	{
+		for (auto& candidate : candidates)
+		{
+			candidate.BenchmarkBandwidth = BenchmarkPhysicalDevice(candidate);
+			bestBandwidth = std::max(bestBandwidth, candidate.BenchmarkBandwidth);
+			printf("GPU[\"%s\"] benchmark: %.2f GB/s\n", candidate.Properties.deviceName, candidate.BenchmarkBandwidth);
+		}
+	}
+
+	// Extensions behind the Enable flags are preferred like any other optional feature
+	DeviceScoringParameters scoring = params.DeviceScoring;
+	if (params.EnableGraphicsPipelineLibrary)
+		AppendUnique(scoring.OptionalDeviceExtensions, { VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME });
+	if (params.EnableShaderObject)
+		AppendUnique(scoring.OptionalDeviceExtensions, { VK_EXT_SHADER_OBJECT_EXTENSION_NAME });
+	if (params.EnableMeshlets)
+		AppendUnique(scoring.OptionalDeviceExtensions, { VK_EXT_MESH_SHADER_EXTENSION_NAME });
+
+	// Scores can be negative, any candidate that passed filtering is better than none
+	float highestScore = -std::numeric_limits<float>::infinity();
+	for (const auto& candidate : candidates)
+	{
+		float score = ScorePhysicalDevice(candidate, scoring, bestBandwidth);
 		if (score > highestScore)
 		{
 			highestScore = score;
-			m_PhysDevice = device;
+			m_PhysDevice = candidate.Device;
 		}
 	}
 
@@ -315,7 +408,7 @@ bool VulkanApp::PickPhysicalDevice(const PreDeviceSetupParameters& params)
 			if (failedOnFeatures[i])
 				printf("[features] ");
 			if (failedOnExtensions[i])
-				printf("[extensions] ");
+				printf("[extensions: %s] ", JoinNames(missingExtensions[i]).c_str());
 			if (failedOnQueues[i])
 				printf("[queues] ");
 			printf("\n");
@@ -325,6 +418,12 @@ bool VulkanApp::PickPhysicalDevice(const PreDeviceSetupParameters& params)
 		return false;
 	}
 
+	for (const auto& candidate : candidates)
+	{
+		if (candidate.Device == m_PhysDevice)
+			m_AvailableDeviceExtensions = candidate.Extensions;
+	}
+
 	VkPhysicalDeviceProperties props{};
 	vkGetPhysicalDeviceProperties(m_PhysDevice, &props);
 	printf("GPU: %s\n", props.deviceName);
@@ -341,134 +440,386 @@ bool VulkanApp::QueryPhysicalDeviceQueues(VkPhysicalDevice device, const PreDevi
 	std::vector<VkQueueFamilyProperties> families(static_cast<size_t>(count));
 	vkGetPhysicalDeviceQueueFamilyProperties(device, &count, families.data());
 
-	// Cache desired amount of queues per type
-	size_t desiredQueueCount = static_cast<uint32_t>(params.DesiredQueues.size());
-	std::vector<uint32_t> desiredCounts(desiredQueueCount, 0);
-	for (size_t i = 0; i < params.DesiredQueues.size(); i++)
-		desiredCounts[i] = params.DesiredQueues[i].Count;
+	// Assign all desired queues at once so no request steals the only family another request could use
+	std::vector<uint32_t> familyUsage;
+	bool valid = SolveQueueAssignment(families, params.DesiredQueues, pQueueIndices, &familyUsage);
 
-	// [Initilization] Store information on which queue handles may be retrieved on which family and from which indices
-	if (pQueueIndices)
+	if (pQueueCis)
 	{
-		pQueueIndices->resize(desiredQueueCount);
-
-		for (size_t i = 0; i < pQueueIndices->size(); i++)
+		for (uint32_t familyIndex = 0; familyIndex < static_cast<uint32_t>(families.size()); familyIndex++)
 		{
-			auto& index = (*pQueueIndices)[i];
-			index.Types = params.DesiredQueues[i].Types;
-			index.Count = {};
-			index.Families = {};
-			index.FirstIndex = {};
-			index.FamilyCount = 0;
+			if (familyUsage[familyIndex] == 0)
+				continue;
+
+			VkDeviceQueueCreateInfo queueCi{};
+			queueCi.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+			queueCi.queueFamilyIndex = familyIndex;
+			queueCi.queueCount = familyUsage[familyIndex];
+			pQueueCis->push_back(queueCi);
 		}
 	}
 
-	for (uint32_t familyIndex = 0; familyIndex < static_cast<uint32_t>(families.size()); familyIndex++)
+	if (valid && pQueueIndices)
+		PrintQueueLayout(families, *pQueueIndices);
+
+	return valid;
+}
+
+bool VulkanApp::CreateLogicalDevice(const PreDeviceSetupParameters& params)
+{
+	std::vector<VkDeviceQueueCreateInfo> queueCis;
+	QueryPhysicalDeviceQueues(m_PhysDevice, params, &m_QueueIndices, &queueCis);
+
+	m_TotalQueueCount = 0;
+	for (const auto& queueCi : queueCis)
+		m_TotalQueueCount += queueCi.queueCount;
+
+	// Per family priorities, taken from the request each queue was assigned to
+	std::vector<std::vector<float>> queuePriorities(queueCis.size());
+	std::vector<VkQueueGlobalPriorityKHR> globalPriorities(queueCis.size(), VK_QUEUE_GLOBAL_PRIORITY_MAX_ENUM_KHR);
+	bool wantsGlobalPriority = false;
+	for (size_t ci = 0; ci < queueCis.size(); ci++)
 	{
-		// Amount of queues in this family
-		uint32_t familyQueueCount = families[familyIndex].queueCount;
-		uint32_t queuesLeftInFamily = families[familyIndex].queueCount;
+		queuePriorities[ci].resize(queueCis[ci].queueCount, 1.0f);
 
-		// Existence of queueFamily should indicate that at least 1 queue is available
-		if (queuesLeftInFamily != 0)
+		for (size_t r = 0; r < m_QueueIndices.size(); r++)
 		{
-			// Loop through desired queue types
-			for (uint32_t i = 0; i < desiredQueueCount; i++)
+			const QueueType& request = params.DesiredQueues[r];
+			const QueueIndices& indices = m_QueueIndices[r];
+			for (uint32_t i = 0; i < indices.FamilyCount; i++)
 			{
-				const QueueType& queue = params.DesiredQueues[i];
-				// proceed if still looking for available queues
-				if (desiredCounts[i] > 0)
+				if (indices.Families[i] != queueCis[ci].queueFamilyIndex)
+					continue;
+
+				float priority = std::min(std::max(request.Priority, 0.0f), 1.0f);
+				for (uint32_t offset = 0; offset < indices.Count[i]; offset++)
+					queuePriorities[ci][indices.FirstIndex[i] + offset] = priority;
+
+				// Global priority applies to the whole family, the most demanding request wins
+				if (request.GlobalPriority.has_value())
 				{
-					// Get offset in queue family
-					uint32_t offset = familyQueueCount - queuesLeftInFamily;
-					uint32_t count = 0;
-					if (queue.Types & families[familyIndex].queueFlags)
-					{
-						// Amount of queues left is less than the desired queues
-						if (queuesLeftInFamily < desiredCounts[i])
-						{
-							count = queuesLeftInFamily;
-
-							desiredCounts[i] -= count;
-							queuesLeftInFamily = 0;
-						}
-						// Amount of queues left is more or exactly equal to the desired queues
-						else
-						{
-							count = desiredCounts[i];
-							queuesLeftInFamily -= desiredCounts[i];
-
-							desiredCounts[i] = 0;
-						}
-
-						// [Populating] Store information on which queue handles may be retrieved on which family and from which indices
-						if (pQueueIndices)
-						{
-							(*pQueueIndices)[i].Families.push_back(familyIndex);
-							(*pQueueIndices)[i].Count.push_back(count);
-							(*pQueueIndices)[i].FirstIndex.push_back(offset);
-							(*pQueueIndices)[i].FamilyCount++;
-						}
-					}
+					wantsGlobalPriority = true;
+					if (globalPriorities[ci] == VK_QUEUE_GLOBAL_PRIORITY_MAX_ENUM_KHR || *request.GlobalPriority > globalPriorities[ci])
+						globalPriorities[ci] = *request.GlobalPriority;
 				}
 			}
 		}
 
-		if (pQueueCis)
+		queueCis[ci].pQueuePriorities = queuePriorities[ci].data();
+	}
+
+	m_EnabledDeviceExtensions.clear();
+	AppendUnique(m_EnabledDeviceExtensions, params.DeviceExtensions);
+
+	std::vector<VkDeviceQueueGlobalPriorityCreateInfoKHR> globalPriorityCis;
+	if (wantsGlobalPriority)
+		ChainGlobalPriorities(queueCis, globalPriorities, globalPriorityCis);
+
+	FeatureChain featureChain;
+	NegotiateOptionalFeatures(params, featureChain);
+
+	VkPhysicalDeviceFeatures enabledFeatures = params.EnabledDeviceFeatures;
+	if (params.DrawQueueIndirectCapacity > 0 || params.EnableGpuCulling || params.EnableOcclusionCulling)
+	{
+		VkPhysicalDeviceFeatures supported{};
+		vkGetPhysicalDeviceFeatures(m_PhysDevice, &supported);
+		if (supported.multiDrawIndirect && supported.drawIndirectFirstInstance)
 		{
-			if (queuesLeftInFamily != families[familyIndex].queueCount)
-			{
-				VkDeviceQueueCreateInfo queueCi{};
-				queueCi.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-				queueCi.queueFamilyIndex = familyIndex;
-				queueCi.queueCount = familyQueueCount - queuesLeftInFamily;
-				pQueueCis->push_back(queueCi);
-			}
+			enabledFeatures.multiDrawIndirect = VK_TRUE;
+			enabledFeatures.drawIndirectFirstInstance = VK_TRUE;
 		}
 	}
+	m_OptionalFeatures.MultiDrawIndirect = enabledFeatures.multiDrawIndirect && enabledFeatures.drawIndirectFirstInstance;
 
-	bool valid = true;
-	for (uint32_t i = 0; i < desiredQueueCount; i++)
+	VkDeviceCreateInfo deviceCi{};
+	deviceCi.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+	deviceCi.pNext = featureChain.Head();
+
+	deviceCi.queueCreateInfoCount = static_cast<uint32_t>(queueCis.size());
+	deviceCi.pQueueCreateInfos = queueCis.data();
+	deviceCi.pEnabledFeatures = &enabledFeatures;
+	deviceCi.enabledExtensionCount = static_cast<uint32_t>(m_EnabledDeviceExtensions.size());
+	deviceCi.ppEnabledExtensionNames = m_EnabledDeviceExtensions.data();
+
+	VkResult result = vkCreateDevice(m_PhysDevice, &deviceCi, m_pAllocator, &m_Device);
+
+	// Elevated priorities may need privileges the process does not have, retry without them
+	if (result == VK_ERROR_NOT_PERMITTED_KHR && !globalPriorityCis.empty())
 	{
-		if (desiredCounts[i] > 0)
-			valid = false;
+		printf("Global queue priorities not permitted, falling back to default priorities\n");
+		for (auto& queueCi : queueCis)
+			queueCi.pNext = nullptr;
+		result = vkCreateDevice(m_PhysDevice, &deviceCi, m_pAllocator, &m_Device);
 	}
 
-	return valid;
+	if (result != VK_SUCCESS)
+	{
+		printf("Failed to create logical device!\n");
+		return false;
+	}
+
+	return true;
 }
 
-#undef max
+void VulkanApp::NegotiateOptionalFeatures(const PreDeviceSetupParameters& params, FeatureChain& featureChain)
+{
+	m_OptionalFeatures = {};
+
+	// Present wait is only useful with a swapchain and needs present ids to refer to frames
+	bool wantsSwapchain = std::find_if(m_EnabledDeviceExtensions.begin(), m_EnabledDeviceExtensions.end(),
+		[](const char* name) { return strcmp(name, VK_KHR_SWAPCHAIN_EXTENSION_NAME) == 0; }) != m_EnabledDeviceExtensions.end();
+	if (params.EnablePresentWait && wantsSwapchain
+		&& m_AvailableDeviceExtensions.Contains(VK_KHR_PRESENT_ID_EXTENSION_NAME)
+		&& m_AvailableDeviceExtensions.Contains(VK_KHR_PRESENT_WAIT_EXTENSION_NAME))
+	{
+		auto presentId = QueryDeviceFeature<VkPhysicalDevicePresentIdFeaturesKHR>(m_PhysDevice, VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR);
+		auto presentWait = QueryDeviceFeature<VkPhysicalDevicePresentWaitFeaturesKHR>(m_PhysDevice, VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR);
+		if (presentId.presentId && presentWait.presentWait)
+		{
+			featureChain.Add(presentId);
+			featureChain.Add(presentWait);
+			AppendUnique(m_EnabledDeviceExtensions, { VK_KHR_PRESENT_ID_EXTENSION_NAME, VK_KHR_PRESENT_WAIT_EXTENSION_NAME });
+			m_OptionalFeatures.PresentWait = true;
+		}
+	}
 
-bool VulkanApp::CreateLogicalDevice(const PreDeviceSetupParameters& params)
+	// Only a hint to the presentation engine, so there is no feature to check
+	if (params.EnableIncrementalPresent && wantsSwapchain && m_AvailableDeviceExtensions.Contains(VK_KHR_INCREMENTAL_PRESENT_EXTENSION_NAME))
+	{
+		AppendUnique(m_EnabledDeviceExtensions, { VK_KHR_INCREMENTAL_PRESENT_EXTENSION_NAME });
+		m_OptionalFeatures.IncrementalPresent = true;
+	}
+
+	if (params.EnableGraphicsPipelineLibrary
+		&& m_AvailableDeviceExtensions.Contains(VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME)
+		&& m_AvailableDeviceExtensions.Contains(VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME))
+	{
+		auto pipelineLibrary = QueryDeviceFeature<VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT>(m_PhysDevice, VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT);
+		if (pipelineLibrary.graphicsPipelineLibrary)
+		{
+			featureChain.Add(pipelineLibrary);
+			AppendUnique(m_EnabledDeviceExtensions, { VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME, VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME });
+			m_OptionalFeatures.GraphicsPipelineLibrary = true;
+
+			VkPhysicalDeviceGraphicsPipelineLibraryPropertiesEXT libraryProps{};
+			libraryProps.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_PROPERTIES_EXT;
+			VkPhysicalDeviceProperties2 props{};
+			props.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+			props.pNext = &libraryProps;
+			vkGetPhysicalDeviceProperties2(m_PhysDevice, &props);
+			m_OptionalFeatures.FastPipelineLinking = libraryProps.graphicsPipelineLibraryFastLinking == VK_TRUE;
+		}
+	}
+
+	if (params.EnableExtendedDynamicState)
+		NegotiateDynamicState(featureChain);
+
+	// Core since 1.2, chained through one 1.2 feature struct with only the used features of it enabled
+	VkPhysicalDeviceProperties deviceProps{};
+	bool wantsIndirectCount = params.EnableGpuCulling || params.EnableOcclusionCulling;
+	if (wantsIndirectCount || params.EnableRuntimeDescriptorArrays)
+		vkGetPhysicalDeviceProperties(m_PhysDevice, &deviceProps);
+	if ((wantsIndirectCount || params.EnableRuntimeDescriptorArrays) && deviceProps.apiVersion >= VK_API_VERSION_1_2)
+	{
+		auto vulkan12 = QueryDeviceFeature<VkPhysicalDeviceVulkan12Features>(m_PhysDevice, VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES);
+		VkPhysicalDeviceVulkan12Features enabled12{};
+		enabled12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+		if (wantsIndirectCount && vulkan12.drawIndirectCount)
+		{
+			enabled12.drawIndirectCount = VK_TRUE;
+			m_OptionalFeatures.DrawIndirectCount = true;
+		}
+		// The binding flags m_LayoutCache gives runtime sized arrays
+		if (params.EnableRuntimeDescriptorArrays && vulkan12.runtimeDescriptorArray && vulkan12.descriptorBindingPartiallyBound
+			&& vulkan12.descriptorBindingVariableDescriptorCount)
+		{
+			enabled12.runtimeDescriptorArray = VK_TRUE;
+			enabled12.descriptorBindingPartiallyBound = VK_TRUE;
+			enabled12.descriptorBindingVariableDescriptorCount = VK_TRUE;
+			m_OptionalFeatures.RuntimeDescriptorArrays = true;
+		}
+		if (m_OptionalFeatures.DrawIndirectCount || m_OptionalFeatures.RuntimeDescriptorArrays)
+			featureChain.Add(enabled12);
+	}
+
+	// Pipelines built without a render pass and shader objects both render inside vkCmdBeginRendering
+	if (params.EnableDynamicRendering || params.EnableGraphicsPipelineLibrary || params.EnableShaderObject)
+		NegotiateDynamicRendering(featureChain);
+
+	// Dynamic rendering is only enabled on 1.3 devices, which also covers the extended dynamic state ShaderObjects records
+	if (params.EnableShaderObject && m_OptionalFeatures.DynamicRendering && m_AvailableDeviceExtensions.Contains(VK_EXT_SHADER_OBJECT_EXTENSION_NAME))
+	{
+		auto shaderObject = QueryDeviceFeature<VkPhysicalDeviceShaderObjectFeaturesEXT>(m_PhysDevice, VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_OBJECT_FEATURES_EXT);
+		if (shaderObject.shaderObject)
+		{
+			featureChain.Add(shaderObject);
+			AppendUnique(m_EnabledDeviceExtensions, { VK_EXT_SHADER_OBJECT_EXTENSION_NAME });
+			m_OptionalFeatures.ShaderObject = true;
+		}
+	}
+
+	// Mesh shaders are SPIR-V 1.4, which is core since 1.2
+	if (params.EnableMeshlets && m_AvailableDeviceExtensions.Contains(VK_EXT_MESH_SHADER_EXTENSION_NAME))
+	{
+		VkPhysicalDeviceProperties meshProps{};
+		vkGetPhysicalDeviceProperties(m_PhysDevice, &meshProps);
+		auto meshShader = QueryDeviceFeature<VkPhysicalDeviceMeshShaderFeaturesEXT>(m_PhysDevice, VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT);
+		if (meshProps.apiVersion >= VK_API_VERSION_1_2 && meshShader.taskShader && meshShader.meshShader)
+		{
+			VkPhysicalDeviceMeshShaderFeaturesEXT enabledMesh{};
+			enabledMesh.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT;
+			enabledMesh.taskShader = VK_TRUE;
+			enabledMesh.meshShader = VK_TRUE;
+			featureChain.Add(enabledMesh);
+			AppendUnique(m_EnabledDeviceExtensions, { VK_EXT_MESH_SHADER_EXTENSION_NAME });
+			m_OptionalFeatures.MeshShader = true;
+		}
+	}
+}
+
+uint32_t VulkanApp::FindQueueFamily(VkQueueFlags required, VkQueueFlags avoided) const
 {
-	std::vector<VkDeviceQueueCreateInfo> queueCis;
-	QueryPhysicalDeviceQueues(m_PhysDevice, params, &m_QueueIndices, &queueCis);
+	uint32_t fallback = UINT32_MAX;
+	for (const QueueIndices& indices : m_QueueIndices)
+	{
+		if ((indices.Types & required) != required || indices.FamilyCount == 0)
+			continue;
+		if (!(indices.Types & avoided))
+			return indices.Families[0];
+		if (fallback == UINT32_MAX)
+			fallback = indices.Families[0];
+	}
+	return fallback;
+}
 
-	uint32_t highestQueueCount = 0;
-	m_TotalQueueCount = 0;
-	for (const auto& queueCi : queueCis)
+void VulkanApp::NegotiateDynamicState(FeatureChain& featureChain)
+{
+	DynamicStateSupport& dynamicState = m_OptionalFeatures.DynamicState;
+
+	// The first two extensions are core in 1.3 apart from two features of the second, the loader only resolves the core names
+	VkPhysicalDeviceProperties props{};
+	vkGetPhysicalDeviceProperties(m_PhysDevice, &props);
+	if (props.apiVersion < VK_API_VERSION_1_3)
+		return;
+	dynamicState.ExtendedDynamicState = true;
+	dynamicState.ExtendedDynamicState2 = true;
+
+	if (m_AvailableDeviceExtensions.Contains(VK_EXT_EXTENDED_DYNAMIC_STATE_2_EXTENSION_NAME))
 	{
-		highestQueueCount = std::max(highestQueueCount, queueCi.queueCount);
-		m_TotalQueueCount += queueCi.queueCount;
+		auto state2 = QueryDeviceFeature<VkPhysicalDeviceExtendedDynamicState2FeaturesEXT>(m_PhysDevice, VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_2_FEATURES_EXT);
+		if (state2.extendedDynamicState2PatchControlPoints)
+		{
+			// Only what m_PipelineBuilder sets, the rest of the struct is core 1.3 or unused
+			VkPhysicalDeviceExtendedDynamicState2FeaturesEXT enabled2{};
+			enabled2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_2_FEATURES_EXT;
+			enabled2.extendedDynamicState2PatchControlPoints = VK_TRUE;
+			featureChain.Add(enabled2);
+			AppendUnique(m_EnabledDeviceExtensions, { VK_EXT_EXTENDED_DYNAMIC_STATE_2_EXTENSION_NAME });
+			dynamicState.PatchControlPoints = true;
+		}
 	}
 
-	// Set all queue priorites to 1.0f
-	std::vector<float> queuePriorities(highestQueueCount, 1.0f);
-	for (auto& queueCi : queueCis)
-		queueCi.pQueuePriorities = queuePriorities.data();
+	if (m_AvailableDeviceExtensions.Contains(VK_EXT_EXTENDED_DYNAMIC_STATE_3_EXTENSION_NAME))
+	{
+		auto state3 = QueryDeviceFeature<VkPhysicalDeviceExtendedDynamicState3FeaturesEXT>(m_PhysDevice, VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_3_FEATURES_EXT);
+		dynamicState.PolygonMode = state3.extendedDynamicState3PolygonMode == VK_TRUE;
+		dynamicState.DepthClamp = state3.extendedDynamicState3DepthClampEnable == VK_TRUE;
+		dynamicState.ColorBlend = state3.extendedDynamicState3ColorBlendEnable && state3.extendedDynamicState3ColorBlendEquation
+			&& state3.extendedDynamicState3ColorWriteMask;
+		if (dynamicState.PolygonMode || dynamicState.DepthClamp || dynamicState.ColorBlend)
+		{
+			VkPhysicalDeviceExtendedDynamicState3FeaturesEXT enabled3{};
+			enabled3.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_3_FEATURES_EXT;
+			enabled3.extendedDynamicState3PolygonMode = dynamicState.PolygonMode;
+			enabled3.extendedDynamicState3DepthClampEnable = dynamicState.DepthClamp;
+			enabled3.extendedDynamicState3ColorBlendEnable = dynamicState.ColorBlend;
+			enabled3.extendedDynamicState3ColorBlendEquation = dynamicState.ColorBlend;
+			enabled3.extendedDynamicState3ColorWriteMask = dynamicState.ColorBlend;
+			featureChain.Add(enabled3);
+			AppendUnique(m_EnabledDeviceExtensions, { VK_EXT_EXTENDED_DYNAMIC_STATE_3_EXTENSION_NAME });
+
+			VkPhysicalDeviceExtendedDynamicState3PropertiesEXT state3Props{};
+			state3Props.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_3_PROPERTIES_EXT;
+			VkPhysicalDeviceProperties2 props2{};
+			props2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+			props2.pNext = &state3Props;
+			vkGetPhysicalDeviceProperties2(m_PhysDevice, &props2);
+			dynamicState.UnrestrictedTopology = state3Props.dynamicPrimitiveTopologyUnrestricted == VK_TRUE;
+		}
+	}
+}
 
-	VkDeviceCreateInfo deviceCi{};
-	deviceCi.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+void VulkanApp::NegotiateDynamicRendering(FeatureChain& featureChain)
+{
+	// Core in 1.3, the loader only resolves vkCmdBeginRendering by its core name
+	VkPhysicalDeviceProperties props{};
+	vkGetPhysicalDeviceProperties(m_PhysDevice, &props);
+	if (props.apiVersion < VK_API_VERSION_1_3)
+		return;
 
-	deviceCi.queueCreateInfoCount = static_cast<uint32_t>(queueCis.size());
-	deviceCi.pQueueCreateInfos = queueCis.data();
-	deviceCi.pEnabledFeatures = &params.EnabledDeviceFeatures;
+	auto dynamicRendering = QueryDeviceFeature<VkPhysicalDeviceDynamicRenderingFeatures>(m_PhysDevice, VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES);
+	if (dynamicRendering.dynamicRendering)
+	{
+		featureChain.Add(dynamicRendering);
+		m_OptionalFeatures.DynamicRendering = true;
+	}
+}
 
-	if (vkCreateDevice(m_PhysDevice, &deviceCi, nullptr, &m_Device) != VK_SUCCESS)
+void VulkanApp::ChainGlobalPriorities(std::vector<VkDeviceQueueCreateInfo>& queueCis,
+	const std::vector<VkQueueGlobalPriorityKHR>& globalPriorities,
+	std::vector<VkDeviceQueueGlobalPriorityCreateInfoKHR>& globalPriorityCis)
+{
+	bool hasKHR = m_AvailableDeviceExtensions.Contains(VK_KHR_GLOBAL_PRIORITY_EXTENSION_NAME);
+	bool hasEXT = m_AvailableDeviceExtensions.Contains(VK_EXT_GLOBAL_PRIORITY_EXTENSION_NAME);
+	if (!hasKHR && !hasEXT)
 	{
-		printf("Failed to create logical device!\n");
-		return false;
+		printf("Global queue priorities requested but not supported by the device, ignoring\n");
+		return;
 	}
 
-	return true;
+	const char* extension = hasKHR ? VK_KHR_GLOBAL_PRIORITY_EXTENSION_NAME : VK_EXT_GLOBAL_PRIORITY_EXTENSION_NAME;
+	AppendUnique(m_EnabledDeviceExtensions, { extension });
+
+	// The KHR extension reports which levels each family supports, requests get clamped to those
+	uint32_t familyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(m_PhysDevice, &familyCount, nullptr);
+	std::vector<VkQueueFamilyGlobalPriorityPropertiesKHR> supported(familyCount);
+	if (hasKHR)
+	{
+		std::vector<VkQueueFamilyProperties2> families(familyCount);
+		for (uint32_t i = 0; i < familyCount; i++)
+		{
+			supported[i].sType = VK_STRUCTURE_TYPE_QUEUE_FAMILY_GLOBAL_PRIORITY_PROPERTIES_KHR;
+			families[i].sType = VK_STRUCTURE_TYPE_QUEUE_FAMILY_PROPERTIES_2;
+			families[i].pNext = &supported[i];
+		}
+		vkGetPhysicalDeviceQueueFamilyProperties2(m_PhysDevice, &familyCount, families.data());
+	}
+
+	// Reserve up front, queue create infos point into this vector
+	globalPriorityCis.reserve(queueCis.size());
+	for (size_t ci = 0; ci < queueCis.size(); ci++)
+	{
+		VkQueueGlobalPriorityKHR priority = globalPriorities[ci];
+		if (priority == VK_QUEUE_GLOBAL_PRIORITY_MAX_ENUM_KHR)
+			continue;
+
+		const auto& levels = supported[queueCis[ci].queueFamilyIndex];
+		if (levels.priorityCount > 0)
+		{
+			VkQueueGlobalPriorityKHR clamped = levels.priorities[0];
+			for (uint32_t i = 0; i < levels.priorityCount; i++)
+			{
+				if (levels.priorities[i] <= priority)
+					clamped = std::max(clamped, levels.priorities[i]);
+			}
+			priority = clamped;
+		}
+
+		VkDeviceQueueGlobalPriorityCreateInfoKHR globalCi{};
+		globalCi.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_GLOBAL_PRIORITY_CREATE_INFO_KHR;
+		globalCi.globalPriority = priority;
+		globalPriorityCis.push_back(globalCi);
+		queueCis[ci].pNext = &globalPriorityCis.back();
+	}
 }
\ No newline at end of file
@@ -2,36 +2,52 @@
 
 #include <string>
 #include <optional>
+#include <chrono>
+#include <atomic>
 
-#include <vulkan/vulkan.h>
+#include "Loader/Loader.h"
+#include "Loader/DispatchBenchmark.h"
 
 #include "Window/Window.h"
+#include "Device/CapabilitySet.h"
+#include "Device/DeviceScoring.h"
+#include "Device/QueueAssignment.h"
+#include "Device/FeatureChain.h"
+#include "Memory/HostAllocator.h"
+#include "Frame/FramePacer.h"
+#include "Frame/DamageTracker.h"
+#include "Shaders/ShaderLibrary.h"
+#include "Shaders/ShaderHotReload.h"
+#include "Shaders/LayoutCache.h"
+#include "Shaders/ShaderVariants.h"
+#include "Pipeline/GraphicsPipelineBuilder.h"
+#include "Pipeline/ShaderObjects.h"
+#include "Pipeline/ShaderObjectBenchmark.h"
+#include "Command/DrawQueue.h"
+#include "Culling/GpuCulling.h"
+#include "Culling/OcclusionCulling.h"
+#include "Culling/CpuCulling.h"
+#include "Culling/SoftwareOcclusion.h"
+#include "Meshlet/MeshletRenderer.h"
 
 #include <vector>
 
 #undef CreateWindow
 
-struct QueueType
-{
-	VkQueueFlags Types;
-	uint32_t Count;
-};
-
-struct QueueIndices
-{
-	VkQueueFlags Types;
-	uint32_t FamilyCount;
-	std::vector<uint32_t> Families;
-	std::vector<uint32_t> FirstIndex;
-	std::vector<uint32_t> Count;
-};
-
 struct PreDeviceSetupParameters
 {
 	std::string AppName = "";
 	uint32_t WindowWidth = 640, WindowHeight = 640;
 	bool AllowWindowResizing = false;
 	bool EnableDeviceDebugging = false;
+	/// <summary>
+	/// Measures recording cost through loader trampolines versus direct device dispatch after device creation
+	/// </summary>
+	bool BenchmarkDispatch = false;
+	/// <summary>
+	/// Routes driver host allocations through the pooled HostAllocator, peaks are reported on exit while debugging
+	/// </summary>
+	bool UseHostAllocationCallbacks = true;
 
 	std::vector<const char*> ValidationLayers = {};
 	std::vector<const char*> InstanceExtensions = {};
@@ -39,6 +55,150 @@ struct PreDeviceSetupParameters
 	VkPhysicalDeviceFeatures EnabledDeviceFeatures = {};
 
 	std::vector<QueueType> DesiredQueues = {};
+
+	/// <summary>
+	/// Determines which suitable physical device gets picked
+	/// </summary>
+	DeviceScoringParameters DeviceScoring = {};
+
+	/// <summary>
+	/// Seconds per Update call. Update runs at this fixed rate independent of the render rate,
+	/// 0 calls Update once per frame with the measured frame time instead
+	/// </summary>
+	double FixedTimestep = 1.0 / 60.0;
+	/// <summary>
+	/// Most Update calls per frame, time beyond that is dropped so a slow frame cannot snowball
+	/// </summary>
+	uint32_t MaxUpdateStepsPerFrame = 5;
+
+	/// <summary>
+	/// Frames per second the frame pacer aims for, 0 leaves the frame rate uncapped
+	/// </summary>
+	double TargetFrameRate = 0.0;
+	/// <summary>
+	/// Most frames the CPU may run ahead of the display, 1 gives the lowest latency
+	/// </summary>
+	uint32_t MaxQueuedFrames = 2;
+	/// <summary>
+	/// Enables VK_KHR_present_id and VK_KHR_present_wait for pacing when the device supports them
+	/// </summary>
+	bool EnablePresentWait = true;
+	/// <summary>
+	/// Enables VK_KHR_incremental_present so presents only carry the damaged regions, see DamageTracker
+	/// </summary>
+	bool EnableIncrementalPresent = true;
+	/// <summary>
+	/// Enables VK_EXT_graphics_pipeline_library so m_PipelineBuilder links precompiled pipeline parts instead of
+	/// compiling whole pipelines, devices supporting it are preferred
+	/// </summary>
+	bool EnableGraphicsPipelineLibrary = false;
+	/// <summary>
+	/// Enables dynamicRendering on 1.3 devices so m_PipelineBuilder can build pipelines without a render pass,
+	/// implied by EnableGraphicsPipelineLibrary and EnableShaderObject
+	/// </summary>
+	bool EnableDynamicRendering = false;
+	/// <summary>
+	/// Enables the extended dynamic state features the device supports, m_PipelineBuilder then keeps that state
+	/// out of its pipelines. Record it with m_PipelineBuilder.SetDynamicState after binding a pipeline
+	/// </summary>
+	bool EnableExtendedDynamicState = true;
+	/// <summary>
+	/// Enables VK_EXT_shader_object together with dynamic rendering so m_ShaderObjects can draw without pipelines,
+	/// devices supporting it are preferred
+	/// </summary>
+	bool EnableShaderObject = false;
+	/// <summary>
+	/// Compares compile time and bind cost of pipelines and shader objects after device creation, needs EnableShaderObject
+	/// </summary>
+	bool BenchmarkShaderObjects = false;
+	/// <summary>
+	/// Indirect commands m_DrawQueue can write per frame, runs beyond that are drawn directly. Opt-in, a non-zero
+	/// capacity enables the multiDrawIndirect and drawIndirectFirstInstance features when supported. The default 0
+	/// draws every run directly and leaves those features alone
+	/// </summary>
+	uint32_t DrawQueueIndirectCapacity = 0;
+	/// <summary>
+	/// Enables drawIndirectCount so m_GpuCulling can cull and pick LODs in a compute pass. The pass runs on the first
+	/// compute queue without graphics from DesiredQueues, the graphics family otherwise
+	/// </summary>
+	bool EnableGpuCulling = false;
+	/// <summary>
+	/// Instances m_GpuCulling and m_OcclusionCulling can cull per frame, sizes their draw buffers
+	/// </summary>
+	uint32_t GpuCullingMaxInstances = 65536;
+	/// <summary>
+	/// Creates m_Meshlets. Enables VK_EXT_mesh_shader so it culls and draws meshlets in task and mesh shaders, devices
+	/// supporting it are preferred. Elsewhere it expands the visible meshlets into an index buffer in compute
+	/// </summary>
+	bool EnableMeshlets = false;
+	/// <summary>
+	/// Enables drawIndirectCount so m_OcclusionCulling can cull against a depth pyramid of the previous frame,
+	/// on the same queue families as m_GpuCulling
+	/// </summary>
+	bool EnableOcclusionCulling = false;
+	/// <summary>
+	/// Allocates the depth buffer of m_SoftwareOcclusion at SoftwareOcclusionWidth x SoftwareOcclusionHeight
+	/// </summary>
+	bool EnableSoftwareOcclusion = false;
+	uint32_t SoftwareOcclusionWidth = 256;
+	uint32_t SoftwareOcclusionHeight = 128;
+
+	/// <summary>
+	/// Enables runtimeDescriptorArray with partially bound and variable count bindings on 1.2 devices, needed by shaders
+	/// with runtime sized descriptor arrays. Their size in m_LayoutCache is set with SetRuntimeArrayCount
+	/// </summary>
+	bool EnableRuntimeDescriptorArrays = false;
+
+	/// <summary>
+	/// Only renders after Invalidate was called, the loop sleeps until window events or an invalidate arrive
+	/// </summary>
+	bool RenderOnDemand = false;
+	/// <summary>
+	/// Milliseconds between loop iterations while the window is minimized or occluded, rendering is skipped then
+	/// </summary>
+	uint32_t HiddenPollInterval = 100;
+
+	/// <summary>
+	/// Shader archive created with ShaderLibrary::Pack, opened into m_ShaderLibrary. Empty disables the library
+	/// </summary>
+	std::string ShaderLibraryPath = {};
+	/// <summary>
+	/// Recompiles shader sources registered with m_ShaderHotReload when they change and swaps the rebuilt pipelines in
+	/// </summary>
+	bool EnableShaderHotReload = false;
+};
+
+/// <summary>
+/// Optional device functionality that was negotiated in CreateLogicalDevice
+/// </summary>
+struct EnabledOptionalFeatures
+{
+	bool PresentWait = false;
+	bool IncrementalPresent = false;
+	bool GraphicsPipelineLibrary = false;
+	/// <summary>
+	/// Linking libraries without optimization is cheap enough to do within a frame
+	/// </summary>
+	bool FastPipelineLinking = false;
+	DynamicStateSupport DynamicState = {};
+	bool ShaderObject = false;
+	/// <summary>
+	/// Shader objects and pipelines without a render pass can only draw inside vkCmdBeginRendering
+	/// </summary>
+	bool DynamicRendering = false;
+	/// <summary>
+	/// multiDrawIndirect together with drawIndirectFirstInstance, lets m_DrawQueue merge draws into indirect calls
+	/// </summary>
+	bool MultiDrawIndirect = false;
+	bool DrawIndirectCount = false;
+	/// <summary>
+	/// runtimeDescriptorArray, descriptorBindingPartiallyBound and descriptorBindingVariableDescriptorCount
+	/// </summary>
+	bool RuntimeDescriptorArrays = false;
+	/// <summary>
+	/// Task and mesh shaders of VK_EXT_mesh_shader
+	/// </summary>
+	bool MeshShader = false;
 };
 
 class VulkanApp
@@ -58,10 +218,18 @@ public:
 	/// </summary>
 	virtual void Init() { }
 	/// <summary>
-	/// Runs each frame
+	/// Advances the simulation by dt seconds, runs at PreDeviceSetupParameters::FixedTimestep
+	/// </summary>
+	virtual void Update(float dt) { }
+	/// <summary>
+	/// Runs each frame, use GetInterpolationAlpha to blend between the last two simulation states
 	/// </summary>
 	virtual void Tick() { }
 	/// <summary>
+	/// Receives input, resize and close events of the window, dispatched at the start of each frame
+	/// </summary>
+	virtual void OnWindowEvent(const WindowEvent& event) { }
+	/// <summary>
 	/// Gets called before destruction of base app parameters
 	/// </summary>
 	virtual void Destroy() { }
@@ -76,9 +244,27 @@ private:
 	/// </summary>
 	void BaseDestroy();
 	/// <summary>
-	/// Update window
+	/// Drains window events and dispatches them to OnWindowEvent
 	/// </summary>
 	void WindowUpdate();
+	/// <summary>
+	/// Runs as many fixed Update steps as the elapsed time requires
+	/// </summary>
+	void StepSimulation();
+	/// <summary>
+	/// Blocks while there is nothing to render, throttles while the window is not visible
+	/// </summary>
+	void WaitWhileIdle();
+	/// <summary>
+	/// Whether Tick should run this iteration, consumes a pending invalidate
+	/// </summary>
+	bool ShouldRender();
+	bool IsWindowVisible() const { return !m_pWindow->IsMinimized() && !m_pWindow->IsOccluded(); }
+	/// <summary>
+	/// Family of the first desired queue with all required and none of the avoided types, ignoring avoided types
+	/// when there is none. UINT32_MAX when no desired queue has the required types
+	/// </summary>
+	uint32_t FindQueueFamily(VkQueueFlags required, VkQueueFlags avoided) const;
 
 	bool CreateInstance(const PreDeviceSetupParameters& params);
 	bool CreateWindow(const PreDeviceSetupParameters& params);
@@ -89,8 +275,36 @@ private:
 		std::vector<QueueIndices>* pQueueIndices = nullptr, 
 		std::vector<VkDeviceQueueCreateInfo>* pQueueCis = nullptr);
 	bool CreateLogicalDevice(const PreDeviceSetupParameters& params);
+	/// <summary>
+	/// Enables optional extensions the device supports and chains their feature structs
+	/// </summary>
+	void NegotiateOptionalFeatures(const PreDeviceSetupParameters& params, FeatureChain& featureChain);
+	/// <summary>
+	/// Fills m_OptionalFeatures.DynamicState and chains the extended dynamic state features the device supports
+	/// </summary>
+	void NegotiateDynamicState(FeatureChain& featureChain);
+	/// <summary>
+	/// Chains the dynamicRendering feature on 1.3 devices and sets m_OptionalFeatures.DynamicRendering
+	/// </summary>
+	void NegotiateDynamicRendering(FeatureChain& featureChain);
+	/// <summary>
+	/// Enables the global priority extension and chains the requested levels into the queue create infos
+	/// </summary>
+	void ChainGlobalPriorities(std::vector<VkDeviceQueueCreateInfo>& queueCis,
+		const std::vector<VkQueueGlobalPriorityKHR>& globalPriorities,
+		std::vector<VkDeviceQueueGlobalPriorityCreateInfoKHR>& globalPriorityCis);
 
 protected:
+	/// <summary>
+	/// Fraction of a fixed step the render time is ahead of the last Update, in [0, 1)
+	/// </summary>
+	float GetInterpolationAlpha() const { return m_InterpolationAlpha; }
+
+	/// <summary>
+	/// Requests a new frame in render on demand mode, may be called from any thread
+	/// </summary>
+	void Invalidate();
+
 	/// <summary>
 	/// This variable defines whether the application should keep running.
 	/// This must be considered as the only valid method of destroying the app
@@ -102,10 +316,67 @@ protected:
 	VkInstance m_Instance = VK_NULL_HANDLE;
 	VkSurfaceKHR m_Surface = VK_NULL_HANDLE;
 	VkPhysicalDevice m_PhysDevice = VK_NULL_HANDLE;
+	CapabilitySet m_AvailableDeviceExtensions = {};
+	std::vector<const char*> m_EnabledDeviceExtensions = {};
 	std::vector<QueueIndices> m_QueueIndices = {};
 	uint32_t m_TotalQueueCount = 0;
 	VkDevice m_Device = VK_NULL_HANDLE;
 
+	/// <summary>
+	/// Pass to every vkCreate* and vkDestroy* call, nullptr when host allocation callbacks are disabled
+	/// </summary>
+	const VkAllocationCallbacks* m_pAllocator = nullptr;
+
+	EnabledOptionalFeatures m_OptionalFeatures = {};
+	FramePacer m_FramePacer;
+	DamageTracker m_DamageTracker;
+	ShaderLibrary m_ShaderLibrary;
+	ShaderHotReload m_ShaderHotReload;
+	LayoutCache m_LayoutCache;
+	/// <summary>
+	/// Variants requested in Init are precompiled in parallel right after it
+	/// </summary>
+	ShaderVariants m_ShaderVariants;
+	GraphicsPipelineBuilder m_PipelineBuilder;
+	ShaderObjectCache m_ShaderObjects;
+	/// <summary>
+	/// Cleared before every Tick, submit the frame's draws and record them per pass
+	/// </summary>
+	DrawQueue m_DrawQueue;
+	/// <summary>
+	/// Only enabled with PreDeviceSetupParameters::EnableGpuCulling, advanced to the next slot before every Tick
+	/// </summary>
+	GpuCulling m_GpuCulling;
+	/// <summary>
+	/// Only enabled with PreDeviceSetupParameters::EnableOcclusionCulling, needs SetDepthSource before it culls anything
+	/// </summary>
+	OcclusionCulling m_OcclusionCulling;
+	/// <summary>
+	/// Only enabled with PreDeviceSetupParameters::EnableMeshlets, advanced to the next slot before every Tick
+	/// </summary>
+	MeshletRenderer m_Meshlets;
+	/// <summary>
+	/// Scene bounds filled by the client, cull them from Tick to skip recording invisible objects
+	/// </summary>
+	CpuCulling m_CpuCulling;
+	/// <summary>
+	/// Only initialized with PreDeviceSetupParameters::EnableSoftwareOcclusion. Occluders rendered by the client each Tick,
+	/// filters the output of m_CpuCulling before recording
+	/// </summary>
+	SoftwareOcclusion m_SoftwareOcclusion;
+
 private:
 	bool m_InitializedBase = false;
+	HostAllocator m_HostAllocator;
+	bool m_ReportHostAllocations = false;
+
+	double m_FixedTimestep = 0.0;
+	uint32_t m_MaxUpdateSteps = 0;
+	double m_Accumulator = 0.0;
+	float m_InterpolationAlpha = 0.0f;
+	std::chrono::steady_clock::time_point m_LastStepTime = {};
+
+	bool m_RenderOnDemand = false;
+	uint32_t m_HiddenPollInterval = 100;
+	std::atomic<bool> m_Invalidated{ true };
 };
\ No newline at end of file
@@ -0,0 +1,417 @@
+#include "CommandEncoder.h"
+
+#include "../Util/ByteKey.h"
+
+namespace
+{
+	// Dynamic state the encoder tracks, to tell which of it survives a pipeline bind
+	const uint32_t STATE_VIEWPORT = 1u << 0;
+	const uint32_t STATE_SCISSOR = 1u << 1;
+	const uint32_t STATE_LINE_WIDTH = 1u << 2;
+	const uint32_t STATE_DEPTH_BIAS = 1u << 3;
+	const uint32_t STATE_BLEND_CONSTANTS = 1u << 4;
+	const uint32_t STATE_STENCIL_REFERENCE = 1u << 5;
+	const uint32_t STATE_CULL_MODE = 1u << 6;
+	const uint32_t STATE_FRONT_FACE = 1u << 7;
+	const uint32_t STATE_TOPOLOGY = 1u << 8;
+	const uint32_t STATE_DEPTH_TEST = 1u << 9;
+	const uint32_t STATE_DEPTH_WRITE = 1u << 10;
+	const uint32_t STATE_DEPTH_COMPARE = 1u << 11;
+	const uint32_t STATE_PRIMITIVE_RESTART = 1u << 12;
+	const uint32_t STATE_PATCH_CONTROL_POINTS = 1u << 13;
+	const uint32_t STATE_POLYGON_MODE = 1u << 14;
+	const uint32_t STATE_DEPTH_CLAMP = 1u << 15;
+	const uint32_t STATE_COLOR_BLEND = 1u << 16;
+}
+
+void CommandEncoder::Begin(VkCommandBuffer cmd)
+{
+	m_Cmd = cmd;
+	Invalidate();
+}
+
+void CommandEncoder::Invalidate()
+{
+	for (BindPointState& bindPoint : m_BindPoints)
+		bindPoint = {};
+	for (uint32_t i = 0; i < MAX_VERTEX_BUFFERS; i++)
+	{
+		m_VertexBuffers[i].Valid = false;
+		m_VertexOffsets[i].Valid = false;
+	}
+	m_IndexBuffer.Valid = false;
+	m_IndexOffset.Valid = false;
+	m_IndexType.Valid = false;
+	m_PushLayout = VK_NULL_HANDLE;
+	memset(m_PushStages, 0, sizeof(m_PushStages));
+	InvalidateDynamicState(0);
+}
+
+void CommandEncoder::SetPersistentState(const DynamicStateSupport& support)
+{
+	// Pipelines of GraphicsPipelineBuilder always have dynamic viewport and scissor
+	m_PersistentState = STATE_VIEWPORT | STATE_SCISSOR;
+	if (support.ExtendedDynamicState)
+		m_PersistentState |= STATE_CULL_MODE | STATE_FRONT_FACE | STATE_TOPOLOGY | STATE_DEPTH_TEST | STATE_DEPTH_WRITE | STATE_DEPTH_COMPARE;
+	if (support.ExtendedDynamicState2)
+		m_PersistentState |= STATE_PRIMITIVE_RESTART;
+	if (support.PatchControlPoints)
+		m_PersistentState |= STATE_PATCH_CONTROL_POINTS;
+	if (support.PolygonMode)
+		m_PersistentState |= STATE_POLYGON_MODE;
+	if (support.DepthClamp)
+		m_PersistentState |= STATE_DEPTH_CLAMP;
+	if (support.ColorBlend)
+		m_PersistentState |= STATE_COLOR_BLEND;
+}
+
+void CommandEncoder::InvalidateDynamicState(uint32_t keptState)
+{
+	for (uint32_t i = 0; i < MAX_VIEWPORTS; i++)
+	{
+		m_Viewports[i].Valid &= (keptState & STATE_VIEWPORT) != 0;
+		m_Scissors[i].Valid &= (keptState & STATE_SCISSOR) != 0;
+	}
+	m_LineWidth.Valid &= (keptState & STATE_LINE_WIDTH) != 0;
+	m_DepthBias.Valid &= (keptState & STATE_DEPTH_BIAS) != 0;
+	m_BlendConstants.Valid &= (keptState & STATE_BLEND_CONSTANTS) != 0;
+	m_StencilReference[0].Valid &= (keptState & STATE_STENCIL_REFERENCE) != 0;
+	m_StencilReference[1].Valid &= (keptState & STATE_STENCIL_REFERENCE) != 0;
+	m_CullMode.Valid &= (keptState & STATE_CULL_MODE) != 0;
+	m_FrontFace.Valid &= (keptState & STATE_FRONT_FACE) != 0;
+	m_Topology.Valid &= (keptState & STATE_TOPOLOGY) != 0;
+	m_DepthTest.Valid &= (keptState & STATE_DEPTH_TEST) != 0;
+	m_DepthWrite.Valid &= (keptState & STATE_DEPTH_WRITE) != 0;
+	m_DepthCompare.Valid &= (keptState & STATE_DEPTH_COMPARE) != 0;
+	m_PrimitiveRestart.Valid &= (keptState & STATE_PRIMITIVE_RESTART) != 0;
+	m_PatchControlPoints.Valid &= (keptState & STATE_PATCH_CONTROL_POINTS) != 0;
+	m_PolygonMode.Valid &= (keptState & STATE_POLYGON_MODE) != 0;
+	m_DepthClamp.Valid &= (keptState & STATE_DEPTH_CLAMP) != 0;
+	m_ColorBlendValid &= (keptState & STATE_COLOR_BLEND) != 0;
+}
+
+void CommandEncoder::BindPipeline(VkPipelineBindPoint bindPoint, VkPipeline pipeline)
+{
+	BindPointState& state = m_BindPoints[BindPointIndex(bindPoint)];
+	if (!Emit(state.Pipeline != pipeline))
+		return;
+
+	vkCmdBindPipeline(m_Cmd, bindPoint, pipeline);
+	state.Pipeline = pipeline;
+	state.pProgram = nullptr;
+	// Static state of the new pipeline replaces whatever was set dynamically
+	if (bindPoint == VK_PIPELINE_BIND_POINT_GRAPHICS)
+		InvalidateDynamicState(m_PersistentState);
+}
+
+void CommandEncoder::BindShaders(const ShaderProgram& program)
+{
+	bool compute = program.Stages.size() == 1 && program.Stages[0] == VK_SHADER_STAGE_COMPUTE_BIT;
+	BindPointState& state = m_BindPoints[compute ? 1 : 0];
+	if (!Emit(state.pProgram != &program))
+		return;
+
+	ShaderObjectCache::Bind(m_Cmd, program);
+	state.pProgram = &program;
+	state.Pipeline = VK_NULL_HANDLE;
+}
+
+void CommandEncoder::BindDescriptorSets(VkPipelineBindPoint bindPoint, VkPipelineLayout layout, uint32_t firstSet, uint32_t setCount,
+	const VkDescriptorSet* pSets, uint32_t dynamicOffsetCount, const uint32_t* pDynamicOffsets)
+{
+	BindPointState& state = m_BindPoints[BindPointIndex(bindPoint)];
+	bool tracked = firstSet + setCount <= MAX_DESCRIPTOR_SETS;
+
+	// Dynamic offsets usually change per draw, those binds are never filtered
+	bool changed = !tracked || state.Layout != layout || dynamicOffsetCount > 0;
+	for (uint32_t i = 0; !changed && i < setCount; i++)
+		changed = state.Sets[firstSet + i] != pSets[i];
+	if (!Emit(changed))
+		return;
+
+	vkCmdBindDescriptorSets(m_Cmd, bindPoint, layout, firstSet, setCount, pSets, dynamicOffsetCount, pDynamicOffsets);
+
+	// A different layout may disturb sets outside the range, unknown offsets make the bound sets unknown
+	if (!tracked || dynamicOffsetCount > 0)
+	{
+		state.Layout = VK_NULL_HANDLE;
+		return;
+	}
+	if (state.Layout != layout)
+	{
+		memset(state.Sets, 0, sizeof(state.Sets));
+		state.Layout = layout;
+	}
+	for (uint32_t i = 0; i < setCount; i++)
+		state.Sets[firstSet + i] = pSets[i];
+}
+
+void CommandEncoder::BindVertexBuffers(uint32_t firstBinding, uint32_t bindingCount, const VkBuffer* pBuffers, const VkDeviceSize* pOffsets)
+{
+	if (firstBinding + bindingCount > MAX_VERTEX_BUFFERS)
+	{
+		Emit(true);
+		vkCmdBindVertexBuffers(m_Cmd, firstBinding, bindingCount, pBuffers, pOffsets);
+		return;
+	}
+
+	// Only the span between the first and last changed binding is recorded
+	uint32_t first = bindingCount;
+	uint32_t last = 0;
+	for (uint32_t i = 0; i < bindingCount; i++)
+	{
+		if (m_VertexBuffers[firstBinding + i].Matches(pBuffers[i]) && m_VertexOffsets[firstBinding + i].Matches(pOffsets[i]))
+			continue;
+		if (first == bindingCount)
+			first = i;
+		last = i;
+	}
+	if (!Emit(first < bindingCount))
+		return;
+
+	vkCmdBindVertexBuffers(m_Cmd, firstBinding + first, last - first + 1, pBuffers + first, pOffsets + first);
+	for (uint32_t i = first; i <= last; i++)
+	{
+		m_VertexBuffers[firstBinding + i].Update(pBuffers[i]);
+		m_VertexOffsets[firstBinding + i].Update(pOffsets[i]);
+	}
+}
+
+void CommandEncoder::BindIndexBuffer(VkBuffer buffer, VkDeviceSize offset, VkIndexType indexType)
+{
+	bool changed = !m_IndexBuffer.Matches(buffer) || !m_IndexOffset.Matches(offset) || !m_IndexType.Matches(indexType);
+	if (!Emit(changed))
+		return;
+
+	vkCmdBindIndexBuffer(m_Cmd, buffer, offset, indexType);
+	m_IndexBuffer.Update(buffer);
+	m_IndexOffset.Update(offset);
+	m_IndexType.Update(indexType);
+}
+
+void CommandEncoder::PushConstants(VkPipelineLayout layout, VkShaderStageFlags stages, uint32_t offset, uint32_t size, const void* pValues)
+{
+	const uint8_t* pBytes = static_cast<const uint8_t*>(pValues);
+	bool tracked = offset + size <= MAX_PUSH_CONSTANT_BYTES;
+
+	bool changed = !tracked || m_PushLayout != layout;
+	for (uint32_t i = 0; !changed && i < size; i++)
+		changed = m_PushStages[offset + i] != stages || m_PushData[offset + i] != pBytes[i];
+	if (!Emit(changed))
+		return;
+
+	vkCmdPushConstants(m_Cmd, layout, stages, offset, size, pValues);
+
+	// Values only carry over to compatible layouts, a different layout starts over
+	if (m_PushLayout != layout)
+	{
+		memset(m_PushStages, 0, sizeof(m_PushStages));
+		m_PushLayout = layout;
+	}
+	if (!tracked)
+		return;
+	memcpy(m_PushData + offset, pBytes, size);
+	for (uint32_t i = 0; i < size; i++)
+		m_PushStages[offset + i] = stages;
+}
+
+void CommandEncoder::SetViewport(uint32_t firstViewport, uint32_t viewportCount, const VkViewport* pViewports)
+{
+	bool tracked = firstViewport + viewportCount <= MAX_VIEWPORTS;
+	bool changed = !tracked;
+	for (uint32_t i = 0; !changed && i < viewportCount; i++)
+		changed = !m_Viewports[firstViewport + i].Matches(pViewports[i]);
+	if (!Emit(changed))
+		return;
+
+	vkCmdSetViewport(m_Cmd, firstViewport, viewportCount, pViewports);
+	for (uint32_t i = 0; tracked && i < viewportCount; i++)
+		m_Viewports[firstViewport + i].Update(pViewports[i]);
+}
+
+void CommandEncoder::SetScissor(uint32_t firstScissor, uint32_t scissorCount, const VkRect2D* pScissors)
+{
+	bool tracked = firstScissor + scissorCount <= MAX_VIEWPORTS;
+	bool changed = !tracked;
+	for (uint32_t i = 0; !changed && i < scissorCount; i++)
+		changed = !m_Scissors[firstScissor + i].Matches(pScissors[i]);
+	if (!Emit(changed))
+		return;
+
+	vkCmdSetScissor(m_Cmd, firstScissor, scissorCount, pScissors);
+	for (uint32_t i = 0; tracked && i < scissorCount; i++)
+		m_Scissors[firstScissor + i].Update(pScissors[i]);
+}
+
+void CommandEncoder::SetLineWidth(float lineWidth)
+{
+	if (Emit(m_LineWidth.Update(lineWidth)))
+		vkCmdSetLineWidth(m_Cmd, lineWidth);
+}
+
+void CommandEncoder::SetDepthBias(float constantFactor, float clamp, float slopeFactor)
+{
+	if (Emit(m_DepthBias.Update({ constantFactor, clamp, slopeFactor })))
+		vkCmdSetDepthBias(m_Cmd, constantFactor, clamp, slopeFactor);
+}
+
+void CommandEncoder::SetBlendConstants(const float blendConstants[4])
+{
+	BlendConstants constants;
+	memcpy(constants.Values, blendConstants, sizeof(constants.Values));
+	if (Emit(m_BlendConstants.Update(constants)))
+		vkCmdSetBlendConstants(m_Cmd, blendConstants);
+}
+
+void CommandEncoder::SetStencilReference(VkStencilFaceFlags faceMask, uint32_t reference)
+{
+	bool changed = ((faceMask & VK_STENCIL_FACE_FRONT_BIT) && !m_StencilReference[0].Matches(reference))
+		|| ((faceMask & VK_STENCIL_FACE_BACK_BIT) && !m_StencilReference[1].Matches(reference));
+	if (!Emit(changed))
+		return;
+
+	vkCmdSetStencilReference(m_Cmd, faceMask, reference);
+	if (faceMask & VK_STENCIL_FACE_FRONT_BIT)
+		m_StencilReference[0].Update(reference);
+	if (faceMask & VK_STENCIL_FACE_BACK_BIT)
+		m_StencilReference[1].Update(reference);
+}
+
+void CommandEncoder::SetCullMode(VkCullModeFlags cullMode)
+{
+	if (Emit(m_CullMode.Update(cullMode)))
+		vkCmdSetCullMode(m_Cmd, cullMode);
+}
+
+void CommandEncoder::SetFrontFace(VkFrontFace frontFace)
+{
+	if (Emit(m_FrontFace.Update(frontFace)))
+		vkCmdSetFrontFace(m_Cmd, frontFace);
+}
+
+void CommandEncoder::SetPrimitiveTopology(VkPrimitiveTopology topology)
+{
+	if (Emit(m_Topology.Update(topology)))
+		vkCmdSetPrimitiveTopology(m_Cmd, topology);
+}
+
+void CommandEncoder::SetDepthTestEnable(bool enable)
+{
+	if (Emit(m_DepthTest.Update(enable ? VK_TRUE : VK_FALSE)))
+		vkCmdSetDepthTestEnable(m_Cmd, enable ? VK_TRUE : VK_FALSE);
+}
+
+void CommandEncoder::SetDepthWriteEnable(bool enable)
+{
+	if (Emit(m_DepthWrite.Update(enable ? VK_TRUE : VK_FALSE)))
+		vkCmdSetDepthWriteEnable(m_Cmd, enable ? VK_TRUE : VK_FALSE);
+}
+
+void CommandEncoder::SetDepthCompareOp(VkCompareOp compareOp)
+{
+	if (Emit(m_DepthCompare.Update(compareOp)))
+		vkCmdSetDepthCompareOp(m_Cmd, compareOp);
+}
+
+void CommandEncoder::SetPrimitiveRestartEnable(bool enable)
+{
+	if (Emit(m_PrimitiveRestart.Update(enable ? VK_TRUE : VK_FALSE)))
+		vkCmdSetPrimitiveRestartEnable(m_Cmd, enable ? VK_TRUE : VK_FALSE);
+}
+
+void CommandEncoder::SetPatchControlPoints(uint32_t patchControlPoints)
+{
+	if (Emit(m_PatchControlPoints.Update(patchControlPoints)))
+		vkCmdSetPatchControlPointsEXT(m_Cmd, patchControlPoints);
+}
+
+void CommandEncoder::SetPolygonMode(VkPolygonMode polygonMode)
+{
+	if (Emit(m_PolygonMode.Update(polygonMode)))
+		vkCmdSetPolygonModeEXT(m_Cmd, polygonMode);
+}
+
+void CommandEncoder::SetDepthClampEnable(bool enable)
+{
+	if (Emit(m_DepthClamp.Update(enable ? VK_TRUE : VK_FALSE)))
+		vkCmdSetDepthClampEnableEXT(m_Cmd, enable ? VK_TRUE : VK_FALSE);
+}
+
+void CommandEncoder::SetColorBlendState(const GraphicsPipelineDesc& desc)
+{
+	std::string key;
+	WriteKey(key, desc.RenderTarget.ColorFormats.size());
+	WriteKey(key, desc.Output.Blend);
+	if (!Emit(!m_ColorBlendValid || key != m_ColorBlendKey))
+		return;
+
+	::SetColorBlendState(m_Cmd, desc);
+	m_ColorBlendKey = std::move(key);
+	m_ColorBlendValid = true;
+}
+
+void CommandEncoder::SetDynamicState(const GraphicsPipelineDesc& desc, const DynamicStateSupport& support)
+{
+	if (support.ExtendedDynamicState)
+	{
+		SetPrimitiveTopology(desc.VertexInput.Topology);
+		SetCullMode(desc.PreRasterization.CullMode);
+		SetFrontFace(desc.PreRasterization.FrontFace);
+		SetDepthTestEnable(desc.Fragment.DepthTest);
+		SetDepthWriteEnable(desc.Fragment.DepthWrite);
+		SetDepthCompareOp(desc.Fragment.DepthCompare);
+	}
+	if (support.ExtendedDynamicState2)
+		SetPrimitiveRestartEnable(desc.VertexInput.PrimitiveRestart);
+	if (support.PatchControlPoints && desc.PreRasterization.PatchControlPoints > 0)
+		SetPatchControlPoints(desc.PreRasterization.PatchControlPoints);
+	if (support.PolygonMode)
+		SetPolygonMode(desc.PreRasterization.PolygonMode);
+	if (support.DepthClamp)
+		SetDepthClampEnable(desc.PreRasterization.DepthClamp);
+	if (support.ColorBlend)
+		SetColorBlendState(desc);
+}
+
+void CommandEncoder::Draw(uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance)
+{
+	Emit(true);
+	vkCmdDraw(m_Cmd, vertexCount, instanceCount, firstVertex, firstInstance);
+}
+
+void CommandEncoder::DrawIndexed(uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, int32_t vertexOffset, uint32_t firstInstance)
+{
+	Emit(true);
+	vkCmdDrawIndexed(m_Cmd, indexCount, instanceCount, firstIndex, vertexOffset, firstInstance);
+}
+
+void CommandEncoder::DrawIndirect(VkBuffer buffer, VkDeviceSize offset, uint32_t drawCount, uint32_t stride)
+{
+	Emit(true);
+	vkCmdDrawIndirect(m_Cmd, buffer, offset, drawCount, stride);
+}
+
+void CommandEncoder::DrawIndexedIndirect(VkBuffer buffer, VkDeviceSize offset, uint32_t drawCount, uint32_t stride)
+{
+	Emit(true);
+	vkCmdDrawIndexedIndirect(m_Cmd, buffer, offset, drawCount, stride);
+}
+
+void CommandEncoder::DrawIndexedIndirectCount(VkBuffer buffer, VkDeviceSize offset, VkBuffer countBuffer, VkDeviceSize countOffset,
+	uint32_t maxDrawCount, uint32_t stride)
+{
+	Emit(true);
+	vkCmdDrawIndexedIndirectCount(m_Cmd, buffer, offset, countBuffer, countOffset, maxDrawCount, stride);
+}
+
+void CommandEncoder::Dispatch(uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ)
+{
+	Emit(true);
+	vkCmdDispatch(m_Cmd, groupCountX, groupCountY, groupCountZ);
+}
+
+void CommandEncoder::DrawMeshTasks(uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ)
+{
+	Emit(true);
+	vkCmdDrawMeshTasksEXT(m_Cmd, groupCountX, groupCountY, groupCountZ);
+}
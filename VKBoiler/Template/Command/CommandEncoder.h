@@ -0,0 +1,180 @@
+#pragma once
+
+#include "../Loader/Loader.h"
+#include "../Pipeline/GraphicsPipelineBuilder.h"
+#include "../Pipeline/ShaderObjects.h"
+
+#include <string.h>
+
+struct CommandEncoderStats
+{
+	/// <summary>
+	/// Commands that reached the driver, draws and dispatches included
+	/// </summary>
+	uint64_t Emitted = 0;
+	/// <summary>
+	/// Commands dropped because they would not have changed the bound state
+	/// </summary>
+	uint64_t Filtered = 0;
+};
+
+/// <summary>
+/// Thin wrapper around a command buffer that remembers what is bound and drops binds and state changes that would
+/// not change anything. Binding a pipeline forgets the dynamic state it may have baked in, unless SetPersistentState
+/// says every pipeline leaves it dynamic. Calls made on the raw command buffer are not seen, call Invalidate after them.
+/// One encoder per command buffer being recorded, not thread safe
+/// </summary>
+class CommandEncoder
+{
+public:
+	static const uint32_t MAX_DESCRIPTOR_SETS = 8;
+	static const uint32_t MAX_VERTEX_BUFFERS = 16;
+	static const uint32_t MAX_VIEWPORTS = 16;
+	static const uint32_t MAX_PUSH_CONSTANT_BYTES = 256;
+
+	/// <summary>
+	/// Starts tracking a command buffer in the recording state, nothing is considered bound
+	/// </summary>
+	void Begin(VkCommandBuffer cmd);
+	/// <summary>
+	/// Forgets all tracked state, the next call of every kind reaches the driver
+	/// </summary>
+	void Invalidate();
+	/// <summary>
+	/// Keeps the state pipelines of a GraphicsPipelineBuilder with this support leave dynamic across pipeline binds:
+	/// viewport, scissor and everything the support covers. By default no state survives a pipeline bind
+	/// </summary>
+	void SetPersistentState(const DynamicStateSupport& support);
+
+	VkCommandBuffer GetCommandBuffer() const { return m_Cmd; }
+	const CommandEncoderStats& GetStats() const { return m_Stats; }
+	void ResetStats() { m_Stats = {}; }
+
+	void BindPipeline(VkPipelineBindPoint bindPoint, VkPipeline pipeline);
+	/// <summary>
+	/// Binds a shader object program. Shader objects bake in no state, so tracked state stays valid
+	/// </summary>
+	void BindShaders(const ShaderProgram& program);
+	void BindDescriptorSets(VkPipelineBindPoint bindPoint, VkPipelineLayout layout, uint32_t firstSet, uint32_t setCount,
+		const VkDescriptorSet* pSets, uint32_t dynamicOffsetCount = 0, const uint32_t* pDynamicOffsets = nullptr);
+	void BindVertexBuffers(uint32_t firstBinding, uint32_t bindingCount, const VkBuffer* pBuffers, const VkDeviceSize* pOffsets);
+	void BindIndexBuffer(VkBuffer buffer, VkDeviceSize offset, VkIndexType indexType);
+	void PushConstants(VkPipelineLayout layout, VkShaderStageFlags stages, uint32_t offset, uint32_t size, const void* pValues);
+
+	void SetViewport(uint32_t firstViewport, uint32_t viewportCount, const VkViewport* pViewports);
+	void SetScissor(uint32_t firstScissor, uint32_t scissorCount, const VkRect2D* pScissors);
+	void SetLineWidth(float lineWidth);
+	void SetDepthBias(float constantFactor, float clamp, float slopeFactor);
+	void SetBlendConstants(const float blendConstants[4]);
+	void SetStencilReference(VkStencilFaceFlags faceMask, uint32_t reference);
+	void SetCullMode(VkCullModeFlags cullMode);
+	void SetFrontFace(VkFrontFace frontFace);
+	void SetPrimitiveTopology(VkPrimitiveTopology topology);
+	void SetDepthTestEnable(bool enable);
+	void SetDepthWriteEnable(bool enable);
+	void SetDepthCompareOp(VkCompareOp compareOp);
+	void SetPrimitiveRestartEnable(bool enable);
+	void SetPatchControlPoints(uint32_t patchControlPoints);
+	void SetPolygonMode(VkPolygonMode polygonMode);
+	void SetDepthClampEnable(bool enable);
+	void SetColorBlendState(const GraphicsPipelineDesc& desc);
+	/// <summary>
+	/// Filtered counterpart of GraphicsPipelineBuilder::SetDynamicState
+	/// </summary>
+	void SetDynamicState(const GraphicsPipelineDesc& desc, const DynamicStateSupport& support);
+
+	void Draw(uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance);
+	void DrawIndexed(uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, int32_t vertexOffset, uint32_t firstInstance);
+	void DrawIndirect(VkBuffer buffer, VkDeviceSize offset, uint32_t drawCount, uint32_t stride);
+	void DrawIndexedIndirect(VkBuffer buffer, VkDeviceSize offset, uint32_t drawCount, uint32_t stride);
+	void DrawIndexedIndirectCount(VkBuffer buffer, VkDeviceSize offset, VkBuffer countBuffer, VkDeviceSize countOffset,
+		uint32_t maxDrawCount, uint32_t stride);
+	void Dispatch(uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ);
+	/// <summary>
+	/// Needs VK_EXT_mesh_shader enabled on the device
+	/// </summary>
+	void DrawMeshTasks(uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ);
+
+private:
+	// Last value set for one piece of state, compared bytewise
+	template<typename T>
+	struct Tracked
+	{
+		T Value;
+		bool Valid = false;
+
+		bool Matches(const T& value) const { return Valid && memcmp(&Value, &value, sizeof(T)) == 0; }
+
+		// True when value differs from the tracked one, which it then replaces
+		bool Update(const T& value)
+		{
+			if (Matches(value))
+				return false;
+			memcpy(&Value, &value, sizeof(T));
+			Valid = true;
+			return true;
+		}
+	};
+
+	struct BindPointState
+	{
+		VkPipeline Pipeline = VK_NULL_HANDLE;
+		// Programs are owned by the ShaderObjectCache and never move
+		const ShaderProgram* pProgram = nullptr;
+		VkPipelineLayout Layout = VK_NULL_HANDLE;
+		VkDescriptorSet Sets[MAX_DESCRIPTOR_SETS] = {};
+	};
+
+	static uint32_t BindPointIndex(VkPipelineBindPoint bindPoint) { return bindPoint == VK_PIPELINE_BIND_POINT_COMPUTE ? 1 : 0; }
+
+	// Counts the call and returns whether it has to be recorded
+	bool Emit(bool changed)
+	{
+		if (changed)
+			m_Stats.Emitted++;
+		else
+			m_Stats.Filtered++;
+		return changed;
+	}
+
+	void InvalidateDynamicState(uint32_t keptState);
+
+private:
+	VkCommandBuffer m_Cmd = VK_NULL_HANDLE;
+	CommandEncoderStats m_Stats = {};
+	uint32_t m_PersistentState = 0;
+
+	BindPointState m_BindPoints[2] = {};
+
+	Tracked<VkBuffer> m_VertexBuffers[MAX_VERTEX_BUFFERS] = {};
+	Tracked<VkDeviceSize> m_VertexOffsets[MAX_VERTEX_BUFFERS] = {};
+	Tracked<VkBuffer> m_IndexBuffer = {};
+	Tracked<VkDeviceSize> m_IndexOffset = {};
+	Tracked<VkIndexType> m_IndexType = {};
+
+	VkPipelineLayout m_PushLayout = VK_NULL_HANDLE;
+	uint8_t m_PushData[MAX_PUSH_CONSTANT_BYTES] = {};
+	// Stages each byte was last pushed for, 0 when unknown
+	VkShaderStageFlags m_PushStages[MAX_PUSH_CONSTANT_BYTES] = {};
+
+	Tracked<VkViewport> m_Viewports[MAX_VIEWPORTS] = {};
+	Tracked<VkRect2D> m_Scissors[MAX_VIEWPORTS] = {};
+	Tracked<float> m_LineWidth = {};
+	struct DepthBias { float Constant; float Clamp; float Slope; };
+	Tracked<DepthBias> m_DepthBias = {};
+	struct BlendConstants { float Values[4]; };
+	Tracked<BlendConstants> m_BlendConstants = {};
+	Tracked<uint32_t> m_StencilReference[2] = {};
+	Tracked<VkCullModeFlags> m_CullMode = {};
+	Tracked<VkFrontFace> m_FrontFace = {};
+	Tracked<VkPrimitiveTopology> m_Topology = {};
+	Tracked<VkBool32> m_DepthTest = {};
+	Tracked<VkBool32> m_DepthWrite = {};
+	Tracked<VkCompareOp> m_DepthCompare = {};
+	Tracked<VkBool32> m_PrimitiveRestart = {};
+	Tracked<uint32_t> m_PatchControlPoints = {};
+	Tracked<VkPolygonMode> m_PolygonMode = {};
+	Tracked<VkBool32> m_DepthClamp = {};
+	std::string m_ColorBlendKey = {};
+	bool m_ColorBlendValid = false;
+};
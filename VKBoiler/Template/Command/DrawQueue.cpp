@@ -0,0 +1,325 @@
+#include "DrawQueue.h"
+
+#include "../Memory/DeviceMemory.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <stdio.h>
+#include <string.h>
+
+#undef max
+#undef min
+
+namespace
+{
+	const uint32_t RADIX_BITS = 8;
+	const uint32_t RADIX = 1u << RADIX_BITS;
+	const uint32_t RADIX_PASSES = 64 / RADIX_BITS;
+	// Below this many packets per thread the cost of starting threads outweighs the sort
+	const size_t PACKETS_PER_SORT_THREAD = 16384;
+
+	// Releases all threads once the last one arrived, reusable for the next round
+	class Barrier
+	{
+	public:
+		explicit Barrier(uint32_t count)
+			:m_Count(count)
+		{
+		}
+
+		void Wait()
+		{
+			if (m_Count == 1)
+				return;
+
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			uint64_t generation = m_Generation;
+			if (++m_Arrived == m_Count)
+			{
+				m_Arrived = 0;
+				m_Generation++;
+				m_Condition.notify_all();
+				return;
+			}
+			m_Condition.wait(lock, [&]() { return m_Generation != generation; });
+		}
+
+	private:
+		std::mutex m_Mutex;
+		std::condition_variable m_Condition;
+		uint32_t m_Count;
+		uint32_t m_Arrived = 0;
+		uint64_t m_Generation = 0;
+	};
+
+	uint32_t Digit(uint64_t key, uint32_t pass)
+	{
+		return static_cast<uint32_t>(key >> (pass * RADIX_BITS)) & (RADIX - 1);
+	}
+
+	// Stable LSD radix sort by Key. Each thread counts and scatters its own contiguous chunk, chunks of lower threads
+	// go first within a bucket which keeps the sort stable. Passes over a digit all keys share are skipped
+	template<typename Item>
+	void RadixSort(std::vector<Item>& items, std::vector<Item>& scratch, uint32_t threadCount)
+	{
+		size_t count = items.size();
+		if (count < 2)
+			return;
+		scratch.resize(count);
+
+		std::vector<uint32_t> keyCounts(static_cast<size_t>(threadCount) * RADIX_PASSES * RADIX, 0);
+		std::vector<uint32_t> passCounts(static_cast<size_t>(threadCount) * RADIX, 0);
+		uint64_t firstKey = items[0].Key;
+		Barrier barrier(threadCount);
+
+		auto worker = [&](uint32_t thread)
+		{
+			size_t begin = count * thread / threadCount;
+			size_t end = count * (thread + 1) / threadCount;
+
+			// Digit totals do not depend on the order, one read tells which passes would move anything
+			uint32_t* pKeyCounts = keyCounts.data() + static_cast<size_t>(thread) * RADIX_PASSES * RADIX;
+			for (size_t i = begin; i < end; i++)
+			{
+				for (uint32_t pass = 0; pass < RADIX_PASSES; pass++)
+					pKeyCounts[pass * RADIX + Digit(items[i].Key, pass)]++;
+			}
+			barrier.Wait();
+
+			Item* pSrc = items.data();
+			Item* pDst = scratch.data();
+			for (uint32_t pass = 0; pass < RADIX_PASSES; pass++)
+			{
+				size_t firstDigitCount = 0;
+				for (uint32_t t = 0; t < threadCount; t++)
+					firstDigitCount += keyCounts[(static_cast<size_t>(t) * RADIX_PASSES + pass) * RADIX + Digit(firstKey, pass)];
+				if (firstDigitCount == count)
+					continue;
+
+				uint32_t* pPassCounts = passCounts.data() + static_cast<size_t>(thread) * RADIX;
+				memset(pPassCounts, 0, RADIX * sizeof(uint32_t));
+				for (size_t i = begin; i < end; i++)
+					pPassCounts[Digit(pSrc[i].Key, pass)]++;
+				barrier.Wait();
+
+				// A bucket of this thread starts after all smaller digits and after the same bucket of lower threads
+				size_t offsets[RADIX];
+				size_t running = 0;
+				for (uint32_t digit = 0; digit < RADIX; digit++)
+				{
+					for (uint32_t t = 0; t < threadCount; t++)
+					{
+						if (t == thread)
+							offsets[digit] = running;
+						running += passCounts[static_cast<size_t>(t) * RADIX + digit];
+					}
+				}
+				for (size_t i = begin; i < end; i++)
+					pDst[offsets[Digit(pSrc[i].Key, pass)]++] = pSrc[i];
+				barrier.Wait();
+
+				std::swap(pSrc, pDst);
+			}
+
+			if (pSrc != items.data())
+				memcpy(items.data() + begin, pSrc + begin, (end - begin) * sizeof(Item));
+		};
+
+		std::vector<std::thread> threads;
+		for (uint32_t i = 1; i < threadCount; i++)
+			threads.emplace_back(worker, i);
+		worker(0);
+		for (std::thread& thread : threads)
+			thread.join();
+	}
+
+	bool SameMesh(const VkDrawIndexedIndirectCommand& a, const VkDrawIndexedIndirectCommand& b)
+	{
+		return a.indexCount == b.indexCount && a.firstIndex == b.firstIndex && a.vertexOffset == b.vertexOffset;
+	}
+}
+
+/*static*/ uint64_t DrawQueue::MakeSortKey(uint32_t pass, uint32_t pipeline, uint32_t material, float depth)
+{
+	const uint32_t depthMax = (1u << DEPTH_BITS) - 1;
+	uint32_t quantizedDepth = static_cast<uint32_t>(std::min(std::max(depth, 0.0f), 1.0f) * static_cast<float>(depthMax));
+
+	uint64_t key = pass & ((1u << PASS_BITS) - 1);
+	key = (key << PIPELINE_BITS) | (pipeline & ((1u << PIPELINE_BITS) - 1));
+	key = (key << MATERIAL_BITS) | (material & ((1u << MATERIAL_BITS) - 1));
+	key = (key << DEPTH_BITS) | std::min(quantizedDepth, depthMax);
+	return key;
+}
+
+bool DrawQueue::Init(VkDevice device, VkPhysicalDevice physicalDevice, const VkAllocationCallbacks* pAllocator,
+	uint32_t framesInFlight, uint32_t indirectCapacity)
+{
+	m_Device = device;
+	m_pAllocator = pAllocator;
+	m_FramesInFlight = std::max(framesInFlight, 1u);
+	m_FrameSlot = 0;
+	m_IndirectCapacity = 0;
+
+	if (indirectCapacity == 0)
+		return true;
+
+	VkPhysicalDeviceProperties props{};
+	vkGetPhysicalDeviceProperties(physicalDevice, &props);
+	m_MaxDrawIndirectCount = std::max(props.limits.maxDrawIndirectCount, 1u);
+
+	// Written by the CPU every frame and read once by the GPU, host visible memory is enough
+	VkPhysicalDeviceMemoryProperties memoryProps{};
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProps);
+	VkDeviceSize size = static_cast<VkDeviceSize>(indirectCapacity) * m_FramesInFlight * sizeof(VkDrawIndexedIndirectCommand);
+	void* pMapped = nullptr;
+	if (!CreateBuffer(m_Device, memoryProps, m_pAllocator, size, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 0, 0, 0, &m_IndirectBuffer, &m_IndirectMemory)
+		|| vkMapMemory(m_Device, m_IndirectMemory, 0, VK_WHOLE_SIZE, 0, &pMapped) != VK_SUCCESS)
+	{
+		printf("Failed to create draw queue indirect buffer, recording draws directly\n");
+		Destroy();
+		return true;
+	}
+
+	m_pIndirectCommands = static_cast<VkDrawIndexedIndirectCommand*>(pMapped);
+	m_IndirectCapacity = indirectCapacity;
+	return true;
+}
+
+void DrawQueue::Destroy()
+{
+	if (m_Device == VK_NULL_HANDLE)
+		return;
+
+	DestroyBuffer(m_Device, m_pAllocator, m_IndirectBuffer, m_IndirectMemory);
+	m_pIndirectCommands = nullptr;
+	m_IndirectCapacity = 0;
+	m_Packets.clear();
+	m_Order.clear();
+	m_Device = VK_NULL_HANDLE;
+}
+
+void DrawQueue::BeginFrame()
+{
+	m_Packets.clear();
+	m_Sorted = false;
+	m_FrameSlot = (m_FrameSlot + 1) % m_FramesInFlight;
+	m_IndirectUsed = 0;
+	m_Stats = {};
+}
+
+void DrawQueue::Submit(const DrawPacket& packet)
+{
+	m_Packets.push_back(packet);
+	m_Sorted = false;
+}
+
+void DrawQueue::Sort(uint32_t threadCount)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	m_Order.resize(m_Packets.size());
+	for (size_t i = 0; i < m_Packets.size(); i++)
+		m_Order[i] = { m_Packets[i].SortKey, static_cast<uint32_t>(i) };
+
+	if (threadCount == 0)
+	{
+		size_t byCount = m_Order.size() / PACKETS_PER_SORT_THREAD;
+		threadCount = static_cast<uint32_t>(std::min<size_t>(byCount, std::max(std::thread::hardware_concurrency(), 1u)));
+	}
+	threadCount = std::max(threadCount, 1u);
+	RadixSort(m_Order, m_SortScratch, threadCount);
+
+	m_Sorted = true;
+	m_Stats.Packets = static_cast<uint32_t>(m_Packets.size());
+	m_Stats.SortMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void DrawQueue::Record(CommandEncoder& encoder, uint32_t pass)
+{
+	if (!m_Sorted)
+		Sort();
+
+	// The pass occupies the top bits, so its packets form one range of the sorted order
+	auto begin = std::lower_bound(m_Order.begin(), m_Order.end(), pass,
+		[](const SortItem& item, uint32_t value) { return GetPass(item.Key) < value; });
+	auto end = std::upper_bound(begin, m_Order.end(), pass,
+		[](uint32_t value, const SortItem& item) { return value < GetPass(item.Key); });
+
+	for (auto run = begin; run != end;)
+	{
+		const DrawPacket& first = m_Packets[run->Index];
+		auto runEnd = run + 1;
+		while (runEnd != end && SameState(first, m_Packets[runEnd->Index]))
+			runEnd++;
+
+		BindState(encoder, first);
+
+		// Same mesh with the next instances continues the previous draw
+		m_Draws.clear();
+		for (auto it = run; it != runEnd; it++)
+		{
+			const VkDrawIndexedIndirectCommand& draw = m_Packets[it->Index].Draw;
+			if (!m_Draws.empty() && SameMesh(m_Draws.back(), draw)
+				&& m_Draws.back().firstInstance + m_Draws.back().instanceCount == draw.firstInstance)
+			{
+				m_Draws.back().instanceCount += draw.instanceCount;
+				m_Stats.InstancedMerges++;
+				continue;
+			}
+			m_Draws.push_back(draw);
+		}
+		RecordDraws(encoder, m_Draws);
+
+		run = runEnd;
+	}
+}
+
+/*static*/ bool DrawQueue::SameState(const DrawPacket& a, const DrawPacket& b)
+{
+	return a.Pipeline == b.Pipeline && a.Layout == b.Layout
+		&& a.DescriptorSet == b.DescriptorSet && a.SetIndex == b.SetIndex
+		&& a.VertexBuffer == b.VertexBuffer && a.VertexBufferOffset == b.VertexBufferOffset
+		&& a.IndexBuffer == b.IndexBuffer && a.IndexBufferOffset == b.IndexBufferOffset && a.IndexType == b.IndexType;
+}
+
+void DrawQueue::BindState(CommandEncoder& encoder, const DrawPacket& packet)
+{
+	encoder.BindPipeline(VK_PIPELINE_BIND_POINT_GRAPHICS, packet.Pipeline);
+	if (packet.DescriptorSet != VK_NULL_HANDLE)
+		encoder.BindDescriptorSets(VK_PIPELINE_BIND_POINT_GRAPHICS, packet.Layout, packet.SetIndex, 1, &packet.DescriptorSet);
+	if (packet.VertexBuffer != VK_NULL_HANDLE)
+		encoder.BindVertexBuffers(0, 1, &packet.VertexBuffer, &packet.VertexBufferOffset);
+	encoder.BindIndexBuffer(packet.IndexBuffer, packet.IndexBufferOffset, packet.IndexType);
+}
+
+void DrawQueue::RecordDraws(CommandEncoder& encoder, const std::vector<VkDrawIndexedIndirectCommand>& draws)
+{
+	uint32_t drawCount = static_cast<uint32_t>(draws.size());
+	if (drawCount > 1 && m_IndirectUsed + drawCount <= m_IndirectCapacity)
+	{
+		uint32_t first = m_FrameSlot * m_IndirectCapacity + m_IndirectUsed;
+		memcpy(m_pIndirectCommands + first, draws.data(), drawCount * sizeof(VkDrawIndexedIndirectCommand));
+		m_IndirectUsed += drawCount;
+
+		const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+		for (uint32_t offset = 0; offset < drawCount; offset += m_MaxDrawIndirectCount)
+		{
+			uint32_t count = std::min(drawCount - offset, m_MaxDrawIndirectCount);
+			encoder.DrawIndexedIndirect(m_IndirectBuffer, static_cast<VkDeviceSize>(first + offset) * stride, count, stride);
+			m_Stats.DrawCalls++;
+		}
+		m_Stats.IndirectDraws += drawCount;
+		return;
+	}
+
+	// Single draws or an exhausted indirect buffer
+	for (const VkDrawIndexedIndirectCommand& draw : draws)
+	{
+		encoder.DrawIndexed(draw.indexCount, draw.instanceCount, draw.firstIndex, draw.vertexOffset, draw.firstInstance);
+		m_Stats.DrawCalls++;
+	}
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include "../Loader/Loader.h"
+#include "CommandEncoder.h"
+
+#include <vector>
+
+/// <summary>
+/// One indexed draw and the state it needs. Per object data is expected to be looked up through the instance index,
+/// so draws of the same mesh with consecutive firstInstance can merge into a single instanced draw
+/// </summary>
+struct DrawPacket
+{
+	/// <summary>
+	/// Orders the packet within its frame, see DrawQueue::MakeSortKey
+	/// </summary>
+	uint64_t SortKey = 0;
+
+	VkPipeline Pipeline = VK_NULL_HANDLE;
+	VkPipelineLayout Layout = VK_NULL_HANDLE;
+	/// <summary>
+	/// Bound at SetIndex when not VK_NULL_HANDLE
+	/// </summary>
+	VkDescriptorSet DescriptorSet = VK_NULL_HANDLE;
+	uint32_t SetIndex = 0;
+
+	/// <summary>
+	/// Bound at binding 0 when not VK_NULL_HANDLE
+	/// </summary>
+	VkBuffer VertexBuffer = VK_NULL_HANDLE;
+	VkDeviceSize VertexBufferOffset = 0;
+	VkBuffer IndexBuffer = VK_NULL_HANDLE;
+	VkDeviceSize IndexBufferOffset = 0;
+	VkIndexType IndexType = VK_INDEX_TYPE_UINT32;
+
+	VkDrawIndexedIndirectCommand Draw = {};
+};
+
+struct DrawQueueStats
+{
+	uint32_t Packets = 0;
+	/// <summary>
+	/// Packets folded into the instance count of the packet before them
+	/// </summary>
+	uint32_t InstancedMerges = 0;
+	/// <summary>
+	/// Draws recorded as part of a multi draw indirect call
+	/// </summary>
+	uint32_t IndirectDraws = 0;
+	/// <summary>
+	/// Draw calls that reached the command buffer, direct and indirect
+	/// </summary>
+	uint32_t DrawCalls = 0;
+	double SortMs = 0.0;
+};
+
+/// <summary>
+/// Collects the draws of a frame and records them ordered by sort key, so draws sharing state end up next to each other.
+/// Runs of packets with identical state are bound once, draws of the same mesh with consecutive instances become one
+/// instanced draw and the remaining draws of a run become one multi draw indirect call. Packets are sorted with an
+/// LSD radix sort split across threads for large queues.
+/// Submit from one thread, BeginFrame has to be called once per frame before the first Submit
+/// </summary>
+class DrawQueue
+{
+public:
+	static const uint32_t PASS_BITS = 6;
+	static const uint32_t PIPELINE_BITS = 12;
+	static const uint32_t MATERIAL_BITS = 22;
+	static const uint32_t DEPTH_BITS = 24;
+
+	/// <summary>
+	/// Pass in the top bits, then pipeline, material and depth. Pipeline and material are client ids, not handles,
+	/// values beyond their bit count wrap. Depth in [0, 1] sorts front to back, pass 1 - depth for back to front
+	/// </summary>
+	static uint64_t MakeSortKey(uint32_t pass, uint32_t pipeline, uint32_t material, float depth);
+	static uint32_t GetPass(uint64_t sortKey) { return static_cast<uint32_t>(sortKey >> (64 - PASS_BITS)); }
+
+	/// <summary>
+	/// indirectCapacity is the number of indirect commands per frame, 0 records every draw directly.
+	/// Needs the multiDrawIndirect and drawIndirectFirstInstance features otherwise
+	/// </summary>
+	bool Init(VkDevice device, VkPhysicalDevice physicalDevice, const VkAllocationCallbacks* pAllocator,
+		uint32_t framesInFlight, uint32_t indirectCapacity);
+	void Destroy();
+
+	/// <summary>
+	/// Drops last frame's packets and moves on to the next indirect buffer slot, the client must have waited for the
+	/// frame that last used it
+	/// </summary>
+	void BeginFrame();
+	void Submit(const DrawPacket& packet);
+	void Reserve(size_t packetCount) { m_Packets.reserve(packetCount); }
+
+	/// <summary>
+	/// Sorts the submitted packets, threadCount 0 picks one by queue size. Record sorts on its own when needed
+	/// </summary>
+	void Sort(uint32_t threadCount = 0);
+	/// <summary>
+	/// Records all packets of one pass, state is bound through the encoder so binds shared with earlier passes are filtered
+	/// </summary>
+	void Record(CommandEncoder& encoder, uint32_t pass);
+
+	const DrawQueueStats& GetStats() const { return m_Stats; }
+
+private:
+	struct SortItem
+	{
+		uint64_t Key;
+		uint32_t Index;
+	};
+
+	static bool SameState(const DrawPacket& a, const DrawPacket& b);
+	void BindState(CommandEncoder& encoder, const DrawPacket& packet);
+	void RecordDraws(CommandEncoder& encoder, const std::vector<VkDrawIndexedIndirectCommand>& draws);
+
+private:
+	VkDevice m_Device = VK_NULL_HANDLE;
+	const VkAllocationCallbacks* m_pAllocator = nullptr;
+
+	std::vector<DrawPacket> m_Packets = {};
+	std::vector<SortItem> m_Order = {};
+	std::vector<SortItem> m_SortScratch = {};
+	bool m_Sorted = false;
+	std::vector<VkDrawIndexedIndirectCommand> m_Draws = {};
+
+	// Host visible, one slot of m_IndirectCapacity commands per frame in flight
+	VkBuffer m_IndirectBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory m_IndirectMemory = VK_NULL_HANDLE;
+	VkDrawIndexedIndirectCommand* m_pIndirectCommands = nullptr;
+	uint32_t m_IndirectCapacity = 0;
+	uint32_t m_MaxDrawIndirectCount = 1;
+	uint32_t m_FramesInFlight = 1;
+	uint32_t m_FrameSlot = 0;
+	uint32_t m_IndirectUsed = 0;
+
+	DrawQueueStats m_Stats = {};
+};
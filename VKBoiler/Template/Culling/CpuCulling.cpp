@@ -0,0 +1,357 @@
+#include "CpuCulling.h"
+
+#include "../Util/CpuFeatures.h"
+
+#include <immintrin.h>
+
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+#include <string.h>
+#include <thread>
+
+#undef max
+#undef min
+
+namespace
+{
+	// Arrays are padded to the widest kernel, so every kernel only does full loads
+	const uint32_t MAX_LANES = 16;
+	// Below this many objects per thread the cost of starting threads outweighs the culling
+	const uint32_t OBJECTS_PER_CULL_THREAD = 16384;
+
+	// Plane components splatted per plane, with the absolute normal for the box test
+	struct CullPlanes
+	{
+		float NormalX[6];
+		float NormalY[6];
+		float NormalZ[6];
+		float Distance[6];
+		float AbsNormalX[6];
+		float AbsNormalY[6];
+		float AbsNormalZ[6];
+	};
+
+	struct BoundsView
+	{
+		const float* pCenterX;
+		const float* pCenterY;
+		const float* pCenterZ;
+		const float* pRadius;
+		const float* pExtentX;
+		const float* pExtentY;
+		const float* pExtentZ;
+	};
+
+	// Writes the visible indices of [begin, end) to pVisible and returns their count. begin is a multiple of MAX_LANES
+	typedef uint32_t(*CullKernel)(const CullPlanes& planes, const BoundsView& bounds, uint32_t begin, uint32_t end, uint32_t* pVisible);
+
+	uint32_t LaneMask(uint32_t first, uint32_t end, uint32_t lanes)
+	{
+		uint32_t remaining = end - first;
+		return remaining >= lanes ? (1u << lanes) - 1 : (1u << remaining) - 1;
+	}
+
+	uint32_t AppendLanes(uint32_t mask, uint32_t first, uint32_t* pVisible)
+	{
+		uint32_t count = 0;
+		while (mask != 0)
+		{
+#if defined(_MSC_VER)
+			unsigned long lane = 0;
+			_BitScanForward(&lane, mask);
+#else
+			uint32_t lane = static_cast<uint32_t>(__builtin_ctz(mask));
+#endif
+			pVisible[count++] = first + lane;
+			mask &= mask - 1;
+		}
+		return count;
+	}
+
+	// The vector kernels evaluate the same expressions in the same order, so all kernels agree bit for bit
+	uint32_t CullScalar(const CullPlanes& planes, const BoundsView& bounds, uint32_t begin, uint32_t end, uint32_t* pVisible)
+	{
+		uint32_t count = 0;
+		for (uint32_t i = begin; i < end; i++)
+		{
+			bool outside = false;
+			for (uint32_t p = 0; p < 6 && !outside; p++)
+			{
+				float distance = planes.NormalX[p] * bounds.pCenterX[i] + planes.NormalY[p] * bounds.pCenterY[i]
+					+ planes.NormalZ[p] * bounds.pCenterZ[i] + planes.Distance[p];
+				float boxRadius = planes.AbsNormalX[p] * bounds.pExtentX[i] + planes.AbsNormalY[p] * bounds.pExtentY[i]
+					+ planes.AbsNormalZ[p] * bounds.pExtentZ[i];
+				outside = distance < -std::min(bounds.pRadius[i], boxRadius);
+			}
+			if (!outside)
+				pVisible[count++] = i;
+		}
+		return count;
+	}
+
+	uint32_t CullSSE2(const CullPlanes& planes, const BoundsView& bounds, uint32_t begin, uint32_t end, uint32_t* pVisible)
+	{
+		const __m128 zero = _mm_setzero_ps();
+		uint32_t count = 0;
+		for (uint32_t i = begin; i < end; i += 4)
+		{
+			__m128 centerX = _mm_load_ps(bounds.pCenterX + i);
+			__m128 centerY = _mm_load_ps(bounds.pCenterY + i);
+			__m128 centerZ = _mm_load_ps(bounds.pCenterZ + i);
+			__m128 radius = _mm_load_ps(bounds.pRadius + i);
+			__m128 extentX = _mm_load_ps(bounds.pExtentX + i);
+			__m128 extentY = _mm_load_ps(bounds.pExtentY + i);
+			__m128 extentZ = _mm_load_ps(bounds.pExtentZ + i);
+
+			__m128 outside = zero;
+			for (uint32_t p = 0; p < 6; p++)
+			{
+				__m128 distance = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes.NormalX[p]), centerX),
+					_mm_mul_ps(_mm_set1_ps(planes.NormalY[p]), centerY)), _mm_mul_ps(_mm_set1_ps(planes.NormalZ[p]), centerZ)),
+					_mm_set1_ps(planes.Distance[p]));
+				__m128 boxRadius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes.AbsNormalX[p]), extentX),
+					_mm_mul_ps(_mm_set1_ps(planes.AbsNormalY[p]), extentY)), _mm_mul_ps(_mm_set1_ps(planes.AbsNormalZ[p]), extentZ));
+				__m128 limit = _mm_sub_ps(zero, _mm_min_ps(radius, boxRadius));
+				outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, limit));
+			}
+			uint32_t visible = ~static_cast<uint32_t>(_mm_movemask_ps(outside)) & LaneMask(i, end, 4);
+			count += AppendLanes(visible, i, pVisible + count);
+		}
+		return count;
+	}
+
+	CPU_TARGET("avx2")
+	uint32_t CullAVX2(const CullPlanes& planes, const BoundsView& bounds, uint32_t begin, uint32_t end, uint32_t* pVisible)
+	{
+		const __m256 zero = _mm256_setzero_ps();
+		uint32_t count = 0;
+		for (uint32_t i = begin; i < end; i += 8)
+		{
+			__m256 centerX = _mm256_load_ps(bounds.pCenterX + i);
+			__m256 centerY = _mm256_load_ps(bounds.pCenterY + i);
+			__m256 centerZ = _mm256_load_ps(bounds.pCenterZ + i);
+			__m256 radius = _mm256_load_ps(bounds.pRadius + i);
+			__m256 extentX = _mm256_load_ps(bounds.pExtentX + i);
+			__m256 extentY = _mm256_load_ps(bounds.pExtentY + i);
+			__m256 extentZ = _mm256_load_ps(bounds.pExtentZ + i);
+
+			__m256 outside = zero;
+			for (uint32_t p = 0; p < 6; p++)
+			{
+				__m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(planes.NormalX[p]), centerX),
+					_mm256_mul_ps(_mm256_set1_ps(planes.NormalY[p]), centerY)), _mm256_mul_ps(_mm256_set1_ps(planes.NormalZ[p]), centerZ)),
+					_mm256_set1_ps(planes.Distance[p]));
+				__m256 boxRadius = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(planes.AbsNormalX[p]), extentX),
+					_mm256_mul_ps(_mm256_set1_ps(planes.AbsNormalY[p]), extentY)), _mm256_mul_ps(_mm256_set1_ps(planes.AbsNormalZ[p]), extentZ));
+				__m256 limit = _mm256_sub_ps(zero, _mm256_min_ps(radius, boxRadius));
+				outside = _mm256_or_ps(outside, _mm256_cmp_ps(distance, limit, _CMP_LT_OQ));
+			}
+			uint32_t visible = ~static_cast<uint32_t>(_mm256_movemask_ps(outside)) & LaneMask(i, end, 8);
+			count += AppendLanes(visible, i, pVisible + count);
+		}
+		return count;
+	}
+
+	CPU_TARGET("avx512f")
+	uint32_t CullAVX512(const CullPlanes& planes, const BoundsView& bounds, uint32_t begin, uint32_t end, uint32_t* pVisible)
+	{
+		const __m512 zero = _mm512_setzero_ps();
+		const __m512i laneIndices = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+		uint32_t count = 0;
+		for (uint32_t i = begin; i < end; i += 16)
+		{
+			__m512 centerX = _mm512_load_ps(bounds.pCenterX + i);
+			__m512 centerY = _mm512_load_ps(bounds.pCenterY + i);
+			__m512 centerZ = _mm512_load_ps(bounds.pCenterZ + i);
+			__m512 radius = _mm512_load_ps(bounds.pRadius + i);
+			__m512 extentX = _mm512_load_ps(bounds.pExtentX + i);
+			__m512 extentY = _mm512_load_ps(bounds.pExtentY + i);
+			__m512 extentZ = _mm512_load_ps(bounds.pExtentZ + i);
+
+			__mmask16 visible = static_cast<__mmask16>(LaneMask(i, end, 16));
+			for (uint32_t p = 0; p < 6; p++)
+			{
+				__m512 distance = _mm512_add_ps(_mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(_mm512_set1_ps(planes.NormalX[p]), centerX),
+					_mm512_mul_ps(_mm512_set1_ps(planes.NormalY[p]), centerY)), _mm512_mul_ps(_mm512_set1_ps(planes.NormalZ[p]), centerZ)),
+					_mm512_set1_ps(planes.Distance[p]));
+				__m512 boxRadius = _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(_mm512_set1_ps(planes.AbsNormalX[p]), extentX),
+					_mm512_mul_ps(_mm512_set1_ps(planes.AbsNormalY[p]), extentY)), _mm512_mul_ps(_mm512_set1_ps(planes.AbsNormalZ[p]), extentZ));
+				__m512 limit = _mm512_sub_ps(zero, _mm512_min_ps(radius, boxRadius));
+				visible = _mm512_mask_cmp_ps_mask(visible, distance, limit, _CMP_NLT_UQ);
+			}
+
+			// Compress store writes the visible lanes' indices contiguously
+			__m512i indices = _mm512_add_epi32(_mm512_set1_epi32(static_cast<int>(i)), laneIndices);
+			_mm512_mask_compressstoreu_epi32(pVisible + count, visible, indices);
+			uint32_t bits = visible;
+			while (bits != 0)
+			{
+				count++;
+				bits &= bits - 1;
+			}
+		}
+		return count;
+	}
+
+	CullKernel GetKernelFunction(CpuCullingKernel kernel)
+	{
+		switch (kernel)
+		{
+		case CpuCullingKernel::SSE2: return CullSSE2;
+		case CpuCullingKernel::AVX2: return CullAVX2;
+		case CpuCullingKernel::AVX512: return CullAVX512;
+		default: return CullScalar;
+		}
+	}
+}
+
+CpuCulling::CpuCulling()
+{
+	const CpuCullingKernel preferred[] = { CpuCullingKernel::AVX512, CpuCullingKernel::AVX2, CpuCullingKernel::SSE2 };
+	for (CpuCullingKernel kernel : preferred)
+	{
+		if (SetKernel(kernel))
+			break;
+	}
+}
+
+uint32_t CpuCulling::AddObject(const float center[3], const float extents[3])
+{
+	if (m_Count == m_CenterX.size())
+	{
+		// Only the size is padded to whole lanes, capacity grows geometrically so filling a scene copies little
+		size_t size = m_CenterX.size() + MAX_LANES;
+		size_t capacity = std::max(m_CenterX.capacity() * 2, size);
+		for (FloatArray* pArray : { &m_CenterX, &m_CenterY, &m_CenterZ, &m_Radius, &m_ExtentX, &m_ExtentY, &m_ExtentZ })
+		{
+			if (pArray->capacity() < size)
+				pArray->reserve(capacity);
+			pArray->resize(size, 0.0f);
+		}
+	}
+	SetObject(m_Count, center, extents);
+	return m_Count++;
+}
+
+void CpuCulling::Reserve(uint32_t count)
+{
+	size_t padded = (static_cast<size_t>(count) + MAX_LANES - 1) / MAX_LANES * MAX_LANES;
+	for (FloatArray* pArray : { &m_CenterX, &m_CenterY, &m_CenterZ, &m_Radius, &m_ExtentX, &m_ExtentY, &m_ExtentZ })
+		pArray->reserve(padded);
+}
+
+void CpuCulling::SetObject(uint32_t index, const float center[3], const float extents[3])
+{
+	m_CenterX[index] = center[0];
+	m_CenterY[index] = center[1];
+	m_CenterZ[index] = center[2];
+	m_ExtentX[index] = fabsf(extents[0]);
+	m_ExtentY[index] = fabsf(extents[1]);
+	m_ExtentZ[index] = fabsf(extents[2]);
+	m_Radius[index] = sqrtf(extents[0] * extents[0] + extents[1] * extents[1] + extents[2] * extents[2]);
+}
+
+void CpuCulling::GetBounds(uint32_t index, float center[3], float extents[3]) const
+{
+	center[0] = m_CenterX[index];
+	center[1] = m_CenterY[index];
+	center[2] = m_CenterZ[index];
+	extents[0] = m_ExtentX[index];
+	extents[1] = m_ExtentY[index];
+	extents[2] = m_ExtentZ[index];
+}
+
+void CpuCulling::Clear()
+{
+	m_Count = 0;
+	for (FloatArray* pArray : { &m_CenterX, &m_CenterY, &m_CenterZ, &m_Radius, &m_ExtentX, &m_ExtentY, &m_ExtentZ })
+		pArray->clear();
+}
+
+bool CpuCulling::SetKernel(CpuCullingKernel kernel)
+{
+	if (!IsSupported(kernel))
+		return false;
+	m_Kernel = kernel;
+	return true;
+}
+
+/*static*/ bool CpuCulling::IsSupported(CpuCullingKernel kernel)
+{
+	switch (kernel)
+	{
+	case CpuCullingKernel::AVX2: return GetCpuFeatures().AVX2;
+	case CpuCullingKernel::AVX512: return GetCpuFeatures().AVX512F;
+	// Part of x64
+	default: return true;
+	}
+}
+
+const std::vector<uint32_t>& CpuCulling::Cull(const float planes[6][4], uint32_t threadCount)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	CullPlanes cullPlanes{};
+	for (uint32_t p = 0; p < 6; p++)
+	{
+		cullPlanes.NormalX[p] = planes[p][0];
+		cullPlanes.NormalY[p] = planes[p][1];
+		cullPlanes.NormalZ[p] = planes[p][2];
+		cullPlanes.Distance[p] = planes[p][3];
+		cullPlanes.AbsNormalX[p] = fabsf(planes[p][0]);
+		cullPlanes.AbsNormalY[p] = fabsf(planes[p][1]);
+		cullPlanes.AbsNormalZ[p] = fabsf(planes[p][2]);
+	}
+	BoundsView bounds{ m_CenterX.data(), m_CenterY.data(), m_CenterZ.data(), m_Radius.data(), m_ExtentX.data(), m_ExtentY.data(), m_ExtentZ.data() };
+	CullKernel kernel = GetKernelFunction(m_Kernel);
+
+	if (threadCount == 0)
+		threadCount = std::min(m_Count / OBJECTS_PER_CULL_THREAD, std::max(std::thread::hardware_concurrency(), 1u));
+	threadCount = std::max(threadCount, 1u);
+
+	// Chunks start on a multiple of the widest kernel, so loads stay aligned
+	uint32_t chunk = (m_Count + threadCount - 1) / threadCount;
+	chunk = (chunk + MAX_LANES - 1) / MAX_LANES * MAX_LANES;
+	threadCount = chunk == 0 ? 1 : (m_Count + chunk - 1) / chunk;
+	m_ThreadVisible.resize(std::max<size_t>(m_ThreadVisible.size(), threadCount));
+	std::vector<uint32_t> visibleCounts(threadCount, 0);
+
+	auto worker = [&](uint32_t thread)
+	{
+		uint32_t begin = thread * chunk;
+		uint32_t end = std::min(begin + chunk, m_Count);
+		if (begin >= end)
+			return;
+		std::vector<uint32_t>& visible = m_ThreadVisible[thread];
+		if (visible.size() < end - begin)
+			visible.resize(end - begin);
+		visibleCounts[thread] = kernel(cullPlanes, bounds, begin, end, visible.data());
+	};
+
+	std::vector<std::thread> threads;
+	for (uint32_t i = 1; i < threadCount; i++)
+		threads.emplace_back(worker, i);
+	worker(0);
+	for (std::thread& thread : threads)
+		thread.join();
+
+	// Chunks are in index order, so concatenating them keeps the indices sorted
+	size_t total = 0;
+	for (uint32_t count : visibleCounts)
+		total += count;
+	m_Visible.resize(total);
+	size_t offset = 0;
+	for (uint32_t thread = 0; thread < threadCount; thread++)
+	{
+		if (visibleCounts[thread] > 0)
+			memcpy(m_Visible.data() + offset, m_ThreadVisible[thread].data(), visibleCounts[thread] * sizeof(uint32_t));
+		offset += visibleCounts[thread];
+	}
+
+	m_Stats.Objects = m_Count;
+	m_Stats.Visible = static_cast<uint32_t>(total);
+	m_Stats.Threads = threadCount;
+	m_Stats.CullMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	return m_Visible;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "../Util/AlignedAllocator.h"
+
+#include <stdint.h>
+#include <vector>
+
+enum class CpuCullingKernel
+{
+	Scalar,
+	SSE2,
+	AVX2,
+	AVX512,
+};
+
+struct CpuCullingStats
+{
+	uint32_t Objects = 0;
+	uint32_t Visible = 0;
+	uint32_t Threads = 0;
+	double CullMs = 0.0;
+};
+
+/// <summary>
+/// Frustum culling of many objects on the CPU. Bounds are kept as structure of arrays, one 64 byte aligned array per
+/// component, so a kernel tests 4, 8 or 16 objects per instruction. The widest kernel the CPU supports is picked at
+/// runtime and large scenes are split across threads. An object is culled when its bounding sphere or its axis aligned
+/// box is fully outside one plane, whichever of the two is tighter for that plane.
+/// Not thread safe, typically filled at load time and culled from VulkanApp::Tick
+/// </summary>
+class CpuCulling
+{
+public:
+	CpuCulling();
+
+	/// <summary>
+	/// Returns the index Cull reports the object as, the bounding sphere encloses the box
+	/// </summary>
+	uint32_t AddObject(const float center[3], const float extents[3]);
+	/// <summary>
+	/// Allocates room for count objects up front, saves the reallocations of filling a large scene
+	/// </summary>
+	void Reserve(uint32_t count);
+	void SetObject(uint32_t index, const float center[3], const float extents[3]);
+	void GetBounds(uint32_t index, float center[3], float extents[3]) const;
+	void Clear();
+	uint32_t GetObjectCount() const { return m_Count; }
+
+	/// <summary>
+	/// Forces a kernel, false when the CPU does not support it
+	/// </summary>
+	bool SetKernel(CpuCullingKernel kernel);
+	CpuCullingKernel GetKernel() const { return m_Kernel; }
+	static bool IsSupported(CpuCullingKernel kernel);
+
+	/// <summary>
+	/// Culls every object against world space planes given as (normal, distance) with normals pointing into the
+	/// frustum. Returns the visible indices in ascending order, valid until the next call. threadCount 0 picks one
+	/// by object count
+	/// </summary>
+	const std::vector<uint32_t>& Cull(const float planes[6][4], uint32_t threadCount = 0);
+	const CpuCullingStats& GetStats() const { return m_Stats; }
+
+private:
+	using FloatArray = std::vector<float, AlignedAllocator<float, 64>>;
+
+private:
+	uint32_t m_Count = 0;
+	FloatArray m_CenterX = {};
+	FloatArray m_CenterY = {};
+	FloatArray m_CenterZ = {};
+	FloatArray m_Radius = {};
+	FloatArray m_ExtentX = {};
+	FloatArray m_ExtentY = {};
+	FloatArray m_ExtentZ = {};
+
+	CpuCullingKernel m_Kernel = CpuCullingKernel::Scalar;
+	std::vector<uint32_t> m_Visible = {};
+	std::vector<std::vector<uint32_t>> m_ThreadVisible = {};
+	CpuCullingStats m_Stats = {};
+};
@@ -0,0 +1,219 @@
+#include "GpuCulling.h"
+
+#include "../Memory/DeviceMemory.h"
+
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+
+#undef max
+#undef min
+
+namespace
+{
+	const char* CULL_SHADER = "GpuCull";
+	const uint32_t CULL_GROUP_SIZE = 64;
+	const uint32_t CULL_BINDING_COUNT = 4;
+
+	// Push constant block of GpuCull.comp
+	struct CullConstants
+	{
+		float FrustumPlanes[6][4];
+		float CameraPosition[3];
+		float LodScale;
+		uint32_t InstanceCount;
+	};
+}
+
+bool ValidateGpuMeshes(GpuMesh* pMeshes, size_t count)
+{
+	bool valid = true;
+	for (size_t i = 0; i < count; i++)
+	{
+		if (pMeshes[i].LodCount <= GPU_MESH_MAX_LODS)
+			continue;
+		printf("GPU mesh %zu has %u LODs, only %u are used\n", i, pMeshes[i].LodCount, GPU_MESH_MAX_LODS);
+		pMeshes[i].LodCount = GPU_MESH_MAX_LODS;
+		valid = false;
+	}
+	return valid;
+}
+
+bool GpuCulling::Init(VkDevice device, VkPhysicalDevice physicalDevice, const VkAllocationCallbacks* pAllocator,
+	ShaderLibrary* pShaderLibrary, LayoutCache* pLayoutCache, bool enabled,
+	uint32_t computeFamily, uint32_t graphicsFamily, uint32_t framesInFlight, uint32_t maxInstances)
+{
+	m_Device = device;
+	m_pAllocator = pAllocator;
+	m_ComputeFamily = computeFamily;
+	m_GraphicsFamily = graphicsFamily;
+	m_MaxInstances = maxInstances;
+	m_FrameSlot = 0;
+
+	if (!enabled || maxInstances == 0)
+		return true;
+
+	ShaderReflection reflection{};
+	if (!pShaderLibrary || !pLayoutCache || !pShaderLibrary->Reflect(CULL_SHADER, &reflection))
+	{
+		printf("GPU culling needs shader [\"%s\"] in the shader library\n", CULL_SHADER);
+		return false;
+	}
+
+	std::vector<VkDescriptorSetLayout> setLayouts;
+	std::vector<VkPushConstantRange> pushConstants;
+	if (!pLayoutCache->GetSetLayouts({ &reflection }, setLayouts, pushConstants) || setLayouts.size() != 1)
+	{
+		printf("Shader [\"%s\"] does not match GpuCulling\n", CULL_SHADER);
+		return false;
+	}
+	m_Layout = pLayoutCache->GetPipelineLayout(setLayouts, pushConstants);
+
+	VkPipelineShaderStageCreateInfo stageCi{};
+	VkShaderModuleCreateInfo moduleCi{};
+	if (m_Layout == VK_NULL_HANDLE
+		|| !pShaderLibrary->FillStage(m_Device, CULL_SHADER, VK_SHADER_STAGE_COMPUTE_BIT, "main", stageCi, moduleCi, m_pAllocator))
+		return false;
+
+	VkComputePipelineCreateInfo pipelineCi{};
+	pipelineCi.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineCi.stage = stageCi;
+	pipelineCi.layout = m_Layout;
+	if (vkCreateComputePipelines(m_Device, VK_NULL_HANDLE, 1, &pipelineCi, m_pAllocator, &m_Pipeline) != VK_SUCCESS)
+	{
+		printf("Failed to create GPU culling pipeline\n");
+		return false;
+	}
+
+	framesInFlight = std::max(framesInFlight, 1u);
+	VkDescriptorPoolSize poolSize{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, CULL_BINDING_COUNT * framesInFlight };
+	VkDescriptorPoolCreateInfo poolCi{};
+	poolCi.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolCi.maxSets = framesInFlight;
+	poolCi.poolSizeCount = 1;
+	poolCi.pPoolSizes = &poolSize;
+	if (vkCreateDescriptorPool(m_Device, &poolCi, m_pAllocator, &m_DescriptorPool) != VK_SUCCESS)
+	{
+		printf("Failed to create GPU culling descriptor pool\n");
+		Destroy();
+		return false;
+	}
+
+	VkPhysicalDeviceMemoryProperties memoryProps{};
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProps);
+	m_Slots.resize(framesInFlight);
+	for (FrameSlot& slot : m_Slots)
+	{
+		VkDescriptorSetAllocateInfo setInfo{};
+		setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		setInfo.descriptorPool = m_DescriptorPool;
+		setInfo.descriptorSetCount = 1;
+		setInfo.pSetLayouts = &setLayouts[0];
+
+		// Written on the compute family and read on the graphics family without ownership transfers
+		VkDeviceSize drawSize = static_cast<VkDeviceSize>(maxInstances) * sizeof(VkDrawIndexedIndirectCommand);
+		if (!CreateBuffer(m_Device, memoryProps, m_pAllocator, drawSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+				0, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_ComputeFamily, m_GraphicsFamily, &slot.DrawBuffer, &slot.DrawMemory)
+			|| !CreateBuffer(m_Device, memoryProps, m_pAllocator, sizeof(uint32_t),
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				0, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_ComputeFamily, m_GraphicsFamily, &slot.CountBuffer, &slot.CountMemory)
+			|| vkAllocateDescriptorSets(m_Device, &setInfo, &slot.Set) != VK_SUCCESS)
+		{
+			printf("Failed to create GPU culling draw buffers\n");
+			Destroy();
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void GpuCulling::Destroy()
+{
+	if (m_Device == VK_NULL_HANDLE)
+		return;
+
+	for (FrameSlot& slot : m_Slots)
+	{
+		DestroyBuffer(m_Device, m_pAllocator, slot.DrawBuffer, slot.DrawMemory);
+		DestroyBuffer(m_Device, m_pAllocator, slot.CountBuffer, slot.CountMemory);
+	}
+	m_Slots.clear();
+
+	if (m_DescriptorPool != VK_NULL_HANDLE)
+		vkDestroyDescriptorPool(m_Device, m_DescriptorPool, m_pAllocator);
+	if (m_Pipeline != VK_NULL_HANDLE)
+		vkDestroyPipeline(m_Device, m_Pipeline, m_pAllocator);
+	m_DescriptorPool = VK_NULL_HANDLE;
+	m_Pipeline = VK_NULL_HANDLE;
+	// Owned by the LayoutCache
+	m_Layout = VK_NULL_HANDLE;
+}
+
+void GpuCulling::BeginFrame()
+{
+	if (!m_Slots.empty())
+		m_FrameSlot = (m_FrameSlot + 1) % static_cast<uint32_t>(m_Slots.size());
+}
+
+void GpuCulling::RecordCull(VkCommandBuffer cmd, VkBuffer instances, VkBuffer meshes, uint32_t instanceCount, const GpuCullView& view)
+{
+	if (!IsEnabled())
+		return;
+	const FrameSlot& slot = m_Slots[m_FrameSlot];
+
+	// The client may swap its scene buffers any frame, the slot's set is not in use anymore
+	VkDescriptorBufferInfo bufferInfos[CULL_BINDING_COUNT] = {
+		{ instances, 0, VK_WHOLE_SIZE },
+		{ meshes, 0, VK_WHOLE_SIZE },
+		{ slot.DrawBuffer, 0, VK_WHOLE_SIZE },
+		{ slot.CountBuffer, 0, VK_WHOLE_SIZE },
+	};
+	VkWriteDescriptorSet writes[CULL_BINDING_COUNT] = {};
+	for (uint32_t i = 0; i < CULL_BINDING_COUNT; i++)
+	{
+		writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writes[i].dstSet = slot.Set;
+		writes[i].dstBinding = i;
+		writes[i].descriptorCount = 1;
+		writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		writes[i].pBufferInfo = &bufferInfos[i];
+	}
+	vkUpdateDescriptorSets(m_Device, CULL_BINDING_COUNT, writes, 0, nullptr);
+
+	vkCmdFillBuffer(cmd, slot.CountBuffer, 0, sizeof(uint32_t), 0);
+	VkMemoryBarrier clearBarrier{};
+	clearBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	clearBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	clearBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &clearBarrier, 0, nullptr, 0, nullptr);
+
+	CullConstants constants{};
+	memcpy(constants.FrustumPlanes, view.FrustumPlanes, sizeof(constants.FrustumPlanes));
+	memcpy(constants.CameraPosition, view.CameraPosition, sizeof(constants.CameraPosition));
+	constants.LodScale = view.LodScale;
+	constants.InstanceCount = std::min(instanceCount, m_MaxInstances);
+
+	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_Pipeline);
+	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_Layout, 0, 1, &slot.Set, 0, nullptr);
+	vkCmdPushConstants(cmd, m_Layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullConstants), &constants);
+	vkCmdDispatch(cmd, (constants.InstanceCount + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+
+	// Across families the semaphore wait between the submits makes the writes visible
+	if (m_ComputeFamily == m_GraphicsFamily)
+	{
+		VkMemoryBarrier drawBarrier{};
+		drawBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		drawBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		drawBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+		vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 1, &drawBarrier, 0, nullptr, 0, nullptr);
+	}
+}
+
+void GpuCulling::RecordDraw(CommandEncoder& encoder) const
+{
+	if (!IsEnabled())
+		return;
+	const FrameSlot& slot = m_Slots[m_FrameSlot];
+	encoder.DrawIndexedIndirectCount(slot.DrawBuffer, 0, slot.CountBuffer, 0, m_MaxInstances, sizeof(VkDrawIndexedIndirectCommand));
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include "../Loader/Loader.h"
+#include "../Shaders/ShaderLibrary.h"
+#include "../Shaders/LayoutCache.h"
+#include "../Command/CommandEncoder.h"
+
+#include <vector>
+
+static const uint32_t GPU_MESH_MAX_LODS = 4;
+
+/// <summary>
+/// One level of detail, drawn while the distance to the camera is at most MaxDistance
+/// </summary>
+struct GpuMeshLod
+{
+	uint32_t IndexCount = 0;
+	uint32_t FirstIndex = 0;
+	int32_t VertexOffset = 0;
+	float MaxDistance = 0.0f;
+};
+
+/// <summary>
+/// std430 layout of a mesh as read by Culling/Shaders/GpuCull.comp. Lods go from the closest to the farthest,
+/// instances beyond the last one are culled
+/// </summary>
+struct GpuMesh
+{
+	/// <summary>
+	/// Object space bounding sphere
+	/// </summary>
+	float Center[3] = {};
+	float Radius = 0.0f;
+	uint32_t LodCount = 0;
+	uint32_t Padding[3] = {};
+	GpuMeshLod Lods[GPU_MESH_MAX_LODS] = {};
+};
+
+/// <summary>
+/// Clamps LodCount of every mesh to GPU_MESH_MAX_LODS, false when one was out of range. Run over the meshes before
+/// uploading them
+/// </summary>
+bool ValidateGpuMeshes(GpuMesh* pMeshes, size_t count);
+
+/// <summary>
+/// std430 layout of an instance as read by Culling/Shaders/GpuCull.comp. Its index is passed on as firstInstance,
+/// so the vertex shader finds the instance through gl_InstanceIndex
+/// </summary>
+struct GpuInstance
+{
+	/// <summary>
+	/// Column major object to world transform
+	/// </summary>
+	float Transform[16] = {};
+	uint32_t Mesh = 0;
+	uint32_t Padding[3] = {};
+};
+
+struct GpuCullView
+{
+	/// <summary>
+	/// World space planes as (normal, distance) with normals pointing into the frustum
+	/// </summary>
+	float FrustumPlanes[6][4] = {};
+	float CameraPosition[3] = {};
+	/// <summary>
+	/// Multiplies the distance used for LOD selection, larger values switch to coarser LODs sooner
+	/// </summary>
+	float LodScale = 1.0f;
+};
+
+/// <summary>
+/// GPU driven culling: a compute pass tests every instance against the frustum, picks its LOD and appends a
+/// VkDrawIndexedIndirectCommand for the visible ones, which RecordDraw consumes through vkCmdDrawIndexedIndirectCount.
+/// CPU cost per frame does not depend on the number of instances.
+///
+/// Instances and meshes live in storage buffers owned by the client. The draw and count buffers have one slot per
+/// frame in flight and are shared between the compute and graphics families, so the cull can run on an async compute
+/// queue. Submit it there signaling a semaphore the graphics submit waits on at VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT.
+/// Needs Culling/Shaders/GpuCull.comp compiled and packed into the shader library
+/// </summary>
+class GpuCulling
+{
+public:
+	/// <summary>
+	/// Does nothing unless enabled, which needs the drawIndirectCount, multiDrawIndirect and drawIndirectFirstInstance features
+	/// </summary>
+	bool Init(VkDevice device, VkPhysicalDevice physicalDevice, const VkAllocationCallbacks* pAllocator,
+		ShaderLibrary* pShaderLibrary, LayoutCache* pLayoutCache, bool enabled,
+		uint32_t computeFamily, uint32_t graphicsFamily, uint32_t framesInFlight, uint32_t maxInstances);
+	void Destroy();
+
+	bool IsEnabled() const { return m_Pipeline != VK_NULL_HANDLE; }
+	/// <summary>
+	/// Family the command buffer passed to RecordCull has to belong to
+	/// </summary>
+	uint32_t GetComputeFamily() const { return m_ComputeFamily; }
+	uint32_t GetMaxInstances() const { return m_MaxInstances; }
+
+	/// <summary>
+	/// Moves on to the next draw buffer slot, the client must have waited for the frame that last used it
+	/// </summary>
+	void BeginFrame();
+	/// <summary>
+	/// Culls instanceCount instances, at most GetMaxInstances. With the same family for compute and graphics the
+	/// draw buffers are made visible to indirect reads right away, otherwise the semaphore between the submits does that
+	/// </summary>
+	void RecordCull(VkCommandBuffer cmd, VkBuffer instances, VkBuffer meshes, uint32_t instanceCount, const GpuCullView& view);
+	/// <summary>
+	/// Draws the visible instances culled this frame, bind the pipeline and the geometry shared by all meshes first
+	/// </summary>
+	void RecordDraw(CommandEncoder& encoder) const;
+
+private:
+	struct FrameSlot
+	{
+		VkBuffer DrawBuffer = VK_NULL_HANDLE;
+		VkDeviceMemory DrawMemory = VK_NULL_HANDLE;
+		VkBuffer CountBuffer = VK_NULL_HANDLE;
+		VkDeviceMemory CountMemory = VK_NULL_HANDLE;
+		VkDescriptorSet Set = VK_NULL_HANDLE;
+	};
+
+private:
+	VkDevice m_Device = VK_NULL_HANDLE;
+	const VkAllocationCallbacks* m_pAllocator = nullptr;
+
+	VkPipelineLayout m_Layout = VK_NULL_HANDLE;
+	VkPipeline m_Pipeline = VK_NULL_HANDLE;
+	VkDescriptorPool m_DescriptorPool = VK_NULL_HANDLE;
+
+	uint32_t m_ComputeFamily = 0;
+	uint32_t m_GraphicsFamily = 0;
+	uint32_t m_MaxInstances = 0;
+	std::vector<FrameSlot> m_Slots = {};
+	uint32_t m_FrameSlot = 0;
+};
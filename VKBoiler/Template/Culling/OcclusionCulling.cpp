@@ -0,0 +1,526 @@
+#include "OcclusionCulling.h"
+
+#include "../Memory/DeviceMemory.h"
+
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+
+#undef max
+#undef min
+
+namespace
+{
+	const char* CULL_SHADER = "OcclusionCull";
+	const char* PYRAMID_SHADER = "DepthPyramid";
+	const uint32_t CULL_GROUP_SIZE = 64;
+	const uint32_t PYRAMID_GROUP_SIZE = 8;
+	const uint32_t MAX_PYRAMID_LEVELS = 16;
+
+	const uint32_t PHASE_EARLY = 0;
+	const uint32_t PHASE_LATE = 1;
+	const uint32_t PHASE_COUNT = 2;
+
+	// Push constant block of OcclusionCull.comp
+	struct CullConstants
+	{
+		float ViewProjection[16];
+		float CameraPosition[3];
+		float LodScale;
+		uint32_t InstanceCount;
+		uint32_t Phase;
+		uint32_t UsePyramid;
+		uint32_t MaxDraws;
+	};
+
+	// Push constant block of DepthPyramid.comp
+	struct PyramidConstants
+	{
+		uint32_t SourceSize[2];
+		uint32_t DestinationSize[2];
+	};
+
+	uint32_t PreviousPowerOfTwo(uint32_t value)
+	{
+		uint32_t power = 1;
+		while (power <= value / 2)
+			power *= 2;
+		return power;
+	}
+
+	void ComputeBarrier(VkCommandBuffer cmd, VkAccessFlags srcAccess, VkPipelineStageFlags dstStages, VkAccessFlags dstAccess)
+	{
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = srcAccess;
+		barrier.dstAccessMask = dstAccess;
+		vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, dstStages, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+	}
+}
+
+bool OcclusionCulling::Init(VkDevice device, VkPhysicalDevice physicalDevice, const VkAllocationCallbacks* pAllocator,
+	ShaderLibrary* pShaderLibrary, LayoutCache* pLayoutCache, bool enabled,
+	uint32_t computeFamily, uint32_t graphicsFamily, uint32_t framesInFlight, uint32_t maxInstances)
+{
+	m_Device = device;
+	m_pAllocator = pAllocator;
+	m_ComputeFamily = computeFamily;
+	m_GraphicsFamily = graphicsFamily;
+	m_MaxInstances = maxInstances;
+	m_FrameSlot = 0;
+
+	if (!enabled || maxInstances == 0)
+		return true;
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &m_MemoryProperties);
+
+	VkDescriptorSetLayout cullSetLayout = VK_NULL_HANDLE;
+	if (!CreatePipeline(pShaderLibrary, pLayoutCache, PYRAMID_SHADER, &m_PyramidSetLayout, &m_PyramidLayout, &m_PyramidPipeline)
+		|| !CreatePipeline(pShaderLibrary, pLayoutCache, CULL_SHADER, &cullSetLayout, &m_CullLayout, &m_CullPipeline))
+	{
+		Destroy();
+		return false;
+	}
+
+	VkSamplerCreateInfo samplerCi{};
+	samplerCi.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerCi.magFilter = VK_FILTER_NEAREST;
+	samplerCi.minFilter = VK_FILTER_NEAREST;
+	samplerCi.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	samplerCi.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerCi.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerCi.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerCi.maxLod = VK_LOD_CLAMP_NONE;
+
+	framesInFlight = std::max(framesInFlight, 1u);
+	VkDescriptorPoolSize cullSizes[2] = {
+		{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5 * framesInFlight },
+		{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, framesInFlight },
+	};
+	VkDescriptorPoolCreateInfo cullPoolCi{};
+	cullPoolCi.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	cullPoolCi.maxSets = framesInFlight;
+	cullPoolCi.poolSizeCount = 2;
+	cullPoolCi.pPoolSizes = cullSizes;
+
+	VkDescriptorPoolSize pyramidSizes[2] = {
+		{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, MAX_PYRAMID_LEVELS },
+		{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, MAX_PYRAMID_LEVELS },
+	};
+	VkDescriptorPoolCreateInfo pyramidPoolCi{};
+	pyramidPoolCi.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	pyramidPoolCi.maxSets = MAX_PYRAMID_LEVELS;
+	pyramidPoolCi.poolSizeCount = 2;
+	pyramidPoolCi.pPoolSizes = pyramidSizes;
+
+	if (vkCreateSampler(m_Device, &samplerCi, m_pAllocator, &m_Sampler) != VK_SUCCESS
+		|| vkCreateDescriptorPool(m_Device, &cullPoolCi, m_pAllocator, &m_CullDescriptorPool) != VK_SUCCESS
+		|| vkCreateDescriptorPool(m_Device, &pyramidPoolCi, m_pAllocator, &m_PyramidDescriptorPool) != VK_SUCCESS)
+	{
+		printf("Failed to create occlusion culling descriptors\n");
+		Destroy();
+		return false;
+	}
+
+	m_Slots.resize(framesInFlight);
+	for (FrameSlot& slot : m_Slots)
+	{
+		VkDescriptorSetAllocateInfo setInfo{};
+		setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		setInfo.descriptorPool = m_CullDescriptorPool;
+		setInfo.descriptorSetCount = 1;
+		setInfo.pSetLayouts = &cullSetLayout;
+
+		const VkBufferUsageFlags storage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+		const VkBufferUsageFlags indirect = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
+		VkDeviceSize drawSize = static_cast<VkDeviceSize>(maxInstances) * PHASE_COUNT * sizeof(VkDrawIndexedIndirectCommand);
+		if (!CreateBuffer(m_Device, m_MemoryProperties, m_pAllocator, drawSize, indirect, 0, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+				m_ComputeFamily, m_GraphicsFamily, &slot.DrawBuffer, &slot.DrawMemory)
+			|| !CreateBuffer(m_Device, m_MemoryProperties, m_pAllocator, PHASE_COUNT * sizeof(uint32_t), indirect | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				0, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_ComputeFamily, m_GraphicsFamily, &slot.CountBuffer, &slot.CountMemory)
+			|| !CreateBuffer(m_Device, m_MemoryProperties, m_pAllocator, static_cast<VkDeviceSize>(maxInstances) * sizeof(uint32_t), storage,
+				0, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_ComputeFamily, m_GraphicsFamily, &slot.OccludedBuffer, &slot.OccludedMemory)
+			|| vkAllocateDescriptorSets(m_Device, &setInfo, &slot.Set) != VK_SUCCESS)
+		{
+			printf("Failed to create occlusion culling buffers\n");
+			Destroy();
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void OcclusionCulling::Destroy()
+{
+	if (m_Device == VK_NULL_HANDLE)
+		return;
+
+	DestroyPyramid();
+	for (FrameSlot& slot : m_Slots)
+	{
+		DestroyBuffer(m_Device, m_pAllocator, slot.DrawBuffer, slot.DrawMemory);
+		DestroyBuffer(m_Device, m_pAllocator, slot.CountBuffer, slot.CountMemory);
+		DestroyBuffer(m_Device, m_pAllocator, slot.OccludedBuffer, slot.OccludedMemory);
+	}
+	m_Slots.clear();
+
+	if (m_CullDescriptorPool != VK_NULL_HANDLE)
+		vkDestroyDescriptorPool(m_Device, m_CullDescriptorPool, m_pAllocator);
+	if (m_PyramidDescriptorPool != VK_NULL_HANDLE)
+		vkDestroyDescriptorPool(m_Device, m_PyramidDescriptorPool, m_pAllocator);
+	if (m_Sampler != VK_NULL_HANDLE)
+		vkDestroySampler(m_Device, m_Sampler, m_pAllocator);
+	if (m_CullPipeline != VK_NULL_HANDLE)
+		vkDestroyPipeline(m_Device, m_CullPipeline, m_pAllocator);
+	if (m_PyramidPipeline != VK_NULL_HANDLE)
+		vkDestroyPipeline(m_Device, m_PyramidPipeline, m_pAllocator);
+	m_CullDescriptorPool = VK_NULL_HANDLE;
+	m_PyramidDescriptorPool = VK_NULL_HANDLE;
+	m_Sampler = VK_NULL_HANDLE;
+	m_CullPipeline = VK_NULL_HANDLE;
+	m_PyramidPipeline = VK_NULL_HANDLE;
+	// Owned by the LayoutCache
+	m_CullLayout = VK_NULL_HANDLE;
+	m_PyramidLayout = VK_NULL_HANDLE;
+	m_PyramidSetLayout = VK_NULL_HANDLE;
+	m_DepthView = VK_NULL_HANDLE;
+}
+
+bool OcclusionCulling::SetDepthSource(VkImageView depthView, VkImageLayout depthLayout, uint32_t width, uint32_t height)
+{
+	if (!IsEnabled())
+		return true;
+
+	m_DepthView = depthView;
+	m_DepthLayout = depthLayout;
+	if (width != m_DepthWidth || height != m_DepthHeight || m_PyramidImage == VK_NULL_HANDLE)
+	{
+		m_DepthWidth = width;
+		m_DepthHeight = height;
+		DestroyPyramid();
+		if (!CreatePyramid(width, height))
+			return false;
+	}
+	UpdatePyramidSets();
+	return true;
+}
+
+void OcclusionCulling::BeginFrame()
+{
+	if (!m_Slots.empty())
+		m_FrameSlot = (m_FrameSlot + 1) % static_cast<uint32_t>(m_Slots.size());
+}
+
+void OcclusionCulling::RecordEarlyCull(VkCommandBuffer cmd, VkBuffer instances, VkBuffer meshes, uint32_t instanceCount, const OcclusionCullView& view)
+{
+	RecordCull(cmd, PHASE_EARLY, instances, meshes, instanceCount, view);
+}
+
+void OcclusionCulling::RecordEarlyDraw(CommandEncoder& encoder) const
+{
+	RecordDraw(encoder, PHASE_EARLY);
+}
+
+void OcclusionCulling::RecordDepthPyramid(VkCommandBuffer cmd)
+{
+	if (!IsEnabled() || m_PyramidView == VK_NULL_HANDLE)
+		return;
+
+	PreparePyramid(cmd);
+	// The early cull of this frame still reads the previous pyramid
+	ComputeBarrier(cmd, 0, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0);
+
+	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_PyramidPipeline);
+	uint32_t sourceWidth = m_DepthWidth;
+	uint32_t sourceHeight = m_DepthHeight;
+	for (uint32_t level = 0; level < m_PyramidSets.size(); level++)
+	{
+		PyramidConstants constants{};
+		constants.SourceSize[0] = sourceWidth;
+		constants.SourceSize[1] = sourceHeight;
+		constants.DestinationSize[0] = std::max(m_PyramidWidth >> level, 1u);
+		constants.DestinationSize[1] = std::max(m_PyramidHeight >> level, 1u);
+
+		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_PyramidLayout, 0, 1, &m_PyramidSets[level], 0, nullptr);
+		vkCmdPushConstants(cmd, m_PyramidLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PyramidConstants), &constants);
+		vkCmdDispatch(cmd, (constants.DestinationSize[0] + PYRAMID_GROUP_SIZE - 1) / PYRAMID_GROUP_SIZE,
+			(constants.DestinationSize[1] + PYRAMID_GROUP_SIZE - 1) / PYRAMID_GROUP_SIZE, 1);
+		// The next level reads this one, the last barrier also covers the late cull
+		ComputeBarrier(cmd, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+
+		sourceWidth = constants.DestinationSize[0];
+		sourceHeight = constants.DestinationSize[1];
+	}
+	m_PyramidBuilt = true;
+}
+
+void OcclusionCulling::RecordLateCull(VkCommandBuffer cmd, VkBuffer instances, VkBuffer meshes, uint32_t instanceCount, const OcclusionCullView& view)
+{
+	RecordCull(cmd, PHASE_LATE, instances, meshes, instanceCount, view);
+}
+
+void OcclusionCulling::RecordLateDraw(CommandEncoder& encoder) const
+{
+	RecordDraw(encoder, PHASE_LATE);
+}
+
+bool OcclusionCulling::CreatePipeline(ShaderLibrary* pShaderLibrary, LayoutCache* pLayoutCache, const char* name,
+	VkDescriptorSetLayout* pSetLayout, VkPipelineLayout* pLayout, VkPipeline* pPipeline)
+{
+	ShaderReflection reflection{};
+	if (!pShaderLibrary || !pLayoutCache || !pShaderLibrary->Reflect(name, &reflection))
+	{
+		printf("Occlusion culling needs shader [\"%s\"] in the shader library\n", name);
+		return false;
+	}
+
+	std::vector<VkDescriptorSetLayout> setLayouts;
+	std::vector<VkPushConstantRange> pushConstants;
+	if (!pLayoutCache->GetSetLayouts({ &reflection }, setLayouts, pushConstants) || setLayouts.size() != 1)
+	{
+		printf("Shader [\"%s\"] does not match OcclusionCulling\n", name);
+		return false;
+	}
+	*pSetLayout = setLayouts[0];
+	*pLayout = pLayoutCache->GetPipelineLayout(setLayouts, pushConstants);
+
+	VkPipelineShaderStageCreateInfo stageCi{};
+	VkShaderModuleCreateInfo moduleCi{};
+	if (*pLayout == VK_NULL_HANDLE
+		|| !pShaderLibrary->FillStage(m_Device, name, VK_SHADER_STAGE_COMPUTE_BIT, "main", stageCi, moduleCi, m_pAllocator))
+		return false;
+
+	VkComputePipelineCreateInfo pipelineCi{};
+	pipelineCi.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineCi.stage = stageCi;
+	pipelineCi.layout = *pLayout;
+	if (vkCreateComputePipelines(m_Device, VK_NULL_HANDLE, 1, &pipelineCi, m_pAllocator, pPipeline) != VK_SUCCESS)
+	{
+		printf("Failed to create pipeline for shader [\"%s\"]\n", name);
+		return false;
+	}
+	return true;
+}
+
+bool OcclusionCulling::CreatePyramid(uint32_t width, uint32_t height)
+{
+	// Power of two levels halve exactly, level 0 covers the depth conservatively with up to 3x3 texels each
+	m_PyramidWidth = PreviousPowerOfTwo(std::max(width, 1u));
+	m_PyramidHeight = PreviousPowerOfTwo(std::max(height, 1u));
+	uint32_t levelCount = 1;
+	while ((std::max(m_PyramidWidth, m_PyramidHeight) >> levelCount) > 0 && levelCount < MAX_PYRAMID_LEVELS)
+		levelCount++;
+
+	uint32_t families[2] = { m_ComputeFamily, m_GraphicsFamily };
+	VkImageCreateInfo imageCi{};
+	imageCi.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageCi.imageType = VK_IMAGE_TYPE_2D;
+	imageCi.format = VK_FORMAT_R32_SFLOAT;
+	imageCi.extent = { m_PyramidWidth, m_PyramidHeight, 1 };
+	imageCi.mipLevels = levelCount;
+	imageCi.arrayLayers = 1;
+	imageCi.samples = VK_SAMPLE_COUNT_1_BIT;
+	imageCi.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageCi.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT;
+	imageCi.sharingMode = m_ComputeFamily == m_GraphicsFamily ? VK_SHARING_MODE_EXCLUSIVE : VK_SHARING_MODE_CONCURRENT;
+	imageCi.queueFamilyIndexCount = m_ComputeFamily == m_GraphicsFamily ? 0 : 2;
+	imageCi.pQueueFamilyIndices = families;
+	imageCi.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	if (vkCreateImage(m_Device, &imageCi, m_pAllocator, &m_PyramidImage) != VK_SUCCESS)
+	{
+		m_PyramidImage = VK_NULL_HANDLE;
+		printf("Failed to create depth pyramid\n");
+		return false;
+	}
+	if (!AllocateImageMemory(m_Device, m_MemoryProperties, m_pAllocator, m_PyramidImage, &m_PyramidMemory))
+	{
+		printf("Failed to allocate depth pyramid memory\n");
+		DestroyPyramid();
+		return false;
+	}
+
+	VkImageViewCreateInfo viewCi{};
+	viewCi.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	viewCi.image = m_PyramidImage;
+	viewCi.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	viewCi.format = VK_FORMAT_R32_SFLOAT;
+	viewCi.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, levelCount, 0, 1 };
+	bool success = vkCreateImageView(m_Device, &viewCi, m_pAllocator, &m_PyramidView) == VK_SUCCESS;
+
+	m_PyramidMipViews.resize(levelCount, VK_NULL_HANDLE);
+	for (uint32_t level = 0; success && level < levelCount; level++)
+	{
+		viewCi.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, level, 1, 0, 1 };
+		success = vkCreateImageView(m_Device, &viewCi, m_pAllocator, &m_PyramidMipViews[level]) == VK_SUCCESS;
+	}
+	if (!success)
+	{
+		printf("Failed to create depth pyramid views\n");
+		DestroyPyramid();
+		return false;
+	}
+
+	m_PyramidPrepared = false;
+	m_PyramidBuilt = false;
+	return true;
+}
+
+void OcclusionCulling::DestroyPyramid()
+{
+	for (VkImageView view : m_PyramidMipViews)
+	{
+		if (view != VK_NULL_HANDLE)
+			vkDestroyImageView(m_Device, view, m_pAllocator);
+	}
+	m_PyramidMipViews.clear();
+	m_PyramidSets.clear();
+	if (m_PyramidDescriptorPool != VK_NULL_HANDLE)
+		vkResetDescriptorPool(m_Device, m_PyramidDescriptorPool, 0);
+
+	if (m_PyramidView != VK_NULL_HANDLE)
+		vkDestroyImageView(m_Device, m_PyramidView, m_pAllocator);
+	if (m_PyramidImage != VK_NULL_HANDLE)
+		vkDestroyImage(m_Device, m_PyramidImage, m_pAllocator);
+	if (m_PyramidMemory != VK_NULL_HANDLE)
+		vkFreeMemory(m_Device, m_PyramidMemory, m_pAllocator);
+	m_PyramidView = VK_NULL_HANDLE;
+	m_PyramidImage = VK_NULL_HANDLE;
+	m_PyramidMemory = VK_NULL_HANDLE;
+	m_PyramidBuilt = false;
+}
+
+void OcclusionCulling::UpdatePyramidSets()
+{
+	uint32_t levelCount = static_cast<uint32_t>(m_PyramidMipViews.size());
+	if (m_PyramidSets.size() != levelCount)
+	{
+		vkResetDescriptorPool(m_Device, m_PyramidDescriptorPool, 0);
+		std::vector<VkDescriptorSetLayout> setLayouts(levelCount, m_PyramidSetLayout);
+		m_PyramidSets.resize(levelCount);
+
+		VkDescriptorSetAllocateInfo setInfo{};
+		setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		setInfo.descriptorPool = m_PyramidDescriptorPool;
+		setInfo.descriptorSetCount = levelCount;
+		setInfo.pSetLayouts = setLayouts.data();
+		if (vkAllocateDescriptorSets(m_Device, &setInfo, m_PyramidSets.data()) != VK_SUCCESS)
+		{
+			printf("Failed to allocate depth pyramid descriptor sets\n");
+			m_PyramidSets.clear();
+			return;
+		}
+	}
+
+	// Each level reads the one above it, level 0 reads the depth
+	std::vector<VkDescriptorImageInfo> imageInfos(levelCount * 2);
+	std::vector<VkWriteDescriptorSet> writes(levelCount * 2);
+	for (uint32_t level = 0; level < levelCount; level++)
+	{
+		VkDescriptorImageInfo& source = imageInfos[level * 2];
+		source.sampler = m_Sampler;
+		source.imageView = level == 0 ? m_DepthView : m_PyramidMipViews[level - 1];
+		source.imageLayout = level == 0 ? m_DepthLayout : VK_IMAGE_LAYOUT_GENERAL;
+		VkDescriptorImageInfo& destination = imageInfos[level * 2 + 1];
+		destination.imageView = m_PyramidMipViews[level];
+		destination.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+		for (uint32_t binding = 0; binding < 2; binding++)
+		{
+			VkWriteDescriptorSet& write = writes[level * 2 + binding];
+			write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			write.dstSet = m_PyramidSets[level];
+			write.dstBinding = binding;
+			write.descriptorCount = 1;
+			write.descriptorType = binding == 0 ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER : VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+			write.pImageInfo = &imageInfos[level * 2 + binding];
+		}
+	}
+	vkUpdateDescriptorSets(m_Device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+}
+
+void OcclusionCulling::PreparePyramid(VkCommandBuffer cmd)
+{
+	if (m_PyramidPrepared)
+		return;
+
+	VkImageMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = m_PyramidImage;
+	barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, VK_REMAINING_MIP_LEVELS, 0, 1 };
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+	m_PyramidPrepared = true;
+}
+
+void OcclusionCulling::RecordCull(VkCommandBuffer cmd, uint32_t phase, VkBuffer instances, VkBuffer meshes, uint32_t instanceCount,
+	const OcclusionCullView& view)
+{
+	if (!IsEnabled() || m_PyramidView == VK_NULL_HANDLE)
+		return;
+	const FrameSlot& slot = m_Slots[m_FrameSlot];
+
+	if (phase == PHASE_EARLY)
+	{
+		// Both phases of a frame share the set, the client may swap its scene buffers between frames
+		VkDescriptorBufferInfo bufferInfos[5] = {
+			{ instances, 0, VK_WHOLE_SIZE },
+			{ meshes, 0, VK_WHOLE_SIZE },
+			{ slot.DrawBuffer, 0, VK_WHOLE_SIZE },
+			{ slot.CountBuffer, 0, VK_WHOLE_SIZE },
+			{ slot.OccludedBuffer, 0, VK_WHOLE_SIZE },
+		};
+		VkDescriptorImageInfo pyramidInfo{ m_Sampler, m_PyramidView, VK_IMAGE_LAYOUT_GENERAL };
+		VkWriteDescriptorSet writes[6] = {};
+		for (uint32_t i = 0; i < 6; i++)
+		{
+			writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			writes[i].dstSet = slot.Set;
+			writes[i].dstBinding = i;
+			writes[i].descriptorCount = 1;
+			writes[i].descriptorType = i < 5 ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+			writes[i].pBufferInfo = i < 5 ? &bufferInfos[i] : nullptr;
+			writes[i].pImageInfo = i < 5 ? nullptr : &pyramidInfo;
+		}
+		vkUpdateDescriptorSets(m_Device, 6, writes, 0, nullptr);
+
+		PreparePyramid(cmd);
+		vkCmdFillBuffer(cmd, slot.CountBuffer, 0, PHASE_COUNT * sizeof(uint32_t), 0);
+		VkMemoryBarrier clearBarrier{};
+		clearBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		clearBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		clearBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &clearBarrier, 0, nullptr, 0, nullptr);
+	}
+
+	CullConstants constants{};
+	memcpy(constants.ViewProjection, view.ViewProjection, sizeof(constants.ViewProjection));
+	memcpy(constants.CameraPosition, view.CameraPosition, sizeof(constants.CameraPosition));
+	constants.LodScale = view.LodScale;
+	constants.InstanceCount = std::min(instanceCount, m_MaxInstances);
+	constants.Phase = phase;
+	constants.UsePyramid = m_PyramidBuilt ? 1 : 0;
+	constants.MaxDraws = m_MaxInstances;
+
+	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_CullPipeline);
+	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_CullLayout, 0, 1, &slot.Set, 0, nullptr);
+	vkCmdPushConstants(cmd, m_CullLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullConstants), &constants);
+	vkCmdDispatch(cmd, (constants.InstanceCount + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+
+	// Draws read the commands, the late phase reads the occluded flags. Across queues the semaphore covers this
+	ComputeBarrier(cmd, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+}
+
+void OcclusionCulling::RecordDraw(CommandEncoder& encoder, uint32_t phase) const
+{
+	if (!IsEnabled() || m_PyramidView == VK_NULL_HANDLE)
+		return;
+	const FrameSlot& slot = m_Slots[m_FrameSlot];
+	const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+	encoder.DrawIndexedIndirectCount(slot.DrawBuffer, static_cast<VkDeviceSize>(phase) * m_MaxInstances * stride,
+		slot.CountBuffer, phase * sizeof(uint32_t), m_MaxInstances, stride);
+}
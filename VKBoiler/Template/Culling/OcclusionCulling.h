@@ -0,0 +1,140 @@
+#pragma once
+
+#include "../Loader/Loader.h"
+#include "../Shaders/ShaderLibrary.h"
+#include "../Shaders/LayoutCache.h"
+#include "../Command/CommandEncoder.h"
+#include "GpuCulling.h"
+
+#include <vector>
+
+struct OcclusionCullView
+{
+	/// <summary>
+	/// Column major, Vulkan clip space with depth 0 at the near plane. Frustum culling happens in clip space
+	/// </summary>
+	float ViewProjection[16] = {};
+	float CameraPosition[3] = {};
+	/// <summary>
+	/// Multiplies the distance used for LOD selection, larger values switch to coarser LODs sooner
+	/// </summary>
+	float LodScale = 1.0f;
+};
+
+/// <summary>
+/// Two phase occlusion culling against a hierarchical depth buffer, for the instances and meshes of GpuCulling.
+/// Per frame:
+///  1. RecordEarlyCull tests against the pyramid built from last frame's depth, RecordEarlyDraw draws what passed
+///  2. RecordDepthPyramid reduces the depth of those draws into the pyramid, keeping the farthest depth per texel
+///  3. RecordLateCull re-tests only what the early phase found occluded, RecordLateDraw draws what became visible
+/// The late phase catches everything the stale pyramid hid wrongly, so nothing visible is lost. The pyramid it leaves
+/// behind feeds the next frame's early phase.
+///
+/// Culling buffers and the pyramid are shared between the compute and graphics families. The early cull can run on
+/// async compute, the pyramid and late cull need the depth written by the graphics queue and usually go there.
+/// Needs Culling/Shaders/OcclusionCull.comp and Culling/Shaders/DepthPyramid.comp packed into the shader library
+/// </summary>
+class OcclusionCulling
+{
+public:
+	/// <summary>
+	/// Does nothing unless enabled, which needs the drawIndirectCount, multiDrawIndirect and drawIndirectFirstInstance features
+	/// </summary>
+	bool Init(VkDevice device, VkPhysicalDevice physicalDevice, const VkAllocationCallbacks* pAllocator,
+		ShaderLibrary* pShaderLibrary, LayoutCache* pLayoutCache, bool enabled,
+		uint32_t computeFamily, uint32_t graphicsFamily, uint32_t framesInFlight, uint32_t maxInstances);
+	void Destroy();
+
+	bool IsEnabled() const { return m_CullPipeline != VK_NULL_HANDLE; }
+	uint32_t GetMaxInstances() const { return m_MaxInstances; }
+
+	/// <summary>
+	/// Sets the depth image the pyramid is built from, recreating the pyramid when the size changed. The depth has to be
+	/// in depthLayout whenever RecordDepthPyramid runs. Call while the device is idle, typically after swapchain recreation
+	/// </summary>
+	bool SetDepthSource(VkImageView depthView, VkImageLayout depthLayout, uint32_t width, uint32_t height);
+	VkImageView GetDepthPyramid() const { return m_PyramidView; }
+
+	/// <summary>
+	/// Moves on to the next slot of culling buffers, the client must have waited for the frame that last used it
+	/// </summary>
+	void BeginFrame();
+	void RecordEarlyCull(VkCommandBuffer cmd, VkBuffer instances, VkBuffer meshes, uint32_t instanceCount, const OcclusionCullView& view);
+	void RecordEarlyDraw(CommandEncoder& encoder) const;
+	/// <summary>
+	/// Record after the early draws finished writing depth and the depth image was moved to the layout given to SetDepthSource
+	/// </summary>
+	void RecordDepthPyramid(VkCommandBuffer cmd);
+	/// <summary>
+	/// Takes the same instances and view as the early cull of this frame
+	/// </summary>
+	void RecordLateCull(VkCommandBuffer cmd, VkBuffer instances, VkBuffer meshes, uint32_t instanceCount, const OcclusionCullView& view);
+	void RecordLateDraw(CommandEncoder& encoder) const;
+
+private:
+	struct FrameSlot
+	{
+		/// <summary>
+		/// Early draws in the first half, late draws in the second
+		/// </summary>
+		VkBuffer DrawBuffer = VK_NULL_HANDLE;
+		VkDeviceMemory DrawMemory = VK_NULL_HANDLE;
+		/// <summary>
+		/// Early and late draw count
+		/// </summary>
+		VkBuffer CountBuffer = VK_NULL_HANDLE;
+		VkDeviceMemory CountMemory = VK_NULL_HANDLE;
+		/// <summary>
+		/// One flag per instance, set by the early phase for instances the late phase has to re-test
+		/// </summary>
+		VkBuffer OccludedBuffer = VK_NULL_HANDLE;
+		VkDeviceMemory OccludedMemory = VK_NULL_HANDLE;
+		VkDescriptorSet Set = VK_NULL_HANDLE;
+	};
+
+	bool CreatePipeline(ShaderLibrary* pShaderLibrary, LayoutCache* pLayoutCache, const char* name,
+		VkDescriptorSetLayout* pSetLayout, VkPipelineLayout* pLayout, VkPipeline* pPipeline);
+	bool CreatePyramid(uint32_t width, uint32_t height);
+	void DestroyPyramid();
+	void UpdatePyramidSets();
+	// Moves a new pyramid out of the undefined layout, before its first use
+	void PreparePyramid(VkCommandBuffer cmd);
+	void RecordCull(VkCommandBuffer cmd, uint32_t phase, VkBuffer instances, VkBuffer meshes, uint32_t instanceCount, const OcclusionCullView& view);
+	void RecordDraw(CommandEncoder& encoder, uint32_t phase) const;
+
+private:
+	VkDevice m_Device = VK_NULL_HANDLE;
+	const VkAllocationCallbacks* m_pAllocator = nullptr;
+	VkPhysicalDeviceMemoryProperties m_MemoryProperties = {};
+
+	VkPipelineLayout m_CullLayout = VK_NULL_HANDLE;
+	VkPipeline m_CullPipeline = VK_NULL_HANDLE;
+	VkDescriptorPool m_CullDescriptorPool = VK_NULL_HANDLE;
+	VkDescriptorSetLayout m_PyramidSetLayout = VK_NULL_HANDLE;
+	VkPipelineLayout m_PyramidLayout = VK_NULL_HANDLE;
+	VkPipeline m_PyramidPipeline = VK_NULL_HANDLE;
+	VkDescriptorPool m_PyramidDescriptorPool = VK_NULL_HANDLE;
+	VkSampler m_Sampler = VK_NULL_HANDLE;
+
+	uint32_t m_ComputeFamily = 0;
+	uint32_t m_GraphicsFamily = 0;
+	uint32_t m_MaxInstances = 0;
+	std::vector<FrameSlot> m_Slots = {};
+	uint32_t m_FrameSlot = 0;
+
+	VkImageView m_DepthView = VK_NULL_HANDLE;
+	VkImageLayout m_DepthLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	uint32_t m_DepthWidth = 0;
+	uint32_t m_DepthHeight = 0;
+
+	VkImage m_PyramidImage = VK_NULL_HANDLE;
+	VkDeviceMemory m_PyramidMemory = VK_NULL_HANDLE;
+	VkImageView m_PyramidView = VK_NULL_HANDLE;
+	std::vector<VkImageView> m_PyramidMipViews = {};
+	std::vector<VkDescriptorSet> m_PyramidSets = {};
+	uint32_t m_PyramidWidth = 0;
+	uint32_t m_PyramidHeight = 0;
+	bool m_PyramidPrepared = false;
+	// Holds depth of an earlier frame, until then the early phase only frustum culls
+	bool m_PyramidBuilt = false;
+};
@@ -0,0 +1,395 @@
+#include "SoftwareOcclusion.h"
+
+#include "../Util/CpuFeatures.h"
+
+#include <immintrin.h>
+
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+#include <string.h>
+
+#undef max
+#undef min
+
+namespace
+{
+	const float FAR_DEPTH = 1.0f;
+	// Corners closer to the camera plane than this make the screen rectangle meaningless
+	const float MIN_CLIP_W = 1e-5f;
+
+	struct ClipVertex
+	{
+		float X, Y, Z, W;
+	};
+
+	// Edge functions as A * x + B * y + C, not negative inside, and the depth plane, in pixel units
+	struct TriangleSetup
+	{
+		float EdgeA[3];
+		float EdgeB[3];
+		float EdgeC[3];
+		float DepthA;
+		float DepthB;
+		float DepthC;
+		int32_t MinX, MaxX, MinY, MaxY;
+	};
+
+	ClipVertex Transform(const float matrix[16], float x, float y, float z)
+	{
+		return {
+			matrix[0] * x + matrix[4] * y + matrix[8] * z + matrix[12],
+			matrix[1] * x + matrix[5] * y + matrix[9] * z + matrix[13],
+			matrix[2] * x + matrix[6] * y + matrix[10] * z + matrix[14],
+			matrix[3] * x + matrix[7] * y + matrix[11] * z + matrix[15],
+		};
+	}
+
+	void Multiply(const float left[16], const float right[16], float result[16])
+	{
+		for (uint32_t column = 0; column < 4; column++)
+		{
+			for (uint32_t row = 0; row < 4; row++)
+			{
+				float sum = 0.0f;
+				for (uint32_t i = 0; i < 4; i++)
+					sum += left[i * 4 + row] * right[column * 4 + i];
+				result[column * 4 + row] = sum;
+			}
+		}
+	}
+
+	ClipVertex Lerp(const ClipVertex& a, const ClipVertex& b, float t)
+	{
+		return { a.X + (b.X - a.X) * t, a.Y + (b.Y - a.Y) * t, a.Z + (b.Z - a.Z) * t, a.W + (b.W - a.W) * t };
+	}
+
+	// Clips against z >= 0, a triangle becomes at most a quad
+	uint32_t ClipNear(const ClipVertex (&input)[3], ClipVertex (&output)[4])
+	{
+		uint32_t count = 0;
+		for (uint32_t i = 0; i < 3; i++)
+		{
+			const ClipVertex& current = input[i];
+			const ClipVertex& next = input[(i + 1) % 3];
+			bool currentInside = current.Z >= 0.0f;
+			bool nextInside = next.Z >= 0.0f;
+			if (currentInside)
+				output[count++] = current;
+			if (currentInside != nextInside)
+				output[count++] = Lerp(current, next, current.Z / (current.Z - next.Z));
+		}
+		return count;
+	}
+
+	// Same arithmetic as the AVX2 kernel, lane for lane
+	void RasterScalar(const TriangleSetup& setup, float* pDepth, uint32_t width)
+	{
+		for (int32_t y = setup.MinY; y <= setup.MaxY; y++)
+		{
+			float py = static_cast<float>(y) + 0.5f;
+			float rowEdge[3];
+			for (uint32_t e = 0; e < 3; e++)
+				rowEdge[e] = setup.EdgeB[e] * py + setup.EdgeC[e];
+			float rowDepth = setup.DepthB * py + setup.DepthC;
+
+			float* pRow = pDepth + static_cast<size_t>(y) * width;
+			for (int32_t x = setup.MinX; x <= setup.MaxX; x++)
+			{
+				float px = static_cast<float>(x) + 0.5f;
+				if (setup.EdgeA[0] * px + rowEdge[0] >= 0.0f && setup.EdgeA[1] * px + rowEdge[1] >= 0.0f && setup.EdgeA[2] * px + rowEdge[2] >= 0.0f)
+					pRow[x] = std::min(pRow[x], setup.DepthA * px + rowDepth);
+			}
+		}
+	}
+
+	CPU_TARGET("avx2")
+	void RasterAVX2(const TriangleSetup& setup, float* pDepth, uint32_t width)
+	{
+		const __m256 laneOffsets = _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f);
+		const __m256 zero = _mm256_setzero_ps();
+		const __m256 firstX = _mm256_set1_ps(static_cast<float>(setup.MinX) + 0.5f);
+		const __m256 lastX = _mm256_set1_ps(static_cast<float>(setup.MaxX) + 0.5f);
+		const __m256 edgeA0 = _mm256_set1_ps(setup.EdgeA[0]);
+		const __m256 edgeA1 = _mm256_set1_ps(setup.EdgeA[1]);
+		const __m256 edgeA2 = _mm256_set1_ps(setup.EdgeA[2]);
+		const __m256 depthA = _mm256_set1_ps(setup.DepthA);
+		int32_t startX = setup.MinX & ~7;
+
+		for (int32_t y = setup.MinY; y <= setup.MaxY; y++)
+		{
+			float py = static_cast<float>(y) + 0.5f;
+			__m256 rowEdge0 = _mm256_set1_ps(setup.EdgeB[0] * py + setup.EdgeC[0]);
+			__m256 rowEdge1 = _mm256_set1_ps(setup.EdgeB[1] * py + setup.EdgeC[1]);
+			__m256 rowEdge2 = _mm256_set1_ps(setup.EdgeB[2] * py + setup.EdgeC[2]);
+			__m256 rowDepth = _mm256_set1_ps(setup.DepthB * py + setup.DepthC);
+
+			float* pRow = pDepth + static_cast<size_t>(y) * width;
+			for (int32_t x = startX; x <= setup.MaxX; x += 8)
+			{
+				__m256 px = _mm256_add_ps(_mm256_set1_ps(static_cast<float>(x)), laneOffsets);
+				// Lanes left or right of the bounding box stay untouched, like in the scalar loop
+				__m256 inside = _mm256_and_ps(_mm256_cmp_ps(px, firstX, _CMP_GE_OQ), _mm256_cmp_ps(px, lastX, _CMP_LE_OQ));
+				inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(edgeA0, px), rowEdge0), zero, _CMP_GE_OQ));
+				inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(edgeA1, px), rowEdge1), zero, _CMP_GE_OQ));
+				inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(edgeA2, px), rowEdge2), zero, _CMP_GE_OQ));
+				if (_mm256_movemask_ps(inside) == 0)
+					continue;
+
+				__m256 depth = _mm256_add_ps(_mm256_mul_ps(depthA, px), rowDepth);
+				__m256 current = _mm256_load_ps(pRow + x);
+				_mm256_store_ps(pRow + x, _mm256_blendv_ps(current, _mm256_min_ps(current, depth), inside));
+			}
+		}
+	}
+
+	// True when depth is nearer than the farthest occluder of any tile in the rows and columns given
+	bool AnyTileNearerScalar(const float* pTiles, uint32_t stride, uint32_t firstX, uint32_t lastX, uint32_t firstY, uint32_t lastY, float depth)
+	{
+		for (uint32_t y = firstY; y <= lastY; y++)
+		{
+			for (uint32_t x = firstX; x <= lastX; x++)
+			{
+				if (depth < pTiles[y * stride + x])
+					return true;
+			}
+		}
+		return false;
+	}
+
+	CPU_TARGET("avx2")
+	bool AnyTileNearerAVX2(const float* pTiles, uint32_t stride, uint32_t firstX, uint32_t lastX, uint32_t firstY, uint32_t lastY, float depth)
+	{
+		const __m256 nearest = _mm256_set1_ps(depth);
+		uint32_t startX = firstX & ~7u;
+		for (uint32_t y = firstY; y <= lastY; y++)
+		{
+			const float* pRow = pTiles + y * stride;
+			for (uint32_t x = startX; x <= lastX; x += 8)
+			{
+				int nearer = _mm256_movemask_ps(_mm256_cmp_ps(nearest, _mm256_load_ps(pRow + x), _CMP_LT_OQ));
+				uint32_t lanes = 0xffu;
+				if (x < firstX)
+					lanes &= 0xffu << (firstX - x);
+				if (lastX - x < 7)
+					lanes &= 0xffu >> (7 - (lastX - x));
+				if (static_cast<uint32_t>(nearer) & lanes)
+					return true;
+			}
+		}
+		return false;
+	}
+}
+
+SoftwareOcclusion::SoftwareOcclusion()
+{
+	if (!SetKernel(SoftwareOcclusionKernel::AVX2))
+		SetKernel(SoftwareOcclusionKernel::Scalar);
+}
+
+void SoftwareOcclusion::Init(uint32_t width, uint32_t height)
+{
+	m_TilesX = std::max((width + TILE_WIDTH - 1) / TILE_WIDTH, 1u);
+	m_TilesY = std::max((height + TILE_HEIGHT - 1) / TILE_HEIGHT, 1u);
+	m_Width = m_TilesX * TILE_WIDTH;
+	m_Height = m_TilesY * TILE_HEIGHT;
+	m_TileStride = (m_TilesX + 7) & ~7u;
+
+	m_Depth.assign(static_cast<size_t>(m_Width) * m_Height, FAR_DEPTH);
+	m_TileDepth.assign(static_cast<size_t>(m_TileStride) * m_TilesY, FAR_DEPTH);
+	m_TilesDirty = false;
+}
+
+bool SoftwareOcclusion::SetKernel(SoftwareOcclusionKernel kernel)
+{
+	if (kernel == SoftwareOcclusionKernel::AVX2 && !GetCpuFeatures().AVX2)
+		return false;
+	m_Kernel = kernel;
+	return true;
+}
+
+void SoftwareOcclusion::BeginFrame(const float viewProjection[16])
+{
+	memcpy(m_ViewProjection, viewProjection, sizeof(m_ViewProjection));
+	std::fill(m_Depth.begin(), m_Depth.end(), FAR_DEPTH);
+	std::fill(m_TileDepth.begin(), m_TileDepth.end(), FAR_DEPTH);
+	m_TilesDirty = false;
+	m_Stats = {};
+}
+
+void SoftwareOcclusion::RenderOccluder(const void* pPositions, size_t positionStride, const uint32_t* pIndices, size_t indexCount,
+	const float* pTransform)
+{
+	if (m_Depth.empty())
+		return;
+	auto start = std::chrono::steady_clock::now();
+
+	float matrix[16];
+	if (pTransform)
+		Multiply(m_ViewProjection, pTransform, matrix);
+	else
+		memcpy(matrix, m_ViewProjection, sizeof(matrix));
+
+	const uint8_t* pBytes = static_cast<const uint8_t*>(pPositions);
+	for (size_t i = 0; i + 2 < indexCount; i += 3)
+	{
+		ClipVertex triangle[3];
+		for (uint32_t corner = 0; corner < 3; corner++)
+		{
+			float position[3];
+			memcpy(position, pBytes + pIndices[i + corner] * positionStride, sizeof(position));
+			triangle[corner] = Transform(matrix, position[0], position[1], position[2]);
+		}
+
+		ClipVertex clipped[4];
+		uint32_t clippedCount = ClipNear(triangle, clipped);
+		ScreenVertex screen[4];
+		bool valid = clippedCount >= 3;
+		for (uint32_t v = 0; v < clippedCount && valid; v++)
+		{
+			valid = clipped[v].W > MIN_CLIP_W;
+			float inverseW = 1.0f / clipped[v].W;
+			screen[v] = { (clipped[v].X * inverseW * 0.5f + 0.5f) * m_Width, (clipped[v].Y * inverseW * 0.5f + 0.5f) * m_Height, clipped[v].Z * inverseW };
+		}
+		if (!valid)
+			continue;
+
+		for (uint32_t v = 2; v < clippedCount; v++)
+			RasterizeTriangle(screen[0], screen[v - 1], screen[v]);
+		m_Stats.OccluderTriangles++;
+	}
+
+	m_TilesDirty = true;
+	m_Stats.RasterMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool SoftwareOcclusion::IsVisible(const float center[3], const float extents[3])
+{
+	if (m_Depth.empty())
+		return true;
+	if (m_TilesDirty)
+		UpdateTiles();
+	m_Stats.Tested++;
+
+	float minX = static_cast<float>(m_Width), maxX = 0.0f;
+	float minY = static_cast<float>(m_Height), maxY = 0.0f;
+	float nearest = FAR_DEPTH;
+	for (uint32_t corner = 0; corner < 8; corner++)
+	{
+		ClipVertex clip = Transform(m_ViewProjection, center[0] + ((corner & 1) ? extents[0] : -extents[0]),
+			center[1] + ((corner & 2) ? extents[1] : -extents[1]), center[2] + ((corner & 4) ? extents[2] : -extents[2]));
+		// Crossing the near plane, the box may cover the whole view
+		if (clip.W <= MIN_CLIP_W || clip.Z < 0.0f)
+			return true;
+
+		float inverseW = 1.0f / clip.W;
+		float x = (clip.X * inverseW * 0.5f + 0.5f) * m_Width;
+		float y = (clip.Y * inverseW * 0.5f + 0.5f) * m_Height;
+		minX = std::min(minX, x);
+		maxX = std::max(maxX, x);
+		minY = std::min(minY, y);
+		maxY = std::max(maxY, y);
+		nearest = std::min(nearest, clip.Z * inverseW);
+	}
+
+	// Nothing of it is on screen, frustum culling missed it
+	if (maxX < 0.0f || maxY < 0.0f || minX >= m_Width || minY >= m_Height)
+	{
+		m_Stats.Occluded++;
+		return false;
+	}
+
+	// Tiles of every pixel the rectangle touches, clamped before converting so huge coordinates do not overflow
+	float limitX = static_cast<float>(m_Width - 1);
+	float limitY = static_cast<float>(m_Height - 1);
+	uint32_t firstX = static_cast<uint32_t>(std::min(std::max(minX, 0.0f), limitX)) / TILE_WIDTH;
+	uint32_t lastX = static_cast<uint32_t>(std::min(std::max(maxX, 0.0f), limitX)) / TILE_WIDTH;
+	uint32_t firstY = static_cast<uint32_t>(std::min(std::max(minY, 0.0f), limitY)) / TILE_HEIGHT;
+	uint32_t lastY = static_cast<uint32_t>(std::min(std::max(maxY, 0.0f), limitY)) / TILE_HEIGHT;
+	bool visible = m_Kernel == SoftwareOcclusionKernel::AVX2
+		? AnyTileNearerAVX2(m_TileDepth.data(), m_TileStride, firstX, lastX, firstY, lastY, nearest)
+		: AnyTileNearerScalar(m_TileDepth.data(), m_TileStride, firstX, lastX, firstY, lastY, nearest);
+	if (!visible)
+		m_Stats.Occluded++;
+	return visible;
+}
+
+const std::vector<uint32_t>& SoftwareOcclusion::Filter(const CpuCulling& scene, const std::vector<uint32_t>& candidates)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	m_Visible.clear();
+	m_Visible.reserve(candidates.size());
+	for (uint32_t index : candidates)
+	{
+		float center[3], extents[3];
+		scene.GetBounds(index, center, extents);
+		if (IsVisible(center, extents))
+			m_Visible.push_back(index);
+	}
+
+	m_Stats.TestMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	return m_Visible;
+}
+
+void SoftwareOcclusion::RasterizeTriangle(const ScreenVertex& a, const ScreenVertex& b, const ScreenVertex& c)
+{
+	float area = (b.X - a.X) * (c.Y - a.Y) - (c.X - a.X) * (b.Y - a.Y);
+	if (area == 0.0f || !isfinite(area))
+		return;
+
+	// Either winding is accepted, the edges are flipped so the inside is positive
+	TriangleSetup setup{};
+	float sign = area > 0.0f ? 1.0f : -1.0f;
+	const ScreenVertex* pVertices[3] = { &a, &b, &c };
+	for (uint32_t e = 0; e < 3; e++)
+	{
+		const ScreenVertex& from = *pVertices[e];
+		const ScreenVertex& to = *pVertices[(e + 1) % 3];
+		setup.EdgeA[e] = -(to.Y - from.Y) * sign;
+		setup.EdgeB[e] = (to.X - from.X) * sign;
+		setup.EdgeC[e] = -(setup.EdgeA[e] * from.X + setup.EdgeB[e] * from.Y);
+	}
+
+	setup.DepthA = ((b.Z - a.Z) * (c.Y - a.Y) - (c.Z - a.Z) * (b.Y - a.Y)) / area;
+	setup.DepthB = ((c.Z - a.Z) * (b.X - a.X) - (b.Z - a.Z) * (c.X - a.X)) / area;
+	setup.DepthC = a.Z - setup.DepthA * a.X - setup.DepthB * a.Y;
+
+	// Pixels whose centers can be inside, clamped before converting so huge coordinates do not overflow
+	float limitX = static_cast<float>(m_Width);
+	float limitY = static_cast<float>(m_Height);
+	float minX = std::min(std::max(std::min(std::min(a.X, b.X), c.X), -1.0f), limitX);
+	float maxX = std::min(std::max(std::max(std::max(a.X, b.X), c.X), -1.0f), limitX);
+	float minY = std::min(std::max(std::min(std::min(a.Y, b.Y), c.Y), -1.0f), limitY);
+	float maxY = std::min(std::max(std::max(std::max(a.Y, b.Y), c.Y), -1.0f), limitY);
+	setup.MinX = std::max(static_cast<int32_t>(ceilf(minX - 0.5f)), 0);
+	setup.MaxX = std::min(static_cast<int32_t>(floorf(maxX - 0.5f)), static_cast<int32_t>(m_Width) - 1);
+	setup.MinY = std::max(static_cast<int32_t>(ceilf(minY - 0.5f)), 0);
+	setup.MaxY = std::min(static_cast<int32_t>(floorf(maxY - 0.5f)), static_cast<int32_t>(m_Height) - 1);
+	if (setup.MinX > setup.MaxX || setup.MinY > setup.MaxY)
+		return;
+
+	if (m_Kernel == SoftwareOcclusionKernel::AVX2)
+		RasterAVX2(setup, m_Depth.data(), m_Width);
+	else
+		RasterScalar(setup, m_Depth.data(), m_Width);
+}
+
+void SoftwareOcclusion::UpdateTiles()
+{
+	for (uint32_t tileY = 0; tileY < m_TilesY; tileY++)
+	{
+		for (uint32_t tileX = 0; tileX < m_TilesX; tileX++)
+		{
+			const float* pPixels = m_Depth.data() + static_cast<size_t>(tileY) * TILE_HEIGHT * m_Width + tileX * TILE_WIDTH;
+			float farthest = 0.0f;
+			for (uint32_t y = 0; y < TILE_HEIGHT; y++)
+			{
+				for (uint32_t x = 0; x < TILE_WIDTH; x++)
+					farthest = std::max(farthest, pPixels[y * m_Width + x]);
+			}
+			m_TileDepth[static_cast<size_t>(tileY) * m_TileStride + tileX] = farthest;
+		}
+	}
+	m_TilesDirty = false;
+}
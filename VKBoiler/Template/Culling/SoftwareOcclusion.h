@@ -0,0 +1,99 @@
+#pragma once
+
+#include "CpuCulling.h"
+#include "../Util/AlignedAllocator.h"
+
+#include <stdint.h>
+#include <vector>
+
+enum class SoftwareOcclusionKernel
+{
+	Scalar,
+	AVX2,
+};
+
+struct SoftwareOcclusionStats
+{
+	uint32_t OccluderTriangles = 0;
+	uint32_t Tested = 0;
+	uint32_t Occluded = 0;
+	double RasterMs = 0.0;
+	double TestMs = 0.0;
+};
+
+/// <summary>
+/// Occlusion culling on the CPU, so hidden objects are dropped before any command is recorded for them. A few large
+/// occluders are rasterized into a low resolution depth buffer, 8 pixels at a time with AVX2 when available. The
+/// farthest depth of every 8x4 pixel tile forms the hierarchical level that bounds are tested against: an object is
+/// occluded when the nearest point of its box lies behind every tile its screen rectangle touches.
+/// Depth follows Vulkan clip space, 0 at the near plane. Per frame: BeginFrame, RenderOccluder for each occluder, then
+/// Filter the output of CpuCulling. Not thread safe
+/// </summary>
+class SoftwareOcclusion
+{
+public:
+	static const uint32_t TILE_WIDTH = 8;
+	static const uint32_t TILE_HEIGHT = 4;
+
+	SoftwareOcclusion();
+
+	/// <summary>
+	/// Resolution is rounded up to whole tiles
+	/// </summary>
+	void Init(uint32_t width, uint32_t height);
+	uint32_t GetWidth() const { return m_Width; }
+	uint32_t GetHeight() const { return m_Height; }
+
+	/// <summary>
+	/// Forces a kernel, false when the CPU does not support it
+	/// </summary>
+	bool SetKernel(SoftwareOcclusionKernel kernel);
+	SoftwareOcclusionKernel GetKernel() const { return m_Kernel; }
+
+	/// <summary>
+	/// Clears the depth buffer, viewProjection is column major
+	/// </summary>
+	void BeginFrame(const float viewProjection[16]);
+	/// <summary>
+	/// Rasterizes a triangle list with either winding. Positions are three floats at the start of each positionStride
+	/// bytes, pTransform is an optional column major object to world matrix. Triangles crossing the near plane are clipped
+	/// </summary>
+	void RenderOccluder(const void* pPositions, size_t positionStride, const uint32_t* pIndices, size_t indexCount,
+		const float* pTransform = nullptr);
+
+	/// <summary>
+	/// Tests a world space box against the occluders rendered this frame
+	/// </summary>
+	bool IsVisible(const float center[3], const float extents[3]);
+	/// <summary>
+	/// Keeps the candidates whose bounds in scene are not occluded, valid until the next call
+	/// </summary>
+	const std::vector<uint32_t>& Filter(const CpuCulling& scene, const std::vector<uint32_t>& candidates);
+	const SoftwareOcclusionStats& GetStats() const { return m_Stats; }
+
+private:
+	struct ScreenVertex
+	{
+		float X, Y, Z;
+	};
+
+	void RasterizeTriangle(const ScreenVertex& a, const ScreenVertex& b, const ScreenVertex& c);
+	void UpdateTiles();
+
+private:
+	uint32_t m_Width = 0;
+	uint32_t m_Height = 0;
+	uint32_t m_TilesX = 0;
+	uint32_t m_TilesY = 0;
+	float m_ViewProjection[16] = {};
+
+	SoftwareOcclusionKernel m_Kernel = SoftwareOcclusionKernel::Scalar;
+	std::vector<float, AlignedAllocator<float, 32>> m_Depth = {};
+	// Farthest depth per tile, rows padded to a multiple of 8 tiles
+	std::vector<float, AlignedAllocator<float, 32>> m_TileDepth = {};
+	uint32_t m_TileStride = 0;
+	bool m_TilesDirty = false;
+
+	std::vector<uint32_t> m_Visible = {};
+	SoftwareOcclusionStats m_Stats = {};
+};
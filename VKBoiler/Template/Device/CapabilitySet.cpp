@@ -0,0 +1,103 @@
+#include "CapabilitySet.h"
+
+CapabilitySet& CapabilitySet::operator=(const CapabilitySet& other)
+{
+	if (this == &other)
+		return *this;
+
+	m_Names.clear();
+	m_Lookup.clear();
+	for (const auto& name : other.m_Names)
+		Add(name.c_str());
+	return *this;
+}
+
+/*static*/CapabilitySet CapabilitySet::FromInstanceLayers()
+{
+	uint32_t count = 0;
+	vkEnumerateInstanceLayerProperties(&count, nullptr);
+	std::vector<VkLayerProperties> layers(static_cast<size_t>(count));
+	vkEnumerateInstanceLayerProperties(&count, layers.data());
+
+	CapabilitySet set{};
+	set.m_Lookup.reserve(static_cast<size_t>(count));
+	for (uint32_t i = 0; i < count; i++)
+		set.Add(layers[i].layerName);
+	return set;
+}
+
+/*static*/CapabilitySet CapabilitySet::FromInstanceExtensions(const char* pLayerName)
+{
+	uint32_t count = 0;
+	vkEnumerateInstanceExtensionProperties(pLayerName, &count, nullptr);
+	std::vector<VkExtensionProperties> extensions(static_cast<size_t>(count));
+	vkEnumerateInstanceExtensionProperties(pLayerName, &count, extensions.data());
+
+	CapabilitySet set{};
+	set.m_Lookup.reserve(static_cast<size_t>(count));
+	for (uint32_t i = 0; i < count; i++)
+		set.Add(extensions[i].extensionName);
+	return set;
+}
+
+/*static*/CapabilitySet CapabilitySet::FromDeviceExtensions(VkPhysicalDevice device, const char* pLayerName)
+{
+	uint32_t count = 0;
+	vkEnumerateDeviceExtensionProperties(device, pLayerName, &count, nullptr);
+	std::vector<VkExtensionProperties> extensions(static_cast<size_t>(count));
+	vkEnumerateDeviceExtensionProperties(device, pLayerName, &count, extensions.data());
+
+	CapabilitySet set{};
+	set.m_Lookup.reserve(static_cast<size_t>(count));
+	for (uint32_t i = 0; i < count; i++)
+		set.Add(extensions[i].extensionName);
+	return set;
+}
+
+bool CapabilitySet::Add(const char* name)
+{
+	if (Contains(name))
+		return false;
+
+	m_Names.emplace_back(name);
+	m_Lookup.insert(std::string_view(m_Names.back()));
+	return true;
+}
+
+bool CapabilitySet::ContainsAll(const std::vector<const char*>& requested, std::vector<const char*>* pMissing) const
+{
+	bool allPresent = true;
+	for (const char* name : requested)
+	{
+		if (Contains(name))
+			continue;
+
+		allPresent = false;
+		if (!pMissing)
+			break;
+		pMissing->push_back(name);
+	}
+	return allPresent;
+}
+
+void AppendUnique(std::vector<const char*>& dst, const std::vector<const char*>& src)
+{
+	std::unordered_set<std::string_view> present(dst.begin(), dst.end());
+	for (const char* name : src)
+	{
+		if (present.insert(std::string_view(name)).second)
+			dst.push_back(name);
+	}
+}
+
+std::string JoinNames(const std::vector<const char*>& names)
+{
+	std::string joined;
+	for (size_t i = 0; i < names.size(); i++)
+	{
+		if (i != 0)
+			joined.append(", ");
+		joined.append("\"").append(names[i]).append("\"");
+	}
+	return joined;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "../Loader/Loader.h"
+
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+/// <summary>
+/// Hashed set of layer or extension names. Names are interned so lookups never touch the original property arrays
+/// </summary>
+class CapabilitySet
+{
+public:
+	CapabilitySet() = default;
+	CapabilitySet(const CapabilitySet& other) { for (const auto& name : other.m_Names) Add(name.c_str()); }
+	CapabilitySet& operator=(const CapabilitySet& other);
+	CapabilitySet(CapabilitySet&&) = default;
+	CapabilitySet& operator=(CapabilitySet&&) = default;
+
+	static CapabilitySet FromInstanceLayers();
+	static CapabilitySet FromInstanceExtensions(const char* pLayerName = nullptr);
+	static CapabilitySet FromDeviceExtensions(VkPhysicalDevice device, const char* pLayerName = nullptr);
+
+	/// <summary>
+	/// Adds a name to the set, returns false if it was already present
+	/// </summary>
+	bool Add(const char* name);
+
+	bool Contains(const char* name) const { return m_Lookup.find(std::string_view(name)) != m_Lookup.end(); }
+
+	/// <summary>
+	/// Checks all requested names and appends every name that is not in the set to pMissing
+	/// </summary>
+	bool ContainsAll(const std::vector<const char*>& requested, std::vector<const char*>* pMissing = nullptr) const;
+
+	size_t Size() const { return m_Names.size(); }
+
+private:
+	// deque never relocates its elements, so the views in m_Lookup stay valid
+	std::deque<std::string> m_Names = {};
+	std::unordered_set<std::string_view> m_Lookup = {};
+};
+
+/// <summary>
+/// Appends the names of src to dst which are not yet present in dst, preserving request order
+/// </summary>
+void AppendUnique(std::vector<const char*>& dst, const std::vector<const char*>& src);
+
+/// <summary>
+/// Joins names into a single comma separated string for error reporting
+/// </summary>
+std::string JoinNames(const std::vector<const char*>& names);
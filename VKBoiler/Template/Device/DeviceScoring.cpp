@@ -0,0 +1,334 @@
+#include "DeviceScoring.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <stdio.h>
+
+#undef max
+#undef min
+
+PhysicalDeviceCandidate QueryPhysicalDeviceCandidate(VkPhysicalDevice device)
+{
+	PhysicalDeviceCandidate candidate{};
+	candidate.Device = device;
+	vkGetPhysicalDeviceProperties(device, &candidate.Properties);
+	vkGetPhysicalDeviceFeatures(device, &candidate.Features);
+	vkGetPhysicalDeviceMemoryProperties(device, &candidate.MemoryProperties);
+
+	uint32_t count = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(device, &count, nullptr);
+	candidate.QueueFamilies.resize(static_cast<size_t>(count));
+	vkGetPhysicalDeviceQueueFamilyProperties(device, &count, candidate.QueueFamilies.data());
+
+	return candidate;
+}
+
+namespace
+{
+	float Saturate(float value) { return std::min(std::max(value, 0.0f), 1.0f); }
+
+	float ScoreDeviceType(VkPhysicalDeviceType type)
+	{
+		switch (type)
+		{
+		case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:		return 1.0f;
+		case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:	return 0.6f;
+		case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:		return 0.4f;
+		case VK_PHYSICAL_DEVICE_TYPE_CPU:				return 0.1f;
+		default:										return 0.0f;
+		}
+	}
+
+	float ScoreLocalHeap(const VkPhysicalDeviceMemoryProperties& memory)
+	{
+		VkDeviceSize largestLocalHeap = 0;
+		for (uint32_t i = 0; i < memory.memoryHeapCount; i++)
+		{
+			if (memory.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+				largestLocalHeap = std::max(largestLocalHeap, memory.memoryHeaps[i].size);
+		}
+
+		// Logarithmic so a 24GB card does not completely drown out every other term, saturates at 16GB
+		float gigabytes = static_cast<float>(largestLocalHeap) / (1024.0f * 1024.0f * 1024.0f);
+		return Saturate(std::log2(gigabytes + 1.0f) / std::log2(17.0f));
+	}
+
+	float ScoreLimits(const VkPhysicalDeviceLimits& limits)
+	{
+		// Normalized against values commonly reported by current desktop hardware
+		float score = 0.0f;
+		score += Saturate(static_cast<float>(limits.maxComputeWorkGroupInvocations) / 1024.0f);
+		score += Saturate(static_cast<float>(limits.maxComputeSharedMemorySize) / 65536.0f);
+		score += Saturate(static_cast<float>(limits.maxPerStageDescriptorSampledImages) / 1048576.0f);
+		score += Saturate(static_cast<float>(limits.maxPerStageDescriptorStorageBuffers) / 1048576.0f);
+		score += Saturate(static_cast<float>(limits.maxDescriptorSetSampledImages) / 1048576.0f);
+		score += Saturate(static_cast<float>(limits.maxImageDimension2D) / 16384.0f);
+		return score / 6.0f;
+	}
+
+	float ScoreOptionalFeatures(const DeviceScoringParameters& params, const PhysicalDeviceCandidate& candidate)
+	{
+		const VkPhysicalDeviceFeatures& optional = params.OptionalDeviceFeatures;
+		const VkPhysicalDeviceFeatures& available = candidate.Features;
+		// Same VkBool32 layout assumption as the required feature check in PickPhysicalDevice
+		size_t featureCount = sizeof(VkPhysicalDeviceFeatures) / sizeof(VkBool32);
+		uint32_t requested = 0;
+		uint32_t supported = 0;
+		for (size_t i = 0; i < featureCount; i++)
+		{
+			if (*(reinterpret_cast<const VkBool32*>(&optional) + i) != VK_TRUE)
+				continue;
+
+			requested++;
+			if (*(reinterpret_cast<const VkBool32*>(&available) + i) == VK_TRUE)
+				supported++;
+		}
+
+		for (const char* pExtension : params.OptionalDeviceExtensions)
+		{
+			requested++;
+			if (candidate.Extensions.Contains(pExtension))
+				supported++;
+		}
+
+		if (requested == 0)
+			return 0.0f;
+		return static_cast<float>(supported) / static_cast<float>(requested);
+	}
+
+	float ScoreQueueTopology(const std::vector<VkQueueFamilyProperties>& families)
+	{
+		bool dedicatedCompute = false;
+		bool dedicatedTransfer = false;
+		uint32_t totalQueues = 0;
+		for (const auto& family : families)
+		{
+			totalQueues += family.queueCount;
+			if ((family.queueFlags & VK_QUEUE_COMPUTE_BIT) && !(family.queueFlags & VK_QUEUE_GRAPHICS_BIT))
+				dedicatedCompute = true;
+			if ((family.queueFlags & VK_QUEUE_TRANSFER_BIT) && !(family.queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)))
+				dedicatedTransfer = true;
+		}
+
+		float score = 0.0f;
+		if (dedicatedCompute)
+			score += 0.4f;
+		if (dedicatedTransfer)
+			score += 0.4f;
+		score += 0.2f * Saturate(static_cast<float>(totalQueues) / 16.0f);
+		return score;
+	}
+}
+
+float ScorePhysicalDevice(const PhysicalDeviceCandidate& candidate, const DeviceScoringParameters& params, float bestBenchmarkBandwidth)
+{
+	if (params.CustomScore)
+		return params.CustomScore(candidate);
+
+	float score = 0.0f;
+	score += params.DeviceTypeWeight * ScoreDeviceType(candidate.Properties.deviceType);
+	score += params.LocalHeapWeight * ScoreLocalHeap(candidate.MemoryProperties);
+	score += params.LimitsWeight * ScoreLimits(candidate.Properties.limits);
+	score += params.OptionalFeaturesWeight * ScoreOptionalFeatures(params, candidate);
+	score += params.QueueTopologyWeight * ScoreQueueTopology(candidate.QueueFamilies);
+
+	if (bestBenchmarkBandwidth > 0.0f)
+		score += params.BenchmarkWeight * Saturate(candidate.BenchmarkBandwidth / bestBenchmarkBandwidth);
+
+	return score;
+}
+
+float BenchmarkPhysicalDevice(const PhysicalDeviceCandidate& candidate)
+{
+	const VkDeviceSize BUFFER_SIZE = 64ull * 1024ull * 1024ull;
+	const uint32_t ITERATIONS = 8;
+
+	// Find compute capable family, prefer one that supports timestamps
+	uint32_t familyIndex = UINT32_MAX;
+	for (uint32_t i = 0; i < static_cast<uint32_t>(candidate.QueueFamilies.size()); i++)
+	{
+		const auto& family = candidate.QueueFamilies[i];
+		if (!(family.queueFlags & VK_QUEUE_COMPUTE_BIT) || family.queueCount == 0)
+			continue;
+
+		if (familyIndex == UINT32_MAX || (family.timestampValidBits > 0 && candidate.QueueFamilies[familyIndex].timestampValidBits == 0))
+			familyIndex = i;
+	}
+
+	if (familyIndex == UINT32_MAX)
+		return 0.0f;
+
+	bool useTimestamps = candidate.QueueFamilies[familyIndex].timestampValidBits > 0;
+
+	float priority = 1.0f;
+	VkDeviceQueueCreateInfo queueCi{};
+	queueCi.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+	queueCi.queueFamilyIndex = familyIndex;
+	queueCi.queueCount = 1;
+	queueCi.pQueuePriorities = &priority;
+
+	VkDeviceCreateInfo deviceCi{};
+	deviceCi.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+	deviceCi.queueCreateInfoCount = 1;
+	deviceCi.pQueueCreateInfos = &queueCi;
+
+	VkDevice device = VK_NULL_HANDLE;
+	if (vkCreateDevice(candidate.Device, &deviceCi, nullptr, &device) != VK_SUCCESS)
+		return 0.0f;
+
+	VkQueue queue = VK_NULL_HANDLE;
+	vkGetDeviceQueue(device, familyIndex, 0, &queue);
+
+	VkBuffer buffer = VK_NULL_HANDLE;
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	VkCommandPool pool = VK_NULL_HANDLE;
+	VkQueryPool queryPool = VK_NULL_HANDLE;
+	VkFence fence = VK_NULL_HANDLE;
+	float bandwidth = 0.0f;
+
+	do
+	{
+		VkBufferCreateInfo bufferCi{};
+		bufferCi.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferCi.size = BUFFER_SIZE;
+		bufferCi.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+		bufferCi.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		if (vkCreateBuffer(device, &bufferCi, nullptr, &buffer) != VK_SUCCESS)
+			break;
+
+		VkMemoryRequirements requirements{};
+		vkGetBufferMemoryRequirements(device, buffer, &requirements);
+
+		// Prefer device local memory, fall back on any compatible type
+		uint32_t memoryType = UINT32_MAX;
+		for (uint32_t i = 0; i < candidate.MemoryProperties.memoryTypeCount; i++)
+		{
+			if (!(requirements.memoryTypeBits & (1u << i)))
+				continue;
+
+			if (candidate.MemoryProperties.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)
+			{
+				memoryType = i;
+				break;
+			}
+			if (memoryType == UINT32_MAX)
+				memoryType = i;
+		}
+
+		if (memoryType == UINT32_MAX)
+			break;
+
+		VkMemoryAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		allocInfo.allocationSize = requirements.size;
+		allocInfo.memoryTypeIndex = memoryType;
+		if (vkAllocateMemory(device, &allocInfo, nullptr, &memory) != VK_SUCCESS)
+			break;
+		if (vkBindBufferMemory(device, buffer, memory, 0) != VK_SUCCESS)
+			break;
+
+		VkCommandPoolCreateInfo poolCi{};
+		poolCi.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolCi.queueFamilyIndex = familyIndex;
+		if (vkCreateCommandPool(device, &poolCi, nullptr, &pool) != VK_SUCCESS)
+			break;
+
+		if (useTimestamps)
+		{
+			VkQueryPoolCreateInfo queryCi{};
+			queryCi.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+			queryCi.queryType = VK_QUERY_TYPE_TIMESTAMP;
+			queryCi.queryCount = 2;
+			if (vkCreateQueryPool(device, &queryCi, nullptr, &queryPool) != VK_SUCCESS)
+				useTimestamps = false;
+		}
+
+		VkCommandBufferAllocateInfo cmdInfo{};
+		cmdInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		cmdInfo.commandPool = pool;
+		cmdInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		cmdInfo.commandBufferCount = 1;
+		VkCommandBuffer cmd = VK_NULL_HANDLE;
+		if (vkAllocateCommandBuffers(device, &cmdInfo, &cmd) != VK_SUCCESS)
+			break;
+
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		vkBeginCommandBuffer(cmd, &beginInfo);
+
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+		// Warm up fill so first touch page faults are not measured
+		vkCmdFillBuffer(cmd, buffer, 0, VK_WHOLE_SIZE, 0);
+		vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+		if (useTimestamps)
+		{
+			vkCmdResetQueryPool(cmd, queryPool, 0, 2);
+			vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, 0);
+		}
+
+		for (uint32_t i = 0; i < ITERATIONS; i++)
+		{
+			vkCmdFillBuffer(cmd, buffer, 0, VK_WHOLE_SIZE, i);
+			vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+		}
+
+		if (useTimestamps)
+			vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, 1);
+
+		vkEndCommandBuffer(cmd);
+
+		VkFenceCreateInfo fenceCi{};
+		fenceCi.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		if (vkCreateFence(device, &fenceCi, nullptr, &fence) != VK_SUCCESS)
+			break;
+
+		VkSubmitInfo submit{};
+		submit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submit.commandBufferCount = 1;
+		submit.pCommandBuffers = &cmd;
+
+		auto start = std::chrono::high_resolution_clock::now();
+		if (vkQueueSubmit(queue, 1, &submit, fence) != VK_SUCCESS)
+			break;
+		// Two seconds is far beyond what the benchmark should take on any real device
+		if (vkWaitForFences(device, 1, &fence, VK_TRUE, 2000000000ull) != VK_SUCCESS)
+			break;
+		auto end = std::chrono::high_resolution_clock::now();
+
+		double seconds = std::chrono::duration<double>(end - start).count();
+		if (useTimestamps)
+		{
+			uint64_t timestamps[2] = {};
+			if (vkGetQueryPoolResults(device, queryPool, 0, 2, sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) == VK_SUCCESS
+				&& timestamps[1] > timestamps[0])
+			{
+				seconds = static_cast<double>(timestamps[1] - timestamps[0]) * candidate.Properties.limits.timestampPeriod * 1e-9;
+			}
+		}
+
+		if (seconds > 0.0)
+			bandwidth = static_cast<float>((static_cast<double>(BUFFER_SIZE) * ITERATIONS) / seconds / 1e9);
+	} while (false);
+
+	vkDeviceWaitIdle(device);
+	if (fence != VK_NULL_HANDLE)
+		vkDestroyFence(device, fence, nullptr);
+	if (queryPool != VK_NULL_HANDLE)
+		vkDestroyQueryPool(device, queryPool, nullptr);
+	if (pool != VK_NULL_HANDLE)
+		vkDestroyCommandPool(device, pool, nullptr);
+	if (buffer != VK_NULL_HANDLE)
+		vkDestroyBuffer(device, buffer, nullptr);
+	if (memory != VK_NULL_HANDLE)
+		vkFreeMemory(device, memory, nullptr);
+	vkDestroyDevice(device, nullptr);
+
+	return bandwidth;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "../Loader/Loader.h"
+
+#include "CapabilitySet.h"
+
+#include <functional>
+#include <vector>
+
+/// <summary>
+/// Everything known about a physical device at the moment it is being scored
+/// </summary>
+struct PhysicalDeviceCandidate
+{
+	VkPhysicalDevice Device = VK_NULL_HANDLE;
+	VkPhysicalDeviceProperties Properties = {};
+	VkPhysicalDeviceFeatures Features = {};
+	VkPhysicalDeviceMemoryProperties MemoryProperties = {};
+	std::vector<VkQueueFamilyProperties> QueueFamilies = {};
+	CapabilitySet Extensions = {};
+
+	/// <summary>
+	/// Result of the micro-benchmark in GB/s, 0 when the benchmark was not run or failed
+	/// </summary>
+	float BenchmarkBandwidth = 0.0f;
+};
+
+/// <summary>
+/// Weights of the individual scoring terms. Every term is normalized to [0, 1] before being weighted
+/// </summary>
+struct DeviceScoringParameters
+{
+	float DeviceTypeWeight = 4.0f;
+	float LocalHeapWeight = 2.0f;
+	float LimitsWeight = 1.0f;
+	float OptionalFeaturesWeight = 1.0f;
+	float QueueTopologyWeight = 1.0f;
+	float BenchmarkWeight = 4.0f;
+
+	/// <summary>
+	/// Features that are not required but make a device more attractive when present
+	/// </summary>
+	VkPhysicalDeviceFeatures OptionalDeviceFeatures = {};
+	/// <summary>
+	/// Extensions that count towards the optional feature term like OptionalDeviceFeatures
+	/// </summary>
+	std::vector<const char*> OptionalDeviceExtensions = {};
+
+	/// <summary>
+	/// Runs a short transfer benchmark on every suitable device, only used when more than one device is suitable
+	/// </summary>
+	bool RunBenchmark = false;
+
+	/// <summary>
+	/// Replaces the builtin scoring model when set
+	/// </summary>
+	std::function<float(const PhysicalDeviceCandidate&)> CustomScore = {};
+};
+
+/// <summary>
+/// Fills in the candidate properties of the given device
+/// </summary>
+PhysicalDeviceCandidate QueryPhysicalDeviceCandidate(VkPhysicalDevice device);
+
+/// <summary>
+/// Scores a candidate, the benchmark term is relative to the best benchmark result among all candidates
+/// </summary>
+float ScorePhysicalDevice(const PhysicalDeviceCandidate& candidate, const DeviceScoringParameters& params, float bestBenchmarkBandwidth);
+
+/// <summary>
+/// Measures device local fill bandwidth on a compute capable queue using a temporary logical device.
+/// Returns the bandwidth in GB/s or 0.0f on failure
+/// </summary>
+float BenchmarkPhysicalDevice(const PhysicalDeviceCandidate& candidate);
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "../Loader/Loader.h"
+
+#include <memory>
+#include <new>
+#include <vector>
+
+/// <summary>
+/// Owns a pNext chain of extension feature structs. Used twice per feature set: once filled in by
+/// vkGetPhysicalDeviceFeatures2 to see what is supported and once as the chain of VkDeviceCreateInfo
+/// </summary>
+class FeatureChain
+{
+public:
+	FeatureChain() = default;
+	FeatureChain(const FeatureChain&) = delete;
+	FeatureChain& operator=(const FeatureChain&) = delete;
+
+	/// <summary>
+	/// Appends a copy of the feature struct to the chain and returns the stored copy.
+	/// The pNext member of the copy is managed by the chain
+	/// </summary>
+	template<typename T>
+	T& Add(const T& feature)
+	{
+		std::unique_ptr<uint8_t[]> storage(new uint8_t[sizeof(T)]);
+		T* pFeature = new (storage.get()) T(feature);
+		pFeature->pNext = nullptr;
+
+		if (!m_Structs.empty())
+			reinterpret_cast<VkBaseOutStructure*>(m_Structs.back().get())->pNext = reinterpret_cast<VkBaseOutStructure*>(pFeature);
+		m_Structs.push_back(std::move(storage));
+		return *pFeature;
+	}
+
+	/// <summary>
+	/// Returns the first struct of the given type or nullptr
+	/// </summary>
+	template<typename T>
+	T* Find(VkStructureType sType)
+	{
+		for (auto& storage : m_Structs)
+		{
+			auto* pBase = reinterpret_cast<VkBaseOutStructure*>(storage.get());
+			if (pBase->sType == sType)
+				return reinterpret_cast<T*>(pBase);
+		}
+		return nullptr;
+	}
+
+	void* Head() { return m_Structs.empty() ? nullptr : m_Structs.front().get(); }
+	bool Empty() const { return m_Structs.empty(); }
+
+private:
+	std::vector<std::unique_ptr<uint8_t[]>> m_Structs = {};
+};
+
+/// <summary>
+/// Fills in a single extension feature struct for the given device
+/// </summary>
+template<typename T>
+T QueryDeviceFeature(VkPhysicalDevice device, VkStructureType sType)
+{
+	T feature{};
+	feature.sType = sType;
+
+	VkPhysicalDeviceFeatures2 features2{};
+	features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	features2.pNext = &feature;
+	vkGetPhysicalDeviceFeatures2(device, &features2);
+
+	feature.pNext = nullptr;
+	return feature;
+}
@@ -0,0 +1,228 @@
+#include "QueueAssignment.h"
+
+#include <limits>
+#include <stdio.h>
+
+namespace
+{
+	const VkQueueFlags RELEVANT_QUEUE_FLAGS = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT | VK_QUEUE_SPARSE_BINDING_BIT;
+
+	// Graphics and compute families support transfer operations even when they do not report it
+	VkQueueFlags EffectiveFlags(VkQueueFlags flags)
+	{
+		if (flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))
+			flags |= VK_QUEUE_TRANSFER_BIT;
+		return flags;
+	}
+
+	uint32_t CountBits(VkQueueFlags flags)
+	{
+		uint32_t count = 0;
+		for (; flags != 0; flags &= flags - 1)
+			count++;
+		return count;
+	}
+
+	struct FlowEdge
+	{
+		uint32_t To;
+		uint32_t Capacity;
+		double Cost;
+		uint32_t Reverse;
+	};
+
+	class FlowGraph
+	{
+	public:
+		explicit FlowGraph(uint32_t nodeCount) : m_Edges(nodeCount) { }
+
+		// Returns the index of the forward edge inside the adjacency list of from
+		size_t AddEdge(uint32_t from, uint32_t to, uint32_t capacity, double cost)
+		{
+			m_Edges[from].push_back({ to, capacity, cost, static_cast<uint32_t>(m_Edges[to].size()) });
+			m_Edges[to].push_back({ from, 0, -cost, static_cast<uint32_t>(m_Edges[from].size() - 1) });
+			return m_Edges[from].size() - 1;
+		}
+
+		// Successive shortest paths, graphs are tiny so Bellman-Ford is plenty
+		uint32_t MinCostMaxFlow(uint32_t source, uint32_t sink)
+		{
+			const double INF = std::numeric_limits<double>::infinity();
+			uint32_t nodeCount = static_cast<uint32_t>(m_Edges.size());
+			uint32_t totalFlow = 0;
+
+			while (true)
+			{
+				std::vector<double> distance(nodeCount, INF);
+				std::vector<uint32_t> prevNode(nodeCount, UINT32_MAX);
+				std::vector<uint32_t> prevEdge(nodeCount, UINT32_MAX);
+				distance[source] = 0.0;
+
+				bool updated = true;
+				for (uint32_t pass = 0; pass < nodeCount && updated; pass++)
+				{
+					updated = false;
+					for (uint32_t node = 0; node < nodeCount; node++)
+					{
+						if (distance[node] == INF)
+							continue;
+
+						for (uint32_t e = 0; e < static_cast<uint32_t>(m_Edges[node].size()); e++)
+						{
+							const FlowEdge& edge = m_Edges[node][e];
+							if (edge.Capacity == 0)
+								continue;
+
+							// Small epsilon prevents cycling on floating point noise
+							if (distance[node] + edge.Cost < distance[edge.To] - 1e-9)
+							{
+								distance[edge.To] = distance[node] + edge.Cost;
+								prevNode[edge.To] = node;
+								prevEdge[edge.To] = e;
+								updated = true;
+							}
+						}
+					}
+				}
+
+				if (distance[sink] == INF)
+					break;
+
+				uint32_t bottleneck = UINT32_MAX;
+				for (uint32_t node = sink; node != source; node = prevNode[node])
+				{
+					const FlowEdge& edge = m_Edges[prevNode[node]][prevEdge[node]];
+					bottleneck = edge.Capacity < bottleneck ? edge.Capacity : bottleneck;
+				}
+
+				for (uint32_t node = sink; node != source; node = prevNode[node])
+				{
+					FlowEdge& edge = m_Edges[prevNode[node]][prevEdge[node]];
+					edge.Capacity -= bottleneck;
+					m_Edges[node][edge.Reverse].Capacity += bottleneck;
+				}
+
+				totalFlow += bottleneck;
+			}
+
+			return totalFlow;
+		}
+
+		// Flow on a forward edge equals the capacity of its reverse edge
+		uint32_t Flow(uint32_t from, size_t edgeIndex) const
+		{
+			const FlowEdge& edge = m_Edges[from][edgeIndex];
+			return m_Edges[edge.To][edge.Reverse].Capacity;
+		}
+
+	private:
+		std::vector<std::vector<FlowEdge>> m_Edges;
+	};
+}
+
+bool SolveQueueAssignment(const std::vector<VkQueueFamilyProperties>& families, const std::vector<QueueType>& desiredQueues,
+	std::vector<QueueIndices>* pQueueIndices, std::vector<uint32_t>* pFamilyUsage)
+{
+	uint32_t requestCount = static_cast<uint32_t>(desiredQueues.size());
+	uint32_t familyCount = static_cast<uint32_t>(families.size());
+
+	// Nodes: [source][requests...][families...][sink]
+	uint32_t source = 0;
+	uint32_t firstRequest = 1;
+	uint32_t firstFamily = firstRequest + requestCount;
+	uint32_t sink = firstFamily + familyCount;
+	FlowGraph graph(sink + 1);
+
+	uint32_t totalDesired = 0;
+	for (uint32_t r = 0; r < requestCount; r++)
+	{
+		graph.AddEdge(source, firstRequest + r, desiredQueues[r].Count, 0.0);
+		totalDesired += desiredQueues[r].Count;
+	}
+
+	for (uint32_t f = 0; f < familyCount; f++)
+		graph.AddEdge(firstFamily + f, sink, families[f].queueCount, 0.0);
+
+	// Remember which edge connects which request to which family
+	std::vector<std::vector<size_t>> requestEdges(requestCount, std::vector<size_t>(familyCount, SIZE_MAX));
+	for (uint32_t r = 0; r < requestCount; r++)
+	{
+		const QueueType& request = desiredQueues[r];
+		float priority = request.Priority > 0.0f ? request.Priority : 0.0f;
+
+		for (uint32_t f = 0; f < familyCount; f++)
+		{
+			VkQueueFlags familyFlags = EffectiveFlags(families[f].queueFlags);
+			if (families[f].queueCount == 0 || (request.Types & familyFlags) != request.Types)
+				continue;
+
+			// Every capability the request does not need makes the family less dedicated to this request.
+			// Scaled by priority so important requests win contested dedicated families, the offset keeps
+			// zero priority requests from being indifferent between families
+			uint32_t unusedCapabilities = CountBits(familyFlags & RELEVANT_QUEUE_FLAGS & ~request.Types);
+			double cost = (1.0 + static_cast<double>(unusedCapabilities)) * (0.01 + static_cast<double>(priority));
+			requestEdges[r][f] = graph.AddEdge(firstRequest + r, firstFamily + f, families[f].queueCount, cost);
+		}
+	}
+
+	uint32_t assigned = graph.MinCostMaxFlow(source, sink);
+
+	// [Populating] Store information on which queue handles may be retrieved on which family and from which indices
+	std::vector<uint32_t> familyUsage(familyCount, 0);
+	if (pQueueIndices)
+		pQueueIndices->resize(requestCount);
+
+	for (uint32_t r = 0; r < requestCount; r++)
+	{
+		QueueIndices indices{};
+		indices.Types = desiredQueues[r].Types;
+		indices.FamilyCount = 0;
+
+		for (uint32_t f = 0; f < familyCount; f++)
+		{
+			if (requestEdges[r][f] == SIZE_MAX)
+				continue;
+
+			uint32_t count = graph.Flow(firstRequest + r, requestEdges[r][f]);
+			if (count == 0)
+				continue;
+
+			indices.Families.push_back(f);
+			indices.FirstIndex.push_back(familyUsage[f]);
+			indices.Count.push_back(count);
+			indices.FamilyCount++;
+			familyUsage[f] += count;
+		}
+
+		if (pQueueIndices)
+			(*pQueueIndices)[r] = std::move(indices);
+	}
+
+	if (pFamilyUsage)
+		*pFamilyUsage = std::move(familyUsage);
+
+	return assigned == totalDesired;
+}
+
+void PrintQueueLayout(const std::vector<VkQueueFamilyProperties>& families, const std::vector<QueueIndices>& queueIndices)
+{
+	printf("Queue layout:\n");
+	for (size_t r = 0; r < queueIndices.size(); r++)
+	{
+		const QueueIndices& indices = queueIndices[r];
+		printf("\t- request[%zu] (G:%d C:%d T:%d):\n", r,
+			(indices.Types & VK_QUEUE_GRAPHICS_BIT) != 0,
+			(indices.Types & VK_QUEUE_COMPUTE_BIT) != 0,
+			(indices.Types & VK_QUEUE_TRANSFER_BIT) != 0);
+
+		for (uint32_t i = 0; i < indices.FamilyCount; i++)
+		{
+			VkQueueFlags flags = families[indices.Families[i]].queueFlags;
+			printf("\t\tfamily[%u] (G:%d C:%d T:%d) queues [%u, %u)\n", indices.Families[i],
+				(flags & VK_QUEUE_GRAPHICS_BIT) != 0,
+				(flags & VK_QUEUE_COMPUTE_BIT) != 0,
+				(flags & VK_QUEUE_TRANSFER_BIT) != 0,
+				indices.FirstIndex[i], indices.FirstIndex[i] + indices.Count[i]);
+		}
+	}
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "../Loader/Loader.h"
+
+#include <optional>
+#include <vector>
+
+struct QueueType
+{
+	VkQueueFlags Types;
+	uint32_t Count;
+
+	/// <summary>
+	/// Queue priority in [0, 1] passed to the device. Also decides which request gets
+	/// its best matching family when requests compete for the same family
+	/// </summary>
+	float Priority = 1.0f;
+
+	/// <summary>
+	/// System wide priority through VK_KHR_global_priority or VK_EXT_global_priority.
+	/// Applies to the whole family the queues end up on, ignored when the device supports neither
+	/// </summary>
+	std::optional<VkQueueGlobalPriorityKHR> GlobalPriority = {};
+};
+
+struct QueueIndices
+{
+	VkQueueFlags Types;
+	uint32_t FamilyCount;
+	std::vector<uint32_t> Families;
+	std::vector<uint32_t> FirstIndex;
+	std::vector<uint32_t> Count;
+};
+
+/// <summary>
+/// Assigns all desired queues to families at once as a min-cost flow problem.
+/// A family costs more the more capabilities it has that a request did not ask for, so async compute
+/// and transfer requests end up on dedicated families when those exist.
+/// Returns false when not every desired queue could be assigned.
+/// </summary>
+/// <param name="pFamilyUsage">Amount of queues used per family</param>
+bool SolveQueueAssignment(const std::vector<VkQueueFamilyProperties>& families,
+	const std::vector<QueueType>& desiredQueues,
+	std::vector<QueueIndices>* pQueueIndices = nullptr,
+	std::vector<uint32_t>* pFamilyUsage = nullptr);
+
+/// <summary>
+/// Prints on which families and indices each desired queue type ended up
+/// </summary>
+void PrintQueueLayout(const std::vector<VkQueueFamilyProperties>& families, const std::vector<QueueIndices>& queueIndices);
@@ -0,0 +1,168 @@
+#include "DamageTracker.h"
+
+#include <algorithm>
+
+#undef max
+#undef min
+
+namespace
+{
+	bool IsEmpty(const VkRect2D& rect) { return rect.extent.width == 0 || rect.extent.height == 0; }
+
+	bool Contains(const VkRect2D& outer, const VkRect2D& inner)
+	{
+		return inner.offset.x >= outer.offset.x && inner.offset.y >= outer.offset.y
+			&& inner.offset.x + static_cast<int64_t>(inner.extent.width) <= outer.offset.x + static_cast<int64_t>(outer.extent.width)
+			&& inner.offset.y + static_cast<int64_t>(inner.extent.height) <= outer.offset.y + static_cast<int64_t>(outer.extent.height);
+	}
+
+	bool Overlaps(const VkRect2D& a, const VkRect2D& b)
+	{
+		return a.offset.x < b.offset.x + static_cast<int64_t>(b.extent.width) && b.offset.x < a.offset.x + static_cast<int64_t>(a.extent.width)
+			&& a.offset.y < b.offset.y + static_cast<int64_t>(b.extent.height) && b.offset.y < a.offset.y + static_cast<int64_t>(a.extent.height);
+	}
+
+	VkRect2D Union(const VkRect2D& a, const VkRect2D& b)
+	{
+		int32_t left = std::min(a.offset.x, b.offset.x);
+		int32_t top = std::min(a.offset.y, b.offset.y);
+		int64_t right = std::max(a.offset.x + static_cast<int64_t>(a.extent.width), b.offset.x + static_cast<int64_t>(b.extent.width));
+		int64_t bottom = std::max(a.offset.y + static_cast<int64_t>(a.extent.height), b.offset.y + static_cast<int64_t>(b.extent.height));
+		return { { left, top }, { static_cast<uint32_t>(right - left), static_cast<uint32_t>(bottom - top) } };
+	}
+}
+
+void DamageTracker::Reset(uint32_t imageCount, VkExtent2D extent)
+{
+	m_Extent = extent;
+	m_ImageLastFrame.assign(imageCount, UINT64_MAX);
+	m_History.clear();
+	m_CurrentDamage.clear();
+	m_ImageDamage.clear();
+	m_RenderArea = {};
+}
+
+void DamageTracker::AddDamage(const VkRect2D& rect)
+{
+	VkRect2D clamped = Clamp(rect);
+	if (!IsEmpty(clamped))
+		Merge(m_CurrentDamage, clamped);
+}
+
+void DamageTracker::AddFullDamage()
+{
+	m_CurrentDamage.assign(1, FullRect());
+}
+
+void DamageTracker::BeginFrame(uint32_t imageIndex)
+{
+	m_ImageIndex = imageIndex;
+	m_ImageDamage = m_CurrentDamage;
+
+	uint64_t lastFrame = imageIndex < m_ImageLastFrame.size() ? m_ImageLastFrame[imageIndex] : UINT64_MAX;
+	uint64_t oldestKnownFrame = m_FrameIndex - m_History.size();
+
+	if (lastFrame == UINT64_MAX || lastFrame + 1 < oldestKnownFrame)
+	{
+		// Undefined contents or damage older than the history, everything has to be redrawn
+		m_ImageDamage.assign(1, FullRect());
+	}
+	else
+	{
+		// Everything that changed after this image was last drawn
+		for (uint64_t frame = lastFrame + 1; frame < m_FrameIndex; frame++)
+		{
+			for (const VkRect2D& rect : m_History[static_cast<size_t>(frame - oldestKnownFrame)])
+				Merge(m_ImageDamage, rect);
+		}
+	}
+
+	m_RenderArea = {};
+	for (size_t i = 0; i < m_ImageDamage.size(); i++)
+		m_RenderArea = i == 0 ? m_ImageDamage[i] : Union(m_RenderArea, m_ImageDamage[i]);
+}
+
+const void* DamageTracker::ChainPresentRegions(VkPresentRegionsKHR& regions, VkPresentRegionKHR& region, const void* pNext)
+{
+	if (!m_IncrementalPresent)
+		return pNext;
+
+	// Relative to the previously presented image, which is exactly the damage of this frame.
+	// Zero rectangles tells the presentation engine the whole image changed
+	m_PresentRects.clear();
+	for (const VkRect2D& rect : m_CurrentDamage)
+		m_PresentRects.push_back({ rect.offset, rect.extent, 0 });
+
+	region = {};
+	region.rectangleCount = static_cast<uint32_t>(m_PresentRects.size());
+	region.pRectangles = m_PresentRects.empty() ? nullptr : m_PresentRects.data();
+
+	regions = {};
+	regions.sType = VK_STRUCTURE_TYPE_PRESENT_REGIONS_KHR;
+	regions.pNext = pNext;
+	regions.swapchainCount = 1;
+	regions.pRegions = &region;
+	return &regions;
+}
+
+void DamageTracker::EndFrame()
+{
+	if (m_ImageIndex < m_ImageLastFrame.size())
+		m_ImageLastFrame[m_ImageIndex] = m_FrameIndex;
+
+	// Images are normally reacquired within imageCount frames, keep some slack for irregular acquire orders
+	m_History.push_back(std::move(m_CurrentDamage));
+	size_t maxHistory = m_ImageLastFrame.size() * 2 + 1;
+	if (m_History.size() > maxHistory)
+		m_History.erase(m_History.begin(), m_History.begin() + (m_History.size() - maxHistory));
+
+	m_CurrentDamage.clear();
+	m_FrameIndex++;
+}
+
+/*static*/void DamageTracker::Merge(std::vector<VkRect2D>& rects, const VkRect2D& rect)
+{
+	VkRect2D merged = rect;
+
+	// Overlapping rectangles are replaced by their union, which may overlap further rectangles
+	bool changed = true;
+	while (changed)
+	{
+		changed = false;
+		for (size_t i = 0; i < rects.size(); i++)
+		{
+			if (Contains(rects[i], merged))
+				return;
+
+			if (Overlaps(rects[i], merged))
+			{
+				merged = Union(rects[i], merged);
+				rects.erase(rects.begin() + i);
+				changed = true;
+				break;
+			}
+		}
+	}
+
+	rects.push_back(merged);
+
+	if (rects.size() > MAX_RECTS)
+	{
+		VkRect2D bounds = rects[0];
+		for (const VkRect2D& r : rects)
+			bounds = Union(bounds, r);
+		rects.assign(1, bounds);
+	}
+}
+
+VkRect2D DamageTracker::Clamp(const VkRect2D& rect) const
+{
+	int64_t left = std::max<int64_t>(rect.offset.x, 0);
+	int64_t top = std::max<int64_t>(rect.offset.y, 0);
+	int64_t right = std::min<int64_t>(rect.offset.x + static_cast<int64_t>(rect.extent.width), m_Extent.width);
+	int64_t bottom = std::min<int64_t>(rect.offset.y + static_cast<int64_t>(rect.extent.height), m_Extent.height);
+
+	if (right <= left || bottom <= top)
+		return {};
+	return { { static_cast<int32_t>(left), static_cast<int32_t>(top) }, { static_cast<uint32_t>(right - left), static_cast<uint32_t>(bottom - top) } };
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "../Loader/Loader.h"
+
+#include <vector>
+
+/// <summary>
+/// Collects the regions of the surface that changed this frame. Turns them into the render area and scissor of
+/// the acquired swapchain image, and into VkPresentRegionsKHR when VK_KHR_incremental_present is enabled.
+///
+/// Swapchain images rotate, so an acquired image misses the damage of every frame since it was last drawn.
+/// That damage is accumulated per image. Restricting rendering only keeps the image correct when the
+/// render pass loads the previous contents (VK_ATTACHMENT_LOAD_OP_LOAD, no transition from UNDEFINED)
+/// </summary>
+class DamageTracker
+{
+public:
+	/// <summary>
+	/// Above this amount of rectangles the damage collapses into its bounding box
+	/// </summary>
+	static const uint32_t MAX_RECTS = 16;
+
+	void SetIncrementalPresent(bool enabled) { m_IncrementalPresent = enabled; }
+	bool UsesIncrementalPresent() const { return m_IncrementalPresent; }
+
+	/// <summary>
+	/// Call after (re)creating the swapchain, every image is fully damaged afterwards
+	/// </summary>
+	void Reset(uint32_t imageCount, VkExtent2D extent);
+
+	/// <summary>
+	/// Reports a changed region of the current frame
+	/// </summary>
+	void AddDamage(const VkRect2D& rect);
+	void AddFullDamage();
+	bool HasDamage() const { return !m_CurrentDamage.empty(); }
+
+	/// <summary>
+	/// Computes the area of the acquired image that has to be redrawn.
+	/// Call once after acquiring, when all damage of the frame has been reported
+	/// </summary>
+	void BeginFrame(uint32_t imageIndex);
+
+	/// <summary>
+	/// Bounding box of everything that is outdated in the acquired image. Use as render area and scissor
+	/// </summary>
+	VkRect2D GetRenderArea() const { return m_RenderArea; }
+	/// <summary>
+	/// Individual outdated rectangles of the acquired image, for clients that can use several scissors
+	/// </summary>
+	const std::vector<VkRect2D>& GetImageDamage() const { return m_ImageDamage; }
+
+	/// <summary>
+	/// Chains the damage of this frame into the present info when incremental present is enabled,
+	/// otherwise returns pNext unchanged. The structs must outlive vkQueuePresentKHR
+	/// </summary>
+	const void* ChainPresentRegions(VkPresentRegionsKHR& regions, VkPresentRegionKHR& region, const void* pNext);
+
+	/// <summary>
+	/// Call after presenting, moves the damage of this frame into the history
+	/// </summary>
+	void EndFrame();
+
+private:
+	static void Merge(std::vector<VkRect2D>& rects, const VkRect2D& rect);
+	VkRect2D Clamp(const VkRect2D& rect) const;
+	VkRect2D FullRect() const { return { { 0, 0 }, m_Extent }; }
+
+private:
+	bool m_IncrementalPresent = false;
+	VkExtent2D m_Extent = {};
+
+	uint64_t m_FrameIndex = 0;
+	uint32_t m_ImageIndex = 0;
+	// Frame each image was last drawn in, UINT64_MAX for images with undefined contents
+	std::vector<uint64_t> m_ImageLastFrame = {};
+	// Damage of previous frames, m_History[i] belongs to frame m_FrameIndex - m_History.size() + i
+	std::vector<std::vector<VkRect2D>> m_History = {};
+
+	std::vector<VkRect2D> m_CurrentDamage = {};
+	std::vector<VkRect2D> m_ImageDamage = {};
+	VkRect2D m_RenderArea = {};
+	std::vector<VkRectLayerKHR> m_PresentRects = {};
+};
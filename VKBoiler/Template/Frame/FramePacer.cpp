@@ -0,0 +1,144 @@
+#include "FramePacer.h"
+
+#include <thread>
+
+namespace
+{
+	// Timeout on present and fence waits, a stalled display should not hang the app forever
+	const uint64_t WAIT_TIMEOUT_NS = 1000000000ull;
+	// Part of a sleep that is spun instead of slept, OS timers tend to oversleep by up to this much
+	const double SPIN_THRESHOLD_SECONDS = 0.001;
+}
+
+FramePacer::~FramePacer()
+{
+	Destroy();
+}
+
+void FramePacer::Init(VkDevice device, bool presentWaitEnabled, double targetFrameRate, uint32_t maxQueuedFrames)
+{
+	m_Device = device;
+	m_PresentWait = presentWaitEnabled;
+	m_TargetFrameRate = targetFrameRate;
+	m_MaxQueuedFrames = maxQueuedFrames > 0 ? maxQueuedFrames : 1;
+	m_FrameFences.assign(m_MaxQueuedFrames, VK_NULL_HANDLE);
+	m_FrameStart = std::chrono::steady_clock::now();
+
+	// High resolution timers exist since Windows 10 1803, older systems get a regular one
+	m_Timer = CreateWaitableTimerExA(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+	if (m_Timer == NULL)
+		m_Timer = CreateWaitableTimerExA(NULL, NULL, 0, TIMER_ALL_ACCESS);
+}
+
+void FramePacer::Destroy()
+{
+	if (m_Timer != NULL)
+		CloseHandle(m_Timer);
+	m_Timer = NULL;
+	m_Device = VK_NULL_HANDLE;
+	m_FrameFences.clear();
+}
+
+void FramePacer::WaitForFrameStart()
+{
+	if (m_Device == VK_NULL_HANDLE)
+		return;
+
+	// Bound the amount of frames queued ahead of the display
+	bool waitedOnPresent = false;
+	if (m_PresentWait && m_Swapchain != VK_NULL_HANDLE && m_PresentId >= m_MaxQueuedFrames)
+	{
+		// Out of date and surface lost results are handled by the client on its next present
+		VkResult result = vkWaitForPresentKHR(m_Device, m_Swapchain, m_PresentId - m_MaxQueuedFrames + 1, WAIT_TIMEOUT_NS);
+		waitedOnPresent = result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR;
+	}
+	else if (!m_FrameFences.empty())
+	{
+		VkFence& fence = m_FrameFences[m_FrameIndex % m_MaxQueuedFrames];
+		if (fence != VK_NULL_HANDLE)
+			vkWaitForFences(m_Device, 1, &fence, VK_TRUE, WAIT_TIMEOUT_NS);
+		fence = VK_NULL_HANDLE;
+	}
+
+	auto now = std::chrono::steady_clock::now();
+	auto deadline = now;
+
+	if (m_TargetFrameRate > 0.0)
+	{
+		auto interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / m_TargetFrameRate));
+
+		// Never start frames faster than the target rate
+		deadline = m_FrameStart + interval;
+
+		// The frame the present wait returned for is on screen now, the next display slot is one interval away.
+		// Start as late as possible while leaving room for the measured CPU time plus some margin
+		if (waitedOnPresent && m_MaxQueuedFrames == 1)
+		{
+			double margin = 0.001 + m_CpuFrameTime * 0.1;
+			auto lateStart = now + interval - std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(m_CpuFrameTime + margin));
+			if (lateStart > deadline)
+				deadline = lateStart;
+		}
+	}
+
+	if (deadline > now)
+		SleepUntil(deadline);
+
+	m_FrameStart = std::chrono::steady_clock::now();
+	m_FrameIndex++;
+}
+
+const void* FramePacer::ChainPresentId(VkSwapchainKHR swapchain, VkPresentIdKHR& presentId, const void* pNext)
+{
+	// Ids are per swapchain, start over when it was recreated
+	if (swapchain != m_Swapchain)
+	{
+		m_Swapchain = swapchain;
+		m_PresentId = 0;
+	}
+
+	if (!m_PresentWait)
+		return pNext;
+
+	m_PresentId++;
+	presentId = {};
+	presentId.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+	presentId.pNext = pNext;
+	presentId.swapchainCount = 1;
+	presentId.pPresentIds = &m_PresentId;
+	return &presentId;
+}
+
+void FramePacer::OnFrameSubmitted(VkFence fence)
+{
+	double cpuTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_FrameStart).count();
+	m_CpuFrameTime = m_CpuFrameTime == 0.0 ? cpuTime : m_CpuFrameTime * 0.9 + cpuTime * 0.1;
+
+	// m_FrameIndex was already advanced when this frame started
+	if (!m_FrameFences.empty() && m_FrameIndex > 0)
+		m_FrameFences[(m_FrameIndex - 1) % m_MaxQueuedFrames] = fence;
+}
+
+void FramePacer::SleepUntil(std::chrono::steady_clock::time_point deadline)
+{
+	double remaining = std::chrono::duration<double>(deadline - std::chrono::steady_clock::now()).count();
+	if (remaining > SPIN_THRESHOLD_SECONDS)
+	{
+		double sleepSeconds = remaining - SPIN_THRESHOLD_SECONDS;
+		if (m_Timer != NULL)
+		{
+			// Negative due time is relative, in 100ns units
+			LARGE_INTEGER dueTime{};
+			dueTime.QuadPart = -static_cast<long long>(sleepSeconds * 1e7);
+			if (SetWaitableTimer(m_Timer, &dueTime, 0, NULL, NULL, FALSE))
+				WaitForSingleObject(m_Timer, INFINITE);
+		}
+		else
+		{
+			Sleep(static_cast<DWORD>(sleepSeconds * 1000.0));
+		}
+	}
+
+	while (std::chrono::steady_clock::now() < deadline)
+		std::this_thread::yield();
+}
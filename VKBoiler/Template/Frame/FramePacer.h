@@ -0,0 +1,75 @@
+#pragma once
+
+#include "../Loader/Loader.h"
+
+#include <chrono>
+#include <vector>
+
+/// <summary>
+/// Bounds the amount of frames queued ahead of the display and sleeps until the latest moment a frame
+/// can be started while still making its deadline. Uses VK_KHR_present_id and VK_KHR_present_wait
+/// when enabled, otherwise throttles on the fences of submitted frames.
+///
+/// Per frame usage from the client: chain ChainPresentId into VkPresentInfoKHR and call
+/// OnFrameSubmitted with the fence of the frame's last submit. The base loop calls WaitForFrameStart
+/// </summary>
+class FramePacer
+{
+public:
+	FramePacer() = default;
+	~FramePacer();
+
+	FramePacer(const FramePacer&) = delete;
+	FramePacer& operator=(const FramePacer&) = delete;
+
+	/// <summary>
+	/// targetFrameRate of 0 leaves the frame rate uncapped, only the queue depth is bounded then
+	/// </summary>
+	void Init(VkDevice device, bool presentWaitEnabled, double targetFrameRate, uint32_t maxQueuedFrames);
+	void Destroy();
+
+	/// <summary>
+	/// Blocks until the next frame should be started
+	/// </summary>
+	void WaitForFrameStart();
+
+	/// <summary>
+	/// Fills presentId with the id of this frame and chains it in front of pNext.
+	/// Returns pNext unchanged when present ids are not enabled
+	/// </summary>
+	const void* ChainPresentId(VkSwapchainKHR swapchain, VkPresentIdKHR& presentId, const void* pNext);
+
+	/// <summary>
+	/// Fence signalled by the last submit of the frame, used as throttle when present wait is not available.
+	/// The fence must not be reset before the pacer waited on it, which is at the start of frame + maxQueuedFrames
+	/// </summary>
+	void OnFrameSubmitted(VkFence fence);
+
+	bool UsesPresentWait() const { return m_PresentWait; }
+	double GetTargetFrameRate() const { return m_TargetFrameRate; }
+	void SetTargetFrameRate(double targetFrameRate) { m_TargetFrameRate = targetFrameRate; }
+
+	/// <summary>
+	/// Smoothed CPU time from frame start until submit in seconds
+	/// </summary>
+	double GetCpuFrameTime() const { return m_CpuFrameTime; }
+
+private:
+	void SleepUntil(std::chrono::steady_clock::time_point deadline);
+
+private:
+	VkDevice m_Device = VK_NULL_HANDLE;
+	bool m_PresentWait = false;
+	double m_TargetFrameRate = 0.0;
+	uint32_t m_MaxQueuedFrames = 2;
+
+	VkSwapchainKHR m_Swapchain = VK_NULL_HANDLE;
+	uint64_t m_FrameIndex = 0;
+	uint64_t m_PresentId = 0;
+	std::vector<VkFence> m_FrameFences = {};
+
+	std::chrono::steady_clock::time_point m_FrameStart = {};
+	double m_CpuFrameTime = 0.0;
+
+	HANDLE m_Timer = NULL;
+};
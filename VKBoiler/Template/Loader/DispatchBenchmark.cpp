@@ -0,0 +1,85 @@
+#include "DispatchBenchmark.h"
+
+#include <chrono>
+#include <stdio.h>
+
+namespace
+{
+	double RecordCommands(const DeviceDispatchTable& table, VkDevice device, VkCommandPool pool, VkCommandBuffer cmd, uint32_t commandCount)
+	{
+		const uint32_t RUNS = 5;
+
+		// Cheapest command that is valid on every queue and needs no resources
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+		double best = 0.0;
+		for (uint32_t run = 0; run < RUNS; run++)
+		{
+			table.vkResetCommandPool(device, pool, 0);
+
+			auto start = std::chrono::high_resolution_clock::now();
+			table.vkBeginCommandBuffer(cmd, &beginInfo);
+			for (uint32_t i = 0; i < commandCount; i++)
+				table.vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+			table.vkEndCommandBuffer(cmd);
+			auto end = std::chrono::high_resolution_clock::now();
+
+			double ns = std::chrono::duration<double, std::nano>(end - start).count();
+			if (run == 0 || ns < best)
+				best = ns;
+		}
+
+		return best / static_cast<double>(commandCount);
+	}
+}
+
+bool BenchmarkDeviceDispatch(VkInstance instance, VkDevice device, uint32_t queueFamily, uint32_t commandCount, DispatchBenchmarkResult* pResult)
+{
+	DeviceDispatchTable trampolines{};
+	DeviceDispatchTable direct{};
+	LoadTrampolineDispatchTable(instance, &trampolines);
+	LoadDeviceDispatchTable(device, &direct);
+
+	VkCommandPoolCreateInfo poolCi{};
+	poolCi.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolCi.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+	poolCi.queueFamilyIndex = queueFamily;
+
+	VkCommandPool pool = VK_NULL_HANDLE;
+	if (direct.vkCreateCommandPool(device, &poolCi, nullptr, &pool) != VK_SUCCESS)
+		return false;
+
+	VkCommandBufferAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.commandPool = pool;
+	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocInfo.commandBufferCount = 1;
+
+	VkCommandBuffer cmd = VK_NULL_HANDLE;
+	if (direct.vkAllocateCommandBuffers(device, &allocInfo, &cmd) != VK_SUCCESS)
+	{
+		direct.vkDestroyCommandPool(device, pool, nullptr);
+		return false;
+	}
+
+	// Interleaved so neither path profits from a warmer cache
+	pResult->TrampolineNsPerCommand = RecordCommands(trampolines, device, pool, cmd, commandCount);
+	pResult->DirectNsPerCommand = RecordCommands(direct, device, pool, cmd, commandCount);
+	double trampoline = RecordCommands(trampolines, device, pool, cmd, commandCount);
+	double directNs = RecordCommands(direct, device, pool, cmd, commandCount);
+	pResult->TrampolineNsPerCommand = trampoline < pResult->TrampolineNsPerCommand ? trampoline : pResult->TrampolineNsPerCommand;
+	pResult->DirectNsPerCommand = directNs < pResult->DirectNsPerCommand ? directNs : pResult->DirectNsPerCommand;
+
+	direct.vkDestroyCommandPool(device, pool, nullptr);
+
+	printf("Dispatch benchmark (%u commands): trampoline %.2f ns/cmd, direct %.2f ns/cmd\n",
+		commandCount, pResult->TrampolineNsPerCommand, pResult->DirectNsPerCommand);
+	return true;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "Loader.h"
+
+struct DispatchBenchmarkResult
+{
+	double TrampolineNsPerCommand = 0.0;
+	double DirectNsPerCommand = 0.0;
+};
+
+/// <summary>
+/// Records the same command heavy command buffer through the loader trampolines and through
+/// the device dispatch table and reports the recording cost per command of both.
+/// The fastest of a few runs is reported to filter out scheduling noise.
+/// No reference numbers are recorded here, results depend on the driver and must be measured on the target machine
+/// </summary>
+bool BenchmarkDeviceDispatch(VkInstance instance, VkDevice device, uint32_t queueFamily, uint32_t commandCount, DispatchBenchmarkResult* pResult);
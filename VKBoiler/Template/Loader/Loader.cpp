@@ -0,0 +1,77 @@
+#include "Loader.h"
+
+#include <stdio.h>
+
+#define VKB_DEFINE_FUNCTION(name) PFN_##name name = nullptr;
+PFN_vkGetInstanceProcAddr vkGetInstanceProcAddr = nullptr;
+VKB_GLOBAL_FUNCTIONS(VKB_DEFINE_FUNCTION)
+VKB_INSTANCE_FUNCTIONS(VKB_DEFINE_FUNCTION)
+VKB_DEVICE_FUNCTIONS(VKB_DEFINE_FUNCTION)
+#undef VKB_DEFINE_FUNCTION
+
+static HMODULE s_VulkanLibrary = NULL;
+
+bool InitializeLoader()
+{
+	if (s_VulkanLibrary != NULL)
+		return true;
+
+	s_VulkanLibrary = LoadLibraryA("vulkan-1.dll");
+	if (s_VulkanLibrary == NULL)
+	{
+		printf("Failed to load vulkan-1.dll!\n");
+		return false;
+	}
+
+	vkGetInstanceProcAddr = reinterpret_cast<PFN_vkGetInstanceProcAddr>(
+		reinterpret_cast<void(*)()>(GetProcAddress(s_VulkanLibrary, "vkGetInstanceProcAddr")));
+	if (vkGetInstanceProcAddr == nullptr)
+	{
+		printf("vulkan-1.dll does not export vkGetInstanceProcAddr!\n");
+		ShutdownLoader();
+		return false;
+	}
+
+#define VKB_LOAD_GLOBAL(name) name = reinterpret_cast<PFN_##name>(vkGetInstanceProcAddr(VK_NULL_HANDLE, #name));
+	VKB_GLOBAL_FUNCTIONS(VKB_LOAD_GLOBAL)
+#undef VKB_LOAD_GLOBAL
+
+	return true;
+}
+
+void ShutdownLoader()
+{
+	if (s_VulkanLibrary != NULL)
+		FreeLibrary(s_VulkanLibrary);
+	s_VulkanLibrary = NULL;
+	vkGetInstanceProcAddr = nullptr;
+}
+
+void LoadInstanceFunctions(VkInstance instance)
+{
+#define VKB_LOAD_INSTANCE(name) name = reinterpret_cast<PFN_##name>(vkGetInstanceProcAddr(instance, #name));
+	VKB_INSTANCE_FUNCTIONS(VKB_LOAD_INSTANCE)
+	VKB_DEVICE_FUNCTIONS(VKB_LOAD_INSTANCE)
+#undef VKB_LOAD_INSTANCE
+}
+
+void LoadDeviceFunctions(VkDevice device)
+{
+#define VKB_LOAD_DEVICE(name) name = reinterpret_cast<PFN_##name>(vkGetDeviceProcAddr(device, #name));
+	VKB_DEVICE_FUNCTIONS(VKB_LOAD_DEVICE)
+#undef VKB_LOAD_DEVICE
+}
+
+void LoadDeviceDispatchTable(VkDevice device, DeviceDispatchTable* pTable)
+{
+#define VKB_LOAD_MEMBER(name) pTable->name = reinterpret_cast<PFN_##name>(vkGetDeviceProcAddr(device, #name));
+	VKB_DEVICE_FUNCTIONS(VKB_LOAD_MEMBER)
+#undef VKB_LOAD_MEMBER
+}
+
+void LoadTrampolineDispatchTable(VkInstance instance, DeviceDispatchTable* pTable)
+{
+#define VKB_LOAD_MEMBER(name) pTable->name = reinterpret_cast<PFN_##name>(vkGetInstanceProcAddr(instance, #name));
+	VKB_DEVICE_FUNCTIONS(VKB_LOAD_MEMBER)
+#undef VKB_LOAD_MEMBER
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+// The template does not link against vulkan-1.lib, every entrypoint is resolved at runtime.
+// Include this header instead of vulkan/vulkan.h
+#ifndef VK_NO_PROTOTYPES
+#define VK_NO_PROTOTYPES
+#endif
+
+#include <vulkan/vulkan.h>
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <Windows.h>
+#include <vulkan/vulkan_win32.h>
+#include "VulkanCompat.h"
+
+#include "LoaderFunctions.h"
+
+#define VKB_DECLARE_FUNCTION(name) extern PFN_##name name;
+extern PFN_vkGetInstanceProcAddr vkGetInstanceProcAddr;
+VKB_GLOBAL_FUNCTIONS(VKB_DECLARE_FUNCTION)
+VKB_INSTANCE_FUNCTIONS(VKB_DECLARE_FUNCTION)
+VKB_DEVICE_FUNCTIONS(VKB_DECLARE_FUNCTION)
+#undef VKB_DECLARE_FUNCTION
+
+/// <summary>
+/// Device level function pointers of a single device. Calls through this table skip the
+/// loader trampoline and dispatch straight into the driver
+/// </summary>
+struct DeviceDispatchTable
+{
+#define VKB_DECLARE_MEMBER(name) PFN_##name name = nullptr;
+	VKB_DEVICE_FUNCTIONS(VKB_DECLARE_MEMBER)
+#undef VKB_DECLARE_MEMBER
+};
+
+/// <summary>
+/// Opens the vulkan runtime library and loads the global functions. Must be called before anything else
+/// </summary>
+bool InitializeLoader();
+/// <summary>
+/// Closes the vulkan runtime library, all function pointers are invalid afterwards
+/// </summary>
+void ShutdownLoader();
+
+/// <summary>
+/// Loads instance functions and device functions through vkGetInstanceProcAddr.
+/// Device functions loaded this way go through the loader trampoline and work for every device
+/// </summary>
+void LoadInstanceFunctions(VkInstance instance);
+/// <summary>
+/// Reloads the global device functions through vkGetDeviceProcAddr, only valid for this device from then on
+/// </summary>
+void LoadDeviceFunctions(VkDevice device);
+
+/// <summary>
+/// Fills a dispatch table with the functions of the given device
+/// </summary>
+void LoadDeviceDispatchTable(VkDevice device, DeviceDispatchTable* pTable);
+/// <summary>
+/// Fills a dispatch table with the trampolines the loader exports for device functions
+/// </summary>
+void LoadTrampolineDispatchTable(VkInstance instance, DeviceDispatchTable* pTable);
@@ -0,0 +1,331 @@
+#pragma once
+
+// X-macro lists of every function the loader resolves, grouped by the object used to load them.
+// Extension functions resolve to nullptr when the extension is not enabled.
+
+// Loaded through vkGetInstanceProcAddr without an instance
+#define VKB_GLOBAL_FUNCTIONS(X) \
+	X(vkCreateInstance) \
+	X(vkEnumerateInstanceExtensionProperties) \
+	X(vkEnumerateInstanceLayerProperties) \
+	X(vkEnumerateInstanceVersion)
+
+// Instance level functions of VK_VERSION_1_0
+#define VKB_INSTANCE_FUNCTIONS_10(X) \
+	X(vkDestroyInstance) \
+	X(vkEnumeratePhysicalDevices) \
+	X(vkGetPhysicalDeviceFeatures) \
+	X(vkGetPhysicalDeviceFormatProperties) \
+	X(vkGetPhysicalDeviceImageFormatProperties) \
+	X(vkGetPhysicalDeviceProperties) \
+	X(vkGetPhysicalDeviceQueueFamilyProperties) \
+	X(vkGetPhysicalDeviceMemoryProperties) \
+	X(vkGetDeviceProcAddr) \
+	X(vkCreateDevice) \
+	X(vkEnumerateDeviceExtensionProperties) \
+	X(vkEnumerateDeviceLayerProperties) \
+	X(vkGetPhysicalDeviceSparseImageFormatProperties)
+
+// Instance level functions of VK_VERSION_1_1
+#define VKB_INSTANCE_FUNCTIONS_11(X) \
+	X(vkEnumeratePhysicalDeviceGroups) \
+	X(vkGetPhysicalDeviceFeatures2) \
+	X(vkGetPhysicalDeviceProperties2) \
+	X(vkGetPhysicalDeviceFormatProperties2) \
+	X(vkGetPhysicalDeviceImageFormatProperties2) \
+	X(vkGetPhysicalDeviceQueueFamilyProperties2) \
+	X(vkGetPhysicalDeviceMemoryProperties2) \
+	X(vkGetPhysicalDeviceSparseImageFormatProperties2) \
+	X(vkGetPhysicalDeviceExternalBufferProperties) \
+	X(vkGetPhysicalDeviceExternalFenceProperties) \
+	X(vkGetPhysicalDeviceExternalSemaphoreProperties)
+
+// Instance level functions of VK_VERSION_1_2
+#define VKB_INSTANCE_FUNCTIONS_12(X)
+
+// Instance level functions of VK_VERSION_1_3
+#define VKB_INSTANCE_FUNCTIONS_13(X) \
+	X(vkGetPhysicalDeviceToolProperties)
+
+// VK_KHR_surface
+#define VKB_INSTANCE_FUNCTIONS_KHR_SURFACE(X) \
+	X(vkDestroySurfaceKHR) \
+	X(vkGetPhysicalDeviceSurfaceSupportKHR) \
+	X(vkGetPhysicalDeviceSurfaceCapabilitiesKHR) \
+	X(vkGetPhysicalDeviceSurfaceFormatsKHR) \
+	X(vkGetPhysicalDeviceSurfacePresentModesKHR) \
+	X(vkGetPhysicalDevicePresentRectanglesKHR)
+
+// VK_KHR_win32_surface
+#define VKB_INSTANCE_FUNCTIONS_KHR_WIN32_SURFACE(X) \
+	X(vkCreateWin32SurfaceKHR) \
+	X(vkGetPhysicalDeviceWin32PresentationSupportKHR)
+
+// Device level functions of VK_VERSION_1_0
+#define VKB_DEVICE_FUNCTIONS_10(X) \
+	X(vkDestroyDevice) \
+	X(vkGetDeviceQueue) \
+	X(vkQueueSubmit) \
+	X(vkQueueWaitIdle) \
+	X(vkDeviceWaitIdle) \
+	X(vkAllocateMemory) \
+	X(vkFreeMemory) \
+	X(vkMapMemory) \
+	X(vkUnmapMemory) \
+	X(vkFlushMappedMemoryRanges) \
+	X(vkInvalidateMappedMemoryRanges) \
+	X(vkGetDeviceMemoryCommitment) \
+	X(vkBindBufferMemory) \
+	X(vkBindImageMemory) \
+	X(vkGetBufferMemoryRequirements) \
+	X(vkGetImageMemoryRequirements) \
+	X(vkGetImageSparseMemoryRequirements) \
+	X(vkQueueBindSparse) \
+	X(vkCreateFence) \
+	X(vkDestroyFence) \
+	X(vkResetFences) \
+	X(vkGetFenceStatus) \
+	X(vkWaitForFences) \
+	X(vkCreateSemaphore) \
+	X(vkDestroySemaphore) \
+	X(vkCreateEvent) \
+	X(vkDestroyEvent) \
+	X(vkGetEventStatus) \
+	X(vkSetEvent) \
+	X(vkResetEvent) \
+	X(vkCreateQueryPool) \
+	X(vkDestroyQueryPool) \
+	X(vkGetQueryPoolResults) \
+	X(vkCreateBuffer) \
+	X(vkDestroyBuffer) \
+	X(vkCreateBufferView) \
+	X(vkDestroyBufferView) \
+	X(vkCreateImage) \
+	X(vkDestroyImage) \
+	X(vkGetImageSubresourceLayout) \
+	X(vkCreateImageView) \
+	X(vkDestroyImageView) \
+	X(vkCreateShaderModule) \
+	X(vkDestroyShaderModule) \
+	X(vkCreatePipelineCache) \
+	X(vkDestroyPipelineCache) \
+	X(vkGetPipelineCacheData) \
+	X(vkMergePipelineCaches) \
+	X(vkCreateGraphicsPipelines) \
+	X(vkCreateComputePipelines) \
+	X(vkDestroyPipeline) \
+	X(vkCreatePipelineLayout) \
+	X(vkDestroyPipelineLayout) \
+	X(vkCreateSampler) \
+	X(vkDestroySampler) \
+	X(vkCreateDescriptorSetLayout) \
+	X(vkDestroyDescriptorSetLayout) \
+	X(vkCreateDescriptorPool) \
+	X(vkDestroyDescriptorPool) \
+	X(vkResetDescriptorPool) \
+	X(vkAllocateDescriptorSets) \
+	X(vkFreeDescriptorSets) \
+	X(vkUpdateDescriptorSets) \
+	X(vkCreateFramebuffer) \
+	X(vkDestroyFramebuffer) \
+	X(vkCreateRenderPass) \
+	X(vkDestroyRenderPass) \
+	X(vkGetRenderAreaGranularity) \
+	X(vkCreateCommandPool) \
+	X(vkDestroyCommandPool) \
+	X(vkResetCommandPool) \
+	X(vkAllocateCommandBuffers) \
+	X(vkFreeCommandBuffers) \
+	X(vkBeginCommandBuffer) \
+	X(vkEndCommandBuffer) \
+	X(vkResetCommandBuffer) \
+	X(vkCmdBindPipeline) \
+	X(vkCmdSetViewport) \
+	X(vkCmdSetScissor) \
+	X(vkCmdSetLineWidth) \
+	X(vkCmdSetDepthBias) \
+	X(vkCmdSetBlendConstants) \
+	X(vkCmdSetDepthBounds) \
+	X(vkCmdSetStencilCompareMask) \
+	X(vkCmdSetStencilWriteMask) \
+	X(vkCmdSetStencilReference) \
+	X(vkCmdBindDescriptorSets) \
+	X(vkCmdBindIndexBuffer) \
+	X(vkCmdBindVertexBuffers) \
+	X(vkCmdDraw) \
+	X(vkCmdDrawIndexed) \
+	X(vkCmdDrawIndirect) \
+	X(vkCmdDrawIndexedIndirect) \
+	X(vkCmdDispatch) \
+	X(vkCmdDispatchIndirect) \
+	X(vkCmdCopyBuffer) \
+	X(vkCmdCopyImage) \
+	X(vkCmdBlitImage) \
+	X(vkCmdCopyBufferToImage) \
+	X(vkCmdCopyImageToBuffer) \
+	X(vkCmdUpdateBuffer) \
+	X(vkCmdFillBuffer) \
+	X(vkCmdClearColorImage) \
+	X(vkCmdClearDepthStencilImage) \
+	X(vkCmdClearAttachments) \
+	X(vkCmdResolveImage) \
+	X(vkCmdSetEvent) \
+	X(vkCmdResetEvent) \
+	X(vkCmdWaitEvents) \
+	X(vkCmdPipelineBarrier) \
+	X(vkCmdBeginQuery) \
+	X(vkCmdEndQuery) \
+	X(vkCmdResetQueryPool) \
+	X(vkCmdWriteTimestamp) \
+	X(vkCmdCopyQueryPoolResults) \
+	X(vkCmdPushConstants) \
+	X(vkCmdBeginRenderPass) \
+	X(vkCmdNextSubpass) \
+	X(vkCmdEndRenderPass) \
+	X(vkCmdExecuteCommands)
+
+// Device level functions of VK_VERSION_1_1
+#define VKB_DEVICE_FUNCTIONS_11(X) \
+	X(vkBindBufferMemory2) \
+	X(vkBindImageMemory2) \
+	X(vkGetDeviceGroupPeerMemoryFeatures) \
+	X(vkCmdSetDeviceMask) \
+	X(vkCmdDispatchBase) \
+	X(vkGetImageMemoryRequirements2) \
+	X(vkGetBufferMemoryRequirements2) \
+	X(vkGetImageSparseMemoryRequirements2) \
+	X(vkTrimCommandPool) \
+	X(vkGetDeviceQueue2) \
+	X(vkCreateSamplerYcbcrConversion) \
+	X(vkDestroySamplerYcbcrConversion) \
+	X(vkCreateDescriptorUpdateTemplate) \
+	X(vkDestroyDescriptorUpdateTemplate) \
+	X(vkUpdateDescriptorSetWithTemplate) \
+	X(vkGetDescriptorSetLayoutSupport)
+
+// Device level functions of VK_VERSION_1_2
+#define VKB_DEVICE_FUNCTIONS_12(X) \
+	X(vkCmdDrawIndirectCount) \
+	X(vkCmdDrawIndexedIndirectCount) \
+	X(vkCreateRenderPass2) \
+	X(vkCmdBeginRenderPass2) \
+	X(vkCmdNextSubpass2) \
+	X(vkCmdEndRenderPass2) \
+	X(vkResetQueryPool) \
+	X(vkGetSemaphoreCounterValue) \
+	X(vkWaitSemaphores) \
+	X(vkSignalSemaphore) \
+	X(vkGetBufferDeviceAddress) \
+	X(vkGetBufferOpaqueCaptureAddress) \
+	X(vkGetDeviceMemoryOpaqueCaptureAddress)
+
+// Device level functions of VK_VERSION_1_3
+#define VKB_DEVICE_FUNCTIONS_13(X) \
+	X(vkCreatePrivateDataSlot) \
+	X(vkDestroyPrivateDataSlot) \
+	X(vkSetPrivateData) \
+	X(vkGetPrivateData) \
+	X(vkCmdSetEvent2) \
+	X(vkCmdResetEvent2) \
+	X(vkCmdWaitEvents2) \
+	X(vkCmdPipelineBarrier2) \
+	X(vkCmdWriteTimestamp2) \
+	X(vkQueueSubmit2) \
+	X(vkCmdCopyBuffer2) \
+	X(vkCmdCopyImage2) \
+	X(vkCmdCopyBufferToImage2) \
+	X(vkCmdCopyImageToBuffer2) \
+	X(vkCmdBlitImage2) \
+	X(vkCmdResolveImage2) \
+	X(vkCmdBeginRendering) \
+	X(vkCmdEndRendering) \
+	X(vkCmdSetCullMode) \
+	X(vkCmdSetFrontFace) \
+	X(vkCmdSetPrimitiveTopology) \
+	X(vkCmdSetViewportWithCount) \
+	X(vkCmdSetScissorWithCount) \
+	X(vkCmdBindVertexBuffers2) \
+	X(vkCmdSetDepthTestEnable) \
+	X(vkCmdSetDepthWriteEnable) \
+	X(vkCmdSetDepthCompareOp) \
+	X(vkCmdSetDepthBoundsTestEnable) \
+	X(vkCmdSetStencilTestEnable) \
+	X(vkCmdSetStencilOp) \
+	X(vkCmdSetRasterizerDiscardEnable) \
+	X(vkCmdSetDepthBiasEnable) \
+	X(vkCmdSetPrimitiveRestartEnable) \
+	X(vkGetDeviceBufferMemoryRequirements) \
+	X(vkGetDeviceImageMemoryRequirements) \
+	X(vkGetDeviceImageSparseMemoryRequirements)
+
+// VK_KHR_swapchain
+#define VKB_DEVICE_FUNCTIONS_KHR_SWAPCHAIN(X) \
+	X(vkCreateSwapchainKHR) \
+	X(vkDestroySwapchainKHR) \
+	X(vkGetSwapchainImagesKHR) \
+	X(vkAcquireNextImageKHR) \
+	X(vkQueuePresentKHR) \
+	X(vkGetDeviceGroupPresentCapabilitiesKHR) \
+	X(vkGetDeviceGroupSurfacePresentModesKHR) \
+	X(vkAcquireNextImage2KHR)
+
+// VK_KHR_present_wait
+#define VKB_DEVICE_FUNCTIONS_KHR_PRESENT_WAIT(X) \
+	X(vkWaitForPresentKHR)
+
+// VK_EXT_extended_dynamic_state2, the 1.3 core subset is in VKB_DEVICE_FUNCTIONS_13
+#define VKB_DEVICE_FUNCTIONS_EXT_EXTENDED_DYNAMIC_STATE_2(X) \
+	X(vkCmdSetPatchControlPointsEXT) \
+	X(vkCmdSetLogicOpEXT)
+
+// VK_EXT_extended_dynamic_state3
+#define VKB_DEVICE_FUNCTIONS_EXT_EXTENDED_DYNAMIC_STATE_3(X) \
+	X(vkCmdSetTessellationDomainOriginEXT) \
+	X(vkCmdSetDepthClampEnableEXT) \
+	X(vkCmdSetPolygonModeEXT) \
+	X(vkCmdSetRasterizationSamplesEXT) \
+	X(vkCmdSetSampleMaskEXT) \
+	X(vkCmdSetAlphaToCoverageEnableEXT) \
+	X(vkCmdSetAlphaToOneEnableEXT) \
+	X(vkCmdSetLogicOpEnableEXT) \
+	X(vkCmdSetColorBlendEnableEXT) \
+	X(vkCmdSetColorBlendEquationEXT) \
+	X(vkCmdSetColorWriteMaskEXT)
+
+// VK_EXT_vertex_input_dynamic_state
+#define VKB_DEVICE_FUNCTIONS_EXT_VERTEX_INPUT_DYNAMIC_STATE(X) \
+	X(vkCmdSetVertexInputEXT)
+
+// VK_EXT_shader_object, which also exposes every dynamic state command above
+#define VKB_DEVICE_FUNCTIONS_EXT_SHADER_OBJECT(X) \
+	X(vkCreateShadersEXT) \
+	X(vkDestroyShaderEXT) \
+	X(vkGetShaderBinaryDataEXT) \
+	X(vkCmdBindShadersEXT)
+
+// VK_EXT_mesh_shader
+#define VKB_DEVICE_FUNCTIONS_EXT_MESH_SHADER(X) \
+	X(vkCmdDrawMeshTasksEXT) \
+	X(vkCmdDrawMeshTasksIndirectEXT) \
+	X(vkCmdDrawMeshTasksIndirectCountEXT)
+
+#define VKB_INSTANCE_FUNCTIONS(X) \
+	VKB_INSTANCE_FUNCTIONS_10(X) \
+	VKB_INSTANCE_FUNCTIONS_11(X) \
+	VKB_INSTANCE_FUNCTIONS_12(X) \
+	VKB_INSTANCE_FUNCTIONS_13(X) \
+	VKB_INSTANCE_FUNCTIONS_KHR_SURFACE(X) \
+	VKB_INSTANCE_FUNCTIONS_KHR_WIN32_SURFACE(X)
+
+#define VKB_DEVICE_FUNCTIONS(X) \
+	VKB_DEVICE_FUNCTIONS_10(X) \
+	VKB_DEVICE_FUNCTIONS_11(X) \
+	VKB_DEVICE_FUNCTIONS_12(X) \
+	VKB_DEVICE_FUNCTIONS_13(X) \
+	VKB_DEVICE_FUNCTIONS_KHR_SWAPCHAIN(X) \
+	VKB_DEVICE_FUNCTIONS_KHR_PRESENT_WAIT(X) \
+	VKB_DEVICE_FUNCTIONS_EXT_EXTENDED_DYNAMIC_STATE_2(X) \
+	VKB_DEVICE_FUNCTIONS_EXT_EXTENDED_DYNAMIC_STATE_3(X) \
+	VKB_DEVICE_FUNCTIONS_EXT_VERTEX_INPUT_DYNAMIC_STATE(X) \
+	VKB_DEVICE_FUNCTIONS_EXT_SHADER_OBJECT(X) \
+	VKB_DEVICE_FUNCTIONS_EXT_MESH_SHADER(X)
@@ -0,0 +1,66 @@
+#pragma once
+
+// Declarations of extensions the vendored headers (1.3.231) predate, copied from newer vulkan_core.h.
+// Each block is skipped when the headers already declare the extension
+
+#ifndef VK_EXT_shader_object
+#define VK_EXT_shader_object 1
+VK_DEFINE_NON_DISPATCHABLE_HANDLE(VkShaderEXT)
+#define VK_EXT_SHADER_OBJECT_SPEC_VERSION 1
+#define VK_EXT_SHADER_OBJECT_EXTENSION_NAME "VK_EXT_shader_object"
+
+static const VkStructureType VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_OBJECT_FEATURES_EXT = static_cast<VkStructureType>(1000482000);
+static const VkStructureType VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_OBJECT_PROPERTIES_EXT = static_cast<VkStructureType>(1000482001);
+static const VkStructureType VK_STRUCTURE_TYPE_SHADER_CREATE_INFO_EXT = static_cast<VkStructureType>(1000482002);
+
+typedef enum VkShaderCodeTypeEXT {
+	VK_SHADER_CODE_TYPE_BINARY_EXT = 0,
+	VK_SHADER_CODE_TYPE_SPIRV_EXT = 1,
+	VK_SHADER_CODE_TYPE_MAX_ENUM_EXT = 0x7FFFFFFF
+} VkShaderCodeTypeEXT;
+
+typedef enum VkShaderCreateFlagBitsEXT {
+	VK_SHADER_CREATE_LINK_STAGE_BIT_EXT = 0x00000001,
+	VK_SHADER_CREATE_ALLOW_VARYING_SUBGROUP_SIZE_BIT_EXT = 0x00000002,
+	VK_SHADER_CREATE_REQUIRE_FULL_SUBGROUPS_BIT_EXT = 0x00000004,
+	VK_SHADER_CREATE_NO_TASK_SHADER_BIT_EXT = 0x00000008,
+	VK_SHADER_CREATE_DISPATCH_BASE_BIT_EXT = 0x00000010,
+	VK_SHADER_CREATE_FLAG_BITS_MAX_ENUM_EXT = 0x7FFFFFFF
+} VkShaderCreateFlagBitsEXT;
+typedef VkFlags VkShaderCreateFlagsEXT;
+
+typedef struct VkPhysicalDeviceShaderObjectFeaturesEXT {
+	VkStructureType sType;
+	void* pNext;
+	VkBool32 shaderObject;
+} VkPhysicalDeviceShaderObjectFeaturesEXT;
+
+typedef struct VkPhysicalDeviceShaderObjectPropertiesEXT {
+	VkStructureType sType;
+	void* pNext;
+	uint8_t shaderBinaryUUID[VK_UUID_SIZE];
+	uint32_t shaderBinaryVersion;
+} VkPhysicalDeviceShaderObjectPropertiesEXT;
+
+typedef struct VkShaderCreateInfoEXT {
+	VkStructureType sType;
+	const void* pNext;
+	VkShaderCreateFlagsEXT flags;
+	VkShaderStageFlagBits stage;
+	VkShaderStageFlags nextStage;
+	VkShaderCodeTypeEXT codeType;
+	size_t codeSize;
+	const void* pCode;
+	const char* pName;
+	uint32_t setLayoutCount;
+	const VkDescriptorSetLayout* pSetLayouts;
+	uint32_t pushConstantRangeCount;
+	const VkPushConstantRange* pPushConstantRanges;
+	const VkSpecializationInfo* pSpecializationInfo;
+} VkShaderCreateInfoEXT;
+
+typedef VkResult (VKAPI_PTR *PFN_vkCreateShadersEXT)(VkDevice device, uint32_t createInfoCount, const VkShaderCreateInfoEXT* pCreateInfos, const VkAllocationCallbacks* pAllocator, VkShaderEXT* pShaders);
+typedef void (VKAPI_PTR *PFN_vkDestroyShaderEXT)(VkDevice device, VkShaderEXT shader, const VkAllocationCallbacks* pAllocator);
+typedef VkResult (VKAPI_PTR *PFN_vkGetShaderBinaryDataEXT)(VkDevice device, VkShaderEXT shader, size_t* pDataSize, void* pData);
+typedef void (VKAPI_PTR *PFN_vkCmdBindShadersEXT)(VkCommandBuffer commandBuffer, uint32_t stageCount, const VkShaderStageFlagBits* pStages, const VkShaderEXT* pShaders);
+#endif
@@ -0,0 +1,93 @@
+#include "DeviceMemory.h"
+
+uint32_t FindMemoryType(const VkPhysicalDeviceMemoryProperties& memoryProperties, uint32_t typeBits,
+	VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred)
+{
+	uint32_t fallback = UINT32_MAX;
+	for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
+	{
+		VkMemoryPropertyFlags flags = memoryProperties.memoryTypes[i].propertyFlags;
+		if (!(typeBits & (1u << i)) || (flags & required) != required)
+			continue;
+
+		if ((flags & preferred) == preferred)
+			return i;
+		if (fallback == UINT32_MAX)
+			fallback = i;
+	}
+	return fallback;
+}
+
+bool CreateBuffer(VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProperties, const VkAllocationCallbacks* pAllocator,
+	VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred,
+	uint32_t firstFamily, uint32_t secondFamily, VkBuffer* pBuffer, VkDeviceMemory* pMemory)
+{
+	*pBuffer = VK_NULL_HANDLE;
+	*pMemory = VK_NULL_HANDLE;
+
+	uint32_t families[2] = { firstFamily, secondFamily };
+	VkBufferCreateInfo bufferCi{};
+	bufferCi.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferCi.size = size;
+	bufferCi.usage = usage;
+	bufferCi.sharingMode = firstFamily == secondFamily ? VK_SHARING_MODE_EXCLUSIVE : VK_SHARING_MODE_CONCURRENT;
+	bufferCi.queueFamilyIndexCount = firstFamily == secondFamily ? 0 : 2;
+	bufferCi.pQueueFamilyIndices = families;
+	if (vkCreateBuffer(device, &bufferCi, pAllocator, pBuffer) != VK_SUCCESS)
+	{
+		*pBuffer = VK_NULL_HANDLE;
+		return false;
+	}
+
+	VkMemoryRequirements requirements{};
+	vkGetBufferMemoryRequirements(device, *pBuffer, &requirements);
+
+	VkMemoryAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = requirements.size;
+	allocInfo.memoryTypeIndex = FindMemoryType(memoryProperties, requirements.memoryTypeBits, required, preferred);
+	if (allocInfo.memoryTypeIndex == UINT32_MAX
+		|| vkAllocateMemory(device, &allocInfo, pAllocator, pMemory) != VK_SUCCESS
+		|| vkBindBufferMemory(device, *pBuffer, *pMemory, 0) != VK_SUCCESS)
+	{
+		DestroyBuffer(device, pAllocator, *pBuffer, *pMemory);
+		return false;
+	}
+	return true;
+}
+
+bool AllocateImageMemory(VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProperties, const VkAllocationCallbacks* pAllocator,
+	VkImage image, VkDeviceMemory* pMemory)
+{
+	*pMemory = VK_NULL_HANDLE;
+
+	VkMemoryRequirements requirements{};
+	vkGetImageMemoryRequirements(device, image, &requirements);
+
+	VkMemoryAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = requirements.size;
+	allocInfo.memoryTypeIndex = FindMemoryType(memoryProperties, requirements.memoryTypeBits, 0, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	if (allocInfo.memoryTypeIndex == UINT32_MAX || vkAllocateMemory(device, &allocInfo, pAllocator, pMemory) != VK_SUCCESS)
+	{
+		*pMemory = VK_NULL_HANDLE;
+		return false;
+	}
+	if (vkBindImageMemory(device, image, *pMemory, 0) != VK_SUCCESS)
+	{
+		vkFreeMemory(device, *pMemory, pAllocator);
+		*pMemory = VK_NULL_HANDLE;
+		return false;
+	}
+	return true;
+}
+
+void DestroyBuffer(VkDevice device, const VkAllocationCallbacks* pAllocator, VkBuffer& buffer, VkDeviceMemory& memory)
+{
+	if (buffer != VK_NULL_HANDLE)
+		vkDestroyBuffer(device, buffer, pAllocator);
+	if (memory != VK_NULL_HANDLE)
+		vkFreeMemory(device, memory, pAllocator);
+	buffer = VK_NULL_HANDLE;
+	memory = VK_NULL_HANDLE;
+}
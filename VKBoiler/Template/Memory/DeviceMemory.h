@@ -0,0 +1,28 @@
+#pragma once
+
+#include "../Loader/Loader.h"
+
+/// <summary>
+/// First memory type allowed by typeBits with all required flags, a type that also has the preferred flags wins.
+/// UINT32_MAX when there is none
+/// </summary>
+uint32_t FindMemoryType(const VkPhysicalDeviceMemoryProperties& memoryProperties, uint32_t typeBits,
+	VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred = 0);
+
+/// <summary>
+/// Creates a buffer bound to an allocation of its own. The buffer is shared concurrently when the two families differ,
+/// so it can be used on both without ownership transfers. On failure nothing is left to destroy
+/// </summary>
+bool CreateBuffer(VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProperties, const VkAllocationCallbacks* pAllocator,
+	VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred,
+	uint32_t firstFamily, uint32_t secondFamily, VkBuffer* pBuffer, VkDeviceMemory* pMemory);
+/// <summary>
+/// Allocates memory of its own for an image and binds it, prefers device local memory
+/// </summary>
+bool AllocateImageMemory(VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProperties, const VkAllocationCallbacks* pAllocator,
+	VkImage image, VkDeviceMemory* pMemory);
+
+/// <summary>
+/// Destroys the buffer and frees its memory when set, both handles are reset
+/// </summary>
+void DestroyBuffer(VkDevice device, const VkAllocationCallbacks* pAllocator, VkBuffer& buffer, VkDeviceMemory& memory);
@@ -0,0 +1,415 @@
+#include "HostAllocator.h"
+
+#include <algorithm>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace
+{
+	const size_t SLOT_ALIGNMENT = 64;
+	// Chunks are aligned to their size, so a slot finds its chunk by masking its address
+	const size_t CHUNK_SIZE = 64 * 1024;
+	const size_t SIZE_CLASSES[HostAllocator::SIZE_CLASS_COUNT] = { 64, 128, 256, 512, 1024, 2048, 4096 };
+	const uint32_t HEAP_CLASS = UINT32_MAX;
+
+	// Stored directly in front of every pointer handed to the driver
+	struct alignas(16) AllocationHeader
+	{
+		void* pRaw;
+		size_t Size;
+		uint32_t Scope;
+		uint32_t SizeClass;
+	};
+
+	struct ThreadCache
+	{
+		uint64_t Generation = 0;
+		void* FreeLists[HostAllocator::SIZE_CLASS_COUNT] = {};
+		uint32_t FreeCounts[HostAllocator::SIZE_CLASS_COUNT] = {};
+	};
+
+	thread_local ThreadCache t_Cache;
+
+	std::atomic<uint64_t> s_NextGeneration{ 1 };
+
+	ThreadCache& GetThreadCache(uint64_t generation)
+	{
+		// Free lists of a previous allocator point into chunks that no longer exist
+		if (t_Cache.Generation != generation)
+		{
+			t_Cache = {};
+			t_Cache.Generation = generation;
+		}
+		return t_Cache;
+	}
+
+	size_t HeaderSpace(size_t alignment)
+	{
+		size_t space = sizeof(AllocationHeader);
+		if (alignment > space)
+			space = alignment;
+		return space;
+	}
+
+	uint32_t SlotsPerChunk(uint32_t sizeClass)
+	{
+		// The first slot alignment holds the chunk header
+		return static_cast<uint32_t>((CHUNK_SIZE - SLOT_ALIGNMENT) / SIZE_CLASSES[sizeClass]);
+	}
+
+	AllocationHeader* GetHeader(void* pMemory)
+	{
+		return reinterpret_cast<AllocationHeader*>(pMemory) - 1;
+	}
+
+	void UpdatePeak(std::atomic<size_t>& peak, size_t value)
+	{
+		size_t previous = peak.load(std::memory_order_relaxed);
+		while (value > previous && !peak.compare_exchange_weak(previous, value, std::memory_order_relaxed)) { }
+	}
+
+	const char* ScopeName(uint32_t scope)
+	{
+		switch (scope)
+		{
+		case VK_SYSTEM_ALLOCATION_SCOPE_COMMAND:	return "command";
+		case VK_SYSTEM_ALLOCATION_SCOPE_OBJECT:		return "object";
+		case VK_SYSTEM_ALLOCATION_SCOPE_CACHE:		return "cache";
+		case VK_SYSTEM_ALLOCATION_SCOPE_DEVICE:		return "device";
+		case VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE:	return "instance";
+		default:									return "unknown";
+		}
+	}
+}
+
+HostAllocator::HostAllocator()
+{
+	m_Generation = s_NextGeneration.fetch_add(1, std::memory_order_relaxed);
+
+	m_Callbacks.pUserData = this;
+	m_Callbacks.pfnAllocation = &HostAllocator::AllocationCallback;
+	m_Callbacks.pfnReallocation = &HostAllocator::ReallocationCallback;
+	m_Callbacks.pfnFree = &HostAllocator::FreeCallback;
+	m_Callbacks.pfnInternalAllocation = &HostAllocator::InternalAllocationCallback;
+	m_Callbacks.pfnInternalFree = &HostAllocator::InternalFreeCallback;
+}
+
+HostAllocator::~HostAllocator()
+{
+	// Only this thread's cache can be invalidated here, other caches notice the generation mismatch
+	if (t_Cache.Generation == m_Generation)
+		t_Cache = {};
+
+	for (Chunk* pChunk : m_Chunks)
+		operator delete(pChunk, std::align_val_t(CHUNK_SIZE));
+	m_Chunks.clear();
+}
+
+HostAllocator::ScopeStatistics HostAllocator::GetStatistics(VkSystemAllocationScope scope) const
+{
+	ScopeStatistics stats{};
+	if (static_cast<uint32_t>(scope) >= SCOPE_COUNT)
+		return stats;
+
+	const ScopeCounters& counters = m_Scopes[scope];
+	stats.CurrentBytes = counters.Current.load(std::memory_order_relaxed);
+	stats.PeakBytes = counters.Peak.load(std::memory_order_relaxed);
+	stats.AllocationCount = counters.Count.load(std::memory_order_relaxed);
+	stats.InternalCurrentBytes = counters.InternalCurrent.load(std::memory_order_relaxed);
+	stats.InternalPeakBytes = counters.InternalPeak.load(std::memory_order_relaxed);
+	return stats;
+}
+
+void HostAllocator::PrintStatistics() const
+{
+	printf("Host allocations:\n");
+	for (uint32_t scope = 0; scope < SCOPE_COUNT; scope++)
+	{
+		ScopeStatistics stats = GetStatistics(static_cast<VkSystemAllocationScope>(scope));
+		printf("\t- %-8s current %zu B, peak %zu B, %zu allocations, internal current %zu B, internal peak %zu B\n",
+			ScopeName(scope), stats.CurrentBytes, stats.PeakBytes, stats.AllocationCount,
+			stats.InternalCurrentBytes, stats.InternalPeakBytes);
+	}
+}
+
+void* HostAllocator::Allocate(size_t size, size_t alignment, VkSystemAllocationScope scope)
+{
+	if (size == 0)
+		return nullptr;
+
+	size_t headerSpace = HeaderSpace(alignment);
+	bool pooledScope = scope == VK_SYSTEM_ALLOCATION_SCOPE_COMMAND || scope == VK_SYSTEM_ALLOCATION_SCOPE_OBJECT;
+
+	void* pRaw = nullptr;
+	void* pMemory = nullptr;
+	uint32_t sizeClass = HEAP_CLASS;
+
+	if (pooledScope && alignment <= SLOT_ALIGNMENT)
+	{
+		for (uint32_t i = 0; i < SIZE_CLASS_COUNT; i++)
+		{
+			if (headerSpace + size <= SIZE_CLASSES[i])
+			{
+				sizeClass = i;
+				break;
+			}
+		}
+	}
+
+	if (sizeClass != HEAP_CLASS)
+	{
+		pRaw = AllocateFromPool(sizeClass);
+		if (!pRaw)
+			return nullptr;
+		// Slots are 64 byte aligned and headerSpace is a multiple of the requested alignment
+		pMemory = static_cast<char*>(pRaw) + headerSpace;
+	}
+	else
+	{
+		pRaw = malloc(size + headerSpace + alignment);
+		if (!pRaw)
+			return nullptr;
+
+		uintptr_t address = reinterpret_cast<uintptr_t>(pRaw) + headerSpace;
+		if (alignment > 1)
+			address = (address + alignment - 1) & ~(static_cast<uintptr_t>(alignment) - 1);
+		pMemory = reinterpret_cast<void*>(address);
+	}
+
+	AllocationHeader* pHeader = GetHeader(pMemory);
+	pHeader->pRaw = pRaw;
+	pHeader->Size = size;
+	pHeader->Scope = static_cast<uint32_t>(scope);
+	pHeader->SizeClass = sizeClass;
+
+	Track(scope, size, true);
+	return pMemory;
+}
+
+void* HostAllocator::Reallocate(void* pOriginal, size_t size, size_t alignment, VkSystemAllocationScope scope)
+{
+	if (!pOriginal)
+		return Allocate(size, alignment, scope);
+
+	if (size == 0)
+	{
+		Free(pOriginal);
+		return nullptr;
+	}
+
+	// Shrinking inside the same slot needs no copy
+	AllocationHeader* pHeader = GetHeader(pOriginal);
+	if (pHeader->SizeClass != HEAP_CLASS && pHeader->Scope == static_cast<uint32_t>(scope)
+		&& HeaderSpace(alignment) + size <= SIZE_CLASSES[pHeader->SizeClass]
+		&& static_cast<char*>(pOriginal) - static_cast<char*>(pHeader->pRaw) == static_cast<ptrdiff_t>(HeaderSpace(alignment)))
+	{
+		Track(scope, pHeader->Size, false);
+		Track(scope, size, true);
+		pHeader->Size = size;
+		return pOriginal;
+	}
+
+	void* pMemory = Allocate(size, alignment, scope);
+	if (!pMemory)
+		return nullptr;
+
+	memcpy(pMemory, pOriginal, pHeader->Size < size ? pHeader->Size : size);
+	Free(pOriginal);
+	return pMemory;
+}
+
+void HostAllocator::Free(void* pMemory)
+{
+	if (!pMemory)
+		return;
+
+	AllocationHeader* pHeader = GetHeader(pMemory);
+	Track(static_cast<VkSystemAllocationScope>(pHeader->Scope), pHeader->Size, false);
+
+	if (pHeader->SizeClass != HEAP_CLASS)
+		ReturnToPool(pHeader->pRaw, pHeader->SizeClass);
+	else
+		free(pHeader->pRaw);
+}
+
+void* HostAllocator::AllocateFromPool(uint32_t sizeClass)
+{
+	ThreadCache& cache = GetThreadCache(m_Generation);
+	if (!cache.FreeLists[sizeClass])
+	{
+		cache.FreeLists[sizeClass] = TakeSharedSlots(sizeClass, cache.FreeCounts[sizeClass]);
+		if (!cache.FreeLists[sizeClass])
+			return nullptr;
+	}
+
+	void* pSlot = cache.FreeLists[sizeClass];
+	cache.FreeLists[sizeClass] = *static_cast<void**>(pSlot);
+	cache.FreeCounts[sizeClass]--;
+	return pSlot;
+}
+
+void HostAllocator::ReturnToPool(void* pSlot, uint32_t sizeClass)
+{
+	// Slots freed on another thread than they were allocated on land in the freeing thread's cache
+	ThreadCache& cache = GetThreadCache(m_Generation);
+	*static_cast<void**>(pSlot) = cache.FreeLists[sizeClass];
+	cache.FreeLists[sizeClass] = pSlot;
+	cache.FreeCounts[sizeClass]++;
+
+	// A thread that only frees would collect them forever, keep one chunk worth and share the rest
+	uint32_t keep = SlotsPerChunk(sizeClass);
+	if (cache.FreeCounts[sizeClass] <= 2 * keep)
+		return;
+
+	void* pLast = cache.FreeLists[sizeClass];
+	for (uint32_t i = 1; i < keep; i++)
+		pLast = *static_cast<void**>(pLast);
+	void* pSurplus = *static_cast<void**>(pLast);
+	*static_cast<void**>(pLast) = nullptr;
+	cache.FreeCounts[sizeClass] = keep;
+	ReturnSharedSlots(pSurplus, sizeClass);
+}
+
+void* HostAllocator::TakeSharedSlots(uint32_t sizeClass, uint32_t& count)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_ChunkMutex);
+		Chunk* pChunk = m_SharedChunks[sizeClass];
+		if (pChunk)
+		{
+			m_SharedChunks[sizeClass] = pChunk->pNext;
+			if (pChunk->pNext)
+				pChunk->pNext->pPrevious = nullptr;
+			pChunk->Listed = false;
+
+			void* pSlots = pChunk->pFreeSlots;
+			count = pChunk->FreeCount;
+			pChunk->pFreeSlots = nullptr;
+			pChunk->FreeCount = 0;
+			return pSlots;
+		}
+	}
+
+	void* pMemory = operator new(CHUNK_SIZE, std::align_val_t(CHUNK_SIZE), std::nothrow);
+	if (!pMemory)
+		return nullptr;
+
+	Chunk* pChunk = new (pMemory) Chunk{};
+	pChunk->SlotCount = SlotsPerChunk(sizeClass);
+	{
+		std::lock_guard<std::mutex> lock(m_ChunkMutex);
+		m_Chunks.push_back(pChunk);
+	}
+
+	// Carve the chunk into slots, linked in address order
+	uintptr_t first = reinterpret_cast<uintptr_t>(pMemory) + SLOT_ALIGNMENT;
+	size_t slotSize = SIZE_CLASSES[sizeClass];
+	void* pSlots = nullptr;
+	for (size_t i = pChunk->SlotCount; i > 0; i--)
+	{
+		void* pSlot = reinterpret_cast<void*>(first + (i - 1) * slotSize);
+		*static_cast<void**>(pSlot) = pSlots;
+		pSlots = pSlot;
+	}
+	count = pChunk->SlotCount;
+	return pSlots;
+}
+
+void HostAllocator::ReturnSharedSlots(void* pSlots, uint32_t sizeClass)
+{
+	std::lock_guard<std::mutex> lock(m_ChunkMutex);
+	while (pSlots)
+	{
+		void* pSlot = pSlots;
+		pSlots = *static_cast<void**>(pSlot);
+
+		Chunk* pChunk = reinterpret_cast<Chunk*>(reinterpret_cast<uintptr_t>(pSlot) & ~(static_cast<uintptr_t>(CHUNK_SIZE) - 1));
+		*static_cast<void**>(pSlot) = pChunk->pFreeSlots;
+		pChunk->pFreeSlots = pSlot;
+		pChunk->FreeCount++;
+
+		if (!pChunk->Listed)
+		{
+			pChunk->pPrevious = nullptr;
+			pChunk->pNext = m_SharedChunks[sizeClass];
+			if (pChunk->pNext)
+				pChunk->pNext->pPrevious = pChunk;
+			m_SharedChunks[sizeClass] = pChunk;
+			pChunk->Listed = true;
+		}
+
+		// Every slot is back, release the chunk unless it is the only one left to hand out
+		bool onlyShared = m_SharedChunks[sizeClass] == pChunk && !pChunk->pNext;
+		if (pChunk->FreeCount < pChunk->SlotCount || onlyShared)
+			continue;
+
+		if (pChunk->pPrevious)
+			pChunk->pPrevious->pNext = pChunk->pNext;
+		else
+			m_SharedChunks[sizeClass] = pChunk->pNext;
+		if (pChunk->pNext)
+			pChunk->pNext->pPrevious = pChunk->pPrevious;
+
+		auto it = std::find(m_Chunks.begin(), m_Chunks.end(), pChunk);
+		*it = m_Chunks.back();
+		m_Chunks.pop_back();
+		operator delete(pChunk, std::align_val_t(CHUNK_SIZE));
+	}
+}
+
+void HostAllocator::Track(VkSystemAllocationScope scope, size_t size, bool allocated)
+{
+	if (static_cast<uint32_t>(scope) >= SCOPE_COUNT)
+		return;
+
+	ScopeCounters& counters = m_Scopes[scope];
+	if (allocated)
+	{
+		size_t current = counters.Current.fetch_add(size, std::memory_order_relaxed) + size;
+		counters.Count.fetch_add(1, std::memory_order_relaxed);
+		UpdatePeak(counters.Peak, current);
+	}
+	else
+	{
+		counters.Current.fetch_sub(size, std::memory_order_relaxed);
+	}
+}
+
+void HostAllocator::TrackInternal(VkSystemAllocationScope scope, size_t size, bool allocated)
+{
+	if (static_cast<uint32_t>(scope) >= SCOPE_COUNT)
+		return;
+
+	ScopeCounters& counters = m_Scopes[scope];
+	if (allocated)
+		UpdatePeak(counters.InternalPeak, counters.InternalCurrent.fetch_add(size, std::memory_order_relaxed) + size);
+	else
+		counters.InternalCurrent.fetch_sub(size, std::memory_order_relaxed);
+}
+
+/*static*/void* VKAPI_PTR HostAllocator::AllocationCallback(void* pUserData, size_t size, size_t alignment, VkSystemAllocationScope scope)
+{
+	return static_cast<HostAllocator*>(pUserData)->Allocate(size, alignment, scope);
+}
+
+/*static*/void* VKAPI_PTR HostAllocator::ReallocationCallback(void* pUserData, void* pOriginal, size_t size, size_t alignment, VkSystemAllocationScope scope)
+{
+	return static_cast<HostAllocator*>(pUserData)->Reallocate(pOriginal, size, alignment, scope);
+}
+
+/*static*/void VKAPI_PTR HostAllocator::FreeCallback(void* pUserData, void* pMemory)
+{
+	static_cast<HostAllocator*>(pUserData)->Free(pMemory);
+}
+
+/*static*/void VKAPI_PTR HostAllocator::InternalAllocationCallback(void* pUserData, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope)
+{
+	static_cast<HostAllocator*>(pUserData)->TrackInternal(scope, size, true);
+}
+
+/*static*/void VKAPI_PTR HostAllocator::InternalFreeCallback(void* pUserData, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope)
+{
+	static_cast<HostAllocator*>(pUserData)->TrackInternal(scope, size, false);
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "../Loader/Loader.h"
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+/// <summary>
+/// VkAllocationCallbacks implementation. Command and object scope allocations, which are small and
+/// frequent during recording, come from thread local size class pools. Threads that free more than they allocate
+/// hand the surplus back to a shared pool, and chunks whose slots all came back are released. All other scopes go
+/// to the heap. Bytes are tracked per VkSystemAllocationScope, including peaks
+/// </summary>
+class HostAllocator
+{
+public:
+	HostAllocator();
+	~HostAllocator();
+
+	HostAllocator(const HostAllocator&) = delete;
+	HostAllocator& operator=(const HostAllocator&) = delete;
+
+	const VkAllocationCallbacks* GetCallbacks() const { return &m_Callbacks; }
+
+	struct ScopeStatistics
+	{
+		size_t CurrentBytes;
+		size_t PeakBytes;
+		size_t AllocationCount;
+		size_t InternalCurrentBytes;
+		size_t InternalPeakBytes;
+	};
+
+	ScopeStatistics GetStatistics(VkSystemAllocationScope scope) const;
+	/// <summary>
+	/// Prints current and peak bytes of every allocation scope
+	/// </summary>
+	void PrintStatistics() const;
+
+	static const uint32_t SIZE_CLASS_COUNT = 7;
+
+private:
+	void* Allocate(size_t size, size_t alignment, VkSystemAllocationScope scope);
+	void* Reallocate(void* pOriginal, size_t size, size_t alignment, VkSystemAllocationScope scope);
+	void Free(void* pMemory);
+
+	void* AllocateFromPool(uint32_t sizeClass);
+	void ReturnToPool(void* pSlot, uint32_t sizeClass);
+	/// <summary>
+	/// Returns a list of free slots from the shared pool or a new chunk, count receives its length
+	/// </summary>
+	void* TakeSharedSlots(uint32_t sizeClass, uint32_t& count);
+	void ReturnSharedSlots(void* pSlots, uint32_t sizeClass);
+
+	void Track(VkSystemAllocationScope scope, size_t size, bool allocated);
+	void TrackInternal(VkSystemAllocationScope scope, size_t size, bool allocated);
+
+	static void* VKAPI_PTR AllocationCallback(void* pUserData, size_t size, size_t alignment, VkSystemAllocationScope scope);
+	static void* VKAPI_PTR ReallocationCallback(void* pUserData, void* pOriginal, size_t size, size_t alignment, VkSystemAllocationScope scope);
+	static void VKAPI_PTR FreeCallback(void* pUserData, void* pMemory);
+	static void VKAPI_PTR InternalAllocationCallback(void* pUserData, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope);
+	static void VKAPI_PTR InternalFreeCallback(void* pUserData, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope);
+
+private:
+	static const uint32_t SCOPE_COUNT = 5;
+
+	// Each scope on its own cache line so threads working in different scopes do not contend
+	struct alignas(64) ScopeCounters
+	{
+		std::atomic<size_t> Current{ 0 };
+		std::atomic<size_t> Peak{ 0 };
+		std::atomic<size_t> Count{ 0 };
+		std::atomic<size_t> InternalCurrent{ 0 };
+		std::atomic<size_t> InternalPeak{ 0 };
+	};
+
+	VkAllocationCallbacks m_Callbacks = {};
+	ScopeCounters m_Scopes[SCOPE_COUNT];
+
+	// Identifies this allocator in the thread local caches, addresses may be reused
+	uint64_t m_Generation = 0;
+
+	// Sits at the start of every CHUNK_SIZE aligned chunk, slots of one size class follow it
+	struct Chunk
+	{
+		// Chunks of the same size class with slots in the shared pool
+		Chunk* pNext;
+		Chunk* pPrevious;
+		void* pFreeSlots;
+		uint32_t FreeCount;
+		uint32_t SlotCount;
+		bool Listed;
+	};
+
+	// Only touched when a thread cache runs dry or holds too many slots
+	std::mutex m_ChunkMutex;
+	std::vector<Chunk*> m_Chunks = {};
+	Chunk* m_SharedChunks[SIZE_CLASS_COUNT] = {};
+};
@@ -0,0 +1,161 @@
+#include "MeshletBuilder.h"
+
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#undef max
+#undef min
+
+namespace
+{
+	const uint8_t NOT_IN_MESHLET = 0xff;
+	// Wider normal cones reject almost nothing and make the test unstable, they are stored as disabled
+	const float MIN_CONE_DOT = 0.1f;
+
+	struct Vec3
+	{
+		float X, Y, Z;
+	};
+
+	Vec3 Subtract(const Vec3& a, const Vec3& b) { return { a.X - b.X, a.Y - b.Y, a.Z - b.Z }; }
+	Vec3 Cross(const Vec3& a, const Vec3& b) { return { a.Y * b.Z - a.Z * b.Y, a.Z * b.X - a.X * b.Z, a.X * b.Y - a.Y * b.X }; }
+	float Dot(const Vec3& a, const Vec3& b) { return a.X * b.X + a.Y * b.Y + a.Z * b.Z; }
+
+	class PositionReader
+	{
+	public:
+		PositionReader(const void* pPositions, size_t stride) : m_pBytes(static_cast<const uint8_t*>(pPositions)), m_Stride(stride) { }
+
+		Vec3 operator[](uint32_t index) const
+		{
+			Vec3 position;
+			memcpy(&position, m_pBytes + index * m_Stride, sizeof(Vec3));
+			return position;
+		}
+
+	private:
+		const uint8_t* m_pBytes;
+		size_t m_Stride;
+	};
+
+	void ComputeBounds(const MeshletData& data, const PositionReader& positions, Meshlet& meshlet)
+	{
+		Vec3 low = positions[data.Vertices[meshlet.VertexOffset]];
+		Vec3 high = low;
+		for (uint32_t i = 1; i < meshlet.VertexCount; i++)
+		{
+			Vec3 position = positions[data.Vertices[meshlet.VertexOffset + i]];
+			low = { std::min(low.X, position.X), std::min(low.Y, position.Y), std::min(low.Z, position.Z) };
+			high = { std::max(high.X, position.X), std::max(high.Y, position.Y), std::max(high.Z, position.Z) };
+		}
+		Vec3 center = { (low.X + high.X) * 0.5f, (low.Y + high.Y) * 0.5f, (low.Z + high.Z) * 0.5f };
+		float radiusSquared = 0.0f;
+		for (uint32_t i = 0; i < meshlet.VertexCount; i++)
+		{
+			Vec3 offset = Subtract(positions[data.Vertices[meshlet.VertexOffset + i]], center);
+			radiusSquared = std::max(radiusSquared, Dot(offset, offset));
+		}
+		memcpy(meshlet.Center, &center, sizeof(meshlet.Center));
+		meshlet.Radius = sqrtf(radiusSquared);
+
+		// Area weighted average normal as the axis, the widest normal around it as the cone angle
+		std::vector<Vec3> normals;
+		normals.reserve(meshlet.TriangleCount);
+		Vec3 axis = { 0.0f, 0.0f, 0.0f };
+		for (uint32_t i = 0; i < meshlet.TriangleCount; i++)
+		{
+			uint32_t triangle = data.Triangles[meshlet.TriangleOffset + i];
+			Vec3 a = positions[data.Vertices[meshlet.VertexOffset + (triangle & 0xff)]];
+			Vec3 b = positions[data.Vertices[meshlet.VertexOffset + ((triangle >> 8) & 0xff)]];
+			Vec3 c = positions[data.Vertices[meshlet.VertexOffset + ((triangle >> 16) & 0xff)]];
+			Vec3 normal = Cross(Subtract(b, a), Subtract(c, a));
+			float length = sqrtf(Dot(normal, normal));
+			if (length == 0.0f)
+				continue;
+			axis = { axis.X + normal.X, axis.Y + normal.Y, axis.Z + normal.Z };
+			normals.push_back({ normal.X / length, normal.Y / length, normal.Z / length });
+		}
+
+		meshlet.ConeCutoff = 1.0f;
+		float axisLength = sqrtf(Dot(axis, axis));
+		if (axisLength == 0.0f)
+			return;
+		axis = { axis.X / axisLength, axis.Y / axisLength, axis.Z / axisLength };
+		float minDot = 1.0f;
+		for (const Vec3& normal : normals)
+			minDot = std::min(minDot, Dot(normal, axis));
+		if (minDot <= MIN_CONE_DOT)
+			return;
+
+		// The cone of view directions seeing only backfaces is the normal cone widened by 90 degrees, so its
+		// cutoff is cos(angle + 90) negated, which is sin(angle)
+		memcpy(meshlet.ConeAxis, &axis, sizeof(meshlet.ConeAxis));
+		meshlet.ConeCutoff = sqrtf(1.0f - minDot * minDot);
+	}
+}
+
+bool BuildMeshlets(const uint32_t* pIndices, size_t indexCount, const void* pPositions, size_t vertexCount, size_t positionStride,
+	MeshletData& data)
+{
+	if (indexCount % 3 != 0 || positionStride < sizeof(Vec3))
+	{
+		printf("Meshlets need a triangle list and positions of three floats\n");
+		return false;
+	}
+	for (size_t i = 0; i < indexCount; i++)
+	{
+		if (pIndices[i] >= vertexCount)
+		{
+			printf("Index %u at %zu is out of the %zu vertices\n", pIndices[i], i, vertexCount);
+			return false;
+		}
+	}
+
+	PositionReader positions(pPositions, positionStride);
+	std::vector<uint8_t> localIndices(vertexCount, NOT_IN_MESHLET);
+	Meshlet meshlet{};
+	meshlet.VertexOffset = static_cast<uint32_t>(data.Vertices.size());
+	meshlet.TriangleOffset = static_cast<uint32_t>(data.Triangles.size());
+
+	auto flush = [&]()
+	{
+		ComputeBounds(data, positions, meshlet);
+		data.Meshlets.push_back(meshlet);
+		for (uint32_t i = 0; i < meshlet.VertexCount; i++)
+			localIndices[data.Vertices[meshlet.VertexOffset + i]] = NOT_IN_MESHLET;
+
+		meshlet = {};
+		meshlet.VertexOffset = static_cast<uint32_t>(data.Vertices.size());
+		meshlet.TriangleOffset = static_cast<uint32_t>(data.Triangles.size());
+	};
+
+	for (size_t i = 0; i < indexCount; i += 3)
+	{
+		uint32_t a = pIndices[i], b = pIndices[i + 1], c = pIndices[i + 2];
+		uint32_t newVertices = (localIndices[a] == NOT_IN_MESHLET ? 1 : 0)
+			+ (localIndices[b] == NOT_IN_MESHLET && b != a ? 1 : 0)
+			+ (localIndices[c] == NOT_IN_MESHLET && c != a && c != b ? 1 : 0);
+		if (meshlet.VertexCount + newVertices > MESHLET_MAX_VERTICES || meshlet.TriangleCount == MESHLET_MAX_TRIANGLES)
+			flush();
+
+		uint32_t triangle = 0;
+		uint32_t corners[3] = { a, b, c };
+		for (uint32_t corner = 0; corner < 3; corner++)
+		{
+			uint32_t vertex = corners[corner];
+			if (localIndices[vertex] == NOT_IN_MESHLET)
+			{
+				localIndices[vertex] = static_cast<uint8_t>(meshlet.VertexCount++);
+				data.Vertices.push_back(vertex);
+			}
+			triangle |= static_cast<uint32_t>(localIndices[vertex]) << (corner * 8);
+		}
+		data.Triangles.push_back(triangle);
+		meshlet.TriangleCount++;
+	}
+	if (meshlet.TriangleCount > 0)
+		flush();
+	return true;
+}
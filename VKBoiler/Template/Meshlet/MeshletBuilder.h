@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+static const uint32_t MESHLET_MAX_VERTICES = 64;
+static const uint32_t MESHLET_MAX_TRIANGLES = 124;
+
+/// <summary>
+/// std430 layout of a meshlet as read by the shaders in Meshlet/Shaders
+/// </summary>
+struct Meshlet
+{
+	/// <summary>
+	/// Bounding sphere of the meshlet's vertices
+	/// </summary>
+	float Center[3] = {};
+	float Radius = 0.0f;
+	/// <summary>
+	/// Normal cone: the meshlet is backfacing when dot(center - camera, axis) >= cutoff * length(center - camera) + radius.
+	/// A cutoff of 1 disables the test, the normals spread too far for it
+	/// </summary>
+	float ConeAxis[3] = {};
+	float ConeCutoff = 1.0f;
+	/// <summary>
+	/// First entry in MeshletData::Vertices and MeshletData::Triangles
+	/// </summary>
+	uint32_t VertexOffset = 0;
+	uint32_t TriangleOffset = 0;
+	uint32_t VertexCount = 0;
+	uint32_t TriangleCount = 0;
+};
+
+struct MeshletData
+{
+	std::vector<Meshlet> Meshlets;
+	/// <summary>
+	/// Index into the vertex buffer for every meshlet vertex
+	/// </summary>
+	std::vector<uint32_t> Vertices;
+	/// <summary>
+	/// One entry per triangle, the three meshlet local vertex indices in its low three bytes
+	/// </summary>
+	std::vector<uint32_t> Triangles;
+};
+
+/// <summary>
+/// Splits a triangle list into meshlets of at most MESHLET_MAX_VERTICES vertices and MESHLET_MAX_TRIANGLES triangles
+/// and appends them to data, so several meshes can share one MeshletData. Triangles are taken in index order, an index
+/// buffer optimized for vertex cache locality gives fuller meshlets. Positions are three floats at the start of each
+/// positionStride bytes, indices refer to them directly
+/// </summary>
+bool BuildMeshlets(const uint32_t* pIndices, size_t indexCount, const void* pPositions, size_t vertexCount, size_t positionStride,
+	MeshletData& data);
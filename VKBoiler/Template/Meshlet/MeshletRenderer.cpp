@@ -0,0 +1,337 @@
+#include "MeshletRenderer.h"
+
+#include "../Memory/DeviceMemory.h"
+
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+
+#undef max
+#undef min
+
+namespace
+{
+	// Meshlets per task shader workgroup
+	const uint32_t TASK_GROUP_SIZE = 32;
+	// Minimum maxTaskWorkGroupCount and maxComputeWorkGroupCount per dimension
+	const uint32_t MAX_GROUP_COUNT = 65535;
+	const uint32_t MESH_BINDING_COUNT = 5;
+	const uint32_t EXPAND_BINDING_COUNT = 6;
+
+	// std140 uniform block shared by all meshlet shaders
+	struct FrameConstants
+	{
+		float ViewProjection[16];
+		float FrustumPlanes[6][4];
+		float CameraPosition[3];
+		uint32_t MeshletCount;
+		uint32_t VertexStride;
+		uint32_t Padding[3];
+	};
+
+	// Host visible storage buffer holding a copy of data
+	bool CreateFilledBuffer(VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProperties, const VkAllocationCallbacks* pAllocator,
+		const void* pData, size_t size, VkBuffer* pBuffer, VkDeviceMemory* pMemory)
+	{
+		void* pMapped = nullptr;
+		if (!CreateBuffer(device, memoryProperties, pAllocator, std::max<VkDeviceSize>(size, sizeof(uint32_t)), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, 0, pBuffer, pMemory))
+			return false;
+		if (vkMapMemory(device, *pMemory, 0, VK_WHOLE_SIZE, 0, &pMapped) != VK_SUCCESS)
+		{
+			DestroyBuffer(device, pAllocator, *pBuffer, *pMemory);
+			return false;
+		}
+		if (size > 0)
+			memcpy(pMapped, pData, size);
+		vkUnmapMemory(device, *pMemory);
+		return true;
+	}
+}
+
+bool MeshletRenderer::Init(VkDevice device, VkPhysicalDevice physicalDevice, const VkAllocationCallbacks* pAllocator,
+	ShaderLibrary* pShaderLibrary, LayoutCache* pLayoutCache, bool enabled, bool meshShaders, uint32_t framesInFlight)
+{
+	m_Device = device;
+	m_pAllocator = pAllocator;
+	m_MeshShaders = false;
+	m_FrameSlot = 0;
+
+	if (!enabled)
+		return true;
+	if (!pShaderLibrary || !pLayoutCache)
+		return false;
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &m_MemoryProperties);
+
+	std::vector<VkDescriptorSetLayout> setLayouts;
+	std::vector<VkPushConstantRange> pushConstants;
+	if (meshShaders)
+	{
+		ShaderReflection task{};
+		ShaderReflection mesh{};
+		if (!pShaderLibrary->Reflect(MESHLET_TASK_SHADER, &task) || !pShaderLibrary->Reflect(MESHLET_MESH_SHADER, &mesh))
+			printf("Mesh shaders [\"%s\"] and [\"%s\"] missing from the shader library, expanding meshlets in compute\n",
+				MESHLET_TASK_SHADER, MESHLET_MESH_SHADER);
+		else if (!pLayoutCache->GetSetLayouts({ &task, &mesh }, setLayouts, pushConstants) || setLayouts.size() != 1)
+		{
+			printf("Mesh shaders do not match MeshletRenderer\n");
+			return false;
+		}
+		else
+			m_MeshShaders = true;
+	}
+
+	if (!m_MeshShaders)
+	{
+		ShaderReflection reflection{};
+		if (!pShaderLibrary->Reflect(MESHLET_EXPAND_SHADER, &reflection))
+		{
+			printf("Meshlets need shader [\"%s\"] in the shader library\n", MESHLET_EXPAND_SHADER);
+			return false;
+		}
+		if (!pLayoutCache->GetSetLayouts({ &reflection }, setLayouts, pushConstants) || setLayouts.size() != 1)
+		{
+			printf("Shader [\"%s\"] does not match MeshletRenderer\n", MESHLET_EXPAND_SHADER);
+			return false;
+		}
+		m_ExpandLayout = pLayoutCache->GetPipelineLayout(setLayouts, pushConstants);
+
+		VkPipelineShaderStageCreateInfo stageCi{};
+		VkShaderModuleCreateInfo moduleCi{};
+		if (m_ExpandLayout == VK_NULL_HANDLE
+			|| !pShaderLibrary->FillStage(m_Device, MESHLET_EXPAND_SHADER, VK_SHADER_STAGE_COMPUTE_BIT, "main", stageCi, moduleCi, m_pAllocator))
+			return false;
+
+		VkComputePipelineCreateInfo pipelineCi{};
+		pipelineCi.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipelineCi.stage = stageCi;
+		pipelineCi.layout = m_ExpandLayout;
+		if (vkCreateComputePipelines(m_Device, VK_NULL_HANDLE, 1, &pipelineCi, m_pAllocator, &m_ExpandPipeline) != VK_SUCCESS)
+		{
+			printf("Failed to create meshlet expansion pipeline\n");
+			return false;
+		}
+	}
+	m_SetLayout = setLayouts[0];
+
+	framesInFlight = std::max(framesInFlight, 1u);
+	uint32_t storageCount = (m_MeshShaders ? MESH_BINDING_COUNT : EXPAND_BINDING_COUNT) - 1;
+	VkDescriptorPoolSize poolSizes[2] = {
+		{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, framesInFlight },
+		{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, storageCount * framesInFlight },
+	};
+	VkDescriptorPoolCreateInfo poolCi{};
+	poolCi.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolCi.maxSets = framesInFlight;
+	poolCi.poolSizeCount = 2;
+	poolCi.pPoolSizes = poolSizes;
+	if (vkCreateDescriptorPool(m_Device, &poolCi, m_pAllocator, &m_DescriptorPool) != VK_SUCCESS)
+	{
+		printf("Failed to create meshlet descriptor pool\n");
+		Destroy();
+		return false;
+	}
+
+	m_Slots.resize(framesInFlight);
+	for (FrameSlot& slot : m_Slots)
+	{
+		VkDescriptorSetAllocateInfo setInfo{};
+		setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		setInfo.descriptorPool = m_DescriptorPool;
+		setInfo.descriptorSetCount = 1;
+		setInfo.pSetLayouts = &m_SetLayout;
+
+		bool success = CreateBuffer(m_Device, m_MemoryProperties, m_pAllocator, sizeof(FrameConstants), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 0, 0, 0, &slot.UniformBuffer, &slot.UniformMemory)
+			&& vkMapMemory(m_Device, slot.UniformMemory, 0, VK_WHOLE_SIZE, 0, &slot.pUniforms) == VK_SUCCESS
+			&& vkAllocateDescriptorSets(m_Device, &setInfo, &slot.Set) == VK_SUCCESS;
+		if (success && !m_MeshShaders)
+			success = CreateBuffer(m_Device, m_MemoryProperties, m_pAllocator, sizeof(VkDrawIndexedIndirectCommand),
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				0, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, 0, &slot.DrawBuffer, &slot.DrawMemory);
+		if (!success)
+		{
+			printf("Failed to create meshlet frame buffers\n");
+			Destroy();
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void MeshletRenderer::Destroy()
+{
+	if (m_Device == VK_NULL_HANDLE)
+		return;
+
+	DestroyGeometry();
+	for (FrameSlot& slot : m_Slots)
+	{
+		DestroyBuffer(m_Device, m_pAllocator, slot.UniformBuffer, slot.UniformMemory);
+		DestroyBuffer(m_Device, m_pAllocator, slot.DrawBuffer, slot.DrawMemory);
+	}
+	m_Slots.clear();
+
+	if (m_DescriptorPool != VK_NULL_HANDLE)
+		vkDestroyDescriptorPool(m_Device, m_DescriptorPool, m_pAllocator);
+	if (m_ExpandPipeline != VK_NULL_HANDLE)
+		vkDestroyPipeline(m_Device, m_ExpandPipeline, m_pAllocator);
+	m_DescriptorPool = VK_NULL_HANDLE;
+	m_ExpandPipeline = VK_NULL_HANDLE;
+	// Owned by the LayoutCache
+	m_ExpandLayout = VK_NULL_HANDLE;
+	m_SetLayout = VK_NULL_HANDLE;
+}
+
+bool MeshletRenderer::SetGeometry(const MeshletData& data, VkBuffer vertexBuffer, uint32_t vertexStride)
+{
+	if (!IsEnabled())
+		return false;
+
+	DestroyGeometry();
+	if (data.Meshlets.size() > static_cast<size_t>(MAX_GROUP_COUNT) * TASK_GROUP_SIZE)
+	{
+		printf("%zu meshlets are more than a single draw can cull\n", data.Meshlets.size());
+		return false;
+	}
+	if (m_MeshShaders && (vertexBuffer == VK_NULL_HANDLE || vertexStride < 3 * sizeof(float) || vertexStride % sizeof(float) != 0))
+	{
+		printf("Mesh shaders need a vertex buffer with float aligned vertices\n");
+		return false;
+	}
+
+	if (!CreateFilledBuffer(m_Device, m_MemoryProperties, m_pAllocator, data.Meshlets.data(), data.Meshlets.size() * sizeof(Meshlet),
+			&m_MeshletBuffer, &m_MeshletMemory)
+		|| !CreateFilledBuffer(m_Device, m_MemoryProperties, m_pAllocator, data.Vertices.data(), data.Vertices.size() * sizeof(uint32_t),
+			&m_VertexIndexBuffer, &m_VertexIndexMemory)
+		|| !CreateFilledBuffer(m_Device, m_MemoryProperties, m_pAllocator, data.Triangles.data(), data.Triangles.size() * sizeof(uint32_t),
+			&m_TriangleBuffer, &m_TriangleMemory))
+	{
+		printf("Failed to upload meshlets\n");
+		DestroyGeometry();
+		return false;
+	}
+
+	// Room for every triangle, in case nothing gets culled
+	if (!m_MeshShaders)
+	{
+		VkDeviceSize indexSize = std::max<VkDeviceSize>(data.Triangles.size() * 3 * sizeof(uint32_t), sizeof(uint32_t));
+		for (FrameSlot& slot : m_Slots)
+		{
+			if (!CreateBuffer(m_Device, m_MemoryProperties, m_pAllocator, indexSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+				0, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, 0, &slot.IndexBuffer, &slot.IndexMemory))
+			{
+				printf("Failed to create meshlet index buffers\n");
+				DestroyGeometry();
+				return false;
+			}
+		}
+	}
+
+	m_MeshletCount = static_cast<uint32_t>(data.Meshlets.size());
+	m_VertexStride = vertexStride;
+	UpdateSets(vertexBuffer);
+	return true;
+}
+
+void MeshletRenderer::BeginFrame()
+{
+	if (!m_Slots.empty())
+		m_FrameSlot = (m_FrameSlot + 1) % static_cast<uint32_t>(m_Slots.size());
+}
+
+void MeshletRenderer::RecordCull(VkCommandBuffer cmd, const MeshletCullView& view)
+{
+	if (!IsEnabled() || m_MeshletCount == 0)
+		return;
+	const FrameSlot& slot = m_Slots[m_FrameSlot];
+
+	FrameConstants constants{};
+	memcpy(constants.ViewProjection, view.ViewProjection, sizeof(constants.ViewProjection));
+	memcpy(constants.FrustumPlanes, view.FrustumPlanes, sizeof(constants.FrustumPlanes));
+	memcpy(constants.CameraPosition, view.CameraPosition, sizeof(constants.CameraPosition));
+	constants.MeshletCount = m_MeshletCount;
+	constants.VertexStride = m_VertexStride / sizeof(float);
+	memcpy(slot.pUniforms, &constants, sizeof(constants));
+	// The task shader culls while drawing
+	if (m_MeshShaders)
+		return;
+
+	// Surviving meshlets append their indices by bumping indexCount
+	VkDrawIndexedIndirectCommand draw{ 0, 1, 0, 0, 0 };
+	vkCmdUpdateBuffer(cmd, slot.DrawBuffer, 0, sizeof(draw), &draw);
+	VkMemoryBarrier clearBarrier{};
+	clearBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	clearBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	clearBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &clearBarrier, 0, nullptr, 0, nullptr);
+
+	// One workgroup per meshlet, folded into rows when there are more than a dimension allows
+	uint32_t groupsX = std::min(m_MeshletCount, MAX_GROUP_COUNT);
+	uint32_t groupsY = (m_MeshletCount + groupsX - 1) / groupsX;
+	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_ExpandPipeline);
+	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_ExpandLayout, 0, 1, &slot.Set, 0, nullptr);
+	vkCmdDispatch(cmd, groupsX, groupsY, 1);
+
+	VkMemoryBarrier drawBarrier{};
+	drawBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	drawBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	drawBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+		0, 1, &drawBarrier, 0, nullptr, 0, nullptr);
+}
+
+void MeshletRenderer::RecordDraw(CommandEncoder& encoder, VkPipelineLayout layout) const
+{
+	if (!IsEnabled() || m_MeshletCount == 0)
+		return;
+	const FrameSlot& slot = m_Slots[m_FrameSlot];
+
+	if (m_MeshShaders)
+	{
+		encoder.BindDescriptorSets(VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 0, 1, &slot.Set);
+		encoder.DrawMeshTasks((m_MeshletCount + TASK_GROUP_SIZE - 1) / TASK_GROUP_SIZE, 1, 1);
+		return;
+	}
+	encoder.BindIndexBuffer(slot.IndexBuffer, 0, VK_INDEX_TYPE_UINT32);
+	encoder.DrawIndexedIndirect(slot.DrawBuffer, 0, 1, sizeof(VkDrawIndexedIndirectCommand));
+}
+
+void MeshletRenderer::DestroyGeometry()
+{
+	DestroyBuffer(m_Device, m_pAllocator, m_MeshletBuffer, m_MeshletMemory);
+	DestroyBuffer(m_Device, m_pAllocator, m_VertexIndexBuffer, m_VertexIndexMemory);
+	DestroyBuffer(m_Device, m_pAllocator, m_TriangleBuffer, m_TriangleMemory);
+	for (FrameSlot& slot : m_Slots)
+		DestroyBuffer(m_Device, m_pAllocator, slot.IndexBuffer, slot.IndexMemory);
+	m_MeshletCount = 0;
+}
+
+void MeshletRenderer::UpdateSets(VkBuffer vertexBuffer)
+{
+	for (const FrameSlot& slot : m_Slots)
+	{
+		// Binding 4 is the vertex data for the mesh shader and the expanded indices for the compute pass
+		VkDescriptorBufferInfo bufferInfos[EXPAND_BINDING_COUNT] = {
+			{ slot.UniformBuffer, 0, VK_WHOLE_SIZE },
+			{ m_MeshletBuffer, 0, VK_WHOLE_SIZE },
+			{ m_VertexIndexBuffer, 0, VK_WHOLE_SIZE },
+			{ m_TriangleBuffer, 0, VK_WHOLE_SIZE },
+			{ m_MeshShaders ? vertexBuffer : slot.IndexBuffer, 0, VK_WHOLE_SIZE },
+			{ slot.DrawBuffer, 0, VK_WHOLE_SIZE },
+		};
+		uint32_t bindingCount = m_MeshShaders ? MESH_BINDING_COUNT : EXPAND_BINDING_COUNT;
+		VkWriteDescriptorSet writes[EXPAND_BINDING_COUNT] = {};
+		for (uint32_t i = 0; i < bindingCount; i++)
+		{
+			writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			writes[i].dstSet = slot.Set;
+			writes[i].dstBinding = i;
+			writes[i].descriptorCount = 1;
+			writes[i].descriptorType = i == 0 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			writes[i].pBufferInfo = &bufferInfos[i];
+		}
+		vkUpdateDescriptorSets(m_Device, bindingCount, writes, 0, nullptr);
+	}
+}
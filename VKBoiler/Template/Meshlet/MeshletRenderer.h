@@ -0,0 +1,113 @@
+#pragma once
+
+#include "../Loader/Loader.h"
+#include "../Shaders/ShaderLibrary.h"
+#include "../Shaders/LayoutCache.h"
+#include "../Command/CommandEncoder.h"
+#include "MeshletBuilder.h"
+
+#include <vector>
+
+/// <summary>
+/// Library names of the shaders in Meshlet/Shaders
+/// </summary>
+static const char* const MESHLET_TASK_SHADER = "MeshletTask";
+static const char* const MESHLET_MESH_SHADER = "MeshletMesh";
+static const char* const MESHLET_EXPAND_SHADER = "MeshletExpand";
+
+struct MeshletCullView
+{
+	/// <summary>
+	/// Column major, only used by the mesh shader
+	/// </summary>
+	float ViewProjection[16] = {};
+	/// <summary>
+	/// World space planes as (normal, distance) with normals pointing into the frustum
+	/// </summary>
+	float FrustumPlanes[6][4] = {};
+	float CameraPosition[3] = {};
+};
+
+/// <summary>
+/// Draws world space geometry split into meshlets, culling every meshlet against the frustum and its normal cone.
+/// With mesh shaders a task shader culls and the mesh shader emits the surviving meshlets, the client builds the
+/// pipeline from MESHLET_TASK_SHADER, MESHLET_MESH_SHADER and its own fragment shader. The mesh shader outputs the world
+/// position at location 0 and the flat meshlet index at location 1.
+///
+/// Without mesh shaders a compute pass writes the triangles of the surviving meshlets into an index buffer and a single
+/// indirect draw consumes it, the client draws with its own vertex pipeline and vertex buffer bound.
+/// The mesh shaders take the meshlet set at set 0, build their pipeline layout through the LayoutCache so it matches
+/// </summary>
+class MeshletRenderer
+{
+public:
+	bool Init(VkDevice device, VkPhysicalDevice physicalDevice, const VkAllocationCallbacks* pAllocator,
+		ShaderLibrary* pShaderLibrary, LayoutCache* pLayoutCache, bool enabled, bool meshShaders, uint32_t framesInFlight);
+	void Destroy();
+
+	bool IsEnabled() const { return m_SetLayout != VK_NULL_HANDLE; }
+	bool UsesMeshShaders() const { return m_MeshShaders; }
+	VkDescriptorSetLayout GetSetLayout() const { return m_SetLayout; }
+
+	/// <summary>
+	/// Uploads the meshlets, replacing earlier ones. The mesh shader reads positions as the first three floats of every
+	/// vertexStride bytes of vertexBuffer, which then needs VK_BUFFER_USAGE_STORAGE_BUFFER_BIT. Call while the device is idle
+	/// </summary>
+	bool SetGeometry(const MeshletData& data, VkBuffer vertexBuffer, uint32_t vertexStride);
+	uint32_t GetMeshletCount() const { return m_MeshletCount; }
+
+	/// <summary>
+	/// Moves on to the next slot of per frame buffers, the client must have waited for the frame that last used it
+	/// </summary>
+	void BeginFrame();
+	/// <summary>
+	/// Updates the view and, without mesh shaders, records the compute pass. Record outside of a render pass
+	/// </summary>
+	void RecordCull(VkCommandBuffer cmd, const MeshletCullView& view);
+	/// <summary>
+	/// Draws the meshlets that survived culling. Bind the mesh pipeline, whose layout receives the meshlet set, or
+	/// the vertex pipeline and vertex buffer, which draw from the expanded index buffer
+	/// </summary>
+	void RecordDraw(CommandEncoder& encoder, VkPipelineLayout layout) const;
+
+private:
+	struct FrameSlot
+	{
+		VkBuffer UniformBuffer = VK_NULL_HANDLE;
+		VkDeviceMemory UniformMemory = VK_NULL_HANDLE;
+		void* pUniforms = nullptr;
+		/// <summary>
+		/// Expanded indices and the draw reading them, only without mesh shaders
+		/// </summary>
+		VkBuffer IndexBuffer = VK_NULL_HANDLE;
+		VkDeviceMemory IndexMemory = VK_NULL_HANDLE;
+		VkBuffer DrawBuffer = VK_NULL_HANDLE;
+		VkDeviceMemory DrawMemory = VK_NULL_HANDLE;
+		VkDescriptorSet Set = VK_NULL_HANDLE;
+	};
+
+	void DestroyGeometry();
+	void UpdateSets(VkBuffer vertexBuffer);
+
+private:
+	VkDevice m_Device = VK_NULL_HANDLE;
+	const VkAllocationCallbacks* m_pAllocator = nullptr;
+	VkPhysicalDeviceMemoryProperties m_MemoryProperties = {};
+
+	bool m_MeshShaders = false;
+	VkDescriptorSetLayout m_SetLayout = VK_NULL_HANDLE;
+	VkPipelineLayout m_ExpandLayout = VK_NULL_HANDLE;
+	VkPipeline m_ExpandPipeline = VK_NULL_HANDLE;
+	VkDescriptorPool m_DescriptorPool = VK_NULL_HANDLE;
+	std::vector<FrameSlot> m_Slots = {};
+	uint32_t m_FrameSlot = 0;
+
+	VkBuffer m_MeshletBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory m_MeshletMemory = VK_NULL_HANDLE;
+	VkBuffer m_VertexIndexBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory m_VertexIndexMemory = VK_NULL_HANDLE;
+	VkBuffer m_TriangleBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory m_TriangleMemory = VK_NULL_HANDLE;
+	uint32_t m_MeshletCount = 0;
+	uint32_t m_VertexStride = 0;
+};
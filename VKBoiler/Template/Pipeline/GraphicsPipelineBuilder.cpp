@@ -0,0 +1,628 @@
+#include "GraphicsPipelineBuilder.h"
+
+#include "../Util/ByteKey.h"
+
+#include <stdio.h>
+
+namespace
+{
+	using ::WriteKey;
+
+	void WriteKey(std::string& key, const PipelineShaderStage& stage)
+	{
+		WriteKey(key, stage.Stage);
+		WriteKey(key, stage.Name);
+		WriteKey(key, stage.EntryPoint);
+	}
+
+	// Pre-rasterization, fragment and output parts are compiled against the same pass
+	void WritePassKey(std::string& key, const RenderTargetLayout& target)
+	{
+		WriteKey(key, target.RenderPass);
+		WriteKey(key, target.Subpass);
+		WriteKey(key, target.ViewMask);
+	}
+
+	// Dynamic topology may only change within the class the pipeline was created with
+	uint32_t TopologyClass(VkPrimitiveTopology topology)
+	{
+		switch (topology)
+		{
+		case VK_PRIMITIVE_TOPOLOGY_POINT_LIST:
+			return 0;
+		case VK_PRIMITIVE_TOPOLOGY_LINE_LIST:
+		case VK_PRIMITIVE_TOPOLOGY_LINE_STRIP:
+		case VK_PRIMITIVE_TOPOLOGY_LINE_LIST_WITH_ADJACENCY:
+		case VK_PRIMITIVE_TOPOLOGY_LINE_STRIP_WITH_ADJACENCY:
+			return 1;
+		case VK_PRIMITIVE_TOPOLOGY_PATCH_LIST:
+			return 3;
+		default:
+			return 2;
+		}
+	}
+
+	bool HasStencil(VkFormat format)
+	{
+		return format == VK_FORMAT_S8_UINT || format == VK_FORMAT_D16_UNORM_S8_UINT
+			|| format == VK_FORMAT_D24_UNORM_S8_UINT || format == VK_FORMAT_D32_SFLOAT_S8_UINT;
+	}
+
+	/// All state of a pipeline description in Vulkan structs, parts pick what they need
+	struct PipelineStates
+	{
+		std::vector<VkPipelineShaderStageCreateInfo> Stages;
+		std::vector<VkShaderModuleCreateInfo> ModuleCis;
+		VkPipelineVertexInputStateCreateInfo VertexInput{ VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO };
+		VkPipelineInputAssemblyStateCreateInfo InputAssembly{ VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO };
+		VkPipelineTessellationStateCreateInfo Tessellation{ VK_STRUCTURE_TYPE_PIPELINE_TESSELLATION_STATE_CREATE_INFO };
+		VkPipelineViewportStateCreateInfo Viewport{ VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO };
+		VkPipelineRasterizationStateCreateInfo Rasterization{ VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO };
+		VkPipelineMultisampleStateCreateInfo Multisample{ VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO };
+		VkPipelineDepthStencilStateCreateInfo DepthStencil{ VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO };
+		std::vector<VkPipelineColorBlendAttachmentState> BlendAttachments;
+		VkPipelineColorBlendStateCreateInfo ColorBlend{ VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO };
+		std::vector<VkDynamicState> DynamicStates;
+		VkPipelineDynamicStateCreateInfo Dynamic{ VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO };
+		VkPipelineRenderingCreateInfo Rendering{ VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO };
+
+		PipelineStates() = default;
+		PipelineStates(const PipelineStates&) = delete;
+
+		void Fill(const GraphicsPipelineDesc& desc)
+		{
+			const VertexInputPart& vertexInput = desc.VertexInput;
+			VertexInput.vertexBindingDescriptionCount = static_cast<uint32_t>(vertexInput.Bindings.size());
+			VertexInput.pVertexBindingDescriptions = vertexInput.Bindings.data();
+			VertexInput.vertexAttributeDescriptionCount = static_cast<uint32_t>(vertexInput.Attributes.size());
+			VertexInput.pVertexAttributeDescriptions = vertexInput.Attributes.data();
+			InputAssembly.topology = vertexInput.Topology;
+			InputAssembly.primitiveRestartEnable = vertexInput.PrimitiveRestart;
+
+			const PreRasterizationPart& preRasterization = desc.PreRasterization;
+			Tessellation.patchControlPoints = preRasterization.PatchControlPoints;
+			Viewport.viewportCount = 1;
+			Viewport.scissorCount = 1;
+			Rasterization.polygonMode = preRasterization.PolygonMode;
+			Rasterization.cullMode = preRasterization.CullMode;
+			Rasterization.frontFace = preRasterization.FrontFace;
+			Rasterization.depthClampEnable = preRasterization.DepthClamp;
+			Rasterization.lineWidth = 1.0f;
+
+			const FragmentPart& fragment = desc.Fragment;
+			DepthStencil.depthTestEnable = fragment.DepthTest;
+			DepthStencil.depthWriteEnable = fragment.DepthWrite;
+			DepthStencil.depthCompareOp = fragment.DepthCompare;
+			DepthStencil.maxDepthBounds = 1.0f;
+
+			const OutputPart& output = desc.Output;
+			Multisample.rasterizationSamples = output.Samples;
+
+			VkPipelineColorBlendAttachmentState opaque{};
+			opaque.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+			BlendAttachments = output.Blend;
+			BlendAttachments.resize(desc.RenderTarget.ColorFormats.size(), opaque);
+			ColorBlend.attachmentCount = static_cast<uint32_t>(BlendAttachments.size());
+			ColorBlend.pAttachments = BlendAttachments.data();
+
+			const RenderTargetLayout& target = desc.RenderTarget;
+			Rendering.viewMask = target.ViewMask;
+			Rendering.colorAttachmentCount = static_cast<uint32_t>(target.ColorFormats.size());
+			Rendering.pColorAttachmentFormats = target.ColorFormats.data();
+			Rendering.depthAttachmentFormat = target.DepthFormat;
+			Rendering.stencilAttachmentFormat = HasStencil(target.DepthFormat) ? target.DepthFormat : VK_FORMAT_UNDEFINED;
+
+			// Stages point into the module infos, they must not move
+			ModuleCis.reserve(8);
+		}
+
+		bool AddStage(VkDevice device, ShaderLibrary* pShaderLibrary, const PipelineShaderStage& stage, const VkAllocationCallbacks* pAllocator)
+		{
+			if (!pShaderLibrary || ModuleCis.size() == ModuleCis.capacity())
+				return false;
+
+			ModuleCis.emplace_back();
+			Stages.emplace_back();
+			return pShaderLibrary->FillStage(device, stage.Name.c_str(), stage.Stage, stage.EntryPoint.c_str(), Stages.back(), ModuleCis.back(), pAllocator);
+		}
+
+		// Call once the dynamic states of every part being created were added
+		const VkPipelineDynamicStateCreateInfo* GetDynamic()
+		{
+			Dynamic.dynamicStateCount = static_cast<uint32_t>(DynamicStates.size());
+			Dynamic.pDynamicStates = DynamicStates.data();
+			return DynamicStates.empty() ? nullptr : &Dynamic;
+		}
+	};
+}
+
+GraphicsPipelineBuilder::~GraphicsPipelineBuilder()
+{
+	Destroy();
+}
+
+void SetColorBlendState(VkCommandBuffer cmd, const GraphicsPipelineDesc& desc)
+{
+	uint32_t attachmentCount = static_cast<uint32_t>(desc.RenderTarget.ColorFormats.size());
+	if (attachmentCount == 0)
+		return;
+
+	VkPipelineColorBlendAttachmentState opaque{};
+	opaque.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+	std::vector<VkBool32> blendEnables(attachmentCount);
+	std::vector<VkColorBlendEquationEXT> equations(attachmentCount);
+	std::vector<VkColorComponentFlags> writeMasks(attachmentCount);
+	for (uint32_t i = 0; i < attachmentCount; i++)
+	{
+		const VkPipelineColorBlendAttachmentState& blend = i < desc.Output.Blend.size() ? desc.Output.Blend[i] : opaque;
+		blendEnables[i] = blend.blendEnable;
+		equations[i] = { blend.srcColorBlendFactor, blend.dstColorBlendFactor, blend.colorBlendOp,
+			blend.srcAlphaBlendFactor, blend.dstAlphaBlendFactor, blend.alphaBlendOp };
+		writeMasks[i] = blend.colorWriteMask;
+	}
+	vkCmdSetColorBlendEnableEXT(cmd, 0, attachmentCount, blendEnables.data());
+	vkCmdSetColorBlendEquationEXT(cmd, 0, attachmentCount, equations.data());
+	vkCmdSetColorWriteMaskEXT(cmd, 0, attachmentCount, writeMasks.data());
+}
+
+void GraphicsPipelineBuilder::Init(VkDevice device, const VkAllocationCallbacks* pAllocator, ShaderLibrary* pShaderLibrary, bool useLibraries,
+	bool dynamicRendering, const DynamicStateSupport& dynamicState, uint32_t framesInFlight)
+{
+	m_Device = device;
+	m_pAllocator = pAllocator;
+	m_pShaderLibrary = pShaderLibrary;
+	m_UseLibraries = useLibraries;
+	m_DynamicRendering = dynamicRendering;
+	m_DynamicState = dynamicState;
+	m_FramesInFlight = framesInFlight;
+	m_StopOptimizing = false;
+
+	if (m_UseLibraries)
+		m_OptimizeThread = std::thread([this]() { OptimizeThread(); });
+}
+
+void GraphicsPipelineBuilder::Destroy()
+{
+	if (m_OptimizeThread.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_JobMutex);
+			m_StopOptimizing = true;
+		}
+		m_JobSignal.notify_all();
+		m_OptimizeThread.join();
+	}
+
+	if (m_Device == VK_NULL_HANDLE)
+		return;
+
+	// Only reached at shutdown, waiting here is cheaper than tracking the last frames
+	if (!m_Retired.empty())
+		vkDeviceWaitIdle(m_Device);
+	for (const RetiredPipeline& retired : m_Retired)
+		vkDestroyPipeline(m_Device, retired.Pipeline, m_pAllocator);
+	for (const auto& optimized : m_Optimized)
+		vkDestroyPipeline(m_Device, optimized.second, m_pAllocator);
+
+	// Linked pipelines go before the libraries they were linked from
+	for (const auto& pipeline : m_Pipelines)
+		vkDestroyPipeline(m_Device, pipeline.second.Pipeline, m_pAllocator);
+	for (const auto& library : m_Libraries)
+		vkDestroyPipeline(m_Device, library.second, m_pAllocator);
+
+	m_Retired.clear();
+	m_Optimized.clear();
+	m_Jobs.clear();
+	m_Pipelines.clear();
+	m_Libraries.clear();
+	m_Device = VK_NULL_HANDLE;
+}
+
+bool GraphicsPipelineBuilder::Precompile(const GraphicsPipelineDesc& desc)
+{
+	if (!CheckRenderTarget(desc))
+		return false;
+	if (!m_UseLibraries)
+		return true;
+
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	bool success = true;
+	for (uint32_t part = 0; part < static_cast<uint32_t>(PartType::Count); part++)
+		success &= GetLibraryLocked(static_cast<PartType>(part), desc) != VK_NULL_HANDLE;
+	return success;
+}
+
+VkPipeline GraphicsPipelineBuilder::GetPipeline(const GraphicsPipelineDesc& desc)
+{
+	if (!CheckRenderTarget(desc))
+		return VK_NULL_HANDLE;
+
+	std::string key;
+	for (uint32_t part = 0; part < static_cast<uint32_t>(PartType::Count); part++)
+		WriteKey(key, PartKey(static_cast<PartType>(part), desc));
+
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	auto it = m_Pipelines.find(key);
+	if (it != m_Pipelines.end())
+		return it->second.Pipeline;
+
+	CachedPipeline cached{};
+	if (!m_UseLibraries)
+	{
+		cached.Pipeline = CreateMonolithic(desc);
+		if (cached.Pipeline != VK_NULL_HANDLE)
+			m_Pipelines.emplace(key, cached);
+		return cached.Pipeline;
+	}
+
+	for (uint32_t part = 0; part < static_cast<uint32_t>(PartType::Count); part++)
+	{
+		cached.Libraries[part] = GetLibraryLocked(static_cast<PartType>(part), desc);
+		if (cached.Libraries[part] == VK_NULL_HANDLE)
+			return VK_NULL_HANDLE;
+	}
+
+	// Usable right away, the optimized link replaces it once the background thread finished it
+	cached.Pipeline = Link(cached.Libraries, desc.Layout, false);
+	if (cached.Pipeline == VK_NULL_HANDLE)
+		return VK_NULL_HANDLE;
+	m_Pipelines.emplace(key, cached);
+
+	OptimizeJob job{};
+	job.Key = key;
+	job.Layout = desc.Layout;
+	for (uint32_t part = 0; part < static_cast<uint32_t>(PartType::Count); part++)
+		job.Libraries[part] = cached.Libraries[part];
+	{
+		std::lock_guard<std::mutex> jobLock(m_JobMutex);
+		m_Jobs.push_back(std::move(job));
+	}
+	m_JobSignal.notify_one();
+
+	return cached.Pipeline;
+}
+
+bool GraphicsPipelineBuilder::CheckRenderTarget(const GraphicsPipelineDesc& desc) const
+{
+	// Without a render pass the pipeline chains VkPipelineRenderingCreateInfo
+	if (desc.RenderTarget.RenderPass == VK_NULL_HANDLE && !m_DynamicRendering)
+	{
+		printf("Graphics pipeline needs a render pass, dynamicRendering is not enabled\n");
+		return false;
+	}
+	return true;
+}
+
+void GraphicsPipelineBuilder::SetDynamicState(VkCommandBuffer cmd, const GraphicsPipelineDesc& desc) const
+{
+	if (m_DynamicState.ExtendedDynamicState)
+	{
+		vkCmdSetPrimitiveTopology(cmd, desc.VertexInput.Topology);
+		vkCmdSetCullMode(cmd, desc.PreRasterization.CullMode);
+		vkCmdSetFrontFace(cmd, desc.PreRasterization.FrontFace);
+		vkCmdSetDepthTestEnable(cmd, desc.Fragment.DepthTest);
+		vkCmdSetDepthWriteEnable(cmd, desc.Fragment.DepthWrite);
+		vkCmdSetDepthCompareOp(cmd, desc.Fragment.DepthCompare);
+	}
+	if (m_DynamicState.ExtendedDynamicState2)
+		vkCmdSetPrimitiveRestartEnable(cmd, desc.VertexInput.PrimitiveRestart);
+	if (m_DynamicState.PatchControlPoints && desc.PreRasterization.PatchControlPoints > 0)
+		vkCmdSetPatchControlPointsEXT(cmd, desc.PreRasterization.PatchControlPoints);
+	if (m_DynamicState.PolygonMode)
+		vkCmdSetPolygonModeEXT(cmd, desc.PreRasterization.PolygonMode);
+	if (m_DynamicState.DepthClamp)
+		vkCmdSetDepthClampEnableEXT(cmd, desc.PreRasterization.DepthClamp);
+	if (m_DynamicState.ColorBlend)
+		SetColorBlendState(cmd, desc);
+}
+
+void GraphicsPipelineBuilder::BeginFrame()
+{
+	m_Frame++;
+
+	// Replaced before frame F means last recorded in frame F - 1, retired once the client waited for its slot again
+	size_t kept = 0;
+	for (const RetiredPipeline& retired : m_Retired)
+	{
+		if (m_Frame - retired.Frame > m_FramesInFlight)
+			vkDestroyPipeline(m_Device, retired.Pipeline, m_pAllocator);
+		else
+			m_Retired[kept++] = retired;
+	}
+	m_Retired.resize(kept);
+
+	std::vector<std::pair<std::string, VkPipeline>> optimized;
+	{
+		std::lock_guard<std::mutex> lock(m_JobMutex);
+		optimized.swap(m_Optimized);
+	}
+	if (optimized.empty())
+		return;
+
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	for (auto& pipeline : optimized)
+	{
+		CachedPipeline& cached = m_Pipelines[pipeline.first];
+		if (cached.Pipeline != VK_NULL_HANDLE)
+			m_Retired.push_back({ cached.Pipeline, m_Frame });
+		cached.Pipeline = pipeline.second;
+		cached.Optimized = true;
+	}
+}
+
+std::string GraphicsPipelineBuilder::PartKey(PartType part, const GraphicsPipelineDesc& desc) const
+{
+	// Dynamic state stays out of the key, descriptions differing only in it share a pipeline
+	const DynamicStateSupport& dynamic = m_DynamicState;
+	std::string key;
+	WriteKey(key, part);
+	switch (part)
+	{
+	case PartType::VertexInput:
+		WriteKey(key, desc.VertexInput.Bindings);
+		WriteKey(key, desc.VertexInput.Attributes);
+		if (!dynamic.ExtendedDynamicState)
+			WriteKey(key, desc.VertexInput.Topology);
+		else if (!dynamic.UnrestrictedTopology)
+			WriteKey(key, TopologyClass(desc.VertexInput.Topology));
+		if (!dynamic.ExtendedDynamicState2)
+			WriteKey(key, desc.VertexInput.PrimitiveRestart);
+		break;
+	case PartType::PreRasterization:
+		WriteKey(key, desc.PreRasterization.Stages.size());
+		for (const PipelineShaderStage& stage : desc.PreRasterization.Stages)
+			WriteKey(key, stage);
+		if (!dynamic.PolygonMode)
+			WriteKey(key, desc.PreRasterization.PolygonMode);
+		if (!dynamic.ExtendedDynamicState)
+		{
+			WriteKey(key, desc.PreRasterization.CullMode);
+			WriteKey(key, desc.PreRasterization.FrontFace);
+		}
+		if (!dynamic.DepthClamp)
+			WriteKey(key, desc.PreRasterization.DepthClamp);
+		// Tessellation on or off changes the stages, only the count is dynamic
+		if (!dynamic.PatchControlPoints)
+			WriteKey(key, desc.PreRasterization.PatchControlPoints);
+		else
+			WriteKey(key, desc.PreRasterization.PatchControlPoints > 0);
+		WriteKey(key, desc.Layout);
+		WritePassKey(key, desc.RenderTarget);
+		break;
+	case PartType::Fragment:
+		WriteKey(key, desc.Fragment.Shader);
+		if (!dynamic.ExtendedDynamicState)
+		{
+			WriteKey(key, desc.Fragment.DepthTest);
+			WriteKey(key, desc.Fragment.DepthWrite);
+			WriteKey(key, desc.Fragment.DepthCompare);
+		}
+		WriteKey(key, desc.Output.Samples);
+		WriteKey(key, desc.Layout);
+		WritePassKey(key, desc.RenderTarget);
+		break;
+	case PartType::Output:
+		if (!dynamic.ColorBlend)
+			WriteKey(key, desc.Output.Blend);
+		WriteKey(key, desc.Output.Samples);
+		WriteKey(key, desc.RenderTarget.ColorFormats);
+		WriteKey(key, desc.RenderTarget.DepthFormat);
+		WritePassKey(key, desc.RenderTarget);
+		break;
+	default:
+		break;
+	}
+	return key;
+}
+
+void GraphicsPipelineBuilder::AddDynamicStates(PartType part, std::vector<VkDynamicState>& states) const
+{
+	const DynamicStateSupport& dynamic = m_DynamicState;
+	switch (part)
+	{
+	case PartType::VertexInput:
+		if (dynamic.ExtendedDynamicState)
+			states.push_back(VK_DYNAMIC_STATE_PRIMITIVE_TOPOLOGY);
+		if (dynamic.ExtendedDynamicState2)
+			states.push_back(VK_DYNAMIC_STATE_PRIMITIVE_RESTART_ENABLE);
+		break;
+	case PartType::PreRasterization:
+		states.push_back(VK_DYNAMIC_STATE_VIEWPORT);
+		states.push_back(VK_DYNAMIC_STATE_SCISSOR);
+		if (dynamic.ExtendedDynamicState)
+		{
+			states.push_back(VK_DYNAMIC_STATE_CULL_MODE);
+			states.push_back(VK_DYNAMIC_STATE_FRONT_FACE);
+		}
+		if (dynamic.PatchControlPoints)
+			states.push_back(VK_DYNAMIC_STATE_PATCH_CONTROL_POINTS_EXT);
+		if (dynamic.PolygonMode)
+			states.push_back(VK_DYNAMIC_STATE_POLYGON_MODE_EXT);
+		if (dynamic.DepthClamp)
+			states.push_back(VK_DYNAMIC_STATE_DEPTH_CLAMP_ENABLE_EXT);
+		break;
+	case PartType::Fragment:
+		if (dynamic.ExtendedDynamicState)
+		{
+			states.push_back(VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE);
+			states.push_back(VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE);
+			states.push_back(VK_DYNAMIC_STATE_DEPTH_COMPARE_OP);
+		}
+		break;
+	case PartType::Output:
+		if (dynamic.ColorBlend)
+		{
+			states.push_back(VK_DYNAMIC_STATE_COLOR_BLEND_ENABLE_EXT);
+			states.push_back(VK_DYNAMIC_STATE_COLOR_BLEND_EQUATION_EXT);
+			states.push_back(VK_DYNAMIC_STATE_COLOR_WRITE_MASK_EXT);
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+VkPipeline GraphicsPipelineBuilder::GetLibraryLocked(PartType part, const GraphicsPipelineDesc& desc)
+{
+	std::string key = PartKey(part, desc);
+	auto it = m_Libraries.find(key);
+	if (it != m_Libraries.end())
+		return it->second;
+
+	VkPipeline library = CreateLibrary(part, desc);
+	if (library != VK_NULL_HANDLE)
+		m_Libraries.emplace(std::move(key), library);
+	return library;
+}
+
+VkPipeline GraphicsPipelineBuilder::CreateLibrary(PartType part, const GraphicsPipelineDesc& desc)
+{
+	PipelineStates states;
+	states.Fill(desc);
+
+	VkGraphicsPipelineLibraryCreateInfoEXT libraryCi{};
+	libraryCi.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_LIBRARY_CREATE_INFO_EXT;
+	libraryCi.pNext = desc.RenderTarget.RenderPass == VK_NULL_HANDLE ? &states.Rendering : nullptr;
+
+	// Link time optimization info is retained so the background link can optimize across parts
+	VkGraphicsPipelineCreateInfo ci{};
+	ci.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	ci.pNext = &libraryCi;
+	ci.flags = VK_PIPELINE_CREATE_LIBRARY_BIT_KHR | VK_PIPELINE_CREATE_RETAIN_LINK_TIME_OPTIMIZATION_INFO_BIT_EXT;
+
+	switch (part)
+	{
+	case PartType::VertexInput:
+		libraryCi.flags = VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT;
+		ci.pVertexInputState = &states.VertexInput;
+		ci.pInputAssemblyState = &states.InputAssembly;
+		break;
+	case PartType::PreRasterization:
+		libraryCi.flags = VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT;
+		for (const PipelineShaderStage& stage : desc.PreRasterization.Stages)
+		{
+			if (!states.AddStage(m_Device, m_pShaderLibrary, stage, m_pAllocator))
+				return VK_NULL_HANDLE;
+		}
+		ci.pTessellationState = desc.PreRasterization.PatchControlPoints > 0 ? &states.Tessellation : nullptr;
+		ci.pViewportState = &states.Viewport;
+		ci.pRasterizationState = &states.Rasterization;
+		ci.layout = desc.Layout;
+		break;
+	case PartType::Fragment:
+		libraryCi.flags = VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT;
+		if (!states.AddStage(m_Device, m_pShaderLibrary, desc.Fragment.Shader, m_pAllocator))
+			return VK_NULL_HANDLE;
+		ci.pDepthStencilState = &states.DepthStencil;
+		ci.pMultisampleState = &states.Multisample;
+		ci.layout = desc.Layout;
+		break;
+	case PartType::Output:
+		libraryCi.flags = VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT;
+		ci.pColorBlendState = &states.ColorBlend;
+		ci.pMultisampleState = &states.Multisample;
+		break;
+	default:
+		return VK_NULL_HANDLE;
+	}
+
+	AddDynamicStates(part, states.DynamicStates);
+	ci.pDynamicState = states.GetDynamic();
+	ci.stageCount = static_cast<uint32_t>(states.Stages.size());
+	ci.pStages = states.Stages.empty() ? nullptr : states.Stages.data();
+	ci.renderPass = desc.RenderTarget.RenderPass;
+	ci.subpass = desc.RenderTarget.Subpass;
+
+	VkPipeline library = VK_NULL_HANDLE;
+	if (vkCreateGraphicsPipelines(m_Device, VK_NULL_HANDLE, 1, &ci, m_pAllocator, &library) != VK_SUCCESS)
+	{
+		printf("Failed to create pipeline library part %u\n", static_cast<uint32_t>(part));
+		return VK_NULL_HANDLE;
+	}
+	return library;
+}
+
+VkPipeline GraphicsPipelineBuilder::CreateMonolithic(const GraphicsPipelineDesc& desc)
+{
+	PipelineStates states;
+	states.Fill(desc);
+	for (const PipelineShaderStage& stage : desc.PreRasterization.Stages)
+	{
+		if (!states.AddStage(m_Device, m_pShaderLibrary, stage, m_pAllocator))
+			return VK_NULL_HANDLE;
+	}
+	if (!states.AddStage(m_Device, m_pShaderLibrary, desc.Fragment.Shader, m_pAllocator))
+		return VK_NULL_HANDLE;
+	for (uint32_t part = 0; part < static_cast<uint32_t>(PartType::Count); part++)
+		AddDynamicStates(static_cast<PartType>(part), states.DynamicStates);
+
+	VkGraphicsPipelineCreateInfo ci{};
+	ci.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	ci.pNext = desc.RenderTarget.RenderPass == VK_NULL_HANDLE ? &states.Rendering : nullptr;
+	ci.stageCount = static_cast<uint32_t>(states.Stages.size());
+	ci.pStages = states.Stages.data();
+	ci.pVertexInputState = &states.VertexInput;
+	ci.pInputAssemblyState = &states.InputAssembly;
+	ci.pTessellationState = desc.PreRasterization.PatchControlPoints > 0 ? &states.Tessellation : nullptr;
+	ci.pViewportState = &states.Viewport;
+	ci.pRasterizationState = &states.Rasterization;
+	ci.pMultisampleState = &states.Multisample;
+	ci.pDepthStencilState = &states.DepthStencil;
+	ci.pColorBlendState = &states.ColorBlend;
+	ci.pDynamicState = states.GetDynamic();
+	ci.layout = desc.Layout;
+	ci.renderPass = desc.RenderTarget.RenderPass;
+	ci.subpass = desc.RenderTarget.Subpass;
+
+	VkPipeline pipeline = VK_NULL_HANDLE;
+	if (vkCreateGraphicsPipelines(m_Device, VK_NULL_HANDLE, 1, &ci, m_pAllocator, &pipeline) != VK_SUCCESS)
+	{
+		printf("Failed to create graphics pipeline\n");
+		return VK_NULL_HANDLE;
+	}
+	return pipeline;
+}
+
+VkPipeline GraphicsPipelineBuilder::Link(const VkPipeline* pLibraries, VkPipelineLayout layout, bool optimize)
+{
+	VkPipelineLibraryCreateInfoKHR libraryCi{};
+	libraryCi.sType = VK_STRUCTURE_TYPE_PIPELINE_LIBRARY_CREATE_INFO_KHR;
+	libraryCi.libraryCount = static_cast<uint32_t>(PartType::Count);
+	libraryCi.pLibraries = pLibraries;
+
+	VkGraphicsPipelineCreateInfo ci{};
+	ci.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	ci.pNext = &libraryCi;
+	ci.flags = optimize ? VK_PIPELINE_CREATE_LINK_TIME_OPTIMIZATION_BIT_EXT : 0;
+	ci.layout = layout;
+
+	VkPipeline pipeline = VK_NULL_HANDLE;
+	if (vkCreateGraphicsPipelines(m_Device, VK_NULL_HANDLE, 1, &ci, m_pAllocator, &pipeline) != VK_SUCCESS)
+	{
+		printf("Failed to link graphics pipeline%s\n", optimize ? " with link time optimization" : "");
+		return VK_NULL_HANDLE;
+	}
+	return pipeline;
+}
+
+void GraphicsPipelineBuilder::OptimizeThread()
+{
+	std::unique_lock<std::mutex> lock(m_JobMutex);
+	while (true)
+	{
+		m_JobSignal.wait(lock, [this]() { return m_StopOptimizing || !m_Jobs.empty(); });
+		if (m_StopOptimizing)
+			break;
+
+		OptimizeJob job = std::move(m_Jobs.front());
+		m_Jobs.erase(m_Jobs.begin());
+
+		lock.unlock();
+		VkPipeline pipeline = Link(job.Libraries, job.Layout, true);
+		lock.lock();
+
+		// The fast-linked pipeline stays in use when optimizing fails
+		if (pipeline != VK_NULL_HANDLE)
+			m_Optimized.emplace_back(std::move(job.Key), pipeline);
+	}
+}
@@ -0,0 +1,236 @@
+#pragma once
+
+#include "../Loader/Loader.h"
+#include "../Shaders/ShaderLibrary.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+struct PipelineShaderStage
+{
+	VkShaderStageFlagBits Stage = VK_SHADER_STAGE_VERTEX_BIT;
+	/// <summary>
+	/// Name of the module in the ShaderLibrary
+	/// </summary>
+	std::string Name = {};
+	std::string EntryPoint = "main";
+};
+
+/// <summary>
+/// Attachments the pipeline renders to. Without a render pass dynamic rendering is used,
+/// which needs the dynamicRendering feature, GraphicsPipelineBuilder refuses such targets when it is not enabled
+/// </summary>
+struct RenderTargetLayout
+{
+	VkRenderPass RenderPass = VK_NULL_HANDLE;
+	uint32_t Subpass = 0;
+	std::vector<VkFormat> ColorFormats = {};
+	VkFormat DepthFormat = VK_FORMAT_UNDEFINED;
+	uint32_t ViewMask = 0;
+};
+
+struct VertexInputPart
+{
+	std::vector<VkVertexInputBindingDescription> Bindings = {};
+	std::vector<VkVertexInputAttributeDescription> Attributes = {};
+	VkPrimitiveTopology Topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+	bool PrimitiveRestart = false;
+};
+
+struct PreRasterizationPart
+{
+	/// <summary>
+	/// Vertex, tessellation and geometry stages
+	/// </summary>
+	std::vector<PipelineShaderStage> Stages = {};
+	VkPolygonMode PolygonMode = VK_POLYGON_MODE_FILL;
+	VkCullModeFlags CullMode = VK_CULL_MODE_BACK_BIT;
+	VkFrontFace FrontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+	bool DepthClamp = false;
+	uint32_t PatchControlPoints = 0;
+};
+
+struct FragmentPart
+{
+	PipelineShaderStage Shader = { VK_SHADER_STAGE_FRAGMENT_BIT };
+	bool DepthTest = true;
+	bool DepthWrite = true;
+	VkCompareOp DepthCompare = VK_COMPARE_OP_LESS_OR_EQUAL;
+};
+
+struct OutputPart
+{
+	/// <summary>
+	/// One per color attachment, attachments without an entry write opaque
+	/// </summary>
+	std::vector<VkPipelineColorBlendAttachmentState> Blend = {};
+	VkSampleCountFlagBits Samples = VK_SAMPLE_COUNT_1_BIT;
+};
+
+/// <summary>
+/// Complete graphics pipeline split into the four parts of VK_EXT_graphics_pipeline_library.
+/// Viewport and scissor are always dynamic, other state is when the device supports it, see DynamicStateSupport
+/// </summary>
+struct GraphicsPipelineDesc
+{
+	VertexInputPart VertexInput = {};
+	PreRasterizationPart PreRasterization = {};
+	FragmentPart Fragment = {};
+	OutputPart Output = {};
+	VkPipelineLayout Layout = VK_NULL_HANDLE;
+	RenderTargetLayout RenderTarget = {};
+};
+
+/// <summary>
+/// Pipeline state the device can set on the command buffer. GraphicsPipelineBuilder leaves it out of pipelines
+/// and their keys, so descriptions differing only in this state share one pipeline
+/// </summary>
+struct DynamicStateSupport
+{
+	/// <summary>
+	/// Extended dynamic state, core in 1.3: topology within its class, cull mode, front face, depth test, write and compare op
+	/// </summary>
+	bool ExtendedDynamicState = false;
+	/// <summary>
+	/// Extended dynamic state 2, core in 1.3: primitive restart
+	/// </summary>
+	bool ExtendedDynamicState2 = false;
+	bool PatchControlPoints = false;
+	/// <summary>
+	/// Topology may also change between points, lines, triangles and patches
+	/// </summary>
+	bool UnrestrictedTopology = false;
+	/// <summary>
+	/// Extended dynamic state 3
+	/// </summary>
+	bool PolygonMode = false;
+	bool DepthClamp = false;
+	/// <summary>
+	/// Blend enable, blend equation and color write mask
+	/// </summary>
+	bool ColorBlend = false;
+};
+
+/// <summary>
+/// Records the blend state of every color attachment of desc with the extended dynamic state 3 commands
+/// </summary>
+void SetColorBlendState(VkCommandBuffer cmd, const GraphicsPipelineDesc& desc);
+
+/// <summary>
+/// Creates and caches graphics pipelines. With graphics pipeline libraries each part is compiled once and shared by
+/// every pipeline using it, new combinations are fast-linked on first use and replaced by a link time optimized
+/// pipeline built on a background thread. Without libraries pipelines are created whole on first use.
+/// Thread safe
+/// </summary>
+class GraphicsPipelineBuilder
+{
+public:
+	GraphicsPipelineBuilder() = default;
+	~GraphicsPipelineBuilder();
+
+	GraphicsPipelineBuilder(const GraphicsPipelineBuilder&) = delete;
+	GraphicsPipelineBuilder& operator=(const GraphicsPipelineBuilder&) = delete;
+
+	void Init(VkDevice device, const VkAllocationCallbacks* pAllocator, ShaderLibrary* pShaderLibrary, bool useLibraries,
+		bool dynamicRendering, const DynamicStateSupport& dynamicState, uint32_t framesInFlight);
+	void Destroy();
+
+	bool UsesLibraries() const { return m_UseLibraries; }
+	bool SupportsDynamicRendering() const { return m_DynamicRendering; }
+	const DynamicStateSupport& GetDynamicState() const { return m_DynamicState; }
+
+	/// <summary>
+	/// Compiles the library parts of a pipeline ahead of time, so GetPipeline only has to link them.
+	/// Does nothing without library support
+	/// </summary>
+	bool Precompile(const GraphicsPipelineDesc& desc);
+
+	/// <summary>
+	/// Returns the cached pipeline or creates it. The handle may be replaced by an optimized pipeline in a later
+	/// frame, fetch it every frame instead of storing it
+	/// </summary>
+	VkPipeline GetPipeline(const GraphicsPipelineDesc& desc);
+
+	/// <summary>
+	/// Records the state of desc that pipelines leave dynamic. Call after binding the pipeline of desc
+	/// </summary>
+	void SetDynamicState(VkCommandBuffer cmd, const GraphicsPipelineDesc& desc) const;
+
+	/// <summary>
+	/// Swaps optimized pipelines in and destroys replaced ones that are no longer in flight.
+	/// Call from the render thread between frames
+	/// </summary>
+	void BeginFrame();
+
+	size_t GetLibraryCount() const { return m_Libraries.size(); }
+	size_t GetPipelineCount() const { return m_Pipelines.size(); }
+
+private:
+	enum class PartType : uint32_t
+	{
+		VertexInput,
+		PreRasterization,
+		Fragment,
+		Output,
+		Count
+	};
+
+	struct CachedPipeline
+	{
+		VkPipeline Pipeline = VK_NULL_HANDLE;
+		VkPipeline Libraries[static_cast<size_t>(PartType::Count)] = {};
+		bool Optimized = false;
+	};
+
+	struct OptimizeJob
+	{
+		std::string Key;
+		VkPipeline Libraries[static_cast<size_t>(PartType::Count)];
+		VkPipelineLayout Layout;
+	};
+
+	struct RetiredPipeline
+	{
+		VkPipeline Pipeline;
+		uint64_t Frame;
+	};
+
+	bool CheckRenderTarget(const GraphicsPipelineDesc& desc) const;
+	std::string PartKey(PartType part, const GraphicsPipelineDesc& desc) const;
+	void AddDynamicStates(PartType part, std::vector<VkDynamicState>& states) const;
+
+	VkPipeline GetLibraryLocked(PartType part, const GraphicsPipelineDesc& desc);
+	VkPipeline CreateLibrary(PartType part, const GraphicsPipelineDesc& desc);
+	VkPipeline CreateMonolithic(const GraphicsPipelineDesc& desc);
+	VkPipeline Link(const VkPipeline* pLibraries, VkPipelineLayout layout, bool optimize);
+
+	void OptimizeThread();
+
+private:
+	VkDevice m_Device = VK_NULL_HANDLE;
+	const VkAllocationCallbacks* m_pAllocator = nullptr;
+	ShaderLibrary* m_pShaderLibrary = nullptr;
+	bool m_UseLibraries = false;
+	bool m_DynamicRendering = false;
+	DynamicStateSupport m_DynamicState = {};
+	uint32_t m_FramesInFlight = 2;
+
+	std::mutex m_Mutex;
+	std::unordered_map<std::string, VkPipeline> m_Libraries = {};
+	std::unordered_map<std::string, CachedPipeline> m_Pipelines = {};
+
+	std::thread m_OptimizeThread;
+	std::mutex m_JobMutex;
+	std::condition_variable m_JobSignal;
+	std::vector<OptimizeJob> m_Jobs = {};
+	std::vector<std::pair<std::string, VkPipeline>> m_Optimized = {};
+	bool m_StopOptimizing = false;
+
+	// Render thread only
+	std::vector<RetiredPipeline> m_Retired = {};
+	uint64_t m_Frame = 0;
+};
@@ -0,0 +1,352 @@
+#include "ShaderObjectBenchmark.h"
+
+#include <chrono>
+#include <stdio.h>
+#include <vector>
+
+namespace
+{
+	// Hand assembled so the benchmark does not depend on the shader library.
+	// Vertex shader writing a constant gl_Position
+	const uint32_t VERTEX_SPIRV[] = {
+		0x07230203, 0x00010000, 0, 12, 0,
+		0x00020011, 1,									// OpCapability Shader
+		0x0003000E, 0, 1,								// OpMemoryModel Logical GLSL450
+		0x0006000F, 0, 1, 0x6E69616D, 0, 7,				// OpEntryPoint Vertex %1 "main" %7
+		0x00040047, 7, 11, 0,							// OpDecorate %7 BuiltIn Position
+		0x00020013, 2,									// %2 = OpTypeVoid
+		0x00030021, 3, 2,								// %3 = OpTypeFunction %2
+		0x00030016, 4, 32,								// %4 = OpTypeFloat 32
+		0x00040017, 5, 4, 4,							// %5 = OpTypeVector %4 4
+		0x00040020, 6, 3, 5,							// %6 = OpTypePointer Output %5
+		0x0004003B, 6, 7, 3,							// %7 = OpVariable %6 Output
+		0x0004002B, 4, 8, 0x00000000,					// %8 = OpConstant %4 0.0
+		0x0004002B, 4, 9, 0x3F800000,					// %9 = OpConstant %4 1.0
+		0x0007002C, 5, 10, 8, 8, 8, 9,					// %10 = OpConstantComposite %5 %8 %8 %8 %9
+		0x00050036, 2, 1, 0, 3,							// %1 = OpFunction %2 None %3
+		0x000200F8, 11,									// %11 = OpLabel
+		0x0003003E, 7, 10,								// OpStore %7 %10
+		0x000100FD,										// OpReturn
+		0x00010038,										// OpFunctionEnd
+	};
+
+	// Fragment shader writing a constant color to location 0
+	const uint32_t FRAGMENT_SPIRV[] = {
+		0x07230203, 0x00010000, 0, 12, 0,
+		0x00020011, 1,									// OpCapability Shader
+		0x0003000E, 0, 1,								// OpMemoryModel Logical GLSL450
+		0x0006000F, 4, 1, 0x6E69616D, 0, 7,				// OpEntryPoint Fragment %1 "main" %7
+		0x00030010, 1, 7,								// OpExecutionMode %1 OriginUpperLeft
+		0x00040047, 7, 30, 0,							// OpDecorate %7 Location 0
+		0x00020013, 2,									// %2 = OpTypeVoid
+		0x00030021, 3, 2,								// %3 = OpTypeFunction %2
+		0x00030016, 4, 32,								// %4 = OpTypeFloat 32
+		0x00040017, 5, 4, 4,							// %5 = OpTypeVector %4 4
+		0x00040020, 6, 3, 5,							// %6 = OpTypePointer Output %5
+		0x0004003B, 6, 7, 3,							// %7 = OpVariable %6 Output
+		0x0004002B, 4, 8, 0x00000000,					// %8 = OpConstant %4 0.0
+		0x0004002B, 4, 9, 0x3F800000,					// %9 = OpConstant %4 1.0
+		0x0007002C, 5, 10, 9, 8, 9, 9,					// %10 = OpConstantComposite %5 %9 %8 %9 %9
+		0x00050036, 2, 1, 0, 3,							// %1 = OpFunction %2 None %3
+		0x000200F8, 11,									// %11 = OpLabel
+		0x0003003E, 7, 10,								// OpStore %7 %10
+		0x000100FD,										// OpReturn
+		0x00010038,										// OpFunctionEnd
+	};
+
+	const VkFormat COLOR_FORMAT = VK_FORMAT_R8G8B8A8_UNORM;
+	// The only depth format every device supports
+	const VkFormat DEPTH_FORMAT = VK_FORMAT_D16_UNORM;
+
+	const VkCullModeFlags CULL_MODES[] = { VK_CULL_MODE_NONE, VK_CULL_MODE_FRONT_BIT, VK_CULL_MODE_BACK_BIT, VK_CULL_MODE_FRONT_AND_BACK };
+	const VkFrontFace FRONT_FACES[] = { VK_FRONT_FACE_COUNTER_CLOCKWISE, VK_FRONT_FACE_CLOCKWISE };
+	const VkCompareOp COMPARE_OPS[] = { VK_COMPARE_OP_LESS, VK_COMPARE_OP_LESS_OR_EQUAL, VK_COMPARE_OP_GREATER, VK_COMPARE_OP_EQUAL };
+	const uint32_t COMBINATION_COUNT = 4 * 2 * 4;
+
+	struct StateCombination
+	{
+		VkCullModeFlags CullMode;
+		VkFrontFace FrontFace;
+		VkCompareOp DepthCompare;
+	};
+
+	StateCombination GetCombination(uint32_t index)
+	{
+		return { CULL_MODES[index % 4], FRONT_FACES[(index / 4) % 2], COMPARE_OPS[(index / 8) % 4] };
+	}
+
+	struct BenchmarkObjects
+	{
+		VkRenderPass RenderPass = VK_NULL_HANDLE;
+		VkPipelineLayout Layout = VK_NULL_HANDLE;
+		VkShaderModule Modules[2] = {};
+		std::vector<VkPipeline> Pipelines;
+		VkShaderEXT Shaders[2] = {};
+		VkCommandPool Pool = VK_NULL_HANDLE;
+		VkCommandBuffer Cmd = VK_NULL_HANDLE;
+
+		void Destroy(VkDevice device)
+		{
+			vkDestroyCommandPool(device, Pool, nullptr);
+			for (VkShaderEXT shader : Shaders)
+			{
+				if (shader != VK_NULL_HANDLE)
+					vkDestroyShaderEXT(device, shader, nullptr);
+			}
+			for (VkPipeline pipeline : Pipelines)
+				vkDestroyPipeline(device, pipeline, nullptr);
+			for (VkShaderModule module : Modules)
+				vkDestroyShaderModule(device, module, nullptr);
+			vkDestroyPipelineLayout(device, Layout, nullptr);
+			vkDestroyRenderPass(device, RenderPass, nullptr);
+		}
+	};
+
+	bool CreateRenderPass(VkDevice device, VkRenderPass* pRenderPass)
+	{
+		VkAttachmentDescription attachments[2]{};
+		attachments[0].format = COLOR_FORMAT;
+		attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
+		attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachments[0].finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		attachments[1] = attachments[0];
+		attachments[1].format = DEPTH_FORMAT;
+		attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+		VkAttachmentReference colorRef = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+		VkAttachmentReference depthRef = { 1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+
+		VkSubpassDescription subpass{};
+		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpass.colorAttachmentCount = 1;
+		subpass.pColorAttachments = &colorRef;
+		subpass.pDepthStencilAttachment = &depthRef;
+
+		VkRenderPassCreateInfo ci{};
+		ci.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+		ci.attachmentCount = 2;
+		ci.pAttachments = attachments;
+		ci.subpassCount = 1;
+		ci.pSubpasses = &subpass;
+		return vkCreateRenderPass(device, &ci, nullptr, pRenderPass) == VK_SUCCESS;
+	}
+
+	VkPipeline CreatePipeline(VkDevice device, const BenchmarkObjects& objects, const StateCombination& state)
+	{
+		VkPipelineShaderStageCreateInfo stages[2]{};
+		for (uint32_t i = 0; i < 2; i++)
+		{
+			stages[i].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+			stages[i].stage = i == 0 ? VK_SHADER_STAGE_VERTEX_BIT : VK_SHADER_STAGE_FRAGMENT_BIT;
+			stages[i].module = objects.Modules[i];
+			stages[i].pName = "main";
+		}
+
+		VkPipelineVertexInputStateCreateInfo vertexInput{ VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO };
+		VkPipelineInputAssemblyStateCreateInfo inputAssembly{ VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO };
+		inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+		VkPipelineViewportStateCreateInfo viewport{ VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO };
+		viewport.viewportCount = 1;
+		viewport.scissorCount = 1;
+		VkPipelineRasterizationStateCreateInfo rasterization{ VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO };
+		rasterization.polygonMode = VK_POLYGON_MODE_FILL;
+		rasterization.cullMode = state.CullMode;
+		rasterization.frontFace = state.FrontFace;
+		rasterization.lineWidth = 1.0f;
+		VkPipelineMultisampleStateCreateInfo multisample{ VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO };
+		multisample.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+		VkPipelineDepthStencilStateCreateInfo depthStencil{ VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO };
+		depthStencil.depthTestEnable = VK_TRUE;
+		depthStencil.depthWriteEnable = VK_TRUE;
+		depthStencil.depthCompareOp = state.DepthCompare;
+		depthStencil.maxDepthBounds = 1.0f;
+		VkPipelineColorBlendAttachmentState blend{};
+		blend.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+		VkPipelineColorBlendStateCreateInfo colorBlend{ VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO };
+		colorBlend.attachmentCount = 1;
+		colorBlend.pAttachments = &blend;
+		VkDynamicState dynamicStates[2] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+		VkPipelineDynamicStateCreateInfo dynamic{ VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO };
+		dynamic.dynamicStateCount = 2;
+		dynamic.pDynamicStates = dynamicStates;
+
+		VkGraphicsPipelineCreateInfo ci{};
+		ci.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+		ci.stageCount = 2;
+		ci.pStages = stages;
+		ci.pVertexInputState = &vertexInput;
+		ci.pInputAssemblyState = &inputAssembly;
+		ci.pViewportState = &viewport;
+		ci.pRasterizationState = &rasterization;
+		ci.pMultisampleState = &multisample;
+		ci.pDepthStencilState = &depthStencil;
+		ci.pColorBlendState = &colorBlend;
+		ci.pDynamicState = &dynamic;
+		ci.layout = objects.Layout;
+		ci.renderPass = objects.RenderPass;
+
+		VkPipeline pipeline = VK_NULL_HANDLE;
+		if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &ci, nullptr, &pipeline) != VK_SUCCESS)
+			return VK_NULL_HANDLE;
+		return pipeline;
+	}
+
+	bool CreatePipelines(VkDevice device, BenchmarkObjects& objects)
+	{
+		const uint32_t* pCode[2] = { VERTEX_SPIRV, FRAGMENT_SPIRV };
+		const size_t codeSize[2] = { sizeof(VERTEX_SPIRV), sizeof(FRAGMENT_SPIRV) };
+		for (uint32_t i = 0; i < 2; i++)
+		{
+			VkShaderModuleCreateInfo moduleCi{};
+			moduleCi.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+			moduleCi.codeSize = codeSize[i];
+			moduleCi.pCode = pCode[i];
+			if (vkCreateShaderModule(device, &moduleCi, nullptr, &objects.Modules[i]) != VK_SUCCESS)
+				return false;
+		}
+
+		// Every combination is a separate compile, as it would be when first used in a frame
+		for (uint32_t i = 0; i < COMBINATION_COUNT; i++)
+		{
+			VkPipeline pipeline = CreatePipeline(device, objects, GetCombination(i));
+			if (pipeline == VK_NULL_HANDLE)
+				return false;
+			objects.Pipelines.push_back(pipeline);
+		}
+		return true;
+	}
+
+	bool CreateShaders(VkDevice device, BenchmarkObjects& objects)
+	{
+		VkShaderCreateInfoEXT cis[2]{};
+		for (uint32_t i = 0; i < 2; i++)
+		{
+			cis[i].sType = VK_STRUCTURE_TYPE_SHADER_CREATE_INFO_EXT;
+			cis[i].flags = VK_SHADER_CREATE_LINK_STAGE_BIT_EXT;
+			cis[i].codeType = VK_SHADER_CODE_TYPE_SPIRV_EXT;
+			cis[i].pName = "main";
+		}
+		cis[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+		cis[0].nextStage = VK_SHADER_STAGE_FRAGMENT_BIT;
+		cis[0].codeSize = sizeof(VERTEX_SPIRV);
+		cis[0].pCode = VERTEX_SPIRV;
+		cis[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+		cis[1].codeSize = sizeof(FRAGMENT_SPIRV);
+		cis[1].pCode = FRAGMENT_SPIRV;
+
+		return vkCreateShadersEXT(device, 2, cis, nullptr, objects.Shaders) == VK_SUCCESS;
+	}
+
+	// Templated so the call into the recording lambda inlines and does not add to either path
+	template<typename BindFunction>
+	double RecordBinds(VkDevice device, const BenchmarkObjects& objects, uint32_t bindCount, const BindFunction& bind)
+	{
+		const uint32_t RUNS = 5;
+
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+		double best = 0.0;
+		for (uint32_t run = 0; run < RUNS; run++)
+		{
+			vkResetCommandPool(device, objects.Pool, 0);
+
+			auto start = std::chrono::high_resolution_clock::now();
+			vkBeginCommandBuffer(objects.Cmd, &beginInfo);
+			for (uint32_t i = 0; i < bindCount; i++)
+				bind(objects.Cmd, i % COMBINATION_COUNT);
+			vkEndCommandBuffer(objects.Cmd);
+			auto end = std::chrono::high_resolution_clock::now();
+
+			double ns = std::chrono::duration<double, std::nano>(end - start).count();
+			if (run == 0 || ns < best)
+				best = ns;
+		}
+
+		return best / static_cast<double>(bindCount);
+	}
+
+	double MillisecondsSince(std::chrono::high_resolution_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+}
+
+bool BenchmarkShaderObjects(VkDevice device, uint32_t queueFamily, uint32_t bindCount, ShaderObjectBenchmarkResult* pResult)
+{
+	if (!vkCreateShadersEXT || bindCount == 0)
+		return false;
+
+	BenchmarkObjects objects;
+	bool success = CreateRenderPass(device, &objects.RenderPass);
+
+	VkPipelineLayoutCreateInfo layoutCi{};
+	layoutCi.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	success = success && vkCreatePipelineLayout(device, &layoutCi, nullptr, &objects.Layout) == VK_SUCCESS;
+
+	VkCommandPoolCreateInfo poolCi{};
+	poolCi.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolCi.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+	poolCi.queueFamilyIndex = queueFamily;
+	success = success && vkCreateCommandPool(device, &poolCi, nullptr, &objects.Pool) == VK_SUCCESS;
+
+	VkCommandBufferAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.commandPool = objects.Pool;
+	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocInfo.commandBufferCount = 1;
+	success = success && vkAllocateCommandBuffers(device, &allocInfo, &objects.Cmd) == VK_SUCCESS;
+
+	// Shader objects first, so the pipelines cannot profit from shaders the driver cached for them
+	auto start = std::chrono::high_resolution_clock::now();
+	success = success && CreateShaders(device, objects);
+	pResult->ShaderObjectCompileMs = MillisecondsSince(start);
+
+	start = std::chrono::high_resolution_clock::now();
+	success = success && CreatePipelines(device, objects);
+	pResult->PipelineCompileMs = MillisecondsSince(start);
+	pResult->StateCombinations = COMBINATION_COUNT;
+
+	if (!success)
+	{
+		printf("Shader object benchmark failed to create its objects\n");
+		objects.Destroy(device);
+		return false;
+	}
+
+	auto bindPipeline = [&objects](VkCommandBuffer cmd, uint32_t combination)
+	{
+		vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, objects.Pipelines[combination]);
+	};
+
+	// A material switch rebinds the shaders and sets the state that is baked into the pipeline on the other path
+	const VkShaderStageFlagBits stages[2] = { VK_SHADER_STAGE_VERTEX_BIT, VK_SHADER_STAGE_FRAGMENT_BIT };
+	auto bindShaders = [&objects, &stages](VkCommandBuffer cmd, uint32_t combination)
+	{
+		StateCombination state = GetCombination(combination);
+		vkCmdBindShadersEXT(cmd, 2, stages, objects.Shaders);
+		vkCmdSetCullMode(cmd, state.CullMode);
+		vkCmdSetFrontFace(cmd, state.FrontFace);
+		vkCmdSetDepthCompareOp(cmd, state.DepthCompare);
+	};
+
+	// Interleaved so neither path profits from a warmer cache
+	pResult->PipelineBindNs = RecordBinds(device, objects, bindCount, bindPipeline);
+	pResult->ShaderObjectBindNs = RecordBinds(device, objects, bindCount, bindShaders);
+	double pipelineNs = RecordBinds(device, objects, bindCount, bindPipeline);
+	double shaderNs = RecordBinds(device, objects, bindCount, bindShaders);
+	pResult->PipelineBindNs = pipelineNs < pResult->PipelineBindNs ? pipelineNs : pResult->PipelineBindNs;
+	pResult->ShaderObjectBindNs = shaderNs < pResult->ShaderObjectBindNs ? shaderNs : pResult->ShaderObjectBindNs;
+
+	objects.Destroy(device);
+
+	printf("Shader object benchmark (%u state combinations): compile %.2f ms pipelines, %.2f ms shader objects\n",
+		pResult->StateCombinations, pResult->PipelineCompileMs, pResult->ShaderObjectCompileMs);
+	printf("Shader object benchmark (%u binds): %.2f ns/bind pipelines, %.2f ns/bind shader objects\n",
+		bindCount, pResult->PipelineBindNs, pResult->ShaderObjectBindNs);
+	return true;
+}
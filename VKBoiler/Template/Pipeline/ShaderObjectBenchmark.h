@@ -0,0 +1,23 @@
+#pragma once
+
+#include "../Loader/Loader.h"
+
+struct ShaderObjectBenchmarkResult
+{
+	/// <summary>
+	/// Combinations of cull mode, front face and depth compare op, each needs its own pipeline
+	/// </summary>
+	uint32_t StateCombinations = 0;
+	double PipelineCompileMs = 0.0;
+	double ShaderObjectCompileMs = 0.0;
+	double PipelineBindNs = 0.0;
+	double ShaderObjectBindNs = 0.0;
+};
+
+/// <summary>
+/// Compares pipelines against shader objects for the same trivial shaders. Compile time covers one pipeline per state
+/// combination versus one linked shader pair, bind cost covers recording a pipeline switch versus binding the shaders
+/// and setting the state that changed. The fastest of a few runs is reported to filter out scheduling noise.
+/// Needs shader objects to be enabled. Run on lavapipe for numbers comparable across machines
+/// </summary>
+bool BenchmarkShaderObjects(VkDevice device, uint32_t queueFamily, uint32_t bindCount, ShaderObjectBenchmarkResult* pResult);
@@ -0,0 +1,269 @@
+#include "ShaderObjects.h"
+
+#include "../Util/ByteKey.h"
+
+#include <algorithm>
+#include <stdio.h>
+
+#undef max
+#undef min
+
+namespace
+{
+	// Every graphics stage a draw may use, in pipeline order. Only those the device enabled may be named when binding
+	const VkShaderStageFlagBits GRAPHICS_STAGES[] = {
+		VK_SHADER_STAGE_VERTEX_BIT,
+		VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT,
+		VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT,
+		VK_SHADER_STAGE_GEOMETRY_BIT,
+		VK_SHADER_STAGE_TASK_BIT_EXT,
+		VK_SHADER_STAGE_MESH_BIT_EXT,
+		VK_SHADER_STAGE_FRAGMENT_BIT,
+	};
+	const uint32_t GRAPHICS_STAGE_COUNT = sizeof(GRAPHICS_STAGES) / sizeof(GRAPHICS_STAGES[0]);
+
+	uint32_t StageOrder(VkShaderStageFlagBits stage)
+	{
+		for (uint32_t i = 0; i < GRAPHICS_STAGE_COUNT; i++)
+		{
+			if (GRAPHICS_STAGES[i] == stage)
+				return i;
+		}
+		return GRAPHICS_STAGE_COUNT;
+	}
+}
+
+ShaderObjectCache::~ShaderObjectCache()
+{
+	Destroy();
+}
+
+void ShaderObjectCache::Init(VkDevice device, const VkAllocationCallbacks* pAllocator, ShaderLibrary* pShaderLibrary, LayoutCache* pLayoutCache, bool enabled,
+	VkShaderStageFlags graphicsStages)
+{
+	m_Device = device;
+	m_pAllocator = pAllocator;
+	m_pShaderLibrary = pShaderLibrary;
+	m_pLayoutCache = pLayoutCache;
+	m_Enabled = enabled;
+	m_GraphicsStages = graphicsStages | VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+}
+
+void ShaderObjectCache::Destroy()
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	for (auto& entry : m_Programs)
+	{
+		for (VkShaderEXT shader : entry.second.Shaders)
+			vkDestroyShaderEXT(m_Device, shader, m_pAllocator);
+	}
+	m_Programs.clear();
+}
+
+const ShaderProgram* ShaderObjectCache::GetProgram(const std::vector<PipelineShaderStage>& stages)
+{
+	if (!m_pShaderLibrary || !m_pLayoutCache)
+		return nullptr;
+
+	std::vector<ShaderReflection> reflections(stages.size());
+	std::vector<const ShaderReflection*> pReflections;
+	for (size_t i = 0; i < stages.size(); i++)
+	{
+		if (!m_pShaderLibrary->Reflect(stages[i].Name.c_str(), &reflections[i]))
+			return nullptr;
+		pReflections.push_back(&reflections[i]);
+	}
+
+	std::vector<VkDescriptorSetLayout> setLayouts;
+	std::vector<VkPushConstantRange> pushConstants;
+	if (!m_pLayoutCache->GetSetLayouts(pReflections, setLayouts, pushConstants))
+		return nullptr;
+	return GetProgram(stages, setLayouts, pushConstants);
+}
+
+const ShaderProgram* ShaderObjectCache::GetProgram(const std::vector<PipelineShaderStage>& stages,
+	const std::vector<VkDescriptorSetLayout>& setLayouts, const std::vector<VkPushConstantRange>& pushConstants)
+{
+	if (!m_Enabled)
+	{
+		printf("Shader objects are not enabled on this device\n");
+		return nullptr;
+	}
+
+	// Linking needs the stages in pipeline order, the key uses the same order
+	std::vector<PipelineShaderStage> sorted = stages;
+	std::sort(sorted.begin(), sorted.end(), [](const PipelineShaderStage& a, const PipelineShaderStage& b) { return StageOrder(a.Stage) < StageOrder(b.Stage); });
+
+	std::string key;
+	for (const PipelineShaderStage& stage : sorted)
+	{
+		WriteKey(key, stage.Stage);
+		WriteKey(key, stage.Name);
+		WriteKey(key, stage.EntryPoint);
+	}
+	WriteKey(key, setLayouts);
+	WriteKey(key, pushConstants);
+
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	auto it = m_Programs.find(key);
+	if (it != m_Programs.end())
+		return &it->second;
+
+	ShaderProgram program;
+	if (!Create(sorted, setLayouts, pushConstants, &program))
+		return nullptr;
+	return &m_Programs.emplace(std::move(key), std::move(program)).first->second;
+}
+
+const ShaderProgram* ShaderObjectCache::GetProgram(const GraphicsPipelineDesc& desc)
+{
+	std::vector<PipelineShaderStage> stages = desc.PreRasterization.Stages;
+	if (!desc.Fragment.Shader.Name.empty())
+		stages.push_back(desc.Fragment.Shader);
+	return GetProgram(stages);
+}
+
+bool ShaderObjectCache::Create(const std::vector<PipelineShaderStage>& stages, const std::vector<VkDescriptorSetLayout>& setLayouts,
+	const std::vector<VkPushConstantRange>& pushConstants, ShaderProgram* pProgram)
+{
+	if (stages.empty() || !m_pShaderLibrary || !m_pLayoutCache)
+		return false;
+
+	pProgram->Layout = m_pLayoutCache->GetPipelineLayout(setLayouts, pushConstants);
+	if (pProgram->Layout == VK_NULL_HANDLE)
+		return false;
+
+	bool compute = stages.size() == 1 && stages[0].Stage == VK_SHADER_STAGE_COMPUTE_BIT;
+	for (const PipelineShaderStage& stage : stages)
+	{
+		if (!compute && !(stage.Stage & m_GraphicsStages))
+		{
+			printf("Shader [\"%s\"] uses a stage the device did not enable\n", stage.Name.c_str());
+			return false;
+		}
+	}
+
+	bool hasTask = std::any_of(stages.begin(), stages.end(), [](const PipelineShaderStage& stage) { return stage.Stage == VK_SHADER_STAGE_TASK_BIT_EXT; });
+
+	std::vector<VkShaderCreateInfoEXT> shaderCis(stages.size());
+	for (size_t i = 0; i < stages.size(); i++)
+	{
+		ShaderBinary binary{};
+		if (!m_pShaderLibrary->Find(stages[i].Name.c_str(), &binary))
+		{
+			printf("Shader [\"%s\"] is not in the library\n", stages[i].Name.c_str());
+			return false;
+		}
+
+		VkShaderCreateInfoEXT& ci = shaderCis[i];
+		ci.sType = VK_STRUCTURE_TYPE_SHADER_CREATE_INFO_EXT;
+		// Linked stages let the driver optimize across interfaces like a pipeline would
+		ci.flags = stages.size() > 1 ? VK_SHADER_CREATE_LINK_STAGE_BIT_EXT : 0;
+		if (stages[i].Stage == VK_SHADER_STAGE_MESH_BIT_EXT && !hasTask)
+			ci.flags |= VK_SHADER_CREATE_NO_TASK_SHADER_BIT_EXT;
+		ci.stage = stages[i].Stage;
+		ci.nextStage = i + 1 < stages.size() ? stages[i + 1].Stage : 0;
+		ci.codeType = VK_SHADER_CODE_TYPE_SPIRV_EXT;
+		ci.codeSize = binary.Size;
+		ci.pCode = binary.pCode;
+		ci.pName = stages[i].EntryPoint.c_str();
+		ci.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+		ci.pSetLayouts = setLayouts.empty() ? nullptr : setLayouts.data();
+		ci.pushConstantRangeCount = static_cast<uint32_t>(pushConstants.size());
+		ci.pPushConstantRanges = pushConstants.empty() ? nullptr : pushConstants.data();
+	}
+
+	pProgram->Shaders.resize(stages.size(), VK_NULL_HANDLE);
+	VkResult result = vkCreateShadersEXT(m_Device, static_cast<uint32_t>(shaderCis.size()), shaderCis.data(), m_pAllocator, pProgram->Shaders.data());
+	if (result != VK_SUCCESS)
+	{
+		// Creation may fail part way, shaders that were created still have to go
+		for (VkShaderEXT shader : pProgram->Shaders)
+		{
+			if (shader != VK_NULL_HANDLE)
+				vkDestroyShaderEXT(m_Device, shader, m_pAllocator);
+		}
+		pProgram->Shaders.clear();
+		printf("Failed to create shader objects for [\"%s\"]\n", stages[0].Name.c_str());
+		return false;
+	}
+
+	for (const PipelineShaderStage& stage : stages)
+		pProgram->Stages.push_back(stage.Stage);
+	if (compute)
+		return true;
+
+	// Stages left bound from an earlier program would still run, Bind unbinds every enabled stage this one does not use
+	for (uint32_t order = 0; order < GRAPHICS_STAGE_COUNT; order++)
+	{
+		if (!(GRAPHICS_STAGES[order] & m_GraphicsStages))
+			continue;
+		auto it = std::find(pProgram->Stages.begin(), pProgram->Stages.end(), GRAPHICS_STAGES[order]);
+		pProgram->BindStages.push_back(GRAPHICS_STAGES[order]);
+		pProgram->BindShaders.push_back(it != pProgram->Stages.end() ? pProgram->Shaders[it - pProgram->Stages.begin()] : VK_NULL_HANDLE);
+	}
+	return true;
+}
+
+/*static*/void ShaderObjectCache::Bind(VkCommandBuffer cmd, const ShaderProgram& program)
+{
+	if (program.Stages.size() == 1 && program.Stages[0] == VK_SHADER_STAGE_COMPUTE_BIT)
+	{
+		vkCmdBindShadersEXT(cmd, 1, program.Stages.data(), program.Shaders.data());
+		return;
+	}
+
+	vkCmdBindShadersEXT(cmd, static_cast<uint32_t>(program.BindStages.size()), program.BindStages.data(), program.BindShaders.data());
+}
+
+/*static*/void ShaderObjectCache::SetState(VkCommandBuffer cmd, const GraphicsPipelineDesc& desc)
+{
+	const VertexInputPart& vertexInput = desc.VertexInput;
+	std::vector<VkVertexInputBindingDescription2EXT> bindings(vertexInput.Bindings.size());
+	for (size_t i = 0; i < bindings.size(); i++)
+	{
+		const VkVertexInputBindingDescription& binding = vertexInput.Bindings[i];
+		bindings[i] = { VK_STRUCTURE_TYPE_VERTEX_INPUT_BINDING_DESCRIPTION_2_EXT, nullptr, binding.binding, binding.stride, binding.inputRate, 1 };
+	}
+	std::vector<VkVertexInputAttributeDescription2EXT> attributes(vertexInput.Attributes.size());
+	for (size_t i = 0; i < attributes.size(); i++)
+	{
+		const VkVertexInputAttributeDescription& attribute = vertexInput.Attributes[i];
+		attributes[i] = { VK_STRUCTURE_TYPE_VERTEX_INPUT_ATTRIBUTE_DESCRIPTION_2_EXT, nullptr, attribute.location, attribute.binding, attribute.format, attribute.offset };
+	}
+	vkCmdSetVertexInputEXT(cmd, static_cast<uint32_t>(bindings.size()), bindings.empty() ? nullptr : bindings.data(),
+		static_cast<uint32_t>(attributes.size()), attributes.empty() ? nullptr : attributes.data());
+	vkCmdSetPrimitiveTopology(cmd, vertexInput.Topology);
+	vkCmdSetPrimitiveRestartEnable(cmd, vertexInput.PrimitiveRestart);
+
+	const PreRasterizationPart& preRasterization = desc.PreRasterization;
+	vkCmdSetRasterizerDiscardEnable(cmd, VK_FALSE);
+	vkCmdSetPolygonModeEXT(cmd, preRasterization.PolygonMode);
+	vkCmdSetCullMode(cmd, preRasterization.CullMode);
+	vkCmdSetFrontFace(cmd, preRasterization.FrontFace);
+	vkCmdSetDepthClampEnableEXT(cmd, preRasterization.DepthClamp);
+	vkCmdSetDepthBiasEnable(cmd, VK_FALSE);
+	vkCmdSetLineWidth(cmd, 1.0f);
+	if (preRasterization.PatchControlPoints > 0)
+	{
+		vkCmdSetPatchControlPointsEXT(cmd, preRasterization.PatchControlPoints);
+		vkCmdSetTessellationDomainOriginEXT(cmd, VK_TESSELLATION_DOMAIN_ORIGIN_UPPER_LEFT);
+	}
+
+	const FragmentPart& fragment = desc.Fragment;
+	vkCmdSetDepthTestEnable(cmd, fragment.DepthTest);
+	vkCmdSetDepthWriteEnable(cmd, fragment.DepthWrite);
+	vkCmdSetDepthCompareOp(cmd, fragment.DepthCompare);
+	vkCmdSetDepthBoundsTestEnable(cmd, VK_FALSE);
+	vkCmdSetStencilTestEnable(cmd, VK_FALSE);
+
+	const OutputPart& output = desc.Output;
+	// Two words cover 64 samples
+	const VkSampleMask sampleMask[2] = { ~0u, ~0u };
+	vkCmdSetRasterizationSamplesEXT(cmd, output.Samples);
+	vkCmdSetSampleMaskEXT(cmd, output.Samples, sampleMask);
+	vkCmdSetAlphaToCoverageEnableEXT(cmd, VK_FALSE);
+	vkCmdSetLogicOpEnableEXT(cmd, VK_FALSE);
+
+	SetColorBlendState(cmd, desc);
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "GraphicsPipelineBuilder.h"
+#include "../Shaders/LayoutCache.h"
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/// <summary>
+/// Linked shader objects of one draw or dispatch, ordered by pipeline stage
+/// </summary>
+struct ShaderProgram
+{
+	std::vector<VkShaderStageFlagBits> Stages = {};
+	std::vector<VkShaderEXT> Shaders = {};
+	/// <summary>
+	/// Compatible with the shaders, used to bind descriptor sets and push constants
+	/// </summary>
+	VkPipelineLayout Layout = VK_NULL_HANDLE;
+	/// <summary>
+	/// What Bind passes for graphics programs: every graphics stage the device enabled, VK_NULL_HANDLE for the unused ones
+	/// </summary>
+	std::vector<VkShaderStageFlagBits> BindStages = {};
+	std::vector<VkShaderEXT> BindShaders = {};
+};
+
+/// <summary>
+/// Draws without pipeline objects through VK_EXT_shader_object. The stages of a program are compiled and linked once,
+/// all other state is set on the command buffer, so no combination of state ever has to be compiled.
+/// Programs are cached by their stages and layouts. Thread safe
+/// </summary>
+class ShaderObjectCache
+{
+public:
+	ShaderObjectCache() = default;
+	~ShaderObjectCache();
+
+	ShaderObjectCache(const ShaderObjectCache&) = delete;
+	ShaderObjectCache& operator=(const ShaderObjectCache&) = delete;
+
+	/// <summary>
+	/// graphicsStages are the stages whose features are enabled, vertex and fragment are always included
+	/// </summary>
+	void Init(VkDevice device, const VkAllocationCallbacks* pAllocator, ShaderLibrary* pShaderLibrary, LayoutCache* pLayoutCache, bool enabled,
+		VkShaderStageFlags graphicsStages);
+	void Destroy();
+
+	/// <summary>
+	/// Whether the device has shader objects, programs cannot be created otherwise
+	/// </summary>
+	bool IsEnabled() const { return m_Enabled; }
+
+	/// <summary>
+	/// Returns the cached program or compiles it. Set layouts and push constants are reflected from the stages.
+	/// The pointer stays valid until Destroy
+	/// </summary>
+	const ShaderProgram* GetProgram(const std::vector<PipelineShaderStage>& stages);
+	const ShaderProgram* GetProgram(const std::vector<PipelineShaderStage>& stages,
+		const std::vector<VkDescriptorSetLayout>& setLayouts, const std::vector<VkPushConstantRange>& pushConstants);
+	/// <summary>
+	/// Program of the pre-rasterization stages and fragment shader of a pipeline description
+	/// </summary>
+	const ShaderProgram* GetProgram(const GraphicsPipelineDesc& desc);
+
+	/// <summary>
+	/// Binds the shaders of the program. Graphics stages the program does not have are unbound
+	/// </summary>
+	static void Bind(VkCommandBuffer cmd, const ShaderProgram& program);
+	/// <summary>
+	/// Sets every piece of state a pipeline built from desc would contain, its shaders and layout are ignored.
+	/// Viewport and scissor are left to vkCmdSetViewportWithCount and vkCmdSetScissorWithCount
+	/// </summary>
+	static void SetState(VkCommandBuffer cmd, const GraphicsPipelineDesc& desc);
+
+	size_t GetProgramCount() const { return m_Programs.size(); }
+
+private:
+	bool Create(const std::vector<PipelineShaderStage>& stages, const std::vector<VkDescriptorSetLayout>& setLayouts,
+		const std::vector<VkPushConstantRange>& pushConstants, ShaderProgram* pProgram);
+
+private:
+	VkDevice m_Device = VK_NULL_HANDLE;
+	const VkAllocationCallbacks* m_pAllocator = nullptr;
+	ShaderLibrary* m_pShaderLibrary = nullptr;
+	LayoutCache* m_pLayoutCache = nullptr;
+	bool m_Enabled = false;
+	VkShaderStageFlags m_GraphicsStages = 0;
+
+	std::mutex m_Mutex;
+	// Node based, programs handed out must not move
+	std::unordered_map<std::string, ShaderProgram> m_Programs = {};
+};
@@ -0,0 +1,263 @@
+#include "LayoutCache.h"
+
+#include "../Util/Hash.h"
+
+#include <algorithm>
+#include <stdio.h>
+
+#undef max
+#undef min
+
+namespace
+{
+	uint64_t HashBindings(const std::vector<VkDescriptorSetLayoutBinding>& bindings, const std::vector<VkDescriptorBindingFlags>& flags)
+	{
+		// Field by field, the struct has padding and a pointer
+		uint64_t hash = HashBytes(nullptr, 0);
+		for (const VkDescriptorSetLayoutBinding& binding : bindings)
+		{
+			hash = HashCombine(hash, binding.binding);
+			hash = HashCombine(hash, binding.descriptorType);
+			hash = HashCombine(hash, binding.descriptorCount);
+			hash = HashCombine(hash, binding.stageFlags);
+		}
+		return HashBytes(flags.data(), flags.size() * sizeof(VkDescriptorBindingFlags), hash);
+	}
+
+	bool EqualBindings(const std::vector<VkDescriptorSetLayoutBinding>& a, const std::vector<VkDescriptorSetLayoutBinding>& b)
+	{
+		return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](const VkDescriptorSetLayoutBinding& x, const VkDescriptorSetLayoutBinding& y)
+			{
+				return x.binding == y.binding && x.descriptorType == y.descriptorType && x.descriptorCount == y.descriptorCount && x.stageFlags == y.stageFlags;
+			});
+	}
+
+	uint64_t HashPipelineLayout(const std::vector<VkDescriptorSetLayout>& setLayouts, const std::vector<VkPushConstantRange>& pushConstants)
+	{
+		uint64_t hash = HashBytes(setLayouts.data(), setLayouts.size() * sizeof(VkDescriptorSetLayout));
+		return HashBytes(pushConstants.data(), pushConstants.size() * sizeof(VkPushConstantRange), hash);
+	}
+
+	bool EqualPushConstants(const std::vector<VkPushConstantRange>& a, const std::vector<VkPushConstantRange>& b)
+	{
+		return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](const VkPushConstantRange& x, const VkPushConstantRange& y)
+			{
+				return x.stageFlags == y.stageFlags && x.offset == y.offset && x.size == y.size;
+			});
+	}
+}
+
+void LayoutCache::Init(VkDevice device, const VkAllocationCallbacks* pAllocator)
+{
+	m_Device = device;
+	m_pAllocator = pAllocator;
+}
+
+void LayoutCache::Destroy()
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	for (auto& bucket : m_PipelineLayouts)
+	{
+		for (const PipelineLayoutEntry& entry : bucket.second)
+			vkDestroyPipelineLayout(m_Device, entry.Layout, m_pAllocator);
+	}
+	for (auto& bucket : m_SetLayouts)
+	{
+		for (const SetLayoutEntry& entry : bucket.second)
+			vkDestroyDescriptorSetLayout(m_Device, entry.Layout, m_pAllocator);
+	}
+
+	m_PipelineLayouts.clear();
+	m_SetLayouts.clear();
+	m_SetLayoutCount = 0;
+	m_PipelineLayoutCount = 0;
+}
+
+VkDescriptorSetLayout LayoutCache::GetSetLayout(const std::vector<VkDescriptorSetLayoutBinding>& bindings, const std::vector<VkDescriptorBindingFlags>& flags)
+{
+	if (!flags.empty() && flags.size() != bindings.size())
+	{
+		printf("Descriptor binding flags must be empty or one per binding\n");
+		return VK_NULL_HANDLE;
+	}
+
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return GetSetLayoutLocked(bindings, flags);
+}
+
+VkPipelineLayout LayoutCache::GetPipelineLayout(const std::vector<const ShaderReflection*>& stages)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	std::vector<VkDescriptorSetLayout> setLayouts;
+	std::vector<VkPushConstantRange> pushConstants;
+	if (!MergeStages(stages, setLayouts, pushConstants))
+		return VK_NULL_HANDLE;
+	return GetPipelineLayoutLocked(setLayouts, pushConstants);
+}
+
+VkPipelineLayout LayoutCache::GetPipelineLayout(const std::vector<VkDescriptorSetLayout>& setLayouts, const std::vector<VkPushConstantRange>& pushConstants)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return GetPipelineLayoutLocked(setLayouts, pushConstants);
+}
+
+bool LayoutCache::GetSetLayouts(const std::vector<const ShaderReflection*>& stages, std::vector<VkDescriptorSetLayout>& setLayouts, std::vector<VkPushConstantRange>& pushConstants)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return MergeStages(stages, setLayouts, pushConstants);
+}
+
+VkDescriptorSetLayout LayoutCache::GetSetLayoutLocked(const std::vector<VkDescriptorSetLayoutBinding>& unsortedBindings, const std::vector<VkDescriptorBindingFlags>& unsortedFlags)
+{
+	// Canonical order, so the same bindings in a different order share a layout. Flags move with their binding
+	std::vector<size_t> order(unsortedBindings.size());
+	for (size_t i = 0; i < order.size(); i++)
+		order[i] = i;
+	std::sort(order.begin(), order.end(), [&unsortedBindings](size_t a, size_t b) { return unsortedBindings[a].binding < unsortedBindings[b].binding; });
+
+	std::vector<VkDescriptorSetLayoutBinding> bindings;
+	std::vector<VkDescriptorBindingFlags> flags;
+	bool anyFlags = std::any_of(unsortedFlags.begin(), unsortedFlags.end(), [](VkDescriptorBindingFlags f) { return f != 0; });
+	for (size_t i : order)
+	{
+		bindings.push_back(unsortedBindings[i]);
+		if (anyFlags)
+			flags.push_back(unsortedFlags[i]);
+	}
+
+	uint64_t hash = HashBindings(bindings, flags);
+	std::vector<SetLayoutEntry>& bucket = m_SetLayouts[hash];
+	for (const SetLayoutEntry& entry : bucket)
+	{
+		if (EqualBindings(entry.Bindings, bindings) && entry.Flags == flags)
+			return entry.Layout;
+	}
+
+	for (VkDescriptorSetLayoutBinding& binding : bindings)
+		binding.pImmutableSamplers = nullptr;
+
+	VkDescriptorSetLayoutBindingFlagsCreateInfo flagsCi{};
+	flagsCi.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+	flagsCi.bindingCount = static_cast<uint32_t>(flags.size());
+	flagsCi.pBindingFlags = flags.empty() ? nullptr : flags.data();
+
+	VkDescriptorSetLayoutCreateInfo ci{};
+	ci.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	ci.pNext = flags.empty() ? nullptr : &flagsCi;
+	ci.bindingCount = static_cast<uint32_t>(bindings.size());
+	ci.pBindings = bindings.empty() ? nullptr : bindings.data();
+
+	VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+	if (vkCreateDescriptorSetLayout(m_Device, &ci, m_pAllocator, &layout) != VK_SUCCESS)
+	{
+		printf("Failed to create descriptor set layout\n");
+		return VK_NULL_HANDLE;
+	}
+
+	bucket.push_back({ std::move(bindings), std::move(flags), layout });
+	m_SetLayoutCount++;
+	return layout;
+}
+
+VkPipelineLayout LayoutCache::GetPipelineLayoutLocked(const std::vector<VkDescriptorSetLayout>& setLayouts, const std::vector<VkPushConstantRange>& pushConstants)
+{
+	uint64_t hash = HashPipelineLayout(setLayouts, pushConstants);
+	std::vector<PipelineLayoutEntry>& bucket = m_PipelineLayouts[hash];
+	for (const PipelineLayoutEntry& entry : bucket)
+	{
+		if (entry.SetLayouts == setLayouts && EqualPushConstants(entry.PushConstants, pushConstants))
+			return entry.Layout;
+	}
+
+	VkPipelineLayoutCreateInfo ci{};
+	ci.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	ci.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+	ci.pSetLayouts = setLayouts.empty() ? nullptr : setLayouts.data();
+	ci.pushConstantRangeCount = static_cast<uint32_t>(pushConstants.size());
+	ci.pPushConstantRanges = pushConstants.empty() ? nullptr : pushConstants.data();
+
+	VkPipelineLayout layout = VK_NULL_HANDLE;
+	if (vkCreatePipelineLayout(m_Device, &ci, m_pAllocator, &layout) != VK_SUCCESS)
+	{
+		printf("Failed to create pipeline layout\n");
+		return VK_NULL_HANDLE;
+	}
+
+	bucket.push_back({ setLayouts, pushConstants, layout });
+	m_PipelineLayoutCount++;
+	return layout;
+}
+
+bool LayoutCache::MergeStages(const std::vector<const ShaderReflection*>& stages, std::vector<VkDescriptorSetLayout>& setLayouts, std::vector<VkPushConstantRange>& pushConstants)
+{
+	std::vector<std::vector<VkDescriptorSetLayoutBinding>> sets;
+	std::vector<std::vector<VkDescriptorBindingFlags>> setFlags;
+	VkPushConstantRange pushRange{};
+
+	for (const ShaderReflection* pStage : stages)
+	{
+		for (const ReflectedBinding& reflected : pStage->Bindings)
+		{
+			if (sets.size() <= reflected.Set)
+			{
+				sets.resize(reflected.Set + 1);
+				setFlags.resize(reflected.Set + 1);
+			}
+
+			// Bindless tables are rarely filled completely
+			bool runtimeArray = reflected.Count == 0;
+			uint32_t count = runtimeArray ? m_RuntimeArrayCount : reflected.Count;
+			VkDescriptorBindingFlags flags = runtimeArray ? VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT : 0;
+			std::vector<VkDescriptorSetLayoutBinding>& bindings = sets[reflected.Set];
+			auto it = std::find_if(bindings.begin(), bindings.end(), [&reflected](const VkDescriptorSetLayoutBinding& b) { return b.binding == reflected.Binding; });
+			if (it == bindings.end())
+			{
+				bindings.push_back({ reflected.Binding, reflected.Type, count, static_cast<VkShaderStageFlags>(pStage->Stage), nullptr });
+				setFlags[reflected.Set].push_back(flags);
+				continue;
+			}
+
+			if (it->descriptorType != reflected.Type)
+			{
+				printf("Stages disagree on the type of set %u binding %u [\"%s\"]\n", reflected.Set, reflected.Binding, reflected.Name.c_str());
+				return false;
+			}
+			it->descriptorCount = std::max(it->descriptorCount, count);
+			it->stageFlags |= pStage->Stage;
+			setFlags[reflected.Set][it - bindings.begin()] |= flags;
+		}
+
+		if (pStage->PushConstantSize > 0)
+		{
+			pushRange.stageFlags |= pStage->Stage;
+			pushRange.size = std::max(pushRange.size, pStage->PushConstantSize);
+		}
+	}
+
+	// Only the highest binding of a set may have a variable count
+	for (size_t set = 0; set < sets.size(); set++)
+	{
+		const std::vector<VkDescriptorSetLayoutBinding>& bindings = sets[set];
+		if (bindings.empty())
+			continue;
+		auto last = std::max_element(bindings.begin(), bindings.end(), [](const VkDescriptorSetLayoutBinding& a, const VkDescriptorSetLayoutBinding& b) { return a.binding < b.binding; });
+		VkDescriptorBindingFlags& flags = setFlags[set][last - bindings.begin()];
+		if (flags & VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT)
+			flags |= VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT;
+	}
+
+	setLayouts.clear();
+	for (size_t set = 0; set < sets.size(); set++)
+	{
+		VkDescriptorSetLayout layout = GetSetLayoutLocked(sets[set], setFlags[set]);
+		if (layout == VK_NULL_HANDLE)
+			return false;
+		setLayouts.push_back(layout);
+	}
+
+	pushConstants.clear();
+	if (pushRange.size > 0)
+		pushConstants.push_back(pushRange);
+	return true;
+}
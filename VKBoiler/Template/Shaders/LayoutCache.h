@@ -0,0 +1,80 @@
+#pragma once
+
+#include "../Loader/Loader.h"
+#include "ShaderReflection.h"
+
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+/// <summary>
+/// Descriptor set and pipeline layouts derived from shader reflection, created once per unique description.
+/// Pipelines built from shaders with the same interface get the same VkPipelineLayout, so bound descriptor sets
+/// stay valid across pipeline switches. Thread safe
+/// </summary>
+class LayoutCache
+{
+public:
+	void Init(VkDevice device, const VkAllocationCallbacks* pAllocator);
+	void Destroy();
+
+	/// <summary>
+	/// Upper bound of runtime sized arrays (bindless tables). Their bindings are partially bound and, when they are the
+	/// highest binding of their set, have a variable count that sets allocate with VkDescriptorSetVariableDescriptorCountAllocateInfo.
+	/// Needs PreDeviceSetupParameters::EnableRuntimeDescriptorArrays
+	/// </summary>
+	void SetRuntimeArrayCount(uint32_t count) { m_RuntimeArrayCount = count; }
+
+	/// <summary>
+	/// Returns the cached layout for the bindings, creating it when it does not exist yet.
+	/// Bindings may be passed in any order, immutable samplers are not supported. Flags are empty or one per binding
+	/// </summary>
+	VkDescriptorSetLayout GetSetLayout(const std::vector<VkDescriptorSetLayoutBinding>& bindings, const std::vector<VkDescriptorBindingFlags>& flags = {});
+
+	/// <summary>
+	/// Merges the interfaces of all stages of a pipeline. Bindings used by several stages become visible to all of them,
+	/// push constants become one range shared by every stage that uses them. Unused set indices get empty layouts
+	/// </summary>
+	VkPipelineLayout GetPipelineLayout(const std::vector<const ShaderReflection*>& stages);
+	VkPipelineLayout GetPipelineLayout(const std::vector<VkDescriptorSetLayout>& setLayouts, const std::vector<VkPushConstantRange>& pushConstants);
+
+	/// <summary>
+	/// Set layouts and push constant ranges GetPipelineLayout uses for the same stages, for allocating matching descriptor sets
+	/// </summary>
+	bool GetSetLayouts(const std::vector<const ShaderReflection*>& stages, std::vector<VkDescriptorSetLayout>& setLayouts, std::vector<VkPushConstantRange>& pushConstants);
+
+	size_t GetSetLayoutCount() const { return m_SetLayoutCount; }
+	size_t GetPipelineLayoutCount() const { return m_PipelineLayoutCount; }
+
+private:
+	struct SetLayoutEntry
+	{
+		std::vector<VkDescriptorSetLayoutBinding> Bindings;
+		// Empty when no binding has flags
+		std::vector<VkDescriptorBindingFlags> Flags;
+		VkDescriptorSetLayout Layout;
+	};
+
+	struct PipelineLayoutEntry
+	{
+		std::vector<VkDescriptorSetLayout> SetLayouts;
+		std::vector<VkPushConstantRange> PushConstants;
+		VkPipelineLayout Layout;
+	};
+
+	VkDescriptorSetLayout GetSetLayoutLocked(const std::vector<VkDescriptorSetLayoutBinding>& bindings, const std::vector<VkDescriptorBindingFlags>& flags);
+	VkPipelineLayout GetPipelineLayoutLocked(const std::vector<VkDescriptorSetLayout>& setLayouts, const std::vector<VkPushConstantRange>& pushConstants);
+	bool MergeStages(const std::vector<const ShaderReflection*>& stages, std::vector<VkDescriptorSetLayout>& setLayouts, std::vector<VkPushConstantRange>& pushConstants);
+
+private:
+	VkDevice m_Device = VK_NULL_HANDLE;
+	const VkAllocationCallbacks* m_pAllocator = nullptr;
+	uint32_t m_RuntimeArrayCount = 1;
+
+	std::mutex m_Mutex;
+	// Buckets keyed by content hash, collisions are resolved by comparing the descriptions
+	std::unordered_map<uint64_t, std::vector<SetLayoutEntry>> m_SetLayouts = {};
+	std::unordered_map<uint64_t, std::vector<PipelineLayoutEntry>> m_PipelineLayouts = {};
+	size_t m_SetLayoutCount = 0;
+	size_t m_PipelineLayoutCount = 0;
+};
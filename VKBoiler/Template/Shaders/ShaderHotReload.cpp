@@ -0,0 +1,536 @@
+#include "ShaderHotReload.h"
+
+#include <algorithm>
+#include <ctype.h>
+#include <fstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace
+{
+	// Editors often write a file several times per save, compiling waits until the directory was quiet this long
+	const DWORD DEBOUNCE_MS = 100;
+	const DWORD CHANGE_BUFFER_SIZE = 16 * 1024;
+	// The stop and watch events take up two of the wait slots
+	const size_t MAX_DIRECTORIES = MAXIMUM_WAIT_OBJECTS - 2;
+
+	std::string DirectoryOf(const std::string& path)
+	{
+		size_t separator = path.find_last_of('\\');
+		return separator == std::string::npos ? std::string() : path.substr(0, separator);
+	}
+
+	// Returns the shader stage in glslc naming, empty when the extension names no stage
+	std::string StageOf(const std::string& path)
+	{
+		size_t last = path.find_last_of('.');
+		if (last == std::string::npos)
+			return {};
+
+		std::string extension = path.substr(last + 1);
+		if (extension == "glsl" || extension == "hlsl")
+		{
+			size_t previous = last == 0 ? std::string::npos : path.find_last_of('.', last - 1);
+			if (previous == std::string::npos)
+				return {};
+			extension = path.substr(previous + 1, last - previous - 1);
+		}
+
+		static const char* s_Stages[] = { "vert", "frag", "comp", "geom", "tesc", "tese", "mesh", "task" };
+		for (const char* stage : s_Stages)
+		{
+			if (extension == stage)
+				return extension;
+		}
+		return {};
+	}
+
+	const char* HlslProfile(const std::string& stage)
+	{
+		if (stage == "vert") return "vs_6_0";
+		if (stage == "frag") return "ps_6_0";
+		if (stage == "comp") return "cs_6_0";
+		if (stage == "geom") return "gs_6_0";
+		if (stage == "tesc") return "hs_6_0";
+		if (stage == "tese") return "ds_6_0";
+		if (stage == "mesh") return "ms_6_5";
+		if (stage == "task") return "as_6_5";
+		return nullptr;
+	}
+
+	bool EndsWith(const std::string& value, const char* suffix)
+	{
+		size_t length = strlen(suffix);
+		return value.size() >= length && value.compare(value.size() - length, length, suffix) == 0;
+	}
+}
+
+ShaderHotReload::~ShaderHotReload()
+{
+	Stop();
+}
+
+bool ShaderHotReload::Start(VkDevice device, const VkAllocationCallbacks* pAllocator, uint32_t framesInFlight, std::function<void()> onReloadReady)
+{
+	m_Device = device;
+	m_pAllocator = pAllocator;
+	m_FramesInFlight = framesInFlight;
+	m_OnReloadReady = std::move(onReloadReady);
+
+	m_StopEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+	m_WatchEvent = CreateEventA(NULL, FALSE, FALSE, NULL);
+	if (m_StopEvent == NULL || m_WatchEvent == NULL)
+	{
+		printf("Failed to create shader reload events\n");
+		return false;
+	}
+
+	m_Thread = std::thread([this]() { ReloadThread(); });
+	return true;
+}
+
+void ShaderHotReload::Stop()
+{
+	if (m_Thread.joinable())
+	{
+		SetEvent(m_StopEvent);
+		m_Thread.join();
+	}
+
+	for (const auto& pDirectory : m_Directories)
+		CloseDirectory(*pDirectory);
+	m_Directories.clear();
+
+	if (m_StopEvent != NULL)
+		CloseHandle(m_StopEvent);
+	if (m_WatchEvent != NULL)
+		CloseHandle(m_WatchEvent);
+	m_StopEvent = NULL;
+	m_WatchEvent = NULL;
+
+	if (m_Device != VK_NULL_HANDLE)
+	{
+		// Only reached at shutdown, waiting here is cheaper than tracking the last frames
+		if (!m_Retired.empty())
+			vkDeviceWaitIdle(m_Device);
+		for (const RetiredPipeline& retired : m_Retired)
+			vkDestroyPipeline(m_Device, retired.Pipeline, m_pAllocator);
+		for (const ReadyPipeline& ready : m_Ready)
+			vkDestroyPipeline(m_Device, ready.Pipeline, m_pAllocator);
+	}
+	m_Retired.clear();
+	m_Ready.clear();
+	m_Pipelines.clear();
+	m_PendingDirectories.clear();
+	m_Spirv.clear();
+	m_Device = VK_NULL_HANDLE;
+}
+
+void ShaderHotReload::Watch(const HotReloadPipeline& pipeline)
+{
+	if (!IsRunning() || !pipeline.pPipeline || !pipeline.Build)
+		return;
+
+	HotReloadPipeline entry = pipeline;
+	for (std::string& source : entry.Sources)
+		source = NormalizePath(source);
+
+	{
+		std::lock_guard<std::mutex> lock(m_WatchMutex);
+		for (const std::string& source : entry.Sources)
+			m_PendingDirectories.push_back(DirectoryOf(source));
+		m_Pipelines.push_back({ std::move(entry), m_NextPipelineId++ });
+	}
+	SetEvent(m_WatchEvent);
+}
+
+void ShaderHotReload::Unwatch(VkPipeline* pPipeline)
+{
+	// Waits for running Build callbacks, a rebuild skips pipelines no longer registered, so nothing for this
+	// pipeline can become ready afterwards
+	std::lock_guard<std::mutex> watchLock(m_WatchMutex);
+	m_Pipelines.erase(std::remove_if(m_Pipelines.begin(), m_Pipelines.end(),
+		[pPipeline](const WatchedPipeline& watched) { return watched.Pipeline.pPipeline == pPipeline; }), m_Pipelines.end());
+
+	std::lock_guard<std::mutex> readyLock(m_ReadyMutex);
+	for (auto it = m_Ready.begin(); it != m_Ready.end();)
+	{
+		if (it->pTarget == pPipeline)
+		{
+			vkDestroyPipeline(m_Device, it->Pipeline, m_pAllocator);
+			it = m_Ready.erase(it);
+		}
+		else
+			it++;
+	}
+}
+
+void ShaderHotReload::ApplyPendingReloads()
+{
+	m_Frame++;
+
+	// A pipeline replaced before frame F was last recorded in frame F - 1, which has retired once
+	// the client waited for its frame slot again
+	size_t kept = 0;
+	for (const RetiredPipeline& retired : m_Retired)
+	{
+		if (m_Frame - retired.Frame > m_FramesInFlight)
+			vkDestroyPipeline(m_Device, retired.Pipeline, m_pAllocator);
+		else
+			m_Retired[kept++] = retired;
+	}
+	m_Retired.resize(kept);
+
+	std::vector<ReadyPipeline> ready;
+	{
+		std::lock_guard<std::mutex> lock(m_ReadyMutex);
+		ready.swap(m_Ready);
+	}
+
+	for (const ReadyPipeline& pipeline : ready)
+	{
+		if (*pipeline.pTarget != VK_NULL_HANDLE)
+			m_Retired.push_back({ *pipeline.pTarget, m_Frame });
+		*pipeline.pTarget = pipeline.Pipeline;
+	}
+}
+
+/*static*/bool ShaderHotReload::Compile(const std::string& sourcePath, const std::string& spirvPath)
+{
+	std::string stage = StageOf(sourcePath);
+	if (stage.empty())
+	{
+		printf("Cannot tell the shader stage of [\"%s\"]\n", sourcePath.c_str());
+		return false;
+	}
+
+	std::string bin;
+	if (const char* sdk = getenv("VULKAN_SDK"))
+		bin = std::string(sdk) + "\\Bin\\";
+
+	std::string command;
+	if (EndsWith(sourcePath, ".hlsl"))
+		command = "\"" + bin + "dxc.exe\" -spirv -T " + HlslProfile(stage) + " -E main \"" + sourcePath + "\" -Fo \"" + spirvPath + "\"";
+	else
+		command = "\"" + bin + "glslc.exe\" -fshader-stage=" + stage + " \"" + sourcePath + "\" -o \"" + spirvPath + "\"";
+
+	// The compiler shares our console, so its diagnostics end up next to our own output
+	STARTUPINFOA startupInfo{};
+	startupInfo.cb = sizeof(startupInfo);
+	PROCESS_INFORMATION processInfo{};
+	if (!CreateProcessA(NULL, &command[0], NULL, NULL, FALSE, 0, NULL, NULL, &startupInfo, &processInfo))
+	{
+		printf("Failed to run shader compiler [%s]\n", command.c_str());
+		return false;
+	}
+
+	DWORD exitCode = 1;
+	WaitForSingleObject(processInfo.hProcess, INFINITE);
+	GetExitCodeProcess(processInfo.hProcess, &exitCode);
+	CloseHandle(processInfo.hThread);
+	CloseHandle(processInfo.hProcess);
+
+	if (exitCode != 0)
+	{
+		printf("Failed to compile [\"%s\"]\n", sourcePath.c_str());
+		return false;
+	}
+	return true;
+}
+
+void ShaderHotReload::ReloadThread()
+{
+	std::vector<std::string> changed;
+	std::vector<HANDLE> handles;
+
+	while (true)
+	{
+		handles.assign({ m_StopEvent, m_WatchEvent });
+		for (const auto& pDirectory : m_Directories)
+			handles.push_back(pDirectory->Event);
+
+		// Every new change restarts the timeout, so compiling starts once the sources stopped changing
+		DWORD timeout = changed.empty() ? INFINITE : DEBOUNCE_MS;
+		DWORD result = WaitForMultipleObjects(static_cast<DWORD>(handles.size()), handles.data(), FALSE, timeout);
+
+		if (result == WAIT_OBJECT_0)
+			break;
+
+		if (result == WAIT_TIMEOUT)
+		{
+			Rebuild(changed);
+			changed.clear();
+		}
+		else if (result == WAIT_OBJECT_0 + 1)
+		{
+			std::vector<std::string> directories;
+			{
+				std::lock_guard<std::mutex> lock(m_WatchMutex);
+				directories.swap(m_PendingDirectories);
+			}
+			for (const std::string& directory : directories)
+				WatchDirectory(directory);
+		}
+		else if (result >= WAIT_OBJECT_0 + 2 && result < WAIT_OBJECT_0 + handles.size())
+		{
+			size_t index = result - WAIT_OBJECT_0 - 2;
+			CollectChanges(*m_Directories[index], changed);
+			// Failed to re-arm, its event would never be signaled again
+			if (!m_Directories[index]->Pending)
+			{
+				CloseDirectory(*m_Directories[index]);
+				m_Directories.erase(m_Directories.begin() + index);
+			}
+		}
+	}
+}
+
+bool ShaderHotReload::WatchDirectory(const std::string& path)
+{
+	for (const auto& pDirectory : m_Directories)
+	{
+		if (pDirectory->Path == path)
+			return true;
+	}
+
+	if (m_Directories.size() >= MAX_DIRECTORIES)
+	{
+		printf("Too many shader directories, [\"%s\"] is not watched\n", path.c_str());
+		return false;
+	}
+
+	HANDLE handle = CreateFileA(path.empty() ? "." : path.c_str(), FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+		NULL, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, NULL);
+	if (handle == INVALID_HANDLE_VALUE)
+	{
+		printf("Failed to watch shader directory [\"%s\"]\n", path.c_str());
+		return false;
+	}
+
+	HANDLE event = CreateEventA(NULL, TRUE, FALSE, NULL);
+	if (event == NULL)
+	{
+		printf("Failed to create watch event for shader directory [\"%s\"]\n", path.c_str());
+		CloseHandle(handle);
+		return false;
+	}
+
+	m_Directories.push_back(std::make_unique<WatchedDirectory>());
+	WatchedDirectory& directory = *m_Directories.back();
+	directory.Path = path;
+	directory.Handle = handle;
+	directory.Event = event;
+	directory.Buffer.resize(CHANGE_BUFFER_SIZE / sizeof(DWORD));
+	if (!ArmDirectory(directory))
+	{
+		CloseDirectory(directory);
+		m_Directories.pop_back();
+		return false;
+	}
+	return true;
+}
+
+bool ShaderHotReload::ArmDirectory(WatchedDirectory& directory)
+{
+	ResetEvent(directory.Event);
+	directory.Overlapped = {};
+	directory.Overlapped.hEvent = directory.Event;
+
+	// Saving through a temporary file and renaming it only shows up as a file name change
+	DWORD filter = FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME;
+	directory.Pending = ReadDirectoryChangesW(directory.Handle, directory.Buffer.data(), CHANGE_BUFFER_SIZE, FALSE, filter, NULL,
+		&directory.Overlapped, NULL) == TRUE;
+	if (!directory.Pending)
+		printf("Failed to watch shader directory [\"%s\"]\n", directory.Path.c_str());
+	return directory.Pending;
+}
+
+void ShaderHotReload::CollectChanges(WatchedDirectory& directory, std::vector<std::string>& changed)
+{
+	DWORD bytes = 0;
+	// Zero bytes means the buffer overflowed and the changes are lost, the next save picks them up again
+	bool completed = GetOverlappedResult(directory.Handle, &directory.Overlapped, &bytes, FALSE) == TRUE;
+	directory.Pending = false;
+	if (completed && bytes > 0)
+	{
+		const uint8_t* pEntry = reinterpret_cast<const uint8_t*>(directory.Buffer.data());
+		while (true)
+		{
+			const FILE_NOTIFY_INFORMATION* pInfo = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(pEntry);
+			if (pInfo->Action != FILE_ACTION_REMOVED)
+			{
+				int wideLength = static_cast<int>(pInfo->FileNameLength / sizeof(wchar_t));
+				int length = WideCharToMultiByte(CP_UTF8, 0, pInfo->FileName, wideLength, nullptr, 0, nullptr, nullptr);
+				std::string name(static_cast<size_t>(length), '\0');
+				WideCharToMultiByte(CP_UTF8, 0, pInfo->FileName, wideLength, &name[0], length, nullptr, nullptr);
+
+				std::string path = NormalizePath(directory.Path.empty() ? name : directory.Path + "\\" + name);
+				if (std::find(changed.begin(), changed.end(), path) == changed.end())
+					changed.push_back(path);
+			}
+
+			if (pInfo->NextEntryOffset == 0)
+				break;
+			pEntry += pInfo->NextEntryOffset;
+		}
+	}
+
+	ArmDirectory(directory);
+}
+
+/*static*/void ShaderHotReload::CloseDirectory(WatchedDirectory& directory)
+{
+	// The read has to complete before its buffer and overlapped go away
+	if (directory.Pending)
+	{
+		DWORD bytes = 0;
+		CancelIoEx(directory.Handle, &directory.Overlapped);
+		GetOverlappedResult(directory.Handle, &directory.Overlapped, &bytes, TRUE);
+		directory.Pending = false;
+	}
+	CloseHandle(directory.Handle);
+	CloseHandle(directory.Event);
+}
+
+void ShaderHotReload::Rebuild(const std::vector<std::string>& changed)
+{
+	auto usesAny = [](const HotReloadPipeline& pipeline, const std::vector<std::string>& paths)
+	{
+		return std::any_of(pipeline.Sources.begin(), pipeline.Sources.end(), [&paths](const std::string& source)
+			{ return std::find(paths.begin(), paths.end(), source) != paths.end(); });
+	};
+
+	// Compiling shells out and takes seconds, Watch and Unwatch must not wait for it
+	std::vector<WatchedPipeline> affected;
+	{
+		std::lock_guard<std::mutex> lock(m_WatchMutex);
+		for (const WatchedPipeline& watched : m_Pipelines)
+		{
+			if (usesAny(watched.Pipeline, changed))
+				affected.push_back(watched);
+		}
+	}
+
+	std::vector<std::string> compiled;
+	for (const std::string& path : changed)
+	{
+		bool watched = std::any_of(affected.begin(), affected.end(), [&path](const WatchedPipeline& pipeline)
+			{ return std::find(pipeline.Pipeline.Sources.begin(), pipeline.Pipeline.Sources.end(), path) != pipeline.Pipeline.Sources.end(); });
+		if (!watched)
+			continue;
+
+		// A failed compile keeps the previous SPIR-V and the pipelines using it
+		std::vector<uint32_t> spirv;
+		if (!LoadSpirv(path, spirv))
+			continue;
+
+		m_Spirv[path] = std::move(spirv);
+		compiled.push_back(path);
+		printf("Reloaded shader [\"%s\"]\n", path.c_str());
+	}
+
+	if (compiled.empty())
+		return;
+
+	// Sources that did not change since startup have not been compiled yet
+	std::vector<uint64_t> buildable;
+	for (const WatchedPipeline& watched : affected)
+	{
+		if (!usesAny(watched.Pipeline, compiled))
+			continue;
+
+		bool valid = true;
+		for (const std::string& source : watched.Pipeline.Sources)
+		{
+			if (m_Spirv.find(source) != m_Spirv.end())
+				continue;
+			std::vector<uint32_t> spirv;
+			valid = LoadSpirv(source, spirv);
+			if (!valid)
+				break;
+			m_Spirv.emplace(source, std::move(spirv));
+		}
+		if (valid)
+			buildable.push_back(watched.Id);
+	}
+
+	if (buildable.empty())
+		return;
+
+	// Building under the lock keeps Unwatch waiting until the client's Build callbacks are done with its objects.
+	// Pipelines unwatched while compiling are skipped
+	std::vector<ReadyPipeline> ready;
+	{
+		std::lock_guard<std::mutex> lock(m_WatchMutex);
+		for (const WatchedPipeline& watched : m_Pipelines)
+		{
+			if (std::find(buildable.begin(), buildable.end(), watched.Id) == buildable.end())
+				continue;
+
+			const HotReloadPipeline& pipeline = watched.Pipeline;
+			std::vector<VkShaderModule> modules;
+			bool valid = true;
+			for (const std::string& source : pipeline.Sources)
+			{
+				const std::vector<uint32_t>& spirv = m_Spirv[source];
+				VkShaderModuleCreateInfo ci{};
+				ci.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+				ci.codeSize = spirv.size() * sizeof(uint32_t);
+				ci.pCode = spirv.data();
+
+				VkShaderModule module = VK_NULL_HANDLE;
+				if (vkCreateShaderModule(m_Device, &ci, m_pAllocator, &module) != VK_SUCCESS)
+				{
+					valid = false;
+					break;
+				}
+				modules.push_back(module);
+			}
+
+			VkPipeline newPipeline = valid ? pipeline.Build(modules) : VK_NULL_HANDLE;
+			for (VkShaderModule module : modules)
+				vkDestroyShaderModule(m_Device, module, m_pAllocator);
+
+			if (newPipeline != VK_NULL_HANDLE)
+				ready.push_back({ pipeline.pPipeline, newPipeline });
+		}
+
+		if (ready.empty())
+			return;
+
+		std::lock_guard<std::mutex> readyLock(m_ReadyMutex);
+		m_Ready.insert(m_Ready.end(), ready.begin(), ready.end());
+	}
+	if (m_OnReloadReady)
+		m_OnReloadReady();
+}
+
+bool ShaderHotReload::LoadSpirv(const std::string& source, std::vector<uint32_t>& spirv)
+{
+	std::string spirvPath = source + ".spv";
+	if (!Compile(source, spirvPath))
+		return false;
+
+	std::ifstream file(spirvPath, std::ios::binary | std::ios::ate);
+	if (!file)
+		return false;
+
+	size_t size = static_cast<size_t>(file.tellg());
+	if (size == 0 || size % sizeof(uint32_t) != 0)
+		return false;
+
+	spirv.resize(size / sizeof(uint32_t));
+	file.seekg(0);
+	file.read(reinterpret_cast<char*>(spirv.data()), static_cast<std::streamsize>(size));
+	return file.good();
+}
+
+/*static*/std::string ShaderHotReload::NormalizePath(const std::string& path)
+{
+	// Paths on Windows are case insensitive and accept both separators
+	std::string normalized = path;
+	for (char& c : normalized)
+		c = c == '/' ? '\\' : static_cast<char>(tolower(static_cast<unsigned char>(c)));
+	return normalized;
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include "../Loader/Loader.h"
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/// <summary>
+/// A pipeline that is rebuilt when one of its shader sources changes
+/// </summary>
+struct HotReloadPipeline
+{
+	/// <summary>
+	/// GLSL or HLSL sources. The stage comes from the extension (.vert, .frag, ...) or from the second to last
+	/// extension for .glsl and .hlsl files (shadow.vert.hlsl)
+	/// </summary>
+	std::vector<std::string> Sources = {};
+	/// <summary>
+	/// Creates the pipeline from fresh modules, in the order of Sources. Runs on the reload thread, the modules
+	/// are destroyed once it returns
+	/// </summary>
+	std::function<VkPipeline(const std::vector<VkShaderModule>& modules)> Build;
+	/// <summary>
+	/// Pipeline handle of the client, replaced by ShaderHotReload::ApplyPendingReloads
+	/// </summary>
+	VkPipeline* pPipeline = nullptr;
+};
+
+/// <summary>
+/// Watches shader sources and recompiles them to SPIR-V on a background thread when they change. Only pipelines
+/// using a changed source are rebuilt, they are swapped in between frames. Replaced pipelines are destroyed once
+/// the frames that may still use them have retired, so reloading never waits for the GPU.
+///
+/// Compiling shells out to glslc and dxc, from %VULKAN_SDK%/Bin when set and from the PATH otherwise
+/// </summary>
+class ShaderHotReload
+{
+public:
+	ShaderHotReload() = default;
+	~ShaderHotReload();
+
+	ShaderHotReload(const ShaderHotReload&) = delete;
+	ShaderHotReload& operator=(const ShaderHotReload&) = delete;
+
+	/// <summary>
+	/// Starts the reload thread. onReloadReady is called from that thread whenever rebuilt pipelines are waiting
+	/// </summary>
+	bool Start(VkDevice device, const VkAllocationCallbacks* pAllocator, uint32_t framesInFlight, std::function<void()> onReloadReady);
+	/// <summary>
+	/// Stops the reload thread and destroys every pipeline it still owns. Call before destroying the device
+	/// </summary>
+	void Stop();
+
+	bool IsRunning() const { return m_Thread.joinable(); }
+
+	/// <summary>
+	/// Registers a pipeline for reloading, ignored when the reload thread is not running
+	/// </summary>
+	void Watch(const HotReloadPipeline& pipeline);
+	/// <summary>
+	/// Call before destroying a watched pipeline
+	/// </summary>
+	void Unwatch(VkPipeline* pPipeline);
+
+	/// <summary>
+	/// Swaps rebuilt pipelines in. Call from the render thread between frames, never while recording
+	/// </summary>
+	void ApplyPendingReloads();
+
+	/// <summary>
+	/// Compiles a single source to SPIR-V, blocking. Returns false and prints the compiler output on errors
+	/// </summary>
+	static bool Compile(const std::string& sourcePath, const std::string& spirvPath);
+
+private:
+	struct WatchedDirectory
+	{
+		std::string Path;
+		HANDLE Handle = NULL;
+		HANDLE Event = NULL;
+		OVERLAPPED Overlapped = {};
+		std::vector<DWORD> Buffer = {};
+		// A read is in flight, only then Overlapped is owned by the kernel
+		bool Pending = false;
+	};
+
+	struct WatchedPipeline
+	{
+		HotReloadPipeline Pipeline;
+		// Tells a registration apart from a later one of the same target
+		uint64_t Id;
+	};
+
+	struct ReadyPipeline
+	{
+		VkPipeline* pTarget;
+		VkPipeline Pipeline;
+	};
+
+	struct RetiredPipeline
+	{
+		VkPipeline Pipeline;
+		uint64_t Frame;
+	};
+
+	void ReloadThread();
+	bool WatchDirectory(const std::string& path);
+	bool ArmDirectory(WatchedDirectory& directory);
+	void CollectChanges(WatchedDirectory& directory, std::vector<std::string>& changed);
+	static void CloseDirectory(WatchedDirectory& directory);
+	void Rebuild(const std::vector<std::string>& changed);
+	bool LoadSpirv(const std::string& source, std::vector<uint32_t>& spirv);
+
+	static std::string NormalizePath(const std::string& path);
+
+private:
+	VkDevice m_Device = VK_NULL_HANDLE;
+	const VkAllocationCallbacks* m_pAllocator = nullptr;
+	uint32_t m_FramesInFlight = 2;
+	std::function<void()> m_OnReloadReady;
+
+	std::thread m_Thread;
+	HANDLE m_StopEvent = NULL;
+	// Signaled when new directories have to be watched
+	HANDLE m_WatchEvent = NULL;
+
+	// Owned by the reload thread after Start. Pending reads point into the entries, so they never move
+	std::vector<std::unique_ptr<WatchedDirectory>> m_Directories = {};
+	std::unordered_map<std::string, std::vector<uint32_t>> m_Spirv = {};
+
+	// Registrations, the reload thread copies them before compiling
+	std::mutex m_WatchMutex;
+	std::vector<WatchedPipeline> m_Pipelines = {};
+	uint64_t m_NextPipelineId = 0;
+	std::vector<std::string> m_PendingDirectories = {};
+
+	std::mutex m_ReadyMutex;
+	std::vector<ReadyPipeline> m_Ready = {};
+
+	// Render thread only
+	std::vector<RetiredPipeline> m_Retired = {};
+	uint64_t m_Frame = 0;
+};
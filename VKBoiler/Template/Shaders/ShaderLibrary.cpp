@@ -0,0 +1,296 @@
+#include "ShaderLibrary.h"
+
+#include "../Util/Hash.h"
+
+#include <algorithm>
+#include <fstream>
+#include <stdio.h>
+#include <string.h>
+
+namespace
+{
+	const uint32_t SPIRV_MAGIC = 0x07230203;
+
+	std::string ModuleName(const std::string& path)
+	{
+		size_t begin = path.find_last_of("/\\");
+		begin = begin == std::string::npos ? 0 : begin + 1;
+		size_t end = path.find_last_of('.');
+		if (end == std::string::npos || end < begin)
+			end = path.size();
+		return path.substr(begin, end - begin);
+	}
+}
+
+ShaderLibrary::~ShaderLibrary()
+{
+	// Modules need a device to be destroyed, Close should have been called before
+	if (m_pData)
+		UnmapViewOfFile(m_pData);
+	if (m_Mapping != NULL)
+		CloseHandle(m_Mapping);
+	if (m_File != NULL)
+		CloseHandle(m_File);
+}
+
+/*static*/bool ShaderLibrary::Pack(const std::vector<std::string>& spirvPaths, const std::string& archivePath)
+{
+	struct PendingModule
+	{
+		std::string Name;
+		std::vector<char> Code;
+		uint64_t NameHash;
+	};
+
+	std::vector<PendingModule> modules;
+	modules.reserve(spirvPaths.size());
+	for (const std::string& path : spirvPaths)
+	{
+		std::ifstream file(path, std::ios::binary | std::ios::ate);
+		if (!file)
+		{
+			printf("Failed to open shader [\"%s\"]\n", path.c_str());
+			return false;
+		}
+
+		PendingModule module{};
+		module.Name = ModuleName(path);
+		module.NameHash = HashString(module.Name.c_str());
+		module.Code.resize(static_cast<size_t>(file.tellg()));
+		file.seekg(0);
+		file.read(module.Code.data(), static_cast<std::streamsize>(module.Code.size()));
+
+		uint32_t magic = 0;
+		if (module.Code.size() >= sizeof(uint32_t))
+			memcpy(&magic, module.Code.data(), sizeof(uint32_t));
+		if (module.Code.size() % 4 != 0 || magic != SPIRV_MAGIC)
+		{
+			printf("Shader [\"%s\"] is not valid SPIR-V\n", path.c_str());
+			return false;
+		}
+
+		modules.push_back(std::move(module));
+	}
+
+	// Sorted by name hash so lookups can binary search the mapped index
+	std::sort(modules.begin(), modules.end(), [](const PendingModule& a, const PendingModule& b) { return a.NameHash < b.NameHash; });
+	for (size_t i = 1; i < modules.size(); i++)
+	{
+		if (modules[i].NameHash == modules[i - 1].NameHash)
+		{
+			printf("Shader names [\"%s\"] and [\"%s\"] collide in the library\n", modules[i - 1].Name.c_str(), modules[i].Name.c_str());
+			return false;
+		}
+	}
+
+	std::string names;
+	std::vector<ShaderArchiveEntry> entries(modules.size());
+	for (size_t i = 0; i < modules.size(); i++)
+	{
+		entries[i].NameHash = modules[i].NameHash;
+		entries[i].ContentHash = HashBytes(modules[i].Code.data(), modules[i].Code.size());
+		entries[i].Size = modules[i].Code.size();
+		entries[i].NameOffset = static_cast<uint32_t>(names.size());
+		entries[i].NameLength = static_cast<uint32_t>(modules[i].Name.size());
+		names.append(modules[i].Name).push_back('\0');
+	}
+	while (names.size() % 4 != 0)
+		names.push_back('\0');
+
+	uint64_t offset = sizeof(ShaderArchiveHeader) + sizeof(ShaderArchiveEntry) * entries.size() + names.size();
+	for (auto& entry : entries)
+	{
+		entry.Offset = offset;
+		offset += entry.Size;
+	}
+
+	ShaderArchiveHeader header{};
+	header.Magic = ARCHIVE_MAGIC;
+	header.Version = ARCHIVE_VERSION;
+	header.EntryCount = static_cast<uint32_t>(entries.size());
+	header.NameBlobSize = static_cast<uint32_t>(names.size());
+
+	std::ofstream out(archivePath, std::ios::binary | std::ios::trunc);
+	if (!out)
+	{
+		printf("Failed to create shader library [\"%s\"]\n", archivePath.c_str());
+		return false;
+	}
+
+	out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	out.write(reinterpret_cast<const char*>(entries.data()), static_cast<std::streamsize>(sizeof(ShaderArchiveEntry) * entries.size()));
+	out.write(names.data(), static_cast<std::streamsize>(names.size()));
+	for (const auto& module : modules)
+		out.write(module.Code.data(), static_cast<std::streamsize>(module.Code.size()));
+
+	return out.good();
+}
+
+bool ShaderLibrary::Open(const std::string& archivePath)
+{
+	m_File = CreateFileA(archivePath.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (m_File == INVALID_HANDLE_VALUE)
+	{
+		m_File = NULL;
+		printf("Failed to open shader library [\"%s\"]\n", archivePath.c_str());
+		return false;
+	}
+
+	LARGE_INTEGER size{};
+	GetFileSizeEx(m_File, &size);
+	m_DataSize = static_cast<uint64_t>(size.QuadPart);
+
+	m_Mapping = CreateFileMappingA(m_File, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (m_Mapping != NULL)
+		m_pData = static_cast<const uint8_t*>(MapViewOfFile(m_Mapping, FILE_MAP_READ, 0, 0, 0));
+
+	if (!m_pData || m_DataSize < sizeof(ShaderArchiveHeader))
+	{
+		printf("Failed to map shader library [\"%s\"]\n", archivePath.c_str());
+		return false;
+	}
+
+	m_pHeader = reinterpret_cast<const ShaderArchiveHeader*>(m_pData);
+	uint64_t indexEnd = sizeof(ShaderArchiveHeader) + sizeof(ShaderArchiveEntry) * static_cast<uint64_t>(m_pHeader->EntryCount) + m_pHeader->NameBlobSize;
+	if (m_pHeader->Magic != ARCHIVE_MAGIC || m_pHeader->Version != ARCHIVE_VERSION || indexEnd > m_DataSize)
+	{
+		printf("Shader library [\"%s\"] is corrupt or of an unsupported version\n", archivePath.c_str());
+		m_pHeader = nullptr;
+		return false;
+	}
+
+	m_pEntries = reinterpret_cast<const ShaderArchiveEntry*>(m_pData + sizeof(ShaderArchiveHeader));
+	m_pNames = reinterpret_cast<const char*>(m_pEntries + m_pHeader->EntryCount);
+	return true;
+}
+
+void ShaderLibrary::Close(VkDevice device, const VkAllocationCallbacks* pAllocator)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_ModuleMutex);
+		for (auto& bucket : m_Modules)
+		{
+			for (const ModuleEntry& entry : bucket.second)
+				vkDestroyShaderModule(device, entry.Module, pAllocator);
+		}
+		m_Modules.clear();
+	}
+
+	if (m_pData)
+		UnmapViewOfFile(m_pData);
+	if (m_Mapping != NULL)
+		CloseHandle(m_Mapping);
+	if (m_File != NULL)
+		CloseHandle(m_File);
+
+	m_pData = nullptr;
+	m_Mapping = NULL;
+	m_File = NULL;
+	m_pHeader = nullptr;
+	m_pEntries = nullptr;
+	m_pNames = nullptr;
+}
+
+const ShaderLibrary::ShaderArchiveEntry* ShaderLibrary::FindEntry(const char* name) const
+{
+	if (!m_pHeader)
+		return nullptr;
+
+	uint64_t hash = HashString(name);
+	const ShaderArchiveEntry* pEnd = m_pEntries + m_pHeader->EntryCount;
+	const ShaderArchiveEntry* pEntry = std::lower_bound(m_pEntries, pEnd, hash,
+		[](const ShaderArchiveEntry& entry, uint64_t value) { return entry.NameHash < value; });
+
+	// The name check guards against lookups of names that are not in the library but share a hash
+	if (pEntry == pEnd || pEntry->NameHash != hash || strcmp(m_pNames + pEntry->NameOffset, name) != 0)
+		return nullptr;
+	if (pEntry->Offset + pEntry->Size > m_DataSize)
+		return nullptr;
+	return pEntry;
+}
+
+bool ShaderLibrary::Find(const char* name, ShaderBinary* pBinary) const
+{
+	const ShaderArchiveEntry* pEntry = FindEntry(name);
+	if (!pEntry)
+		return false;
+
+	pBinary->pCode = reinterpret_cast<const uint32_t*>(m_pData + pEntry->Offset);
+	pBinary->Size = static_cast<size_t>(pEntry->Size);
+	pBinary->ContentHash = pEntry->ContentHash;
+	return true;
+}
+
+bool ShaderLibrary::Reflect(const char* name, ShaderReflection* pReflection) const
+{
+	ShaderBinary binary{};
+	if (!Find(name, &binary))
+	{
+		printf("Shader [\"%s\"] is not in the library\n", name);
+		return false;
+	}
+	return ReflectShader(binary.pCode, binary.Size, pReflection);
+}
+
+VkShaderModule ShaderLibrary::GetModule(VkDevice device, const char* name, const VkAllocationCallbacks* pAllocator)
+{
+	ShaderBinary binary{};
+	if (!Find(name, &binary))
+	{
+		printf("Shader [\"%s\"] is not in the library\n", name);
+		return VK_NULL_HANDLE;
+	}
+
+	std::lock_guard<std::mutex> lock(m_ModuleMutex);
+	std::vector<ModuleEntry>& bucket = m_Modules[binary.ContentHash];
+	for (const ModuleEntry& entry : bucket)
+	{
+		if (entry.Size == binary.Size && (entry.pCode == binary.pCode || memcmp(entry.pCode, binary.pCode, binary.Size) == 0))
+			return entry.Module;
+	}
+
+	VkShaderModuleCreateInfo ci{};
+	ci.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	ci.codeSize = binary.Size;
+	ci.pCode = binary.pCode;
+
+	VkShaderModule module = VK_NULL_HANDLE;
+	if (vkCreateShaderModule(device, &ci, pAllocator, &module) != VK_SUCCESS)
+	{
+		printf("Failed to create shader module [\"%s\"]\n", name);
+		return VK_NULL_HANDLE;
+	}
+
+	bucket.push_back({ binary.pCode, binary.Size, module });
+	return module;
+}
+
+bool ShaderLibrary::FillStage(VkDevice device, const char* name, VkShaderStageFlagBits stage, const char* entryPoint,
+	VkPipelineShaderStageCreateInfo& stageCi, VkShaderModuleCreateInfo& moduleCi, const VkAllocationCallbacks* pAllocator)
+{
+	stageCi = {};
+	stageCi.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	stageCi.stage = stage;
+	stageCi.pName = entryPoint;
+
+	if (m_InlineModules)
+	{
+		ShaderBinary binary{};
+		if (!Find(name, &binary))
+		{
+			printf("Shader [\"%s\"] is not in the library\n", name);
+			return false;
+		}
+
+		moduleCi = {};
+		moduleCi.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+		moduleCi.codeSize = binary.Size;
+		moduleCi.pCode = binary.pCode;
+		stageCi.pNext = &moduleCi;
+		stageCi.module = VK_NULL_HANDLE;
+		return true;
+	}
+
+	stageCi.module = GetModule(device, name, pAllocator);
+	return stageCi.module != VK_NULL_HANDLE;
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include "../Loader/Loader.h"
+#include "ShaderReflection.h"
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/// <summary>
+/// Read only view of a SPIR-V module inside the library
+/// </summary>
+struct ShaderBinary
+{
+	const uint32_t* pCode = nullptr;
+	size_t Size = 0;
+	uint64_t ContentHash = 0;
+};
+
+/// <summary>
+/// All SPIR-V modules of the application packed into one memory-mapped archive. Lookups go through a hashed index,
+/// so startup costs one file open instead of one per shader. VkShaderModules are created on first use and shared
+/// between entries with identical contents.
+///
+/// Archive layout: ShaderArchiveHeader, sorted ShaderArchiveEntry index, name blob, 4 byte aligned SPIR-V blobs
+/// </summary>
+class ShaderLibrary
+{
+public:
+	ShaderLibrary() = default;
+	~ShaderLibrary();
+
+	ShaderLibrary(const ShaderLibrary&) = delete;
+	ShaderLibrary& operator=(const ShaderLibrary&) = delete;
+
+	/// <summary>
+	/// Packs .spv files into an archive. Modules are named after their file name without directory and extension
+	/// </summary>
+	static bool Pack(const std::vector<std::string>& spirvPaths, const std::string& archivePath);
+
+	bool Open(const std::string& archivePath);
+	/// <summary>
+	/// Destroys all created modules and unmaps the archive
+	/// </summary>
+	void Close(VkDevice device, const VkAllocationCallbacks* pAllocator);
+
+	bool IsOpen() const { return m_pData != nullptr; }
+
+	/// <summary>
+	/// Returns the SPIR-V of a module, the memory stays valid until Close
+	/// </summary>
+	bool Find(const char* name, ShaderBinary* pBinary) const;
+	/// <summary>
+	/// Reflects a module of the library, see LayoutCache for turning the result into layouts
+	/// </summary>
+	bool Reflect(const char* name, ShaderReflection* pReflection) const;
+
+	/// <summary>
+	/// Creates the module on first use, thread safe. Returns VK_NULL_HANDLE when the name is unknown
+	/// </summary>
+	VkShaderModule GetModule(VkDevice device, const char* name, const VkAllocationCallbacks* pAllocator);
+
+	/// <summary>
+	/// Allows FillStage to skip module objects by chaining the SPIR-V into the stage create info.
+	/// Only valid when the device supports it (VK_EXT_graphics_pipeline_library)
+	/// </summary>
+	void SetInlineModules(bool enabled) { m_InlineModules = enabled; }
+	bool UsesInlineModules() const { return m_InlineModules; }
+
+	/// <summary>
+	/// Fills a pipeline stage for the named module. With inline modules the SPIR-V is chained through moduleCi,
+	/// which has to outlive pipeline creation, otherwise the module is created through GetModule
+	/// </summary>
+	bool FillStage(VkDevice device, const char* name, VkShaderStageFlagBits stage, const char* entryPoint,
+		VkPipelineShaderStageCreateInfo& stageCi, VkShaderModuleCreateInfo& moduleCi, const VkAllocationCallbacks* pAllocator);
+
+private:
+	struct ShaderArchiveHeader
+	{
+		uint32_t Magic;
+		uint32_t Version;
+		uint32_t EntryCount;
+		uint32_t NameBlobSize;
+	};
+
+	struct ShaderArchiveEntry
+	{
+		uint64_t NameHash;
+		uint64_t ContentHash;
+		uint64_t Offset;
+		uint64_t Size;
+		uint32_t NameOffset;
+		uint32_t NameLength;
+	};
+
+	static const uint32_t ARCHIVE_MAGIC = 0x4c53564b; // "VKSL"
+	static const uint32_t ARCHIVE_VERSION = 1;
+
+	struct ModuleEntry
+	{
+		// Points into the mapped archive, which outlives the module
+		const uint32_t* pCode;
+		size_t Size;
+		VkShaderModule Module;
+	};
+
+	const ShaderArchiveEntry* FindEntry(const char* name) const;
+
+private:
+	HANDLE m_File = NULL;
+	HANDLE m_Mapping = NULL;
+	const uint8_t* m_pData = nullptr;
+	uint64_t m_DataSize = 0;
+
+	const ShaderArchiveHeader* m_pHeader = nullptr;
+	const ShaderArchiveEntry* m_pEntries = nullptr;
+	const char* m_pNames = nullptr;
+
+	bool m_InlineModules = false;
+
+	// Buckets keyed by content hash so identical modules under different names share one VkShaderModule,
+	// collisions are resolved by comparing the code
+	std::mutex m_ModuleMutex;
+	std::unordered_map<uint64_t, std::vector<ModuleEntry>> m_Modules = {};
+};
@@ -0,0 +1,547 @@
+#include "ShaderReflection.h"
+
+#include <algorithm>
+#include <stdio.h>
+
+namespace
+{
+	// Only the parts of the SPIR-V specification needed to describe resources
+	enum SpirvOp : uint32_t
+	{
+		OpName = 5,
+		OpEntryPoint = 15,
+		OpTypeBool = 20,
+		OpTypeInt = 21,
+		OpTypeFloat = 22,
+		OpTypeVector = 23,
+		OpTypeMatrix = 24,
+		OpTypeImage = 25,
+		OpTypeSampler = 26,
+		OpTypeSampledImage = 27,
+		OpTypeArray = 28,
+		OpTypeRuntimeArray = 29,
+		OpTypeStruct = 30,
+		OpTypePointer = 32,
+		OpConstant = 43,
+		OpSpecConstantTrue = 48,
+		OpSpecConstantFalse = 49,
+		OpSpecConstant = 50,
+		OpVariable = 59,
+		OpDecorate = 71,
+		OpMemberDecorate = 72,
+		OpTypeAccelerationStructureKHR = 5341
+	};
+
+	enum SpirvDecoration : uint32_t
+	{
+		DecorationSpecId = 1,
+		DecorationBlock = 2,
+		DecorationBufferBlock = 3,
+		DecorationArrayStride = 6,
+		DecorationMatrixStride = 7,
+		DecorationBuiltIn = 11,
+		DecorationLocation = 30,
+		DecorationBinding = 33,
+		DecorationDescriptorSet = 34,
+		DecorationOffset = 35
+	};
+
+	enum SpirvStorageClass : uint32_t
+	{
+		StorageClassUniformConstant = 0,
+		StorageClassInput = 1,
+		StorageClassUniform = 2,
+		StorageClassPushConstant = 9,
+		StorageClassStorageBuffer = 12
+	};
+
+	const uint32_t SPIRV_MAGIC = 0x07230203;
+	const uint32_t NOT_DECORATED = UINT32_MAX;
+	const uint32_t IMAGE_DIM_BUFFER = 5;
+	const uint32_t IMAGE_DIM_SUBPASS_DATA = 6;
+
+	struct SpirvMember
+	{
+		uint32_t Offset = 0;
+		uint32_t MatrixStride = 0;
+	};
+
+	struct SpirvId
+	{
+		uint32_t Opcode = 0;
+		// Result type of variables and constants, pointee, element, component or image type of types
+		uint32_t Type = 0;
+		uint32_t StorageClass = 0;
+		// Constant value, scalar width, vector size, matrix columns or array length id
+		uint32_t Value = 0;
+		// Int signedness or image dimension
+		uint32_t Signedness = 0;
+		uint32_t ImageSampled = 0;
+		std::vector<uint32_t> MemberTypes = {};
+		std::vector<SpirvMember> Members = {};
+		std::string Name = {};
+
+		uint32_t Set = NOT_DECORATED;
+		uint32_t Binding = NOT_DECORATED;
+		uint32_t Location = NOT_DECORATED;
+		uint32_t SpecId = NOT_DECORATED;
+		uint32_t ArrayStride = 0;
+		bool BuiltIn = false;
+		bool BufferBlock = false;
+	};
+
+	std::string ReadString(const uint32_t* pWords, uint32_t wordCount)
+	{
+		const char* pChars = reinterpret_cast<const char*>(pWords);
+		size_t maxLength = wordCount * sizeof(uint32_t);
+		size_t length = 0;
+		while (length < maxLength && pChars[length] != '\0')
+			length++;
+		return std::string(pChars, length);
+	}
+
+	VkShaderStageFlagBits StageFromExecutionModel(uint32_t model)
+	{
+		switch (model)
+		{
+		case 0: return VK_SHADER_STAGE_VERTEX_BIT;
+		case 1: return VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT;
+		case 2: return VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
+		case 3: return VK_SHADER_STAGE_GEOMETRY_BIT;
+		case 4: return VK_SHADER_STAGE_FRAGMENT_BIT;
+		case 5: return VK_SHADER_STAGE_COMPUTE_BIT;
+		case 5267: case 5364: return VK_SHADER_STAGE_TASK_BIT_EXT;
+		case 5268: case 5365: return VK_SHADER_STAGE_MESH_BIT_EXT;
+		case 5313: return VK_SHADER_STAGE_RAYGEN_BIT_KHR;
+		case 5314: return VK_SHADER_STAGE_INTERSECTION_BIT_KHR;
+		case 5315: return VK_SHADER_STAGE_ANY_HIT_BIT_KHR;
+		case 5316: return VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR;
+		case 5317: return VK_SHADER_STAGE_MISS_BIT_KHR;
+		case 5318: return VK_SHADER_STAGE_CALLABLE_BIT_KHR;
+		default: return VK_SHADER_STAGE_ALL;
+		}
+	}
+
+	uint32_t TypeSize(const std::vector<SpirvId>& ids, uint32_t typeId, uint32_t matrixStride = 0)
+	{
+		if (typeId >= ids.size())
+			return 0;
+		const SpirvId& type = ids[typeId];
+		switch (type.Opcode)
+		{
+		case OpTypeBool:
+			return 4;
+		case OpTypeInt:
+		case OpTypeFloat:
+			return type.Value / 8;
+		case OpTypeVector:
+			return type.Value * TypeSize(ids, type.Type);
+		case OpTypeMatrix:
+			return type.Value * (matrixStride ? matrixStride : TypeSize(ids, type.Type));
+		case OpTypeArray:
+		{
+			uint32_t length = type.Value < ids.size() ? ids[type.Value].Value : 0;
+			return length * (type.ArrayStride ? type.ArrayStride : TypeSize(ids, type.Type, matrixStride));
+		}
+		case OpTypeStruct:
+		{
+			// Explicit offsets account for padding, the struct ends after its furthest member
+			uint32_t size = 0;
+			for (size_t i = 0; i < type.MemberTypes.size(); i++)
+				size = std::max(size, type.Members[i].Offset + TypeSize(ids, type.MemberTypes[i], type.Members[i].MatrixStride));
+			return size;
+		}
+		default:
+			return 0;
+		}
+	}
+
+	// Vertex formats by scalar width and component count, 8 bit floats do not exist
+	struct VertexFormats
+	{
+		uint32_t Width;
+		VkFormat Float[4];
+		VkFormat Int[4];
+		VkFormat Uint[4];
+	};
+
+	const VertexFormats VERTEX_FORMATS[] =
+	{
+		{ 8,
+			{ VK_FORMAT_UNDEFINED, VK_FORMAT_UNDEFINED, VK_FORMAT_UNDEFINED, VK_FORMAT_UNDEFINED },
+			{ VK_FORMAT_R8_SINT, VK_FORMAT_R8G8_SINT, VK_FORMAT_R8G8B8_SINT, VK_FORMAT_R8G8B8A8_SINT },
+			{ VK_FORMAT_R8_UINT, VK_FORMAT_R8G8_UINT, VK_FORMAT_R8G8B8_UINT, VK_FORMAT_R8G8B8A8_UINT } },
+		{ 16,
+			{ VK_FORMAT_R16_SFLOAT, VK_FORMAT_R16G16_SFLOAT, VK_FORMAT_R16G16B16_SFLOAT, VK_FORMAT_R16G16B16A16_SFLOAT },
+			{ VK_FORMAT_R16_SINT, VK_FORMAT_R16G16_SINT, VK_FORMAT_R16G16B16_SINT, VK_FORMAT_R16G16B16A16_SINT },
+			{ VK_FORMAT_R16_UINT, VK_FORMAT_R16G16_UINT, VK_FORMAT_R16G16B16_UINT, VK_FORMAT_R16G16B16A16_UINT } },
+		{ 32,
+			{ VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT, VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT },
+			{ VK_FORMAT_R32_SINT, VK_FORMAT_R32G32_SINT, VK_FORMAT_R32G32B32_SINT, VK_FORMAT_R32G32B32A32_SINT },
+			{ VK_FORMAT_R32_UINT, VK_FORMAT_R32G32_UINT, VK_FORMAT_R32G32B32_UINT, VK_FORMAT_R32G32B32A32_UINT } },
+		{ 64,
+			{ VK_FORMAT_R64_SFLOAT, VK_FORMAT_R64G64_SFLOAT, VK_FORMAT_R64G64B64_SFLOAT, VK_FORMAT_R64G64B64A64_SFLOAT },
+			{ VK_FORMAT_R64_SINT, VK_FORMAT_R64G64_SINT, VK_FORMAT_R64G64B64_SINT, VK_FORMAT_R64G64B64A64_SINT },
+			{ VK_FORMAT_R64_UINT, VK_FORMAT_R64G64_UINT, VK_FORMAT_R64G64B64_UINT, VK_FORMAT_R64G64B64A64_UINT } }
+	};
+
+	VkFormat VertexFormat(const std::vector<SpirvId>& ids, uint32_t typeId)
+	{
+		const SpirvId& type = ids[typeId];
+		uint32_t components = 1;
+		const SpirvId* pScalar = &type;
+		if (type.Opcode == OpTypeVector)
+		{
+			if (type.Type >= ids.size())
+				return VK_FORMAT_UNDEFINED;
+			components = type.Value;
+			pScalar = &ids[type.Type];
+		}
+
+		if (components < 1 || components > 4)
+			return VK_FORMAT_UNDEFINED;
+
+		for (const VertexFormats& formats : VERTEX_FORMATS)
+		{
+			if (formats.Width != pScalar->Value)
+				continue;
+			if (pScalar->Opcode == OpTypeFloat)
+				return formats.Float[components - 1];
+			if (pScalar->Opcode == OpTypeInt)
+				return pScalar->Signedness ? formats.Int[components - 1] : formats.Uint[components - 1];
+		}
+		return VK_FORMAT_UNDEFINED;
+	}
+
+	uint32_t FormatSize(VkFormat format)
+	{
+		for (const VertexFormats& formats : VERTEX_FORMATS)
+		{
+			for (uint32_t i = 0; i < 4; i++)
+			{
+				if (format != VK_FORMAT_UNDEFINED && (formats.Float[i] == format || formats.Int[i] == format || formats.Uint[i] == format))
+					return (i + 1) * formats.Width / 8;
+			}
+		}
+		return 0;
+	}
+
+	VkDescriptorType DescriptorType(const std::vector<SpirvId>& ids, uint32_t storageClass, uint32_t typeId)
+	{
+		const SpirvId& type = ids[typeId];
+		switch (storageClass)
+		{
+		case StorageClassUniformConstant:
+			switch (type.Opcode)
+			{
+			case OpTypeSampler:
+				return VK_DESCRIPTOR_TYPE_SAMPLER;
+			case OpTypeSampledImage:
+				return type.Type < ids.size() && ids[type.Type].Signedness == IMAGE_DIM_BUFFER ? VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+			case OpTypeImage:
+				if (type.Signedness == IMAGE_DIM_SUBPASS_DATA)
+					return VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+				if (type.Signedness == IMAGE_DIM_BUFFER)
+					return type.ImageSampled == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+				return type.ImageSampled == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+			case OpTypeAccelerationStructureKHR:
+				return VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR;
+			default:
+				return VK_DESCRIPTOR_TYPE_MAX_ENUM;
+			}
+		case StorageClassUniform:
+			// Before SPIR-V 1.3 storage buffers are uniform blocks decorated with BufferBlock
+			return type.BufferBlock ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		case StorageClassStorageBuffer:
+			return VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		default:
+			return VK_DESCRIPTOR_TYPE_MAX_ENUM;
+		}
+	}
+}
+
+bool ReflectShader(const uint32_t* pCode, size_t size, ShaderReflection* pReflection)
+{
+	size_t wordCount = size / sizeof(uint32_t);
+	if (wordCount < 5 || pCode[0] != SPIRV_MAGIC)
+	{
+		printf("Cannot reflect module, it is not SPIR-V\n");
+		return false;
+	}
+
+	uint32_t bound = pCode[3];
+	std::vector<SpirvId> ids(bound);
+	std::vector<uint32_t> variables;
+	bool hasEntryPoint = false;
+
+	auto validId = [bound](uint32_t id) { return id < bound; };
+
+	for (size_t i = 5; i < wordCount;)
+	{
+		const uint32_t* pWords = pCode + i;
+		uint32_t opcode = pWords[0] & 0xffff;
+		uint32_t count = pWords[0] >> 16;
+		if (count == 0 || i + count > wordCount)
+		{
+			printf("Cannot reflect module, instruction at word %zu is malformed\n", i);
+			return false;
+		}
+		i += count;
+
+		switch (opcode)
+		{
+		case OpEntryPoint:
+			// Modules with several entry points describe the first one
+			if (!hasEntryPoint && count >= 4)
+			{
+				pReflection->Stage = StageFromExecutionModel(pWords[1]);
+				pReflection->EntryPoint = ReadString(pWords + 3, count - 3);
+				hasEntryPoint = true;
+			}
+			break;
+		case OpName:
+			if (count >= 3 && validId(pWords[1]))
+				ids[pWords[1]].Name = ReadString(pWords + 2, count - 2);
+			break;
+		case OpDecorate:
+		{
+			if (count < 3 || !validId(pWords[1]))
+				break;
+			SpirvId& target = ids[pWords[1]];
+			uint32_t literal = count >= 4 ? pWords[3] : 0;
+			switch (pWords[2])
+			{
+			case DecorationSpecId: target.SpecId = literal; break;
+			case DecorationBufferBlock: target.BufferBlock = true; break;
+			case DecorationArrayStride: target.ArrayStride = literal; break;
+			case DecorationBuiltIn: target.BuiltIn = true; break;
+			case DecorationLocation: target.Location = literal; break;
+			case DecorationBinding: target.Binding = literal; break;
+			case DecorationDescriptorSet: target.Set = literal; break;
+			default: break;
+			}
+			break;
+		}
+		case OpMemberDecorate:
+		{
+			if (count < 5 || !validId(pWords[1]))
+				break;
+			SpirvId& target = ids[pWords[1]];
+			if (target.Members.size() <= pWords[2])
+				target.Members.resize(pWords[2] + 1);
+			if (pWords[3] == DecorationOffset)
+				target.Members[pWords[2]].Offset = pWords[4];
+			else if (pWords[3] == DecorationMatrixStride)
+				target.Members[pWords[2]].MatrixStride = pWords[4];
+			break;
+		}
+		case OpTypeBool:
+		case OpTypeSampler:
+		case OpTypeAccelerationStructureKHR:
+			if (count >= 2 && validId(pWords[1]))
+				ids[pWords[1]].Opcode = opcode;
+			break;
+		case OpTypeInt:
+		case OpTypeFloat:
+			if (count >= 3 && validId(pWords[1]))
+			{
+				ids[pWords[1]].Opcode = opcode;
+				ids[pWords[1]].Value = pWords[2];
+				ids[pWords[1]].Signedness = opcode == OpTypeInt && count >= 4 ? pWords[3] : 0;
+			}
+			break;
+		case OpTypeVector:
+		case OpTypeMatrix:
+		case OpTypeArray:
+			if (count >= 4 && validId(pWords[1]))
+			{
+				ids[pWords[1]].Opcode = opcode;
+				ids[pWords[1]].Type = pWords[2];
+				ids[pWords[1]].Value = pWords[3];
+			}
+			break;
+		case OpTypeImage:
+			if (count >= 8 && validId(pWords[1]))
+			{
+				ids[pWords[1]].Opcode = opcode;
+				ids[pWords[1]].Signedness = pWords[3];
+				ids[pWords[1]].ImageSampled = pWords[7];
+			}
+			break;
+		case OpTypeSampledImage:
+		case OpTypeRuntimeArray:
+			if (count >= 3 && validId(pWords[1]))
+			{
+				ids[pWords[1]].Opcode = opcode;
+				ids[pWords[1]].Type = pWords[2];
+			}
+			break;
+		case OpTypeStruct:
+			if (count >= 2 && validId(pWords[1]))
+			{
+				SpirvId& type = ids[pWords[1]];
+				type.Opcode = opcode;
+				type.MemberTypes.assign(pWords + 2, pWords + count);
+				type.Members.resize(std::max(type.Members.size(), type.MemberTypes.size()));
+			}
+			break;
+		case OpTypePointer:
+			if (count >= 4 && validId(pWords[1]))
+			{
+				ids[pWords[1]].Opcode = opcode;
+				ids[pWords[1]].StorageClass = pWords[2];
+				ids[pWords[1]].Type = pWords[3];
+			}
+			break;
+		case OpConstant:
+		case OpSpecConstant:
+			if (count >= 4 && validId(pWords[2]))
+			{
+				ids[pWords[2]].Opcode = opcode;
+				ids[pWords[2]].Type = pWords[1];
+				ids[pWords[2]].Value = pWords[3];
+			}
+			break;
+		case OpSpecConstantTrue:
+		case OpSpecConstantFalse:
+			if (count >= 3 && validId(pWords[2]))
+			{
+				ids[pWords[2]].Opcode = opcode;
+				ids[pWords[2]].Type = pWords[1];
+			}
+			break;
+		case OpVariable:
+			if (count >= 4 && validId(pWords[2]))
+			{
+				ids[pWords[2]].Opcode = opcode;
+				ids[pWords[2]].Type = pWords[1];
+				ids[pWords[2]].StorageClass = pWords[3];
+				variables.push_back(pWords[2]);
+			}
+			break;
+		default:
+			break;
+		}
+	}
+
+	if (!hasEntryPoint)
+	{
+		printf("Cannot reflect module, it has no entry point\n");
+		return false;
+	}
+
+	for (uint32_t id : variables)
+	{
+		const SpirvId& variable = ids[id];
+		if (!validId(variable.Type) || ids[variable.Type].Opcode != OpTypePointer || !validId(ids[variable.Type].Type))
+			continue;
+		uint32_t typeId = ids[variable.Type].Type;
+
+		if (variable.StorageClass == StorageClassPushConstant)
+		{
+			pReflection->PushConstantSize = std::max(pReflection->PushConstantSize, TypeSize(ids, typeId));
+			continue;
+		}
+
+		if (variable.StorageClass == StorageClassInput)
+		{
+			if (pReflection->Stage != VK_SHADER_STAGE_VERTEX_BIT || variable.BuiltIn || variable.Location == NOT_DECORATED)
+				continue;
+
+			// Matrices take one location per column
+			uint32_t columns = 1;
+			if (ids[typeId].Opcode == OpTypeMatrix)
+			{
+				columns = ids[typeId].Value;
+				typeId = ids[typeId].Type;
+				if (!validId(typeId))
+				{
+					printf("Cannot reflect module, vertex input has an invalid column type [\"%s\"]\n", variable.Name.c_str());
+					return false;
+				}
+			}
+
+			VkFormat format = VertexFormat(ids, typeId);
+			if (format == VK_FORMAT_UNDEFINED)
+			{
+				printf("Cannot reflect module, vertex input has no matching vertex format [\"%s\"]\n", variable.Name.c_str());
+				return false;
+			}
+			for (uint32_t column = 0; column < columns; column++)
+				pReflection->VertexInputs.push_back({ variable.Location + column, format, variable.Name });
+			continue;
+		}
+
+		if (variable.Set == NOT_DECORATED || variable.Binding == NOT_DECORATED)
+			continue;
+
+		ReflectedBinding binding{};
+		binding.Set = variable.Set;
+		binding.Binding = variable.Binding;
+		binding.Name = variable.Name;
+		while (ids[typeId].Opcode == OpTypeArray)
+		{
+			uint32_t lengthId = ids[typeId].Value;
+			binding.Count *= validId(lengthId) ? ids[lengthId].Value : 1;
+			typeId = ids[typeId].Type;
+			if (!validId(typeId))
+				break;
+		}
+		if (validId(typeId) && ids[typeId].Opcode == OpTypeRuntimeArray)
+		{
+			binding.Count = 0;
+			typeId = ids[typeId].Type;
+		}
+		if (!validId(typeId))
+		{
+			printf("Cannot reflect module, array element type is out of range [\"%s\"]\n", variable.Name.c_str());
+			return false;
+		}
+
+		binding.Type = DescriptorType(ids, variable.StorageClass, typeId);
+		if (binding.Type != VK_DESCRIPTOR_TYPE_MAX_ENUM)
+			pReflection->Bindings.push_back(binding);
+	}
+
+	for (uint32_t id = 0; id < bound; id++)
+	{
+		const SpirvId& constant = ids[id];
+		if (constant.SpecId == NOT_DECORATED)
+			continue;
+		if (constant.Opcode != OpSpecConstant && constant.Opcode != OpSpecConstantTrue && constant.Opcode != OpSpecConstantFalse)
+			continue;
+
+		ReflectedSpecConstant specConstant{};
+		specConstant.ConstantId = constant.SpecId;
+		specConstant.Size = validId(constant.Type) ? std::max(TypeSize(ids, constant.Type), 4u) : 4;
+		specConstant.Name = constant.Name;
+		pReflection->SpecConstants.push_back(specConstant);
+	}
+
+	std::sort(pReflection->Bindings.begin(), pReflection->Bindings.end(), [](const ReflectedBinding& a, const ReflectedBinding& b)
+		{ return a.Set != b.Set ? a.Set < b.Set : a.Binding < b.Binding; });
+	std::sort(pReflection->VertexInputs.begin(), pReflection->VertexInputs.end(), [](const ReflectedVertexInput& a, const ReflectedVertexInput& b)
+		{ return a.Location < b.Location; });
+	std::sort(pReflection->SpecConstants.begin(), pReflection->SpecConstants.end(), [](const ReflectedSpecConstant& a, const ReflectedSpecConstant& b)
+		{ return a.ConstantId < b.ConstantId; });
+	return true;
+}
+
+void BuildVertexAttributes(const ShaderReflection& reflection, uint32_t binding, std::vector<VkVertexInputAttributeDescription>& attributes, uint32_t* pStride)
+{
+	uint32_t offset = 0;
+	attributes.clear();
+	for (const ReflectedVertexInput& input : reflection.VertexInputs)
+	{
+		VkVertexInputAttributeDescription attribute{};
+		attribute.location = input.Location;
+		attribute.binding = binding;
+		attribute.format = input.Format;
+		attribute.offset = offset;
+		attributes.push_back(attribute);
+		offset += FormatSize(input.Format);
+	}
+
+	if (pStride)
+		*pStride = offset;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "../Loader/Loader.h"
+
+#include <string>
+#include <vector>
+
+struct ReflectedBinding
+{
+	uint32_t Set = 0;
+	uint32_t Binding = 0;
+	VkDescriptorType Type = VK_DESCRIPTOR_TYPE_MAX_ENUM;
+	/// <summary>
+	/// Array size, 0 for runtime sized arrays
+	/// </summary>
+	uint32_t Count = 1;
+	std::string Name = {};
+};
+
+struct ReflectedVertexInput
+{
+	uint32_t Location = 0;
+	VkFormat Format = VK_FORMAT_UNDEFINED;
+	std::string Name = {};
+};
+
+struct ReflectedSpecConstant
+{
+	uint32_t ConstantId = 0;
+	/// <summary>
+	/// Size in bytes, booleans are 4 byte VkBool32
+	/// </summary>
+	uint32_t Size = 4;
+	std::string Name = {};
+};
+
+/// <summary>
+/// Resource interface of a SPIR-V module, everything needed to derive its layouts without hand written descriptions
+/// </summary>
+struct ShaderReflection
+{
+	VkShaderStageFlagBits Stage = VK_SHADER_STAGE_ALL;
+	std::string EntryPoint = {};
+	std::vector<ReflectedBinding> Bindings = {};
+	/// <summary>
+	/// Bytes of push constants the module reads, 0 when it uses none
+	/// </summary>
+	uint32_t PushConstantSize = 0;
+	/// <summary>
+	/// Vertex shader inputs without built-ins, sorted by location
+	/// </summary>
+	std::vector<ReflectedVertexInput> VertexInputs = {};
+	std::vector<ReflectedSpecConstant> SpecConstants = {};
+};
+
+/// <summary>
+/// Reflects the first entry point of a SPIR-V module. Returns false on malformed modules
+/// </summary>
+bool ReflectShader(const uint32_t* pCode, size_t size, ShaderReflection* pReflection);
+
+/// <summary>
+/// Tightly packed attributes for the reflected vertex inputs, all sourced from one binding
+/// </summary>
+void BuildVertexAttributes(const ShaderReflection& reflection, uint32_t binding, std::vector<VkVertexInputAttributeDescription>& attributes, uint32_t* pStride);
@@ -0,0 +1,221 @@
+#include "ShaderVariants.h"
+
+#include "../Util/Hash.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+
+#undef max
+#undef min
+
+SpecializationKey& SpecializationKey::Set(uint32_t constantId, uint32_t value)
+{
+	auto it = std::lower_bound(m_Ids.begin(), m_Ids.end(), constantId);
+	size_t index = static_cast<size_t>(it - m_Ids.begin());
+	if (it != m_Ids.end() && *it == constantId)
+	{
+		m_Values[index] = value;
+		return *this;
+	}
+
+	m_Ids.insert(it, constantId);
+	m_Values.insert(m_Values.begin() + index, value);
+	return *this;
+}
+
+SpecializationKey& SpecializationKey::SetFloat(uint32_t constantId, float value)
+{
+	uint32_t bits = 0;
+	memcpy(&bits, &value, sizeof(bits));
+	return Set(constantId, bits);
+}
+
+uint64_t SpecializationKey::Hash() const
+{
+	uint64_t hash = HashBytes(m_Ids.data(), m_Ids.size() * sizeof(uint32_t));
+	return HashBytes(m_Values.data(), m_Values.size() * sizeof(uint32_t), hash);
+}
+
+void SpecializationKey::Fill(VkSpecializationInfo& info, std::vector<VkSpecializationMapEntry>& entries) const
+{
+	entries.resize(m_Ids.size());
+	for (size_t i = 0; i < m_Ids.size(); i++)
+		entries[i] = { m_Ids[i], static_cast<uint32_t>(i * sizeof(uint32_t)), sizeof(uint32_t) };
+
+	info = {};
+	info.mapEntryCount = static_cast<uint32_t>(entries.size());
+	info.pMapEntries = entries.empty() ? nullptr : entries.data();
+	info.dataSize = m_Values.size() * sizeof(uint32_t);
+	info.pData = m_Values.empty() ? nullptr : m_Values.data();
+}
+
+void ShaderVariants::Init(VkDevice device, const VkAllocationCallbacks* pAllocator)
+{
+	m_Device = device;
+	m_pAllocator = pAllocator;
+}
+
+void ShaderVariants::Destroy()
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	for (auto& bucket : m_Variants)
+	{
+		for (const Variant& variant : bucket.second)
+			vkDestroyPipeline(m_Device, variant.Pipeline, m_pAllocator);
+	}
+
+	m_Variants.clear();
+	m_Requested.clear();
+	m_Families.clear();
+	m_VariantCount = 0;
+}
+
+uint32_t ShaderVariants::AddFamily(VariantBuildFunction build)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	m_Families.push_back(std::move(build));
+	return static_cast<uint32_t>(m_Families.size() - 1);
+}
+
+void ShaderVariants::Request(uint32_t family, const SpecializationKey& key)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	if (FindLocked(VariantHash(family, key), family, key))
+		return;
+
+	bool requested = std::any_of(m_Requested.begin(), m_Requested.end(), [family, &key](const Variant& variant)
+		{ return variant.Family == family && variant.Key == key; });
+	if (!requested)
+		m_Requested.push_back({ family, key, VK_NULL_HANDLE });
+}
+
+bool ShaderVariants::Precompile(uint32_t threadCount)
+{
+	std::vector<Variant> pending;
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		pending.swap(m_Requested);
+	}
+	if (pending.empty())
+		return true;
+
+	auto start = std::chrono::steady_clock::now();
+
+	if (threadCount == 0)
+		threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+	threadCount = std::min(threadCount, static_cast<uint32_t>(pending.size()));
+
+	// Pipeline creation is free threaded, workers pull variants until none are left
+	std::atomic<size_t> next{ 0 };
+	auto worker = [&]()
+	{
+		for (size_t i = next.fetch_add(1); i < pending.size(); i = next.fetch_add(1))
+			pending[i].Pipeline = Build(pending[i].Family, pending[i].Key);
+	};
+
+	std::vector<std::thread> threads;
+	for (uint32_t i = 1; i < threadCount; i++)
+		threads.emplace_back(worker);
+	worker();
+	for (std::thread& thread : threads)
+		thread.join();
+
+	bool success = true;
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	for (Variant& variant : pending)
+	{
+		if (variant.Pipeline == VK_NULL_HANDLE)
+		{
+			success = false;
+			continue;
+		}
+
+		// Get may have built the same variant meanwhile
+		uint64_t hash = VariantHash(variant.Family, variant.Key);
+		if (FindLocked(hash, variant.Family, variant.Key))
+		{
+			vkDestroyPipeline(m_Device, variant.Pipeline, m_pAllocator);
+			continue;
+		}
+		m_Variants[hash].push_back(std::move(variant));
+		m_VariantCount++;
+	}
+
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	printf("Precompiled %zu shader variants on %u threads in %.2f ms\n", pending.size(), threadCount, ms);
+	return success;
+}
+
+VkPipeline ShaderVariants::Get(uint32_t family, const SpecializationKey& key)
+{
+	uint64_t hash = VariantHash(family, key);
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		if (Variant* pVariant = FindLocked(hash, family, key))
+			return pVariant->Pipeline;
+	}
+
+	// Built outside the lock so lookups of other variants do not wait on the driver
+	VkPipeline pipeline = Build(family, key);
+	if (pipeline == VK_NULL_HANDLE)
+		return VK_NULL_HANDLE;
+
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	if (Variant* pVariant = FindLocked(hash, family, key))
+	{
+		vkDestroyPipeline(m_Device, pipeline, m_pAllocator);
+		return pVariant->Pipeline;
+	}
+
+	m_Variants[hash].push_back({ family, key, pipeline });
+	m_VariantCount++;
+	return pipeline;
+}
+
+VkPipeline ShaderVariants::Build(uint32_t family, const SpecializationKey& key)
+{
+	// Copied so families can still be added while variants build
+	VariantBuildFunction build;
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		if (family < m_Families.size())
+			build = m_Families[family];
+	}
+	if (!build)
+	{
+		printf("Unknown shader variant family %u\n", family);
+		return VK_NULL_HANDLE;
+	}
+
+	VkSpecializationInfo info{};
+	std::vector<VkSpecializationMapEntry> entries;
+	key.Fill(info, entries);
+
+	VkPipeline pipeline = build(info);
+	if (pipeline == VK_NULL_HANDLE)
+		printf("Failed to build variant %016llx of shader variant family %u\n", static_cast<unsigned long long>(key.Hash()), family);
+	return pipeline;
+}
+
+ShaderVariants::Variant* ShaderVariants::FindLocked(uint64_t hash, uint32_t family, const SpecializationKey& key)
+{
+	auto bucket = m_Variants.find(hash);
+	if (bucket == m_Variants.end())
+		return nullptr;
+
+	for (Variant& variant : bucket->second)
+	{
+		if (variant.Family == family && variant.Key == key)
+			return &variant;
+	}
+	return nullptr;
+}
+
+/*static*/uint64_t ShaderVariants::VariantHash(uint32_t family, const SpecializationKey& key)
+{
+	return HashCombine(key.Hash(), family);
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "../Loader/Loader.h"
+
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+/// <summary>
+/// Specialization constant values of one variant. Only 32 bit constants are supported (bool, int, uint, float)
+/// </summary>
+class SpecializationKey
+{
+public:
+	SpecializationKey& Set(uint32_t constantId, uint32_t value);
+	SpecializationKey& SetInt(uint32_t constantId, int32_t value) { return Set(constantId, static_cast<uint32_t>(value)); }
+	SpecializationKey& SetBool(uint32_t constantId, bool value) { return Set(constantId, value ? VK_TRUE : VK_FALSE); }
+	SpecializationKey& SetFloat(uint32_t constantId, float value);
+
+	uint64_t Hash() const;
+	bool operator==(const SpecializationKey& other) const { return m_Ids == other.m_Ids && m_Values == other.m_Values; }
+
+	/// <summary>
+	/// Fills the specialization info for pipeline creation, entries must outlive it
+	/// </summary>
+	void Fill(VkSpecializationInfo& info, std::vector<VkSpecializationMapEntry>& entries) const;
+
+private:
+	// Sorted by id, so keys built in a different order compare and hash equal
+	std::vector<uint32_t> m_Ids = {};
+	std::vector<uint32_t> m_Values = {};
+};
+
+/// <summary>
+/// Builds a pipeline for a set of specialization constants. Called from worker threads during Precompile
+/// </summary>
+using VariantBuildFunction = std::function<VkPipeline(const VkSpecializationInfo& specialization)>;
+
+/// <summary>
+/// Turns one SPIR-V module into many pipelines through specialization constants (feature toggles, loop counts,
+/// workgroup sizes with LocalSizeId). Variants are deduplicated by key, created in parallel by Precompile and
+/// on demand by Get. Thread safe
+/// </summary>
+class ShaderVariants
+{
+public:
+	void Init(VkDevice device, const VkAllocationCallbacks* pAllocator);
+	void Destroy();
+
+	/// <summary>
+	/// Registers a pipeline description, variants of it are identified by the returned family and their key
+	/// </summary>
+	uint32_t AddFamily(VariantBuildFunction build);
+
+	/// <summary>
+	/// Queues a variant for Precompile. Already requested or built variants are ignored
+	/// </summary>
+	void Request(uint32_t family, const SpecializationKey& key);
+	/// <summary>
+	/// Builds every requested variant on up to threadCount threads, 0 uses all hardware threads.
+	/// Runs after the client Init, returns false when a variant failed to build
+	/// </summary>
+	bool Precompile(uint32_t threadCount = 0);
+
+	/// <summary>
+	/// Returns the variant, building it when it was neither requested nor built before
+	/// </summary>
+	VkPipeline Get(uint32_t family, const SpecializationKey& key);
+
+	size_t GetVariantCount() const { return m_VariantCount; }
+
+private:
+	struct Variant
+	{
+		uint32_t Family;
+		SpecializationKey Key;
+		VkPipeline Pipeline;
+	};
+
+	VkPipeline Build(uint32_t family, const SpecializationKey& key);
+	Variant* FindLocked(uint64_t hash, uint32_t family, const SpecializationKey& key);
+
+	static uint64_t VariantHash(uint32_t family, const SpecializationKey& key);
+
+private:
+	VkDevice m_Device = VK_NULL_HANDLE;
+	const VkAllocationCallbacks* m_pAllocator = nullptr;
+
+	std::mutex m_Mutex;
+	std::vector<VariantBuildFunction> m_Families = {};
+	// Buckets keyed by variant hash, collisions are resolved by comparing the keys
+	std::unordered_map<uint64_t, std::vector<Variant>> m_Variants = {};
+	std::vector<Variant> m_Requested = {};
+	size_t m_VariantCount = 0;
+};
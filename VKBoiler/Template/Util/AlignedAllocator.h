@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stddef.h>
+#include <new>
+
+/// <summary>
+/// Allocator for std::vector storage starting at an Alignment byte boundary, so vector kernels can use aligned loads
+/// </summary>
+template<typename T, size_t Alignment>
+struct AlignedAllocator
+{
+	using value_type = T;
+
+	template<typename U>
+	struct rebind
+	{
+		using other = AlignedAllocator<U, Alignment>;
+	};
+
+	AlignedAllocator() = default;
+	template<typename U>
+	AlignedAllocator(const AlignedAllocator<U, Alignment>&) { }
+
+	T* allocate(size_t count)
+	{
+		return static_cast<T*>(::operator new(count * sizeof(T), std::align_val_t(Alignment)));
+	}
+
+	void deallocate(T* pMemory, size_t)
+	{
+		::operator delete(pMemory, std::align_val_t(Alignment));
+	}
+
+	template<typename U>
+	bool operator==(const AlignedAllocator<U, Alignment>&) const { return true; }
+	template<typename U>
+	bool operator!=(const AlignedAllocator<U, Alignment>&) const { return false; }
+};
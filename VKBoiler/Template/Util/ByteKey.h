@@ -0,0 +1,25 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Cache keys built by appending the raw bytes of every field. Only use with types without padding or pointers
+
+template<typename T>
+void WriteKey(std::string& key, const T& value)
+{
+	key.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template<typename T>
+void WriteKey(std::string& key, const std::vector<T>& values)
+{
+	WriteKey(key, values.size());
+	key.append(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+}
+
+inline void WriteKey(std::string& key, const std::string& value)
+{
+	WriteKey(key, value.size());
+	key.append(value);
+}
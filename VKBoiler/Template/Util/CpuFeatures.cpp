@@ -0,0 +1,69 @@
+#include "CpuFeatures.h"
+
+#include <stdint.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+namespace
+{
+	void Cpuid(uint32_t leaf, uint32_t subleaf, uint32_t registers[4])
+	{
+#if defined(_MSC_VER)
+		int values[4] = {};
+		__cpuidex(values, static_cast<int>(leaf), static_cast<int>(subleaf));
+		for (uint32_t i = 0; i < 4; i++)
+			registers[i] = static_cast<uint32_t>(values[i]);
+#else
+		__cpuid_count(leaf, subleaf, registers[0], registers[1], registers[2], registers[3]);
+#endif
+	}
+
+	// Register state the operating system saves on context switches
+	uint64_t ReadXcr0()
+	{
+#if defined(_MSC_VER)
+		return _xgetbv(0);
+#else
+		uint32_t low = 0, high = 0;
+		__asm__("xgetbv" : "=a"(low), "=d"(high) : "c"(0));
+		return (static_cast<uint64_t>(high) << 32) | low;
+#endif
+	}
+
+	CpuFeatures DetectCpuFeatures()
+	{
+		CpuFeatures features{};
+		uint32_t registers[4] = {};
+		Cpuid(0, 0, registers);
+		uint32_t maxLeaf = registers[0];
+		if (maxLeaf < 1)
+			return features;
+
+		Cpuid(1, 0, registers);
+		bool osxsave = (registers[2] & (1u << 27)) != 0;
+		uint64_t xcr0 = osxsave ? ReadXcr0() : 0;
+		// XMM and YMM, then opmask and both halves of ZMM
+		bool ymmSaved = (xcr0 & 0x6) == 0x6;
+		bool zmmSaved = (xcr0 & 0xe6) == 0xe6;
+
+		features.AVX = ymmSaved && (registers[2] & (1u << 28)) != 0;
+		features.FMA = features.AVX && (registers[2] & (1u << 12)) != 0;
+		if (maxLeaf >= 7)
+		{
+			Cpuid(7, 0, registers);
+			features.AVX2 = features.AVX && (registers[1] & (1u << 5)) != 0;
+			features.AVX512F = zmmSaved && (registers[1] & (1u << 16)) != 0;
+		}
+		return features;
+	}
+}
+
+const CpuFeatures& GetCpuFeatures()
+{
+	static const CpuFeatures features = DetectCpuFeatures();
+	return features;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+// Runtime detection of the x86 vector extensions kernels may dispatch on. Every flag also checks that the operating
+// system saves the registers involved
+
+#if defined(_MSC_VER)
+#define CPU_TARGET(features)
+#else
+// Lets GCC and Clang compile intrinsics of an extension in one function without enabling it for the whole file
+#define CPU_TARGET(features) __attribute__((target(features)))
+#endif
+
+struct CpuFeatures
+{
+	bool AVX = false;
+	bool AVX2 = false;
+	bool FMA = false;
+	bool AVX512F = false;
+};
+
+/// <summary>
+/// Detected once on first use
+/// </summary>
+const CpuFeatures& GetCpuFeatures();
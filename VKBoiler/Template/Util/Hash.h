@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/// <summary>
+/// 64 bit FNV-1a, stable across runs and platforms so it can be stored in files
+/// </summary>
+inline uint64_t HashBytes(const void* pData, size_t size, uint64_t seed = 0xcbf29ce484222325ull)
+{
+	const uint8_t* pBytes = static_cast<const uint8_t*>(pData);
+	uint64_t hash = seed;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= pBytes[i];
+		hash *= 0x100000001b3ull;
+	}
+	return hash;
+}
+
+inline uint64_t HashString(const char* pString)
+{
+	uint64_t hash = 0xcbf29ce484222325ull;
+	for (; *pString != '\0'; pString++)
+	{
+		hash ^= static_cast<uint8_t>(*pString);
+		hash *= 0x100000001b3ull;
+	}
+	return hash;
+}
+
+/// <summary>
+/// Mixes value into an existing hash
+/// </summary>
+inline uint64_t HashCombine(uint64_t hash, uint64_t value)
+{
+	hash ^= value + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2);
+	return hash;
+}
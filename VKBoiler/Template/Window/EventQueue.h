@@ -0,0 +1,51 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <stddef.h>
+
+/// <summary>
+/// Bounded lock-free queue for exactly one producer thread and one consumer thread
+/// </summary>
+template<typename T, size_t Capacity>
+class SpscQueue
+{
+	static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+	/// <summary>
+	/// Producer side, returns false when the queue is full
+	/// </summary>
+	bool Push(const T& value)
+	{
+		size_t tail = m_Tail.load(std::memory_order_relaxed);
+		if (tail - m_Head.load(std::memory_order_acquire) == Capacity)
+			return false;
+
+		m_Items[tail & (Capacity - 1)] = value;
+		m_Tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	/// <summary>
+	/// Consumer side, returns false when the queue is empty
+	/// </summary>
+	bool Pop(T& value)
+	{
+		size_t head = m_Head.load(std::memory_order_relaxed);
+		if (head == m_Tail.load(std::memory_order_acquire))
+			return false;
+
+		value = m_Items[head & (Capacity - 1)];
+		m_Head.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool Empty() const { return m_Head.load(std::memory_order_acquire) == m_Tail.load(std::memory_order_acquire); }
+
+private:
+	// Producer and consumer indices on separate cache lines to avoid false sharing
+	alignas(64) std::atomic<size_t> m_Head{ 0 };
+	alignas(64) std::atomic<size_t> m_Tail{ 0 };
+	alignas(64) std::array<T, Capacity> m_Items = {};
+};
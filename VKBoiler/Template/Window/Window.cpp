@@ -2,35 +2,114 @@
 
 #include <stdio.h>
 #include <string>
+#include <condition_variable>
+#include <mutex>
 
 const char* Window::s_WindowClassName = "VkBoilerWC";
 
 // Returns Window*
 #define GET_WINDOW_HANDLE(hWnd) reinterpret_cast<Window*>(GetWindowLongPtr(hWnd, 0))
 
+// Posted to the window thread to destroy the window from the thread that owns it
+#define WM_VKBOILER_DESTROY (WM_APP + 1)
+
 Window::Window(const std::string& appName, bool allowResizing, uint32_t width, uint32_t height)
 {
 	m_Width = width;
 	m_Height = height;
-	RegisterWC();
-	CreateHWND(appName, allowResizing);
+	m_WakeEvent = CreateEventA(NULL, FALSE, FALSE, NULL);
+
+	// The window has to be created on the thread that pumps its messages, wait until it exists
+	std::mutex mutex;
+	std::condition_variable created;
+	bool done = false;
+
+	m_Thread = std::thread([&, appName, allowResizing]()
+	{
+		m_ThreadId = GetCurrentThreadId();
+		RegisterWC();
+		CreateHWND(appName, allowResizing);
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			done = true;
+		}
+		created.notify_one();
+
+		if (m_Handle != NULL)
+			MessageLoop();
+	});
+
+	std::unique_lock<std::mutex> lock(mutex);
+	created.wait(lock, [&]() { return done; });
 }
 
 Window::~Window()
 {
-	DestroyWindow(m_Handle);
+	if (m_Handle != NULL)
+		PostMessageA(m_Handle, WM_VKBOILER_DESTROY, 0, 0);
+	if (m_Thread.joinable())
+		m_Thread.join();
+	if (m_WakeEvent != NULL)
+		CloseHandle(m_WakeEvent);
 }
 
 void Window::Tick()
+{
+	m_Events.clear();
+
+	WindowEvent event{};
+	while (m_EventQueue.Pop(event))
+	{
+		if (event.Type == WindowEventType::Resize)
+		{
+			m_Width = static_cast<uint32_t>(event.A);
+			m_Height = static_cast<uint32_t>(event.B);
+		}
+		else if (event.Type == WindowEventType::Minimized)
+			m_Minimized = true;
+		else if (event.Type == WindowEventType::Restored)
+			m_Minimized = false;
+		m_Events.push_back(event);
+	}
+}
+
+bool Window::IsOccluded() const
+{
+	return m_Width == 0 || m_Height == 0 || !IsWindowVisible(m_Handle);
+}
+
+void Window::WaitForEvents(DWORD timeoutMs)
+{
+	if (!m_EventQueue.Empty() || m_WakeEvent == NULL)
+		return;
+	WaitForSingleObject(m_WakeEvent, timeoutMs);
+}
+
+void Window::Wake()
+{
+	if (m_WakeEvent != NULL)
+		SetEvent(m_WakeEvent);
+}
+
+void Window::MessageLoop()
 {
 	MSG msg{};
-	while (PeekMessageA(&msg, m_Handle, 0, 0, PM_REMOVE) != 0)
+	while (GetMessageA(&msg, NULL, 0, 0) > 0)
 	{
 		TranslateMessage(&msg);
 		DispatchMessageA(&msg);
 	}
 }
 
+void Window::Publish(const WindowEvent& event)
+{
+	// A full queue means the render thread is stalled, input that old is not worth keeping.
+	// Closing is also stored in m_QuitMessage so it can never get lost
+	m_EventQueue.Push(event);
+	Wake();
+}
+
 void Window::CreateHWND(const std::string& appName, bool allowResizing)
 {
 	std::string title = "VkBoiler: ";
@@ -103,17 +182,100 @@ LRESULT Window::WndProc(HWND hWnd, UINT Msg, WPARAM wParam, LPARAM lParam)
 	{
 		case WM_CLOSE:
 		{
+			// Only flag the request, the window gets destroyed by the owner through the destructor
 			Window* window = GET_WINDOW_HANDLE(hWnd);
 			if (window != nullptr)
-				window->m_QuitMessage = true;
+			{
+				window->m_QuitMessage.store(true, std::memory_order_release);
+				window->Publish({ WindowEventType::Close });
+			}
+			return 0;
+		}
 
+		case WM_VKBOILER_DESTROY:
+		{
+			DestroyWindow(hWnd);
+			return 0;
+		}
+
+		case WM_DESTROY:
+		{
 			PostQuitMessage(0);
 			return 0;
 		}
 
-		default:
+		case WM_SIZE:
 		{
-			return DefWindowProc(hWnd, Msg, wParam, lParam);
+			Window* window = GET_WINDOW_HANDLE(hWnd);
+			if (window == nullptr)
+				break;
+
+			if (wParam == SIZE_MINIMIZED)
+			{
+				window->Publish({ WindowEventType::Minimized });
+			}
+			else
+			{
+				if (wParam == SIZE_RESTORED || wParam == SIZE_MAXIMIZED)
+					window->Publish({ WindowEventType::Restored });
+				window->Publish({ WindowEventType::Resize, static_cast<int32_t>(LOWORD(lParam)), static_cast<int32_t>(HIWORD(lParam)) });
+			}
+			return 0;
 		}
+
+		case WM_ACTIVATE:
+		{
+			Window* window = GET_WINDOW_HANDLE(hWnd);
+			if (window != nullptr)
+				window->Publish({ LOWORD(wParam) != 0 ? WindowEventType::FocusGained : WindowEventType::FocusLost });
+			break;
+		}
+
+		case WM_KEYDOWN:
+		case WM_KEYUP:
+		{
+			Window* window = GET_WINDOW_HANDLE(hWnd);
+			if (window != nullptr)
+				window->Publish({ Msg == WM_KEYDOWN ? WindowEventType::KeyDown : WindowEventType::KeyUp, static_cast<int32_t>(wParam) });
+			return 0;
+		}
+
+		case WM_MOUSEMOVE:
+		case WM_LBUTTONDOWN:
+		case WM_LBUTTONUP:
+		case WM_RBUTTONDOWN:
+		case WM_RBUTTONUP:
+		{
+			Window* window = GET_WINDOW_HANDLE(hWnd);
+			if (window == nullptr)
+				return 0;
+
+			WindowEvent event{};
+			event.X = static_cast<int32_t>(static_cast<short>(LOWORD(lParam)));
+			event.Y = static_cast<int32_t>(static_cast<short>(HIWORD(lParam)));
+			switch (Msg)
+			{
+			case WM_MOUSEMOVE:		event.Type = WindowEventType::MouseMove; break;
+			case WM_LBUTTONDOWN:	event.Type = WindowEventType::MouseButtonDown; event.B = 0; break;
+			case WM_LBUTTONUP:		event.Type = WindowEventType::MouseButtonUp; event.B = 0; break;
+			case WM_RBUTTONDOWN:	event.Type = WindowEventType::MouseButtonDown; event.B = 1; break;
+			case WM_RBUTTONUP:		event.Type = WindowEventType::MouseButtonUp; event.B = 1; break;
+			}
+			window->Publish(event);
+			return 0;
+		}
+
+		case WM_MOUSEWHEEL:
+		{
+			Window* window = GET_WINDOW_HANDLE(hWnd);
+			if (window != nullptr)
+				window->Publish({ WindowEventType::MouseWheel, static_cast<int32_t>(GET_WHEEL_DELTA_WPARAM(wParam)) });
+			return 0;
+		}
+
+		default:
+			break;
 	}
+
+	return DefWindowProc(hWnd, Msg, wParam, lParam);
 }
\ No newline at end of file
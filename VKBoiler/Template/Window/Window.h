@@ -5,25 +5,87 @@
 
 #include <stdint.h>
 #include <string>
+#include <atomic>
+#include <thread>
+#include <vector>
 
+#include "EventQueue.h"
+
+enum class WindowEventType : uint32_t
+{
+	Close,
+	Resize,
+	Minimized,
+	Restored,
+	FocusGained,
+	FocusLost,
+	KeyDown,
+	KeyUp,
+	MouseMove,
+	MouseButtonDown,
+	MouseButtonUp,
+	MouseWheel
+};
+
+struct WindowEvent
+{
+	WindowEventType Type = WindowEventType::Close;
+	/// <summary>
+	/// Resize: width and height, Key: virtual key code in A, Mouse: cursor position, MouseButton: button in B, MouseWheel: delta in A
+	/// </summary>
+	int32_t A = 0;
+	int32_t B = 0;
+	int32_t X = 0;
+	int32_t Y = 0;
+};
+
+/// <summary>
+/// Platform window running its message loop on a dedicated thread, so modal resize/move loops and slow
+/// message handling never stall rendering. Messages are translated to WindowEvents and published through a lock-free queue
+/// </summary>
 class Window
 {
 public:
 	Window(const std::string& appName, bool allowResizing, uint32_t width, uint32_t height);
 	~Window();
 
+	/// <summary>
+	/// Drains the events published by the window thread since the last call. Must be called from the render thread
+	/// </summary>
 	void Tick();
 
+	/// <summary>
+	/// Events drained by the last Tick
+	/// </summary>
+	const std::vector<WindowEvent>& GetEvents() const { return m_Events; }
+
 	uint32_t GetWidth() const { return m_Width; }
 	uint32_t GetHeight() const { return m_Height; }
 
 	HWND GetWindowHandle() const { return m_Handle; }
 
 	bool IsValid() const { return m_Handle != NULL; }
-	bool WantsQuit() const { return m_QuitMessage; }
+	bool WantsQuit() const { return m_QuitMessage.load(std::memory_order_acquire); }
+
+	bool IsMinimized() const { return m_Minimized; }
+	/// <summary>
+	/// Hidden windows and windows without a drawable area cannot show anything that gets rendered
+	/// </summary>
+	bool IsOccluded() const;
+
+	/// <summary>
+	/// Blocks until the window thread publishes an event, Wake is called or the timeout in milliseconds passes
+	/// </summary>
+	void WaitForEvents(DWORD timeoutMs);
+	/// <summary>
+	/// Releases a thread blocked in WaitForEvents, may be called from any thread
+	/// </summary>
+	void Wake();
 
 private:
+	void MessageLoop();
 	void CreateHWND(const std::string& appName, bool allowResizing);
+	void Publish(const WindowEvent& event);
 	static void RegisterWC();
 
 	static LRESULT WndProc(HWND hWnd, UINT Msg, WPARAM wParam, LPARAM lParam);
@@ -31,5 +93,12 @@ private:
 	HWND m_Handle = NULL;
 	uint32_t m_Width = 640, m_Height = 640;
 	static const char* s_WindowClassName;
-	bool m_QuitMessage = false;
-};
\ No newline at end of file
+	std::atomic<bool> m_QuitMessage{ false };
+	bool m_Minimized = false;
+	HANDLE m_WakeEvent = NULL;
+
+	std::thread m_Thread;
+	DWORD m_ThreadId = 0;
+	SpscQueue<WindowEvent, 1024> m_EventQueue;
+	std::vector<WindowEvent> m_Events = {};
+};
@@ -15,18 +15,41 @@ public:
 	void Init()
 	{
 		m_pApp->BaseInit();
-		if(!m_pApp->m_InitializedBase)
+		if(m_pApp->m_InitializedBase)
+		{
 			m_pApp->Init();
+			m_pApp->m_ShaderVariants.Precompile();
+		}
+
+		// Time spent in Init should not be simulated
+		m_pApp->m_LastStepTime = std::chrono::steady_clock::now();
 	}
 	void Tick()
 	{
-		m_pApp->Tick();
+		m_pApp->WaitWhileIdle();
+
+		// Events are published by the window thread, drain them before simulating and rendering
 		m_pApp->WindowUpdate();
+		m_pApp->StepSimulation();
+
+		if (m_pApp->ShouldRender())
+		{
+			// Only frames that are recorded are paced, idle and on-demand ticks never wait
+			m_pApp->m_FramePacer.WaitForFrameStart();
+			// Frame boundary, rebuilt pipelines are never swapped while a frame is recorded
+			m_pApp->m_ShaderHotReload.ApplyPendingReloads();
+			m_pApp->m_PipelineBuilder.BeginFrame();
+			m_pApp->m_DrawQueue.BeginFrame();
+			m_pApp->m_GpuCulling.BeginFrame();
+			m_pApp->m_OcclusionCulling.BeginFrame();
+			m_pApp->m_Meshlets.BeginFrame();
+			m_pApp->Tick();
+		}
 		m_pApp->m_Running = !m_pApp->m_pWindow->WantsQuit();
 	}
 	void Destroy() 
 	{
-		if (!m_pApp->m_InitializedBase)
+		if (m_pApp->m_InitializedBase)
 			m_pApp->Destroy();
 
 		m_pApp->BaseDestroy();